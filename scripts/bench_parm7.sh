@@ -2,12 +2,18 @@
 set -euo pipefail
 
 if [[ $# -lt 1 ]]; then
-  echo "Usage: $0 <bench_binary> [parm7_path] [iterations]" >&2
+  echo "Usage: $0 <bench_binary> [parm7_path] [iterations] [large_natom]" >&2
   exit 1
 fi
 
 bench_bin="$1"
 parm7_path="${2:-$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)/daux/binder_wcn.parm7}"
 iterations="${3:-5}"
+large_natom="${4:-1000000}"
 
+echo "== ${parm7_path}"
 "${bench_bin}" "${parm7_path}" "${iterations}"
+
+# Large-system tier: a generated solvated system well past the 16-bit count range.
+echo "== synthetic:${large_natom}"
+"${bench_bin}" "synthetic:${large_natom}" "${iterations}"
@@ -0,0 +1,325 @@
+#include "include/bonded.hpp"
+#include "include/exclusions.hpp"
+#include "include/forcefield.hpp"
+#include "include/generalized_born.hpp"
+#include "include/neighbors.hpp"
+#include "include/nonbonded.hpp"
+#include "include/one_four.hpp"
+#include "include/parallel.hpp"
+#include "include/parsers.hpp"
+#include "include/simd.hpp"
+#include "include/synthetic.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr std::string_view kSyntheticPrefix = "synthetic:";
+constexpr std::size_t kLookups = std::size_t{1} << 22;
+// Atom cap for the all-pairs Generalized Born benchmark.
+constexpr std::size_t kGbAtoms = 8000;
+
+[[nodiscard]] int parse_iterations(int argc, char const *const argv[]) {
+  if (argc < 3) {
+    return 5;
+  }
+  try {
+    return std::max(1, std::stoi(argv[2]));
+  } catch (...) {
+    return 5;
+  }
+}
+
+[[nodiscard]] rms::Parm7Topology load_topology(std::string_view input) {
+  if (input.starts_with(kSyntheticPrefix)) {
+    auto const natom = std::stoull(std::string(input.substr(kSyntheticPrefix.size())));
+    return rms::parse_parm7_buffer(rms::make_synthetic_parm7(rms::synthetic_system_for_atoms(natom)));
+  }
+  return rms::parse_parm7_file(std::filesystem::path(input));
+}
+
+// Type pairs of random atom pairs, as a neighbour loop would visit them.
+[[nodiscard]] std::vector<std::pair<int, int>> sample_type_pairs(const rms::Parm7Topology &topo) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> atom_dist(0, topo.atom_type_index.size() - 1);
+  std::vector<std::pair<int, int>> pairs(kLookups);
+  for (auto &[type_i, type_j] : pairs) {
+    type_i = topo.atom_type_index[atom_dist(rng)];
+    type_j = topo.atom_type_index[atom_dist(rng)];
+  }
+  return pairs;
+}
+
+// Nearby atom pairs, where exclusions actually occur, visited atom by atom as a
+// neighbour loop would.
+[[nodiscard]] std::vector<std::pair<int, int>> sample_atom_pairs(const rms::Parm7Topology &topo) {
+  std::mt19937 rng(7);
+  int const natom = topo.pointers.natom;
+  std::uniform_int_distribution<int> atom_dist(0, natom - 1);
+  std::uniform_int_distribution<int> gap_dist(1, 100);
+  std::vector<std::pair<int, int>> pairs(kLookups);
+  for (auto &[atom_i, atom_j] : pairs) {
+    atom_i = atom_dist(rng);
+    atom_j = std::min(natom - 1, atom_i + gap_dist(rng));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+template <typename Lookup>
+void run_lookups(std::string_view label, const std::vector<std::pair<int, int>> &pairs, int iterations,
+  Lookup &&lookup) {
+  double checksum = 0.0;
+  auto const start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    for (auto const &[type_i, type_j] : pairs) {
+      checksum += lookup(type_i, type_j);
+    }
+  }
+  auto const end = std::chrono::steady_clock::now();
+  double const elapsed = std::chrono::duration<double>(end - start).count();
+  double const lookups = static_cast<double>(pairs.size()) * static_cast<double>(iterations);
+  fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+  fmt::println("[{}] ns_per_lookup: {:.3f}", label, elapsed / lookups * 1.0e9);
+  fmt::println("[{}] checksum: {:.6e}", label, checksum);
+}
+} // namespace
+
+int main(int argc, char const *const argv[]) {
+  if (argc < 2) {
+    fmt::println(stderr, "Usage: rms_forcefield_bench <parm7_path|synthetic:NATOM> [iterations]");
+    return 1;
+  }
+  auto const topo = load_topology(argv[1]);
+  auto const iterations = parse_iterations(argc, argv);
+  auto const pairs = sample_type_pairs(topo);
+
+  fmt::println("ntypes: {}", topo.pointers.ntypes);
+  fmt::println("lookups: {}", pairs.size());
+  fmt::println("iterations: {}", iterations);
+
+  // Checked lookup through NONBONDED_PARM_INDEX, as the CLI sample does.
+  run_lookups("lj_pair_coeffs", pairs, iterations, [&](int type_i, int type_j) {
+    auto const coeffs = rms::lj_pair_coeffs(topo, type_i, type_j);
+    return coeffs ? coeffs->first + coeffs->second : 0.0;
+  });
+
+  auto const build_start = std::chrono::steady_clock::now();
+  rms::LJTable const table(topo);
+  auto const build_end = std::chrono::steady_clock::now();
+  fmt::println("[lj-table] build_s: {:.6f}", std::chrono::duration<double>(build_end - build_start).count());
+
+  run_lookups("lj-table", pairs, iterations, [&](int type_i, int type_j) {
+    auto const coeffs = table.pair(type_i, type_j);
+    return coeffs.a + coeffs.b;
+  });
+
+  // Exclusion checks: linear scan of the raw parm7 rows (with the prefix sum
+  // precomputed) against the CSR index.
+  auto const atom_pairs = sample_atom_pairs(topo);
+  std::vector<std::size_t> row_start(topo.number_excluded_atoms.size() + 1, 0);
+  for (std::size_t atom = 0; atom < topo.number_excluded_atoms.size(); ++atom) {
+    row_start[atom + 1] = row_start[atom] + static_cast<std::size_t>(topo.number_excluded_atoms[atom]);
+  }
+  run_lookups("exclusions-scan", atom_pairs, iterations, [&](int atom_i, int atom_j) {
+    auto const low = static_cast<std::size_t>(std::min(atom_i, atom_j));
+    int const high = std::max(atom_i, atom_j);
+    auto const first = topo.excluded_atoms_list.begin() + static_cast<std::ptrdiff_t>(row_start[low]);
+    auto const last = topo.excluded_atoms_list.begin() + static_cast<std::ptrdiff_t>(row_start[low + 1]);
+    return std::find(first, last, high) != last ? 1.0 : 0.0;
+  });
+
+  auto const exclusions_start = std::chrono::steady_clock::now();
+  rms::ExclusionList const exclusions(topo);
+  auto const exclusions_end = std::chrono::steady_clock::now();
+  fmt::println("[exclusions-csr] build_s: {:.6f}",
+    std::chrono::duration<double>(exclusions_end - exclusions_start).count());
+  run_lookups("exclusions-csr", atom_pairs, iterations,
+    [&](int atom_i, int atom_j) { return exclusions.excluded(atom_i, atom_j) ? 1.0 : 0.0; });
+
+  // 1-4 pair lists: an ordered map keyed by pair against the radix-sorted
+  // OneFourList at 1, 2, 4, ... threads.
+  std::size_t const max_threads = rms::resolve_thread_count(0);
+  auto const run_one_four = [&](const rms::Parm7Topology &source) {
+    auto const set_start = std::chrono::steady_clock::now();
+    std::map<std::pair<int, int>, int> naive;
+    for (std::size_t dihedral = 0; dihedral < source.dihedral_i.size(); ++dihedral) {
+      if ((source.dihedral_flags[dihedral] & 0x1U) == 0) {
+        naive.try_emplace(
+          std::minmax(source.dihedral_i[dihedral], source.dihedral_l[dihedral]), source.dihedral_type[dihedral]);
+      }
+    }
+    double const set_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - set_start).count();
+    fmt::println("[one-four-map] build_s: {:.6f} ({} dihedrals, {} pairs)", set_elapsed, source.dihedral_i.size(),
+      naive.size());
+    for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+      auto const start = std::chrono::steady_clock::now();
+      std::size_t kept = 0;
+      for (int iter = 0; iter < iterations; ++iter) {
+        kept = rms::OneFourList(source, threads).size();
+      }
+      double const elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+      fmt::println("[one-four-threads={}] build_s: {:.6f} ({} pairs)", threads, elapsed, kept);
+      if (threads == max_threads) {
+        break;
+      }
+    }
+  };
+
+  // Neighbour lists need coordinates, which only the synthetic systems have.
+  std::string_view const input = argv[1];
+  if (!input.starts_with(kSyntheticPrefix)) {
+    run_one_four(topo);
+    return 0;
+  }
+  auto const system =
+    rms::synthetic_system_for_atoms(std::stoull(std::string(input.substr(kSyntheticPrefix.size()))));
+  auto const positions = rms::make_synthetic_coordinates(system).positions;
+  auto const box = rms::PeriodicBox::from_topology(topo);
+  double const cutoff = box ? std::min(8.0, box->max_cutoff() - 2.0) : 8.0;
+  fmt::println("neighbor cutoff: {:.3f} + skin 2.0", cutoff);
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    rms::VerletList list(rms::NeighborOptions{.cutoff = cutoff, .skin = 2.0, .threads = threads}, &exclusions);
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      list.rebuild(positions, box);
+    }
+    double const elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+    auto const check_start = std::chrono::steady_clock::now();
+    bool const rebuilt = list.update(positions, box);
+    double const check = std::chrono::duration<double>(std::chrono::steady_clock::now() - check_start).count();
+    auto const label = fmt::format("verlet-threads={}", threads);
+    fmt::println("[{}] build_s: {:.6f}", label, elapsed);
+    fmt::println("[{}] ns_per_atom: {:.1f}", label, elapsed / static_cast<double>(positions.size()) * 1.0e9);
+    fmt::println("[{}] pairs: {} ({:.1f} per atom)", label, list.pair_count(),
+      static_cast<double>(list.pair_count()) / static_cast<double>(positions.size()));
+    fmt::println("[{}] skin_check_s: {:.6f} (rebuilt: {})", label, check, rebuilt);
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  // Nonbonded energies on a prebuilt list: every SIMD tier on one thread,
+  // energy only and with forces, then the detected tier at 1, 2, 4, ... threads.
+  auto const run_nonbonded = [&](rms::SimdLevel level, std::size_t threads, bool with_forces) {
+    rms::NonbondedEngine engine(
+      topo, rms::NonbondedOptions{.cutoff = cutoff, .skin = 2.0, .threads = threads, .level = level});
+    rms::Coordinates forces;
+    rms::Coordinates *const out = with_forces ? &forces : nullptr;
+    static_cast<void>(engine.evaluate(positions, box, out));
+    double checksum = 0.0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      checksum += engine.evaluate(positions, box, out).total();
+    }
+    double const elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+    auto const label = fmt::format("nonbonded-{}-{}-threads={}", rms::simd_level_name(level),
+      with_forces ? "forces" : "energy", threads);
+    fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+    fmt::println("[{}] ns_per_pair: {:.3f}", label,
+      elapsed / static_cast<double>(engine.neighbors().pair_count()) * 1.0e9);
+    fmt::println("[{}] checksum: {:.6e}", label, checksum / iterations);
+  };
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+    if (level > rms::detected_simd_level()) {
+      break;
+    }
+    run_nonbonded(level, 1, false);
+    run_nonbonded(level, 1, true);
+  }
+  for (std::size_t threads = 2; threads <= max_threads; threads *= 2) {
+    run_nonbonded(rms::detected_simd_level(), threads, true);
+  }
+
+  // 1-4 pairs and bonded terms on a chain of the same length (a water box
+  // has no dihedrals), jittered so no angle is straight; same tiers and
+  // threads.
+  rms::SyntheticSystem const chain{.solute_atoms = positions.size(), .waters = 0};
+  auto const chain_topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(chain));
+  run_one_four(chain_topo);
+  auto chain_positions = rms::make_synthetic_coordinates(chain).positions;
+  std::mt19937 rng(3);
+  std::normal_distribution<double> jitter(0.0, 0.2);
+  for (std::size_t atom = 0; atom < chain_positions.size(); ++atom) {
+    chain_positions.x[atom] += jitter(rng);
+    chain_positions.y[atom] += jitter(rng);
+    chain_positions.z[atom] += jitter(rng);
+  }
+  auto const run_bonded = [&](rms::SimdLevel level, std::size_t threads, bool with_forces) {
+    rms::BondedEngine const engine(chain_topo, rms::BondedOptions{.threads = threads, .level = level});
+    rms::Coordinates forces;
+    rms::Coordinates *const out = with_forces ? &forces : nullptr;
+    static_cast<void>(engine.evaluate(chain_positions, out));
+    double checksum = 0.0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      checksum += engine.evaluate(chain_positions, out).total();
+    }
+    double const elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+    auto const terms = engine.bond_count() + engine.angle_count() + engine.dihedral_count();
+    auto const label = fmt::format("bonded-{}-{}-threads={}", rms::simd_level_name(level),
+      with_forces ? "forces" : "energy", threads);
+    fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+    fmt::println("[{}] terms_per_s: {:.3e} ({} terms, {} / {} / {} batches)", label,
+      static_cast<double>(terms) / elapsed, terms, engine.bond_batches().size() - 1,
+      engine.angle_batches().size() - 1, engine.dihedral_batches().size() - 1);
+    fmt::println("[{}] checksum: {:.6e}", label, checksum / iterations);
+  };
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+    if (level > rms::detected_simd_level()) {
+      break;
+    }
+    run_bonded(level, 1, false);
+    run_bonded(level, 1, true);
+  }
+  for (std::size_t threads = 2; threads <= max_threads; threads *= 2) {
+    run_bonded(rms::detected_simd_level(), threads, true);
+  }
+
+  // Generalized Born is all-pairs, so it runs on a compact system of at most
+  // kGbAtoms atoms (MM/GBSA solute sized); same tiers and threads.
+  auto const gb_system = rms::synthetic_system_for_atoms(std::min(positions.size(), kGbAtoms));
+  auto const gb_topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(gb_system));
+  auto const gb_positions = rms::make_synthetic_coordinates(gb_system).positions;
+  auto const run_gb = [&](rms::SimdLevel level, std::size_t threads) {
+    rms::GeneralizedBornEngine engine(gb_topo, rms::GeneralizedBornOptions{.threads = threads, .level = level});
+    static_cast<void>(engine.evaluate(gb_positions));
+    double checksum = 0.0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      checksum += engine.evaluate(gb_positions);
+    }
+    double const elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+    auto const natom = static_cast<double>(engine.atom_count());
+    auto const label = fmt::format("gb-{}-threads={}", rms::simd_level_name(level), threads);
+    fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+    fmt::println("[{}] ns_per_atom_pair: {:.3f} ({} atoms)", label, elapsed / (natom * natom) * 1.0e9,
+      engine.atom_count());
+    fmt::println("[{}] checksum: {:.6e}", label, checksum / iterations);
+  };
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+    if (level > rms::detected_simd_level()) {
+      break;
+    }
+    run_gb(level, 1);
+  }
+  for (std::size_t threads = 2; threads <= max_threads; threads *= 2) {
+    run_gb(rms::detected_simd_level(), threads);
+  }
+  return 0;
+}
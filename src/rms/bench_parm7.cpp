@@ -1,20 +1,49 @@
+#include "include/bond_graph.hpp"
+#include "include/coordinates.hpp"
+#include "include/fixed_width.hpp"
+#include "include/parallel.hpp"
 #include "include/parsers.hpp"
+#include "include/synthetic.hpp"
+#include "include/topology_cache.hpp"
+#include "include/trajectory.hpp"
 
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace {
-[[nodiscard]] std::filesystem::path parse_path(int argc, char const *const argv[]) {
+constexpr std::string_view kSyntheticPrefix = "synthetic:";
+
+[[nodiscard]] std::string parse_input(int argc, char const *const argv[]) {
   if (argc < 2) {
     return {};
   }
-  return std::filesystem::path(argv[1]);
+  return argv[1];
+}
+
+// "synthetic:<natom>" generates a solvated system of at least that many atoms
+// and writes it to a temporary file, so the file-based modes see real I/O.
+[[nodiscard]] std::filesystem::path materialize_synthetic(std::string_view spec) {
+  auto const natom = std::stoull(std::string(spec.substr(kSyntheticPrefix.size())));
+  auto const text = rms::make_synthetic_parm7(rms::synthetic_system_for_atoms(natom));
+  auto const path = std::filesystem::temp_directory_path() / fmt::format("rms_synthetic_{}.parm7", natom);
+  std::ofstream file(path, std::ios::binary);
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw std::runtime_error(fmt::format("Failed to write {}", path.string()));
+  }
+  return path;
 }
 
 [[nodiscard]] int parse_iterations(int argc, char const *const argv[]) {
@@ -27,36 +56,296 @@ namespace {
     return 5;
   }
 }
-} // namespace
 
-int main(int argc, char const *const argv[]) {
-  auto const path = parse_path(argc, argv);
-  if (path.empty()) {
-    fmt::println(stderr, "Usage: rms_parm7_bench <parm7_path> [iterations]");
-    return 1;
+[[nodiscard]] std::vector<char> read_file(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+struct BenchResult {
+  double elapsed_s = 0.0;
+  std::size_t checksum = 0;
+};
+
+template <typename Parse>
+[[nodiscard]] BenchResult run_bench(int iterations, Parse &&parse) {
+  BenchResult result;
+  auto const start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    auto topo = parse();
+    result.checksum += topo.atom_name.size();
+    result.checksum += topo.bond_i.size();
+  }
+  auto const end = std::chrono::steady_clock::now();
+  result.elapsed_s = std::chrono::duration<double>(end - start).count();
+  return result;
+}
+
+// Re-encodes the integer payload of a topology as %FORMAT(10I8) text.
+[[nodiscard]] std::string encode_i8_lines(const rms::Parm7Topology &topo) {
+  std::string text;
+  auto append = [&](std::span<const int> values) {
+    for (int const value : values) {
+      fmt::format_to(std::back_inserter(text), "{:8d}", value);
+    }
+  };
+  append(topo.excluded_atoms_list);
+  append(topo.nonbonded_parm_index);
+  append(topo.residue_pointer);
+  append(topo.bond_i);
+  append(topo.bond_j);
+  append(topo.angle_i);
+  append(topo.angle_j);
+  append(topo.angle_k);
+  append(topo.dihedral_i);
+  append(topo.dihedral_l);
+  text.resize(text.size() - text.size() % (10 * rms::kI8FieldWidth));
+  return text;
+}
+
+void bench_i8_decode(const std::string &text, int iterations) {
+  std::size_t const line_bytes = 10 * rms::kI8FieldWidth;
+  std::size_t const lines = text.size() / line_bytes;
+  std::vector<int> out(10);
+
+  auto const top = rms::detected_simd_level();
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Sse42, rms::SimdLevel::Avx2}) {
+    if (level > top) {
+      break;
+    }
+    std::size_t checksum = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      for (std::size_t line = 0; line < lines; ++line) {
+        std::string_view const view(text.data() + line * line_bytes, line_bytes);
+        checksum += rms::decode_i8_fields(view, out, level);
+        checksum += static_cast<std::size_t>(out[9]);
+      }
+    }
+    auto const end = std::chrono::steady_clock::now();
+    double const elapsed = std::chrono::duration<double>(end - start).count();
+    double const total_bytes = static_cast<double>(lines * line_bytes) * static_cast<double>(iterations);
+    fmt::println("[i8-{}] elapsed_s: {:.6f}", rms::simd_level_name(level), elapsed);
+    fmt::println("[i8-{}] throughput_GBps: {:.6f}", rms::simd_level_name(level), total_bytes / elapsed / 1.0e9);
+    fmt::println("[i8-{}] checksum: {}", rms::simd_level_name(level), checksum);
   }
+}
 
-  auto const iterations = parse_iterations(argc, argv);
-  std::uintmax_t const bytes = std::filesystem::file_size(path);
+// Re-encodes the real payload of a topology as %FORMAT(5E16.8) text.
+[[nodiscard]] std::string encode_e16_lines(const rms::Parm7Topology &topo) {
+  std::string text;
+  auto append = [&](std::span<const double> values) {
+    for (double const value : values) {
+      fmt::format_to(std::back_inserter(text), "{:16.8E}", value);
+    }
+  };
+  append(topo.charge);
+  append(topo.mass);
+  append(topo.radii);
+  append(topo.screen);
+  append(topo.lennard_jones_acoeff);
+  append(topo.lennard_jones_bcoeff);
+  text.resize(text.size() - text.size() % (5 * 16));
+  return text;
+}
 
-  std::size_t checksum = 0;
+void bench_e16_decode(const std::string &text, int iterations) {
+  std::size_t const line_bytes = 5 * 16;
+  std::size_t const lines = text.size() / line_bytes;
+  std::vector<double> out(5);
+
+  double checksum = 0.0;
   auto const start = std::chrono::steady_clock::now();
   for (int iter = 0; iter < iterations; ++iter) {
-    auto topo = rms::parse_parm7_file(path);
-    checksum += topo.atom_name.size();
-    checksum += topo.bond_i.size();
+    for (std::size_t line = 0; line < lines; ++line) {
+      std::string_view const view(text.data() + line * line_bytes, line_bytes);
+      checksum += static_cast<double>(rms::decode_real_fields(view, 16, out));
+      checksum += out[4];
+    }
   }
   auto const end = std::chrono::steady_clock::now();
+  double const elapsed = std::chrono::duration<double>(end - start).count();
+  double const total_bytes = static_cast<double>(lines * line_bytes) * static_cast<double>(iterations);
+  fmt::println("[e16] elapsed_s: {:.6f}", elapsed);
+  fmt::println("[e16] throughput_GBps: {:.6f}", total_bytes / elapsed / 1.0e9);
+  fmt::println("[e16] checksum: {:.6e}", checksum);
+}
 
-  std::chrono::duration<double> const elapsed = end - start;
+void report(std::string_view label, const BenchResult &result, std::uintmax_t bytes, int iterations) {
   double const total_bytes = static_cast<double>(bytes) * static_cast<double>(iterations);
-  double const gb_per_s = total_bytes / elapsed.count() / 1.0e9;
+  fmt::println("[{}] elapsed_s: {:.6f}", label, result.elapsed_s);
+  fmt::println("[{}] throughput_GBps: {:.6f}", label, total_bytes / result.elapsed_s / 1.0e9);
+  fmt::println("[{}] checksum: {}", label, result.checksum);
+}
+} // namespace
+
+int main(int argc, char const *const argv[]) {
+  auto const input = parse_input(argc, argv);
+  if (input.empty()) {
+    fmt::println(stderr, "Usage: rms_parm7_bench <parm7_path|synthetic:NATOM> [iterations]");
+    return 1;
+  }
+
+  bool const synthetic = input.starts_with(kSyntheticPrefix);
+  auto const path = synthetic ? materialize_synthetic(input) : std::filesystem::path(input);
+  auto const iterations = parse_iterations(argc, argv);
+  std::uintmax_t const bytes = std::filesystem::file_size(path);
 
   fmt::println("parm7 bytes: {}", bytes);
   fmt::println("iterations: {}", iterations);
-  fmt::println("elapsed_s: {:.6f}", elapsed.count());
-  fmt::println("throughput_GBps: {:.6f}", gb_per_s);
-  fmt::println("checksum: {}", checksum);
 
+  // Includes open + mmap + parse on every iteration.
+  auto const file_result = run_bench(iterations, [&] { return rms::parse_parm7_file(path); });
+  report("file", file_result, bytes, iterations);
+
+  // Pure parse cost over bytes that are already resident.
+  auto const contents = read_file(path);
+  auto const buffer_result = run_bench(iterations, [&] { return rms::parse_parm7_buffer(contents); });
+  report("buffer", buffer_result, bytes, iterations);
+
+  // Section-parallel scaling: same in-memory parse, pinned to 1, 2, 4, ... threads.
+  std::size_t const max_threads = rms::resolve_thread_count(0);
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    rms::Parm7ParseOptions const options{.threads = threads};
+    auto const result = run_bench(iterations, [&] { return rms::parse_parm7_buffer(contents, options); });
+    report(fmt::format("threads={}", threads), result, bytes, iterations);
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  // Selective load: per-atom metadata only, everything else deferred.
+  rms::Parm7ParseOptions const atoms_only{.sections = rms::kParm7AtomSections};
+  auto const atoms_result = run_bench(iterations, [&] { return rms::parse_parm7_buffer(contents, atoms_only); });
+  report("sections=atoms", atoms_result, bytes, iterations);
+
+  // Arrays carved from one arena sized from POINTERS; teardown is a single release.
+  rms::Parm7ParseOptions const arena{.use_arena = true};
+  auto const arena_result = run_bench(iterations, [&] { return rms::parse_parm7_buffer(contents, arena); });
+  report("arena", arena_result, bytes, iterations);
+
+  auto const topo = rms::parse_parm7_buffer(contents);
+
+  // Derived structures, to compare with the parse itself.
+  BenchResult graph_result;
+  auto const graph_start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    rms::BondGraph const graph(topo);
+    graph_result.checksum += graph.adjacency().size();
+  }
+  graph_result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - graph_start).count();
+  report("bond-graph", graph_result, bytes, iterations);
+  rms::BondGraph const graph(topo);
+  BenchResult molecules_result;
+  auto const molecules_start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    molecules_result.checksum += rms::find_molecules(graph).size();
+  }
+  molecules_result.elapsed_s =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - molecules_start).count();
+  report("molecules", molecules_result, bytes, iterations);
+
+  // Restart with positions, velocities and box for a system of the same size: open + mmap + decode.
+  auto const rst7_path = std::filesystem::temp_directory_path() / "rms_parm7_bench.rst7";
+  {
+    std::ofstream rst7_file(rst7_path, std::ios::binary | std::ios::trunc);
+    rst7_file << rms::make_synthetic_rst7(
+      rms::synthetic_system_for_atoms(static_cast<std::size_t>(topo.pointers.natom)), true);
+  }
+  std::uintmax_t const rst7_bytes = std::filesystem::file_size(rst7_path);
+  fmt::println("rst7 bytes: {}", rst7_bytes);
+  BenchResult rst7_result;
+  auto const rst7_start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    auto const rst7 = rms::parse_rst7_file(rst7_path);
+    rst7_result.checksum += rst7.natom();
+  }
+  rst7_result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - rst7_start).count();
+  report("rst7", rst7_result, rst7_bytes, iterations);
+  std::filesystem::remove(rst7_path);
+
+  // ASCII trajectory of up to ~256 MB for a system of the same size: index scan, sidecar reuse, then every frame
+  // decoded in order and in parallel.
+  auto const mdcrd_path = std::filesystem::temp_directory_path() / "rms_parm7_bench.mdcrd";
+  {
+    auto const system = rms::synthetic_system_for_atoms(static_cast<std::size_t>(topo.pointers.natom));
+    auto const start = rms::make_synthetic_coordinates(system);
+    auto const frame_bytes = static_cast<std::size_t>(topo.pointers.natom) * 3 * 81 / 10 + 32;
+    auto const frames = std::clamp<std::size_t>((std::size_t{256} << 20U) / frame_bytes, 4, 1000);
+    std::ofstream mdcrd_file(mdcrd_path, std::ios::binary | std::ios::trunc);
+    rms::MdcrdFrame frame{.positions = {}, .box = std::array{40.0, 40.0, 40.0}};
+    frame.positions.x.assign(static_cast<std::size_t>(topo.pointers.natom), 0.0);
+    frame.positions.y = frame.positions.x;
+    frame.positions.z = frame.positions.x;
+    std::string text = "synthetic trajectory\n";
+    for (std::size_t idx = 0; idx < frames; ++idx) {
+      for (std::size_t atom = 0; atom < frame.positions.size(); ++atom) {
+        auto const source = atom % start.positions.size();
+        frame.positions.x[atom] = start.positions.x[source] + static_cast<double>(idx) * 0.01;
+        frame.positions.y[atom] = start.positions.y[source];
+        frame.positions.z[atom] = start.positions.z[source];
+      }
+      rms::append_mdcrd_frame(text, frame);
+      mdcrd_file << text;
+      text.clear();
+    }
+  }
+  std::filesystem::remove(rms::mdcrd_index_path(mdcrd_path));
+  std::uintmax_t const mdcrd_bytes = std::filesystem::file_size(mdcrd_path);
+  fmt::println("mdcrd bytes: {}", mdcrd_bytes);
+  auto const time_mdcrd = [&](std::string_view label, auto &&body) {
+    BenchResult result;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      result.checksum += body();
+    }
+    result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report(label, result, mdcrd_bytes, iterations);
+  };
+  time_mdcrd("mdcrd-index", [&] {
+    return rms::MdcrdTrajectory(mdcrd_path, topo, rms::MdcrdOptions{.use_index_file = false}).frame_count();
+  });
+  static_cast<void>(rms::MdcrdTrajectory(mdcrd_path, topo));
+  time_mdcrd("mdcrd-sidecar", [&] { return rms::MdcrdTrajectory(mdcrd_path, topo).frame_count(); });
+  rms::MdcrdTrajectory const trajectory(mdcrd_path, topo);
+  time_mdcrd("mdcrd-frames", [&] {
+    std::size_t checksum = 0;
+    trajectory.for_each_frame(0, trajectory.frame_count(),
+      [&](std::size_t, const rms::MdcrdFrame &frame) { checksum += frame.positions.size(); });
+    return checksum;
+  });
+  time_mdcrd("mdcrd-parallel", [&] {
+    std::atomic<std::size_t> checksum{0};
+    trajectory.for_each_frame_parallel(0, trajectory.frame_count(), 0,
+      [&](std::size_t, const rms::MdcrdFrame &frame) { checksum += frame.positions.size(); });
+    return checksum.load();
+  });
+  std::filesystem::remove(rms::mdcrd_index_path(mdcrd_path));
+  std::filesystem::remove(mdcrd_path);
+
+  // Startup from the binary cache: materialized topology, then the zero-copy view alone.
+  auto const cache_path = std::filesystem::temp_directory_path() / "rms_parm7_bench.rmscache";
+  rms::write_topology_cache(cache_path, topo, rms::topology_cache_key(path));
+  fmt::println("cache bytes: {}", std::filesystem::file_size(cache_path));
+  auto const cache_result = run_bench(iterations, [&] { return rms::TopologyCacheView(cache_path).to_topology(); });
+  report("cache-load", cache_result, bytes, iterations);
+  BenchResult view_result;
+  auto const view_start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    rms::TopologyCacheView const view(cache_path);
+    view_result.checksum += view.array(&rms::Parm7Topology::atom_name).size();
+    view_result.checksum += view.array(&rms::Parm7Topology::bond_i).size();
+  }
+  view_result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - view_start).count();
+  report("cache-view", view_result, bytes, iterations);
+  std::filesystem::remove(cache_path);
+
+  // Field decoders in isolation: integers per SIMD tier, then Fortran reals.
+  bench_i8_decode(encode_i8_lines(topo), iterations);
+  bench_e16_decode(encode_e16_lines(topo), iterations);
+
+  if (synthetic) {
+    std::filesystem::remove(path);
+  }
   return 0;
 }
@@ -0,0 +1,213 @@
+#include "include/coordinates.hpp"
+#include "include/mask.hpp"
+#include "include/parsers.hpp"
+#include "include/rmsd.hpp"
+#include "include/simd.hpp"
+#include "include/pairwise.hpp"
+#include "include/parallel.hpp"
+#include "include/synthetic.hpp"
+#include "include/trajectory.hpp"
+#include "include/trajectory_rmsd.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr std::string_view kSyntheticPrefix = "synthetic:";
+constexpr std::size_t kFrames = 32;
+
+[[nodiscard]] int parse_iterations(int argc, char const *const argv[]) {
+  if (argc < 3) {
+    return 20;
+  }
+  try {
+    return std::max(1, std::stoi(argv[2]));
+  } catch (...) {
+    return 20;
+  }
+}
+
+// Frames are the reference rotated about z by a growing angle, shifted and
+// jittered, so every one needs a real superposition.
+[[nodiscard]] std::vector<rms::Coordinates> make_frames(const rms::Coordinates &reference) {
+  std::mt19937_64 rng(11);
+  std::normal_distribution<double> jitter(0.0, 0.5);
+  std::vector<rms::Coordinates> frames;
+  frames.reserve(kFrames);
+  for (std::size_t idx = 0; idx < kFrames; ++idx) {
+    double const angle = 0.05 * static_cast<double>(idx + 1);
+    rms::Coordinates frame(reference.size());
+    for (std::size_t atom = 0; atom < reference.size(); ++atom) {
+      double const x = reference.x[atom];
+      double const y = reference.y[atom];
+      frame.x[atom] = std::cos(angle) * x - std::sin(angle) * y + 10.0 + jitter(rng);
+      frame.y[atom] = std::sin(angle) * x + std::cos(angle) * y - 4.0 + jitter(rng);
+      frame.z[atom] = reference.z[atom] + 2.0 + jitter(rng);
+    }
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+template <typename T>
+void run_rmsd(std::string_view label, const rms::BasicRmsdReference<T> &reference,
+  const std::vector<rms::BasicCoordinates<T>> &frames, int iterations) {
+  double checksum = 0.0;
+  auto const start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iterations; ++iter) {
+    for (auto const &frame : frames) {
+      checksum += reference.rmsd(frame);
+    }
+  }
+  auto const end = std::chrono::steady_clock::now();
+  double const elapsed = std::chrono::duration<double>(end - start).count();
+  double const evaluations = static_cast<double>(frames.size()) * static_cast<double>(iterations);
+  fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+  fmt::println("[{}] ns_per_frame: {:.1f}", label, elapsed / evaluations * 1.0e9);
+  fmt::println("[{}] ns_per_atom_frame: {:.4f}", label,
+    elapsed / (evaluations * static_cast<double>(reference.size())) * 1.0e9);
+  fmt::println("[{}] checksum: {:.6e}", label, checksum);
+}
+} // namespace
+
+int main(int argc, char const *const argv[]) {
+  if (argc < 2 || !std::string_view(argv[1]).starts_with(kSyntheticPrefix)) {
+    fmt::println(stderr, "Usage: rms_rmsd_bench synthetic:NATOM [iterations]");
+    return 1;
+  }
+  auto const natom = std::stoull(std::string(std::string_view(argv[1]).substr(kSyntheticPrefix.size())));
+  auto const system = rms::synthetic_system_for_atoms(natom);
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const reference = rms::make_synthetic_coordinates(system).positions;
+  auto const iterations = parse_iterations(argc, argv);
+  auto const frames = make_frames(reference);
+  std::vector<rms::CoordinatesF> frames_f;
+  std::ranges::transform(frames, std::back_inserter(frames_f), [](auto const &frame) { return rms::to_float(frame); });
+  auto const reference_f = rms::to_float(reference);
+
+  fmt::println("natom: {}", reference.size());
+  fmt::println("frames: {}", frames.size());
+  fmt::println("iterations: {}", iterations);
+
+  // Mask compilation: bulk sweeps of packed names, interned ids and residue ranges.
+  for (std::string_view const mask : {"@O", "!:WAT", ":WAT@H1,H2", ":2-100000 & @O", "@C*", "@*1", "@%HW", "@/O"}) {
+    std::size_t selected = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < iterations; ++iter) {
+      selected += rms::compile_mask(mask, topo).size();
+    }
+    double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto const label = fmt::format("mask {}", mask);
+    fmt::println("[{}] ms_per_compile: {:.3f}", label, elapsed / static_cast<double>(iterations) * 1.0e3);
+    fmt::println("[{}] selected: {}", label, selected / static_cast<std::size_t>(iterations));
+  }
+
+  // Every tier up to the one this CPU supports, in double and float, plain and mass-weighted.
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+    if (level > rms::detected_simd_level()) {
+      break;
+    }
+    auto const name = rms::simd_level_name(level);
+    run_rmsd(fmt::format("qcp-{}-f64", name), rms::RmsdReference(reference, std::span<const double>{}, level), frames,
+      iterations);
+    run_rmsd(fmt::format("qcp-{}-f32", name), rms::RmsdReferenceF(reference_f, std::span<const double>{}, level),
+      frames_f, iterations);
+    run_rmsd(fmt::format("qcp-{}-f64-mass", name), rms::RmsdReference(reference, topo, level), frames, iterations);
+    run_rmsd(fmt::format("qcp-{}-f32-mass", name), rms::RmsdReferenceF(reference_f, topo, level), frames_f,
+      iterations);
+  }
+
+  auto const write_trajectory = [&](const std::filesystem::path &path, std::size_t count) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::string text = "rms_rmsd_bench\n";
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      rms::append_mdcrd_frame(text, rms::MdcrdFrame{.positions = frames[idx % frames.size()], .box = std::nullopt});
+      file << text;
+      text.clear();
+    }
+  };
+
+  // Whole-trajectory driver (decode + fit per frame) on an ASCII trajectory of
+  // up to ~128 MB, at 1, 2, 4, ... threads.
+  auto const mdcrd_path = std::filesystem::temp_directory_path() / "rms_rmsd_bench.mdcrd";
+  {
+    auto const frame_bytes = reference.size() * 3 * 81 / 10 + 1;
+    write_trajectory(mdcrd_path, std::clamp<std::size_t>((std::size_t{128} << 20U) / frame_bytes, 8, 4096));
+  }
+  {
+    rms::MdcrdTrajectory const trajectory(mdcrd_path, topo, rms::MdcrdOptions{.use_index_file = false});
+    rms::RmsdReference const fit(reference);
+    fmt::println("trajectory frames: {}", trajectory.frame_count());
+    double serial_s = 0.0;
+    std::size_t const max_threads = rms::resolve_thread_count(0);
+    for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+      double checksum = 0.0;
+      auto const start = std::chrono::steady_clock::now();
+      auto const result = rms::trajectory_rmsd(trajectory, fit, rms::TrajectoryRmsdOptions{.threads = threads});
+      double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      for (double const value : result.rmsd) {
+        checksum += value;
+      }
+      serial_s = threads == 1 ? elapsed : serial_s;
+      auto const label = fmt::format("trajectory-threads={}", threads);
+      fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+      fmt::println("[{}] frames_per_s: {:.1f}", label, static_cast<double>(trajectory.frame_count()) / elapsed);
+      fmt::println("[{}] speedup: {:.2f}", label, serial_s / elapsed);
+      fmt::println("[{}] checksum: {:.6e}", label, checksum);
+      if (threads == max_threads) {
+        break;
+      }
+    }
+  }
+  std::filesystem::remove(mdcrd_path);
+
+  // All-vs-all matrix over enough frames for ~2e9 atom pairs, with cache-sized
+  // tiles and with one-frame tiles (a plain double loop).
+  auto const pairwise_path = std::filesystem::temp_directory_path() / "rms_rmsd_bench_pairwise.mdcrd";
+  auto const matrix_path = std::filesystem::temp_directory_path() / "rms_rmsd_bench.rmsmat";
+  auto const pairs_wanted = 2.0e9 / static_cast<double>(reference.size());
+  write_trajectory(
+    pairwise_path, std::clamp<std::size_t>(static_cast<std::size_t>(std::sqrt(2.0 * pairs_wanted)), 8, 20000));
+  {
+    rms::MdcrdTrajectory const trajectory(pairwise_path, topo, rms::MdcrdOptions{.use_index_file = false});
+    auto const pack_start = std::chrono::steady_clock::now();
+    rms::PackedFrames const packed(trajectory);
+    fmt::println("[pairwise] pack_s: {:.6f}",
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - pack_start).count());
+    auto const count = packed.frame_count();
+    double const pairs = static_cast<double>(count) * static_cast<double>(count - 1) / 2.0;
+    fmt::println("pairwise frames: {}", count);
+    for (std::size_t const block : {std::size_t{0}, std::size_t{1}}) {
+      auto const start = std::chrono::steady_clock::now();
+      rms::write_pairwise_rmsd(matrix_path, packed, rms::PairwiseRmsdOptions{.block_frames = block});
+      double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      rms::RmsdMatrix const matrix(matrix_path);
+      double checksum = 0.0;
+      for (float const value : matrix.condensed()) {
+        checksum += static_cast<double>(value);
+      }
+      auto const label = block == 0 ? std::string("pairwise-tiled") : std::string("pairwise-untiled");
+      fmt::println("[{}] elapsed_s: {:.6f}", label, elapsed);
+      fmt::println("[{}] ns_per_pair: {:.1f}", label, elapsed / pairs * 1.0e9);
+      fmt::println("[{}] ns_per_atom_pair: {:.4f}", label,
+        elapsed / (pairs * static_cast<double>(reference.size())) * 1.0e9);
+      fmt::println("[{}] checksum: {:.6e}", label, checksum);
+    }
+  }
+  std::filesystem::remove(matrix_path);
+  std::filesystem::remove(pairwise_path);
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include "include/bond_graph.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kItemsPerTask = 16384;
+
+[[nodiscard]] std::size_t task_count(std::size_t items) { return (items + kItemsPerTask - 1) / kItemsPerTask; }
+
+template <typename F>
+void for_each_block(std::size_t items, std::size_t threads, F &&fn) {
+  parallel_for(task_count(items), threads, [&](std::size_t task) {
+    std::size_t const end = std::min(items, (task + 1) * kItemsPerTask);
+    for (std::size_t idx = task * kItemsPerTask; idx < end; ++idx) {
+      fn(idx);
+    }
+  });
+}
+
+// Root of `atom`, halving the path on the way. Roots are the lowest atom of
+// their set, since unite() always links the higher root below the lower one.
+[[nodiscard]] int find_root(std::vector<int> &parent, int atom) noexcept {
+  while (true) {
+    std::atomic_ref<int> node(parent[static_cast<std::size_t>(atom)]);
+    int up = node.load(std::memory_order_relaxed);
+    if (up == atom) {
+      return atom;
+    }
+    int const grand = std::atomic_ref<int>(parent[static_cast<std::size_t>(up)]).load(std::memory_order_relaxed);
+    if (grand != up) {
+      node.compare_exchange_weak(up, grand, std::memory_order_relaxed);
+    }
+    atom = grand;
+  }
+}
+
+void unite(std::vector<int> &parent, int atom_a, int atom_b) noexcept {
+  while (true) {
+    int root_a = find_root(parent, atom_a);
+    int root_b = find_root(parent, atom_b);
+    if (root_a == root_b) {
+      return;
+    }
+    if (root_a < root_b) {
+      std::swap(root_a, root_b);
+    }
+    // Only a root may be relinked; if another worker got there first, retry.
+    int expected = root_a;
+    if (std::atomic_ref<int>(parent[static_cast<std::size_t>(root_a)])
+          .compare_exchange_strong(expected, root_b, std::memory_order_relaxed)) {
+      return;
+    }
+    atom_a = root_a;
+    atom_b = root_b;
+  }
+}
+
+} // namespace
+
+BondGraph::BondGraph(const Parm7Topology &topo, std::size_t threads) {
+  auto const natom = static_cast<std::size_t>(topo.pointers.natom);
+  auto const nbond = topo.bond_i.size();
+  if ((topo.loaded_sections & section_bit(Parm7Section::BondsIncHydrogen)) == 0) {
+    throw std::runtime_error("BondGraph needs the BONDS sections to be loaded");
+  }
+
+  for_each_block(nbond, threads, [&](std::size_t bond) {
+    for (int const atom : {topo.bond_i[bond], topo.bond_j[bond]}) {
+      if (atom < 0 || static_cast<std::size_t>(atom) >= natom) {
+        throw std::runtime_error(fmt::format("Bond {} names atom {}, outside [0, {})", bond, atom, natom));
+      }
+    }
+  });
+
+  // Degrees, then offsets; rows are filled through per-atom atomic cursors and
+  // sorted afterwards, so the result does not depend on scheduling.
+  std::vector<std::size_t> cursor(natom, 0);
+  auto claim = [&cursor](int atom) {
+    return std::atomic_ref<std::size_t>(cursor[static_cast<std::size_t>(atom)]).fetch_add(1, std::memory_order_relaxed);
+  };
+  for_each_block(nbond, threads, [&](std::size_t bond) {
+    static_cast<void>(claim(topo.bond_i[bond]));
+    static_cast<void>(claim(topo.bond_j[bond]));
+  });
+  offsets_.assign(natom + 1, 0);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    offsets_[atom + 1] = offsets_[atom] + cursor[atom];
+    cursor[atom] = offsets_[atom];
+  }
+
+  adjacency_.resize(offsets_.back());
+  for_each_block(nbond, threads, [&](std::size_t bond) {
+    adjacency_[claim(topo.bond_i[bond])] = topo.bond_j[bond];
+    adjacency_[claim(topo.bond_j[bond])] = topo.bond_i[bond];
+  });
+  for_each_block(natom, threads, [&](std::size_t atom) {
+    std::sort(adjacency_.begin() + static_cast<std::ptrdiff_t>(offsets_[atom]),
+      adjacency_.begin() + static_cast<std::ptrdiff_t>(offsets_[atom + 1]));
+  });
+}
+
+Molecules find_molecules(const BondGraph &graph, std::size_t threads) {
+  std::size_t const natom = graph.atom_count();
+  std::vector<int> parent(natom);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    parent[atom] = static_cast<int>(atom);
+  }
+
+  // Each bond is visited once, from its lower atom.
+  for_each_block(natom, threads, [&](std::size_t atom) {
+    int const self = static_cast<int>(atom);
+    for (int const neighbor : graph.neighbors(self)) {
+      if (neighbor > self) {
+        unite(parent, self, neighbor);
+      }
+    }
+  });
+  // Other workers are still halving paths through parent[atom], so the
+  // flattening store has to be atomic too.
+  for_each_block(natom, threads, [&](std::size_t atom) {
+    int const root = find_root(parent, static_cast<int>(atom));
+    std::atomic_ref<int>(parent[atom]).store(root, std::memory_order_relaxed);
+  });
+
+  // Roots are the lowest atoms of their molecules, so numbering them in atom
+  // order numbers molecules by first atom.
+  Molecules molecules;
+  molecules.molecule_of.resize(natom);
+  std::vector<std::size_t> sizes;
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    auto const root = static_cast<std::size_t>(parent[atom]);
+    if (root == atom) {
+      molecules.molecule_of[atom] = static_cast<int>(sizes.size());
+      sizes.push_back(0);
+    } else {
+      molecules.molecule_of[atom] = molecules.molecule_of[root];
+    }
+    ++sizes[static_cast<std::size_t>(molecules.molecule_of[atom])];
+  }
+
+  molecules.offsets.assign(sizes.size() + 1, 0);
+  for (std::size_t mol = 0; mol < sizes.size(); ++mol) {
+    molecules.offsets[mol + 1] = molecules.offsets[mol] + sizes[mol];
+  }
+  molecules.atoms.resize(natom);
+  std::vector<std::size_t> fill(molecules.offsets.begin(), molecules.offsets.end() - 1);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    molecules.atoms[fill[static_cast<std::size_t>(molecules.molecule_of[atom])]++] = static_cast<int>(atom);
+  }
+  return molecules;
+}
+
+void check_molecules(const Parm7Topology &topo, const Molecules &molecules) {
+  if (topo.solvent_pointers) {
+    auto const nspm = static_cast<std::size_t>((*topo.solvent_pointers)[1]);
+    if (nspm != molecules.size()) {
+      throw std::runtime_error(
+        fmt::format("SOLVENT_POINTERS lists {} molecules, the bond graph has {}", nspm, molecules.size()));
+    }
+  }
+  if (topo.atoms_per_molecule.empty()) {
+    return;
+  }
+
+  std::size_t first_atom = 0;
+  for (std::size_t mol = 0; mol < topo.atoms_per_molecule.size(); ++mol) {
+    auto const expected = static_cast<std::size_t>(topo.atoms_per_molecule[mol]);
+    if (mol >= molecules.size()) {
+      throw std::runtime_error(fmt::format("ATOMS_PER_MOLECULE has molecule {}, the bond graph has {} molecules", mol,
+        molecules.size()));
+    }
+    auto const atoms = molecules.atoms_of(mol);
+    if (atoms.size() != expected || static_cast<std::size_t>(atoms.front()) != first_atom ||
+        static_cast<std::size_t>(atoms.back()) != first_atom + expected - 1) {
+      throw std::runtime_error(fmt::format(
+        "Molecule {} spans {} atoms from atom {}, ATOMS_PER_MOLECULE expects {} contiguous atoms from atom {}", mol,
+        atoms.size(), atoms.front(), expected, first_atom));
+    }
+    first_atom += expected;
+  }
+}
+
+std::size_t first_solvent_molecule(const Parm7Topology &topo, const Molecules &molecules) {
+  if (!topo.solvent_pointers) {
+    return molecules.size();
+  }
+  auto const nspsol = (*topo.solvent_pointers)[2];
+  return std::clamp<std::size_t>(nspsol > 0 ? static_cast<std::size_t>(nspsol) - 1 : 0, 0, molecules.size());
+}
+
+} // namespace rms
@@ -0,0 +1,1081 @@
+#include "include/bonded.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+// Terms per task; batches are cut into chunks of this size whatever the
+// thread count, so the chunk energies are always summed the same way.
+constexpr std::size_t kTermsPerTask = 4096;
+constexpr int kMaxPeriod = 12;
+// Floor for the squared lengths the gradients divide by, so a collinear
+// angle or dihedral gives large forces rather than NaN.
+constexpr double kTiny = 1e-30;
+
+struct PositionView {
+  double const *x;
+  double const *y;
+  double const *z;
+};
+
+// Where forces are added; unused when only energies are wanted.
+struct ForceSink {
+  double *x = nullptr;
+  double *y = nullptr;
+  double *z = nullptr;
+};
+
+struct BondView {
+  int const *i;
+  int const *j;
+  double const *force;
+  double const *equil;
+};
+
+struct AngleView {
+  int const *i;
+  int const *j;
+  int const *k;
+  double const *force;
+  double const *equil;
+};
+
+struct DihedralView {
+  int const *i;
+  int const *j;
+  int const *k;
+  int const *l;
+  double const *force;
+  double const *period;
+  double const *cos_phase;
+  double const *sin_phase;
+  double const *improper;
+  int max_period;
+};
+
+struct TorsionSums {
+  double proper = 0.0;
+  double improper = 0.0;
+};
+
+// Each kernel takes stored terms [begin, end), adds forces (with Forces) and
+// returns the energy.
+using BondsFn = double (*)(const BondView &t, std::size_t begin, std::size_t end, const PositionView &p,
+  const ForceSink &f) noexcept;
+using AnglesFn = double (*)(const AngleView &t, std::size_t begin, std::size_t end, const PositionView &p,
+  const ForceSink &f) noexcept;
+using DihedralsFn = TorsionSums (*)(const DihedralView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept;
+
+struct Kernels {
+  BondsFn bonds;
+  AnglesFn angles;
+  DihedralsFn dihedrals;
+};
+
+[[gnu::always_inline]] inline void add_force(const ForceSink &f, std::size_t atom, double fx, double fy,
+  double fz) noexcept {
+  f.x[atom] += fx;
+  f.y[atom] += fy;
+  f.z[atom] += fz;
+}
+
+template <bool Forces>
+double bonds_scalar(const BondView &t, std::size_t begin, std::size_t end, const PositionView &p,
+  const ForceSink &f) noexcept {
+  double energy = 0.0;
+  for (std::size_t n = begin; n < end; ++n) {
+    auto const i = static_cast<std::size_t>(t.i[n]);
+    auto const j = static_cast<std::size_t>(t.j[n]);
+    double const dx = p.x[j] - p.x[i];
+    double const dy = p.y[j] - p.y[i];
+    double const dz = p.z[j] - p.z[i];
+    double const r = std::sqrt(dx * dx + dy * dy + dz * dz);
+    double const dr = r - t.equil[n];
+    double const kdr = t.force[n] * dr;
+    energy += kdr * dr;
+    if constexpr (Forces) {
+      double const g = 2.0 * kdr / r;
+      add_force(f, i, g * dx, g * dy, g * dz);
+      add_force(f, j, -g * dx, -g * dy, -g * dz);
+    }
+  }
+  return energy;
+}
+
+// theta = atan2(|u x v|, u . v) with u = r_i - r_j and v = r_k - r_j, which
+// stays accurate near 0 and 180 degrees where acos does not.
+template <bool Forces>
+double angles_scalar(const AngleView &t, std::size_t begin, std::size_t end, const PositionView &p,
+  const ForceSink &f) noexcept {
+  double energy = 0.0;
+  for (std::size_t n = begin; n < end; ++n) {
+    auto const i = static_cast<std::size_t>(t.i[n]);
+    auto const j = static_cast<std::size_t>(t.j[n]);
+    auto const k = static_cast<std::size_t>(t.k[n]);
+    double const ux = p.x[i] - p.x[j];
+    double const uy = p.y[i] - p.y[j];
+    double const uz = p.z[i] - p.z[j];
+    double const vx = p.x[k] - p.x[j];
+    double const vy = p.y[k] - p.y[j];
+    double const vz = p.z[k] - p.z[j];
+    double const wx = uy * vz - uz * vy;
+    double const wy = uz * vx - ux * vz;
+    double const wz = ux * vy - uy * vx;
+    double const uv = ux * vx + uy * vy + uz * vz;
+    double const s = std::sqrt(std::max(wx * wx + wy * wy + wz * wz, kTiny));
+    double const dtheta = std::atan2(s, uv) - t.equil[n];
+    double const kdt = t.force[n] * dtheta;
+    energy += kdt * dtheta;
+    if constexpr (Forces) {
+      double const g = 2.0 * kdt / s;
+      double const cu = uv / (ux * ux + uy * uy + uz * uz);
+      double const cv = uv / (vx * vx + vy * vy + vz * vz);
+      double const fix = g * (vx - cu * ux);
+      double const fiy = g * (vy - cu * uy);
+      double const fiz = g * (vz - cu * uz);
+      double const fkx = g * (ux - cv * vx);
+      double const fky = g * (uy - cv * vy);
+      double const fkz = g * (uz - cv * vz);
+      add_force(f, i, fix, fiy, fiz);
+      add_force(f, k, fkx, fky, fkz);
+      add_force(f, j, -fix - fkx, -fiy - fky, -fiz - fkz);
+    }
+  }
+  return energy;
+}
+
+// Blondel & Karplus (1996): F = r_i - r_j, G = r_j - r_k, H = r_l - r_k,
+// A = F x G, B = H x G, cos phi = A.B / |A||B| and sin phi = (B x A).G /
+// |A||B||G| (the IUPAC sign). cos(n phi) and sin(n phi) come from the
+// angle-addition recurrence, so no trigonometric call is needed, and
+// cos(n phi - gamma) = cos(n phi) cos(gamma) + sin(n phi) sin(gamma).
+template <bool Forces>
+TorsionSums dihedrals_scalar(const DihedralView &t, std::size_t begin, std::size_t end, const PositionView &p,
+  const ForceSink &f) noexcept {
+  TorsionSums sums;
+  for (std::size_t n = begin; n < end; ++n) {
+    auto const i = static_cast<std::size_t>(t.i[n]);
+    auto const j = static_cast<std::size_t>(t.j[n]);
+    auto const k = static_cast<std::size_t>(t.k[n]);
+    auto const l = static_cast<std::size_t>(t.l[n]);
+    double const fx = p.x[i] - p.x[j];
+    double const fy = p.y[i] - p.y[j];
+    double const fz = p.z[i] - p.z[j];
+    double const gx = p.x[j] - p.x[k];
+    double const gy = p.y[j] - p.y[k];
+    double const gz = p.z[j] - p.z[k];
+    double const hx = p.x[l] - p.x[k];
+    double const hy = p.y[l] - p.y[k];
+    double const hz = p.z[l] - p.z[k];
+    double const ax = fy * gz - fz * gy;
+    double const ay = fz * gx - fx * gz;
+    double const az = fx * gy - fy * gx;
+    double const bx = hy * gz - hz * gy;
+    double const by = hz * gx - hx * gz;
+    double const bz = hx * gy - hy * gx;
+    double const aa = std::max(ax * ax + ay * ay + az * az, kTiny);
+    double const bb = std::max(bx * bx + by * by + bz * bz, kTiny);
+    double const gg = std::max(gx * gx + gy * gy + gz * gz, kTiny);
+    double const g = std::sqrt(gg);
+    double const rab = 1.0 / std::sqrt(aa * bb);
+    double const c = (ax * bx + ay * by + az * bz) * rab;
+    double const s = ((by * az - bz * ay) * gx + (bz * ax - bx * az) * gy + (bx * ay - by * ax) * gz) * rab / g;
+
+    double const period = t.period[n];
+    double cn = 1.0;
+    double sn = 0.0;
+    double cm = 1.0;
+    double sm = 0.0;
+    for (int m = 1; m <= t.max_period; ++m) {
+      double const next = cm * c - sm * s;
+      sm = sm * c + cm * s;
+      cm = next;
+      bool const hit = period == static_cast<double>(m);
+      cn = hit ? cm : cn;
+      sn = hit ? sm : sn;
+    }
+    double const force = t.force[n];
+    double const energy = force * (1.0 + cn * t.cos_phase[n] + sn * t.sin_phase[n]);
+    sums.proper += (1.0 - t.improper[n]) * energy;
+    sums.improper += t.improper[n] * energy;
+    if constexpr (Forces) {
+      double const dedphi = force * period * (cn * t.sin_phase[n] - sn * t.cos_phase[n]);
+      double const pa = dedphi * g / aa;
+      double const pb = dedphi * g / bb;
+      double const fg = (fx * gx + fy * gy + fz * gz) / gg;
+      double const hg = (hx * gx + hy * gy + hz * gz) / gg;
+      double const ja = -(1.0 + fg) * pa;
+      double const jb = hg * pb;
+      double const ka = fg * pa;
+      double const kb = (1.0 - hg) * pb;
+      add_force(f, i, pa * ax, pa * ay, pa * az);
+      add_force(f, j, ja * ax + jb * bx, ja * ay + jb * by, ja * az + jb * bz);
+      add_force(f, k, ka * ax + kb * bx, ka * ay + kb * by, ka * az + kb * bz);
+      add_force(f, l, -pb * bx, -pb * by, -pb * bz);
+    }
+  }
+  return sums;
+}
+
+#if RMS_X86_DISPATCH
+// atan(t) for t in [0, 1]: Cephes' reduction around pi / 4 and its rational
+// approximation on [-0.42, 0.66], good to about 1 ulp.
+constexpr std::array<double, 5> kAtanP = {-8.750608600031904122785e-1, -1.615753718733365076637e1,
+  -7.500855792314704667340e1, -1.228866684490136173410e2, -6.485021904942025371773e1};
+constexpr std::array<double, 5> kAtanQ = {2.485846490142306297962e1, 1.650270098316988542046e2,
+  4.328810604912902668951e2, 4.853903996359136964868e2, 1.945506571482613964425e2};
+constexpr double kAtanMoreBits = 6.123233995736765886130e-17;
+
+// Vector operations for the kernels, in double lanes with 32-bit atom indices.
+struct Avx2Ops {
+  using Vec = __m256d;
+  using Mask = __m256d;
+  using Index = __m128i;
+  static constexpr std::size_t kWidth = 4;
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec load(double const *p) noexcept {
+    return _mm256_loadu_pd(p);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Index index(int const *p) noexcept {
+    return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+  }
+  // Masked form with every lane on; the plain gather starts from an
+  // undefined register, which GCC reports as uninitialized.
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec gather(double const *base, Index at) noexcept {
+    __m256d const all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, at, all, 8);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec zero() noexcept { return _mm256_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec set1(double v) noexcept { return _mm256_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec add(Vec a, Vec b) noexcept { return _mm256_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec div(Vec a, Vec b) noexcept { return _mm256_div_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  // c - a * b
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec fnma(Vec a, Vec b, Vec c) noexcept {
+    return _mm256_fnmadd_pd(a, b, c);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec sqrt(Vec v) noexcept { return _mm256_sqrt_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec max(Vec a, Vec b) noexcept { return _mm256_max_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec min(Vec a, Vec b) noexcept { return _mm256_min_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec abs(Vec v) noexcept {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Mask equal(Vec a, Vec b) noexcept {
+    return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Mask greater(Vec a, Vec b) noexcept {
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+  }
+  // mask ? a : b
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec select(Mask mask, Vec a, Vec b) noexcept {
+    return _mm256_blendv_pd(b, a, mask);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static double sum(Vec v) noexcept {
+    __m128d const pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+  }
+  // The lanes name distinct atoms (one batch), so plain adds cannot collide.
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static void scatter_add(const ForceSink &f, Index at, Vec fx, Vec fy,
+    Vec fz) noexcept {
+    alignas(16) std::array<int, kWidth> atoms;
+    alignas(32) std::array<double, kWidth> x;
+    alignas(32) std::array<double, kWidth> y;
+    alignas(32) std::array<double, kWidth> z;
+    _mm_store_si128(reinterpret_cast<__m128i *>(atoms.data()), at);
+    _mm256_store_pd(x.data(), fx);
+    _mm256_store_pd(y.data(), fy);
+    _mm256_store_pd(z.data(), fz);
+    for (std::size_t lane = 0; lane < kWidth; ++lane) {
+      add_force(f, static_cast<std::size_t>(atoms[lane]), x[lane], y[lane], z[lane]);
+    }
+  }
+  // atan2(y, x) for y >= 0, in [0, pi].
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec atan2(Vec y, Vec x) noexcept {
+    Vec const ax = abs(x);
+    Vec const t = div(min(y, ax), max(max(y, ax), set1(kTiny)));
+    Mask const reduced = greater(t, set1(0.66));
+    Vec const z = select(reduced, div(sub(t, set1(1.0)), add(t, set1(1.0))), t);
+    Vec const z2 = mul(z, z);
+    Vec p = set1(kAtanP[0]);
+    for (std::size_t c = 1; c < kAtanP.size(); ++c) {
+      p = fma(p, z2, set1(kAtanP[c]));
+    }
+    Vec q = add(z2, set1(kAtanQ[0]));
+    for (std::size_t c = 1; c < kAtanQ.size(); ++c) {
+      q = fma(q, z2, set1(kAtanQ[c]));
+    }
+    Vec const base =
+      select(reduced, set1(std::numbers::pi / 4.0 + 0.5 * kAtanMoreBits), zero());
+    Vec angle = add(base, fma(mul(z, z2), div(p, q), z));
+    angle = select(greater(y, ax), sub(set1(std::numbers::pi / 2.0), angle), angle);
+    return select(greater(zero(), x), sub(set1(std::numbers::pi), angle), angle);
+  }
+};
+
+struct Avx512Ops {
+  using Vec = __m512d;
+  using Mask = __mmask8;
+  using Index = __m256i;
+  static constexpr std::size_t kWidth = 8;
+  static constexpr __mmask8 kAll = 0xFF;
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec load(double const *p) noexcept {
+    return _mm512_loadu_pd(p);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Index index(int const *p) noexcept {
+    return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+  }
+  // Masked gather, sqrt, min and max: the plain forms start from an undefined
+  // register, which GCC 12 reports as uninitialized.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec gather(double const *base, Index at) noexcept {
+    return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), kAll, at, base, 8);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec zero() noexcept { return _mm512_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec set1(double v) noexcept { return _mm512_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec add(Vec a, Vec b) noexcept { return _mm512_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec sub(Vec a, Vec b) noexcept { return _mm512_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec mul(Vec a, Vec b) noexcept { return _mm512_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec div(Vec a, Vec b) noexcept { return _mm512_div_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+  // c - a * b
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec fnma(Vec a, Vec b, Vec c) noexcept {
+    return _mm512_fnmadd_pd(a, b, c);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec sqrt(Vec v) noexcept {
+    return _mm512_maskz_sqrt_pd(kAll, v);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec max(Vec a, Vec b) noexcept {
+    return _mm512_maskz_max_pd(kAll, a, b);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec min(Vec a, Vec b) noexcept {
+    return _mm512_maskz_min_pd(kAll, a, b);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec abs(Vec v) noexcept { return _mm512_abs_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Mask equal(Vec a, Vec b) noexcept {
+    return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Mask greater(Vec a, Vec b) noexcept {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+  }
+  // mask ? a : b
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec select(Mask mask, Vec a, Vec b) noexcept {
+    return _mm512_mask_blend_pd(mask, b, a);
+  }
+  // Stored rather than reduced in-register; GCC flags the undefined upper
+  // halves of _mm512_reduce_add_pd.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static double sum(Vec v) noexcept {
+    alignas(64) std::array<double, kWidth> lanes;
+    _mm512_store_pd(lanes.data(), v);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+  // The lanes name distinct atoms (one batch), so gather, add and scatter
+  // cannot lose an update.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static void scatter_add(const ForceSink &f, Index at, Vec fx, Vec fy,
+    Vec fz) noexcept {
+    _mm512_mask_i32scatter_pd(f.x, kAll, at, add(gather(f.x, at), fx), 8);
+    _mm512_mask_i32scatter_pd(f.y, kAll, at, add(gather(f.y, at), fy), 8);
+    _mm512_mask_i32scatter_pd(f.z, kAll, at, add(gather(f.z, at), fz), 8);
+  }
+  // atan2(y, x) for y >= 0, in [0, pi].
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec atan2(Vec y, Vec x) noexcept {
+    Vec const ax = abs(x);
+    Vec const t = div(min(y, ax), max(max(y, ax), set1(kTiny)));
+    Mask const reduced = greater(t, set1(0.66));
+    Vec const z = select(reduced, div(sub(t, set1(1.0)), add(t, set1(1.0))), t);
+    Vec const z2 = mul(z, z);
+    Vec p = set1(kAtanP[0]);
+    for (std::size_t c = 1; c < kAtanP.size(); ++c) {
+      p = fma(p, z2, set1(kAtanP[c]));
+    }
+    Vec q = add(z2, set1(kAtanQ[0]));
+    for (std::size_t c = 1; c < kAtanQ.size(); ++c) {
+      q = fma(q, z2, set1(kAtanQ[c]));
+    }
+    Vec const base =
+      select(reduced, set1(std::numbers::pi / 4.0 + 0.5 * kAtanMoreBits), zero());
+    Vec angle = add(base, fma(mul(z, z2), div(p, q), z));
+    angle = select(greater(y, ax), sub(set1(std::numbers::pi / 2.0), angle), angle);
+    return select(greater(zero(), x), sub(set1(std::numbers::pi), angle), angle);
+  }
+};
+
+// The AVX2 and AVX-512 kernels share one body, written out per target because
+// a function's ISA cannot be a template parameter. They mirror the scalar
+// kernels above term for term.
+template <bool Forces>
+RMS_TARGET("avx2,fma") double bonds_avx2(const BondView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx2Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec energy = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    Vec const dx = Ops::sub(Ops::gather(p.x, j), Ops::gather(p.x, i));
+    Vec const dy = Ops::sub(Ops::gather(p.y, j), Ops::gather(p.y, i));
+    Vec const dz = Ops::sub(Ops::gather(p.z, j), Ops::gather(p.z, i));
+    Vec const r = Ops::sqrt(Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx))));
+    Vec const dr = Ops::sub(r, Ops::load(t.equil + n));
+    Vec const kdr = Ops::mul(Ops::load(t.force + n), dr);
+    energy = Ops::fma(kdr, dr, energy);
+    if constexpr (Forces) {
+      Vec const g = Ops::div(Ops::add(kdr, kdr), r);
+      Vec const gx = Ops::mul(g, dx);
+      Vec const gy = Ops::mul(g, dy);
+      Vec const gz = Ops::mul(g, dz);
+      Ops::scatter_add(f, i, gx, gy, gz);
+      Ops::scatter_add(f, j, Ops::sub(Ops::zero(), gx), Ops::sub(Ops::zero(), gy), Ops::sub(Ops::zero(), gz));
+    }
+  }
+  return Ops::sum(energy) + bonds_scalar<Forces>(t, vector_end, end, p, f);
+}
+
+template <bool Forces>
+RMS_TARGET("avx2,fma") double angles_avx2(const AngleView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx2Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec energy = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    auto const k = Ops::index(t.k + n);
+    Vec const xj = Ops::gather(p.x, j);
+    Vec const yj = Ops::gather(p.y, j);
+    Vec const zj = Ops::gather(p.z, j);
+    Vec const ux = Ops::sub(Ops::gather(p.x, i), xj);
+    Vec const uy = Ops::sub(Ops::gather(p.y, i), yj);
+    Vec const uz = Ops::sub(Ops::gather(p.z, i), zj);
+    Vec const vx = Ops::sub(Ops::gather(p.x, k), xj);
+    Vec const vy = Ops::sub(Ops::gather(p.y, k), yj);
+    Vec const vz = Ops::sub(Ops::gather(p.z, k), zj);
+    Vec const wx = Ops::fnma(uz, vy, Ops::mul(uy, vz));
+    Vec const wy = Ops::fnma(ux, vz, Ops::mul(uz, vx));
+    Vec const wz = Ops::fnma(uy, vx, Ops::mul(ux, vy));
+    Vec const uv = Ops::fma(uz, vz, Ops::fma(uy, vy, Ops::mul(ux, vx)));
+    Vec const s =
+      Ops::sqrt(Ops::max(Ops::fma(wz, wz, Ops::fma(wy, wy, Ops::mul(wx, wx))), Ops::set1(kTiny)));
+    Vec const dtheta = Ops::sub(Ops::atan2(s, uv), Ops::load(t.equil + n));
+    Vec const kdt = Ops::mul(Ops::load(t.force + n), dtheta);
+    energy = Ops::fma(kdt, dtheta, energy);
+    if constexpr (Forces) {
+      Vec const g = Ops::div(Ops::add(kdt, kdt), s);
+      Vec const cu = Ops::div(uv, Ops::fma(uz, uz, Ops::fma(uy, uy, Ops::mul(ux, ux))));
+      Vec const cv = Ops::div(uv, Ops::fma(vz, vz, Ops::fma(vy, vy, Ops::mul(vx, vx))));
+      Vec const fix = Ops::mul(g, Ops::fnma(cu, ux, vx));
+      Vec const fiy = Ops::mul(g, Ops::fnma(cu, uy, vy));
+      Vec const fiz = Ops::mul(g, Ops::fnma(cu, uz, vz));
+      Vec const fkx = Ops::mul(g, Ops::fnma(cv, vx, ux));
+      Vec const fky = Ops::mul(g, Ops::fnma(cv, vy, uy));
+      Vec const fkz = Ops::mul(g, Ops::fnma(cv, vz, uz));
+      Ops::scatter_add(f, i, fix, fiy, fiz);
+      Ops::scatter_add(f, k, fkx, fky, fkz);
+      Ops::scatter_add(f, j, Ops::sub(Ops::sub(Ops::zero(), fix), fkx), Ops::sub(Ops::sub(Ops::zero(), fiy), fky),
+        Ops::sub(Ops::sub(Ops::zero(), fiz), fkz));
+    }
+  }
+  return Ops::sum(energy) + angles_scalar<Forces>(t, vector_end, end, p, f);
+}
+
+template <bool Forces>
+RMS_TARGET("avx2,fma") TorsionSums dihedrals_avx2(const DihedralView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx2Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const one = Ops::set1(1.0);
+  Vec const tiny = Ops::set1(kTiny);
+  Vec proper = Ops::zero();
+  Vec improper = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    auto const k = Ops::index(t.k + n);
+    auto const l = Ops::index(t.l + n);
+    Vec const xj = Ops::gather(p.x, j);
+    Vec const yj = Ops::gather(p.y, j);
+    Vec const zj = Ops::gather(p.z, j);
+    Vec const xk = Ops::gather(p.x, k);
+    Vec const yk = Ops::gather(p.y, k);
+    Vec const zk = Ops::gather(p.z, k);
+    Vec const fx = Ops::sub(Ops::gather(p.x, i), xj);
+    Vec const fy = Ops::sub(Ops::gather(p.y, i), yj);
+    Vec const fz = Ops::sub(Ops::gather(p.z, i), zj);
+    Vec const gx = Ops::sub(xj, xk);
+    Vec const gy = Ops::sub(yj, yk);
+    Vec const gz = Ops::sub(zj, zk);
+    Vec const hx = Ops::sub(Ops::gather(p.x, l), xk);
+    Vec const hy = Ops::sub(Ops::gather(p.y, l), yk);
+    Vec const hz = Ops::sub(Ops::gather(p.z, l), zk);
+    Vec const ax = Ops::fnma(fz, gy, Ops::mul(fy, gz));
+    Vec const ay = Ops::fnma(fx, gz, Ops::mul(fz, gx));
+    Vec const az = Ops::fnma(fy, gx, Ops::mul(fx, gy));
+    Vec const bx = Ops::fnma(hz, gy, Ops::mul(hy, gz));
+    Vec const by = Ops::fnma(hx, gz, Ops::mul(hz, gx));
+    Vec const bz = Ops::fnma(hy, gx, Ops::mul(hx, gy));
+    Vec const aa = Ops::max(Ops::fma(az, az, Ops::fma(ay, ay, Ops::mul(ax, ax))), tiny);
+    Vec const bb = Ops::max(Ops::fma(bz, bz, Ops::fma(by, by, Ops::mul(bx, bx))), tiny);
+    Vec const gg = Ops::max(Ops::fma(gz, gz, Ops::fma(gy, gy, Ops::mul(gx, gx))), tiny);
+    Vec const g = Ops::sqrt(gg);
+    Vec const rab = Ops::div(one, Ops::sqrt(Ops::mul(aa, bb)));
+    Vec const c = Ops::mul(Ops::fma(az, bz, Ops::fma(ay, by, Ops::mul(ax, bx))), rab);
+    Vec const cx = Ops::fnma(bz, ay, Ops::mul(by, az));
+    Vec const cy = Ops::fnma(bx, az, Ops::mul(bz, ax));
+    Vec const cz = Ops::fnma(by, ax, Ops::mul(bx, ay));
+    Vec const s = Ops::div(Ops::mul(Ops::fma(cz, gz, Ops::fma(cy, gy, Ops::mul(cx, gx))), rab), g);
+
+    Vec const period = Ops::load(t.period + n);
+    Vec cn = one;
+    Vec sn = Ops::zero();
+    Vec cm = one;
+    Vec sm = Ops::zero();
+    for (int m = 1; m <= t.max_period; ++m) {
+      Vec const next = Ops::fnma(sm, s, Ops::mul(cm, c));
+      sm = Ops::fma(cm, s, Ops::mul(sm, c));
+      cm = next;
+      auto const hit = Ops::equal(period, Ops::set1(static_cast<double>(m)));
+      cn = Ops::select(hit, cm, cn);
+      sn = Ops::select(hit, sm, sn);
+    }
+    Vec const force = Ops::load(t.force + n);
+    Vec const cos_phase = Ops::load(t.cos_phase + n);
+    Vec const sin_phase = Ops::load(t.sin_phase + n);
+    Vec const weight = Ops::load(t.improper + n);
+    Vec const energy = Ops::mul(force, Ops::fma(sn, sin_phase, Ops::fma(cn, cos_phase, one)));
+    proper = Ops::fma(Ops::sub(one, weight), energy, proper);
+    improper = Ops::fma(weight, energy, improper);
+    if constexpr (Forces) {
+      Vec const dedphi = Ops::mul(Ops::mul(force, period), Ops::fnma(sn, cos_phase, Ops::mul(cn, sin_phase)));
+      Vec const pa = Ops::div(Ops::mul(dedphi, g), aa);
+      Vec const pb = Ops::div(Ops::mul(dedphi, g), bb);
+      Vec const fg = Ops::div(Ops::fma(fz, gz, Ops::fma(fy, gy, Ops::mul(fx, gx))), gg);
+      Vec const hg = Ops::div(Ops::fma(hz, gz, Ops::fma(hy, gy, Ops::mul(hx, gx))), gg);
+      Vec const ja = Ops::sub(Ops::zero(), Ops::mul(Ops::add(one, fg), pa));
+      Vec const jb = Ops::mul(hg, pb);
+      Vec const ka = Ops::mul(fg, pa);
+      Vec const kb = Ops::mul(Ops::sub(one, hg), pb);
+      Vec const mb = Ops::sub(Ops::zero(), pb);
+      Ops::scatter_add(f, i, Ops::mul(pa, ax), Ops::mul(pa, ay), Ops::mul(pa, az));
+      Ops::scatter_add(f, j, Ops::fma(ja, ax, Ops::mul(jb, bx)), Ops::fma(ja, ay, Ops::mul(jb, by)),
+        Ops::fma(ja, az, Ops::mul(jb, bz)));
+      Ops::scatter_add(f, k, Ops::fma(ka, ax, Ops::mul(kb, bx)), Ops::fma(ka, ay, Ops::mul(kb, by)),
+        Ops::fma(ka, az, Ops::mul(kb, bz)));
+      Ops::scatter_add(f, l, Ops::mul(mb, bx), Ops::mul(mb, by), Ops::mul(mb, bz));
+    }
+  }
+  TorsionSums sums = dihedrals_scalar<Forces>(t, vector_end, end, p, f);
+  sums.proper += Ops::sum(proper);
+  sums.improper += Ops::sum(improper);
+  return sums;
+}
+
+template <bool Forces>
+RMS_TARGET("avx512f") double bonds_avx512(const BondView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx512Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec energy = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    Vec const dx = Ops::sub(Ops::gather(p.x, j), Ops::gather(p.x, i));
+    Vec const dy = Ops::sub(Ops::gather(p.y, j), Ops::gather(p.y, i));
+    Vec const dz = Ops::sub(Ops::gather(p.z, j), Ops::gather(p.z, i));
+    Vec const r = Ops::sqrt(Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx))));
+    Vec const dr = Ops::sub(r, Ops::load(t.equil + n));
+    Vec const kdr = Ops::mul(Ops::load(t.force + n), dr);
+    energy = Ops::fma(kdr, dr, energy);
+    if constexpr (Forces) {
+      Vec const g = Ops::div(Ops::add(kdr, kdr), r);
+      Vec const gx = Ops::mul(g, dx);
+      Vec const gy = Ops::mul(g, dy);
+      Vec const gz = Ops::mul(g, dz);
+      Ops::scatter_add(f, i, gx, gy, gz);
+      Ops::scatter_add(f, j, Ops::sub(Ops::zero(), gx), Ops::sub(Ops::zero(), gy), Ops::sub(Ops::zero(), gz));
+    }
+  }
+  return Ops::sum(energy) + bonds_scalar<Forces>(t, vector_end, end, p, f);
+}
+
+template <bool Forces>
+RMS_TARGET("avx512f") double angles_avx512(const AngleView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx512Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec energy = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    auto const k = Ops::index(t.k + n);
+    Vec const xj = Ops::gather(p.x, j);
+    Vec const yj = Ops::gather(p.y, j);
+    Vec const zj = Ops::gather(p.z, j);
+    Vec const ux = Ops::sub(Ops::gather(p.x, i), xj);
+    Vec const uy = Ops::sub(Ops::gather(p.y, i), yj);
+    Vec const uz = Ops::sub(Ops::gather(p.z, i), zj);
+    Vec const vx = Ops::sub(Ops::gather(p.x, k), xj);
+    Vec const vy = Ops::sub(Ops::gather(p.y, k), yj);
+    Vec const vz = Ops::sub(Ops::gather(p.z, k), zj);
+    Vec const wx = Ops::fnma(uz, vy, Ops::mul(uy, vz));
+    Vec const wy = Ops::fnma(ux, vz, Ops::mul(uz, vx));
+    Vec const wz = Ops::fnma(uy, vx, Ops::mul(ux, vy));
+    Vec const uv = Ops::fma(uz, vz, Ops::fma(uy, vy, Ops::mul(ux, vx)));
+    Vec const s =
+      Ops::sqrt(Ops::max(Ops::fma(wz, wz, Ops::fma(wy, wy, Ops::mul(wx, wx))), Ops::set1(kTiny)));
+    Vec const dtheta = Ops::sub(Ops::atan2(s, uv), Ops::load(t.equil + n));
+    Vec const kdt = Ops::mul(Ops::load(t.force + n), dtheta);
+    energy = Ops::fma(kdt, dtheta, energy);
+    if constexpr (Forces) {
+      Vec const g = Ops::div(Ops::add(kdt, kdt), s);
+      Vec const cu = Ops::div(uv, Ops::fma(uz, uz, Ops::fma(uy, uy, Ops::mul(ux, ux))));
+      Vec const cv = Ops::div(uv, Ops::fma(vz, vz, Ops::fma(vy, vy, Ops::mul(vx, vx))));
+      Vec const fix = Ops::mul(g, Ops::fnma(cu, ux, vx));
+      Vec const fiy = Ops::mul(g, Ops::fnma(cu, uy, vy));
+      Vec const fiz = Ops::mul(g, Ops::fnma(cu, uz, vz));
+      Vec const fkx = Ops::mul(g, Ops::fnma(cv, vx, ux));
+      Vec const fky = Ops::mul(g, Ops::fnma(cv, vy, uy));
+      Vec const fkz = Ops::mul(g, Ops::fnma(cv, vz, uz));
+      Ops::scatter_add(f, i, fix, fiy, fiz);
+      Ops::scatter_add(f, k, fkx, fky, fkz);
+      Ops::scatter_add(f, j, Ops::sub(Ops::sub(Ops::zero(), fix), fkx), Ops::sub(Ops::sub(Ops::zero(), fiy), fky),
+        Ops::sub(Ops::sub(Ops::zero(), fiz), fkz));
+    }
+  }
+  return Ops::sum(energy) + angles_scalar<Forces>(t, vector_end, end, p, f);
+}
+
+template <bool Forces>
+RMS_TARGET("avx512f") TorsionSums dihedrals_avx512(const DihedralView &t, std::size_t begin, std::size_t end,
+  const PositionView &p, const ForceSink &f) noexcept {
+  using Ops = Avx512Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const one = Ops::set1(1.0);
+  Vec const tiny = Ops::set1(kTiny);
+  Vec proper = Ops::zero();
+  Vec improper = Ops::zero();
+  for (std::size_t n = begin; n < vector_end; n += Ops::kWidth) {
+    auto const i = Ops::index(t.i + n);
+    auto const j = Ops::index(t.j + n);
+    auto const k = Ops::index(t.k + n);
+    auto const l = Ops::index(t.l + n);
+    Vec const xj = Ops::gather(p.x, j);
+    Vec const yj = Ops::gather(p.y, j);
+    Vec const zj = Ops::gather(p.z, j);
+    Vec const xk = Ops::gather(p.x, k);
+    Vec const yk = Ops::gather(p.y, k);
+    Vec const zk = Ops::gather(p.z, k);
+    Vec const fx = Ops::sub(Ops::gather(p.x, i), xj);
+    Vec const fy = Ops::sub(Ops::gather(p.y, i), yj);
+    Vec const fz = Ops::sub(Ops::gather(p.z, i), zj);
+    Vec const gx = Ops::sub(xj, xk);
+    Vec const gy = Ops::sub(yj, yk);
+    Vec const gz = Ops::sub(zj, zk);
+    Vec const hx = Ops::sub(Ops::gather(p.x, l), xk);
+    Vec const hy = Ops::sub(Ops::gather(p.y, l), yk);
+    Vec const hz = Ops::sub(Ops::gather(p.z, l), zk);
+    Vec const ax = Ops::fnma(fz, gy, Ops::mul(fy, gz));
+    Vec const ay = Ops::fnma(fx, gz, Ops::mul(fz, gx));
+    Vec const az = Ops::fnma(fy, gx, Ops::mul(fx, gy));
+    Vec const bx = Ops::fnma(hz, gy, Ops::mul(hy, gz));
+    Vec const by = Ops::fnma(hx, gz, Ops::mul(hz, gx));
+    Vec const bz = Ops::fnma(hy, gx, Ops::mul(hx, gy));
+    Vec const aa = Ops::max(Ops::fma(az, az, Ops::fma(ay, ay, Ops::mul(ax, ax))), tiny);
+    Vec const bb = Ops::max(Ops::fma(bz, bz, Ops::fma(by, by, Ops::mul(bx, bx))), tiny);
+    Vec const gg = Ops::max(Ops::fma(gz, gz, Ops::fma(gy, gy, Ops::mul(gx, gx))), tiny);
+    Vec const g = Ops::sqrt(gg);
+    Vec const rab = Ops::div(one, Ops::sqrt(Ops::mul(aa, bb)));
+    Vec const c = Ops::mul(Ops::fma(az, bz, Ops::fma(ay, by, Ops::mul(ax, bx))), rab);
+    Vec const cx = Ops::fnma(bz, ay, Ops::mul(by, az));
+    Vec const cy = Ops::fnma(bx, az, Ops::mul(bz, ax));
+    Vec const cz = Ops::fnma(by, ax, Ops::mul(bx, ay));
+    Vec const s = Ops::div(Ops::mul(Ops::fma(cz, gz, Ops::fma(cy, gy, Ops::mul(cx, gx))), rab), g);
+
+    Vec const period = Ops::load(t.period + n);
+    Vec cn = one;
+    Vec sn = Ops::zero();
+    Vec cm = one;
+    Vec sm = Ops::zero();
+    for (int m = 1; m <= t.max_period; ++m) {
+      Vec const next = Ops::fnma(sm, s, Ops::mul(cm, c));
+      sm = Ops::fma(cm, s, Ops::mul(sm, c));
+      cm = next;
+      auto const hit = Ops::equal(period, Ops::set1(static_cast<double>(m)));
+      cn = Ops::select(hit, cm, cn);
+      sn = Ops::select(hit, sm, sn);
+    }
+    Vec const force = Ops::load(t.force + n);
+    Vec const cos_phase = Ops::load(t.cos_phase + n);
+    Vec const sin_phase = Ops::load(t.sin_phase + n);
+    Vec const weight = Ops::load(t.improper + n);
+    Vec const energy = Ops::mul(force, Ops::fma(sn, sin_phase, Ops::fma(cn, cos_phase, one)));
+    proper = Ops::fma(Ops::sub(one, weight), energy, proper);
+    improper = Ops::fma(weight, energy, improper);
+    if constexpr (Forces) {
+      Vec const dedphi = Ops::mul(Ops::mul(force, period), Ops::fnma(sn, cos_phase, Ops::mul(cn, sin_phase)));
+      Vec const pa = Ops::div(Ops::mul(dedphi, g), aa);
+      Vec const pb = Ops::div(Ops::mul(dedphi, g), bb);
+      Vec const fg = Ops::div(Ops::fma(fz, gz, Ops::fma(fy, gy, Ops::mul(fx, gx))), gg);
+      Vec const hg = Ops::div(Ops::fma(hz, gz, Ops::fma(hy, gy, Ops::mul(hx, gx))), gg);
+      Vec const ja = Ops::sub(Ops::zero(), Ops::mul(Ops::add(one, fg), pa));
+      Vec const jb = Ops::mul(hg, pb);
+      Vec const ka = Ops::mul(fg, pa);
+      Vec const kb = Ops::mul(Ops::sub(one, hg), pb);
+      Vec const mb = Ops::sub(Ops::zero(), pb);
+      Ops::scatter_add(f, i, Ops::mul(pa, ax), Ops::mul(pa, ay), Ops::mul(pa, az));
+      Ops::scatter_add(f, j, Ops::fma(ja, ax, Ops::mul(jb, bx)), Ops::fma(ja, ay, Ops::mul(jb, by)),
+        Ops::fma(ja, az, Ops::mul(jb, bz)));
+      Ops::scatter_add(f, k, Ops::fma(ka, ax, Ops::mul(kb, bx)), Ops::fma(ka, ay, Ops::mul(kb, by)),
+        Ops::fma(ka, az, Ops::mul(kb, bz)));
+      Ops::scatter_add(f, l, Ops::mul(mb, bx), Ops::mul(mb, by), Ops::mul(mb, bz));
+    }
+  }
+  TorsionSums sums = dihedrals_scalar<Forces>(t, vector_end, end, p, f);
+  sums.proper += Ops::sum(proper);
+  sums.improper += Ops::sum(improper);
+  return sums;
+}
+#endif
+
+template <bool Forces>
+[[nodiscard]] constexpr Kernels scalar_kernels() noexcept {
+  return Kernels{&bonds_scalar<Forces>, &angles_scalar<Forces>, &dihedrals_scalar<Forces>};
+}
+
+[[nodiscard]] Kernels select_kernels(SimdLevel level, bool forces) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return forces ? Kernels{&bonds_avx512<true>, &angles_avx512<true>, &dihedrals_avx512<true>}
+                  : Kernels{&bonds_avx512<false>, &angles_avx512<false>, &dihedrals_avx512<false>};
+  }
+  if (level >= SimdLevel::Avx2) {
+    return forces ? Kernels{&bonds_avx2<true>, &angles_avx2<true>, &dihedrals_avx2<true>}
+                  : Kernels{&bonds_avx2<false>, &angles_avx2<false>, &dihedrals_avx2<false>};
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return forces ? scalar_kernels<true>() : scalar_kernels<false>();
+}
+
+void require_loaded(const Parm7Topology &topo, Parm7Section section, std::string_view name) {
+  if ((topo.loaded_sections & section_bit(section)) == 0) {
+    throw std::runtime_error(fmt::format("BondedEngine needs the {} section to be loaded", name));
+  }
+}
+
+void require_size(std::string_view name, std::size_t size, std::size_t expected) {
+  if (size != expected) {
+    throw std::runtime_error(fmt::format("BondedEngine needs {} with {} entries, got {}", name, expected, size));
+  }
+}
+
+// Checks a term's atoms and type; `kind` names the term in messages.
+template <std::size_t Arity>
+void check_term(std::string_view kind, std::size_t term, const std::array<int, Arity> &atoms, int type,
+  std::size_t natom, std::size_t types) {
+  for (int const atom : atoms) {
+    if (atom < 0 || static_cast<std::size_t>(atom) >= natom) {
+      throw std::runtime_error(fmt::format("{} {} names atom {}, outside [0, {})", kind, term, atom, natom));
+    }
+  }
+  if (type < 0 || static_cast<std::size_t>(type) >= types) {
+    throw std::runtime_error(fmt::format("{} {} has type {}, outside [0, {})", kind, term, type, types));
+  }
+}
+
+// Greedy colouring into atom-disjoint batches: each term takes the first
+// batch none of its atoms is in yet. Atoms track their batches in a 64-bit
+// mask, so batches are handed out 64 at a time and terms that find all 64
+// taken wait for the next round. Returns the terms in batch order (topology
+// order within a batch) and fills `batches` with the offsets.
+template <std::size_t Arity, typename AtomsOf>
+[[nodiscard]] std::vector<std::size_t> colour_terms(std::size_t natom, std::size_t count, AtomsOf &&atoms_of,
+  std::vector<std::size_t> &batches) {
+  constexpr auto kUnset = std::numeric_limits<std::size_t>::max();
+  std::vector<std::size_t> colour(count, kUnset);
+  std::vector<std::uint64_t> used(natom);
+  std::size_t colours = 0;
+  for (std::size_t left = count, base = 0; left > 0; base += 64) {
+    std::ranges::fill(used, 0);
+    for (std::size_t term = 0; term < count; ++term) {
+      if (colour[term] != kUnset) {
+        continue;
+      }
+      std::array<int, Arity> const atoms = atoms_of(term);
+      std::uint64_t taken = 0;
+      for (int const atom : atoms) {
+        taken |= used[static_cast<std::size_t>(atom)];
+      }
+      if (taken == ~std::uint64_t{0}) {
+        continue;
+      }
+      auto const bit = static_cast<unsigned>(std::countr_one(taken));
+      for (int const atom : atoms) {
+        used[static_cast<std::size_t>(atom)] |= std::uint64_t{1} << bit;
+      }
+      colour[term] = base + bit;
+      colours = std::max(colours, base + bit + 1);
+      --left;
+    }
+  }
+
+  // Counting sort by colour; first fit can leave a colour empty, so only
+  // non-empty batches are kept.
+  std::vector<std::size_t> start(colours + 1, 0);
+  for (std::size_t const c : colour) {
+    ++start[c + 1];
+  }
+  batches.assign(1, 0);
+  for (std::size_t c = 0; c < colours; ++c) {
+    if (start[c + 1] > 0) {
+      batches.push_back(batches.back() + start[c + 1]);
+    }
+    start[c + 1] += start[c];
+  }
+  std::vector<std::size_t> order(count);
+  for (std::size_t term = 0; term < count; ++term) {
+    order[start[colour[term]]++] = term;
+  }
+  return order;
+}
+
+// Runs fn(begin, end) over every batch in chunks of kTermsPerTask and returns
+// the results in chunk order. With `ordered` each batch finishes before the
+// next starts (force scatter); without, all chunks run at once.
+template <typename Result, typename F>
+[[nodiscard]] std::vector<Result> run_batches(std::span<const std::size_t> batches, std::size_t threads,
+  bool ordered, F &&fn) {
+  std::vector<std::pair<std::size_t, std::size_t>> chunks;
+  std::vector<std::size_t> first_chunk(1, 0);
+  for (std::size_t batch = 0; batch + 1 < batches.size(); ++batch) {
+    for (std::size_t begin = batches[batch]; begin < batches[batch + 1]; begin += kTermsPerTask) {
+      chunks.emplace_back(begin, std::min(batches[batch + 1], begin + kTermsPerTask));
+    }
+    first_chunk.push_back(chunks.size());
+  }
+  std::vector<Result> results(chunks.size());
+  auto const run = [&](std::size_t first, std::size_t last) {
+    parallel_for(last - first, threads, [&](std::size_t idx) {
+      auto const [begin, end] = chunks[first + idx];
+      results[first + idx] = fn(begin, end);
+    });
+  };
+  if (ordered) {
+    for (std::size_t batch = 0; batch + 1 < first_chunk.size(); ++batch) {
+      run(first_chunk[batch], first_chunk[batch + 1]);
+    }
+  } else {
+    run(0, chunks.size());
+  }
+  return results;
+}
+
+template <std::size_t Arity, typename... Atoms>
+[[nodiscard]] std::vector<int> interleave(std::size_t count, const Atoms &...atoms) {
+  static_assert(sizeof...(Atoms) == Arity);
+  std::vector<int> out;
+  out.reserve(Arity * count);
+  for (std::size_t term = 0; term < count; ++term) {
+    (out.push_back(atoms[term]), ...);
+  }
+  return out;
+}
+
+} // namespace
+
+BondedEngine::BondedEngine(const Parm7Topology &topo, const BondedOptions &options)
+    : options_(options), natom_(static_cast<std::size_t>(topo.pointers.natom)) {
+  options_.level = std::min(options_.level, detected_simd_level());
+  require_loaded(topo, Parm7Section::BondForceConstant, "BOND_FORCE_CONSTANT");
+  require_loaded(topo, Parm7Section::BondEquilValue, "BOND_EQUIL_VALUE");
+  require_loaded(topo, Parm7Section::AngleForceConstant, "ANGLE_FORCE_CONSTANT");
+  require_loaded(topo, Parm7Section::AngleEquilValue, "ANGLE_EQUIL_VALUE");
+  require_loaded(topo, Parm7Section::DihedralForceConstant, "DIHEDRAL_FORCE_CONSTANT");
+  require_loaded(topo, Parm7Section::DihedralPeriodicity, "DIHEDRAL_PERIODICITY");
+  require_loaded(topo, Parm7Section::DihedralPhase, "DIHEDRAL_PHASE");
+  require_loaded(topo, Parm7Section::BondsIncHydrogen, "BONDS");
+  require_loaded(topo, Parm7Section::AnglesIncHydrogen, "ANGLES");
+  require_loaded(topo, Parm7Section::DihedralsIncHydrogen, "DIHEDRALS");
+  require_size("BOND_EQUIL_VALUE", topo.bond_equil_value.size(), topo.bond_force_constant.size());
+  require_size("ANGLE_EQUIL_VALUE", topo.angle_equil_value.size(), topo.angle_force_constant.size());
+  require_size("DIHEDRAL_PERIODICITY", topo.dihedral_periodicity.size(), topo.dihedral_force_constant.size());
+  require_size("DIHEDRAL_PHASE", topo.dihedral_phase.size(), topo.dihedral_force_constant.size());
+
+  // Bonds.
+  std::size_t const nbonds = topo.bond_i.size();
+  auto const bond_atoms = [&](std::size_t term) { return std::array{topo.bond_i[term], topo.bond_j[term]}; };
+  for (std::size_t term = 0; term < nbonds; ++term) {
+    check_term("Bond", term, bond_atoms(term), topo.bond_type[term], natom_, topo.bond_force_constant.size());
+  }
+  auto const bond_order = colour_terms<2>(natom_, nbonds, bond_atoms, bonds_.batches);
+  bonds_.i.resize(nbonds);
+  bonds_.j.resize(nbonds);
+  bonds_.force.resize(nbonds);
+  bonds_.equil.resize(nbonds);
+  for (std::size_t n = 0; n < nbonds; ++n) {
+    auto const term = bond_order[n];
+    auto const type = static_cast<std::size_t>(topo.bond_type[term]);
+    bonds_.i[n] = topo.bond_i[term];
+    bonds_.j[n] = topo.bond_j[term];
+    bonds_.force[n] = topo.bond_force_constant[type];
+    bonds_.equil[n] = topo.bond_equil_value[type];
+  }
+
+  // Angles.
+  std::size_t const nangles = topo.angle_i.size();
+  auto const angle_atoms = [&](std::size_t term) {
+    return std::array{topo.angle_i[term], topo.angle_j[term], topo.angle_k[term]};
+  };
+  for (std::size_t term = 0; term < nangles; ++term) {
+    check_term("Angle", term, angle_atoms(term), topo.angle_type[term], natom_, topo.angle_force_constant.size());
+  }
+  auto const angle_order = colour_terms<3>(natom_, nangles, angle_atoms, angles_.batches);
+  angles_.i.resize(nangles);
+  angles_.j.resize(nangles);
+  angles_.k.resize(nangles);
+  angles_.force.resize(nangles);
+  angles_.equil.resize(nangles);
+  for (std::size_t n = 0; n < nangles; ++n) {
+    auto const term = angle_order[n];
+    auto const type = static_cast<std::size_t>(topo.angle_type[term]);
+    angles_.i[n] = topo.angle_i[term];
+    angles_.j[n] = topo.angle_j[term];
+    angles_.k[n] = topo.angle_k[term];
+    angles_.force[n] = topo.angle_force_constant[type];
+    angles_.equil[n] = topo.angle_equil_value[type];
+  }
+
+  // Dihedrals, with the periodicity checked once per type.
+  for (std::size_t type = 0; type < topo.dihedral_periodicity.size(); ++type) {
+    double const period = topo.dihedral_periodicity[type];
+    if (!(period >= 0.0 && period <= kMaxPeriod) || period != std::round(period)) {
+      throw std::runtime_error(fmt::format(
+        "Dihedral type {} has periodicity {}, not an integer in [0, {}]", type, period, kMaxPeriod));
+    }
+  }
+  std::size_t const ndihedrals = topo.dihedral_i.size();
+  auto const dihedral_atoms = [&](std::size_t term) {
+    return std::array{topo.dihedral_i[term], topo.dihedral_j[term], topo.dihedral_k[term], topo.dihedral_l[term]};
+  };
+  for (std::size_t term = 0; term < ndihedrals; ++term) {
+    check_term("Dihedral", term, dihedral_atoms(term), topo.dihedral_type[term], natom_,
+      topo.dihedral_force_constant.size());
+  }
+  auto const dihedral_order = colour_terms<4>(natom_, ndihedrals, dihedral_atoms, dihedrals_.batches);
+  dihedrals_.i.resize(ndihedrals);
+  dihedrals_.j.resize(ndihedrals);
+  dihedrals_.k.resize(ndihedrals);
+  dihedrals_.l.resize(ndihedrals);
+  dihedrals_.force.resize(ndihedrals);
+  dihedrals_.period.resize(ndihedrals);
+  dihedrals_.cos_phase.resize(ndihedrals);
+  dihedrals_.sin_phase.resize(ndihedrals);
+  dihedrals_.improper.resize(ndihedrals);
+  for (std::size_t n = 0; n < ndihedrals; ++n) {
+    auto const term = dihedral_order[n];
+    auto const type = static_cast<std::size_t>(topo.dihedral_type[term]);
+    dihedrals_.i[n] = topo.dihedral_i[term];
+    dihedrals_.j[n] = topo.dihedral_j[term];
+    dihedrals_.k[n] = topo.dihedral_k[term];
+    dihedrals_.l[n] = topo.dihedral_l[term];
+    dihedrals_.force[n] = topo.dihedral_force_constant[type];
+    dihedrals_.period[n] = topo.dihedral_periodicity[type];
+    dihedrals_.cos_phase[n] = std::cos(topo.dihedral_phase[type]);
+    dihedrals_.sin_phase[n] = std::sin(topo.dihedral_phase[type]);
+    dihedrals_.improper[n] = (topo.dihedral_flags[term] & 0x2U) != 0 ? 1.0 : 0.0;
+    max_period_ = std::max(max_period_, static_cast<int>(dihedrals_.period[n]));
+  }
+}
+
+std::vector<int> BondedEngine::bond_atoms() const {
+  return interleave<2>(bond_count(), bonds_.i, bonds_.j);
+}
+
+std::vector<int> BondedEngine::angle_atoms() const {
+  return interleave<3>(angle_count(), angles_.i, angles_.j, angles_.k);
+}
+
+std::vector<int> BondedEngine::dihedral_atoms() const {
+  return interleave<4>(dihedral_count(), dihedrals_.i, dihedrals_.j, dihedrals_.k, dihedrals_.l);
+}
+
+BondedEnergy BondedEngine::evaluate(const Coordinates &positions, Coordinates *forces) const {
+  if (positions.size() != natom_ || positions.y.size() != natom_ || positions.z.size() != natom_) {
+    throw std::invalid_argument(fmt::format("BondedEngine expects {} atoms, got {}", natom_, positions.size()));
+  }
+  PositionView const p{.x = positions.x.data(), .y = positions.y.data(), .z = positions.z.data()};
+  ForceSink sink;
+  if (forces != nullptr) {
+    forces->resize(natom_);
+    std::ranges::fill(forces->x, 0.0);
+    std::ranges::fill(forces->y, 0.0);
+    std::ranges::fill(forces->z, 0.0);
+    sink = ForceSink{.x = forces->x.data(), .y = forces->y.data(), .z = forces->z.data()};
+  }
+  Kernels const kernels = select_kernels(options_.level, forces != nullptr);
+  bool const ordered = forces != nullptr;
+
+  BondedEnergy total;
+  BondView const bonds{.i = bonds_.i.data(), .j = bonds_.j.data(), .force = bonds_.force.data(),
+    .equil = bonds_.equil.data()};
+  for (double const energy : run_batches<double>(bonds_.batches, options_.threads, ordered,
+         [&](std::size_t begin, std::size_t end) { return kernels.bonds(bonds, begin, end, p, sink); })) {
+    total.bond += energy;
+  }
+
+  AngleView const angles{.i = angles_.i.data(), .j = angles_.j.data(), .k = angles_.k.data(),
+    .force = angles_.force.data(), .equil = angles_.equil.data()};
+  for (double const energy : run_batches<double>(angles_.batches, options_.threads, ordered,
+         [&](std::size_t begin, std::size_t end) { return kernels.angles(angles, begin, end, p, sink); })) {
+    total.angle += energy;
+  }
+
+  DihedralView const dihedrals{.i = dihedrals_.i.data(),
+    .j = dihedrals_.j.data(),
+    .k = dihedrals_.k.data(),
+    .l = dihedrals_.l.data(),
+    .force = dihedrals_.force.data(),
+    .period = dihedrals_.period.data(),
+    .cos_phase = dihedrals_.cos_phase.data(),
+    .sin_phase = dihedrals_.sin_phase.data(),
+    .improper = dihedrals_.improper.data(),
+    .max_period = max_period_};
+  for (auto const &sums : run_batches<TorsionSums>(dihedrals_.batches, options_.threads, ordered,
+         [&](std::size_t begin, std::size_t end) { return kernels.dihedrals(dihedrals, begin, end, p, sink); })) {
+    total.dihedral += sums.proper;
+    total.improper += sums.improper;
+  }
+  return total;
+}
+
+} // namespace rms
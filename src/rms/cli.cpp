@@ -7,16 +7,45 @@ namespace rms {
 
 std::optional<CliOptions> parse_cli(int argc, char const *const argv[]) {
   CLI::App app{"rms: parse Amber parm7/prmtop topologies and print a summary"};
+  // --threads and --no-cache are also accepted after the subcommand.
+  app.fallthrough();
 
   CliOptions options{};
-  app.add_option("parm7", options.parm7_path, "Path to Amber parm7/prmtop topology file")
-    ->required();
+  app.add_option("parm7", options.parm7_path, "Path to Amber parm7/prmtop topology file");
   app.add_option("--sample", options.sample_count,
     "Number of atoms to sample for force field details (0 to disable)")
     ->default_val(5);
+  app.add_option("--threads", options.threads, "Worker threads for parsing and analysis (0 = all hardware threads)")
+    ->default_val(0);
+  bool no_cache = false;
+  app.add_flag("--no-cache", no_cache, "Parse the text topology without reading or writing <parm7>.rmscache");
+
+  RmsdCliOptions rmsd{};
+  auto *rmsd_cmd = app.add_subcommand("rmsd", "RMSD of every trajectory frame against a reference structure");
+  rmsd_cmd->add_option("parm7", options.parm7_path, "Path to Amber parm7/prmtop topology file")->required();
+  rmsd_cmd->add_option("reference", rmsd.reference_path, "Reference structure (rst7/inpcrd)")->required();
+  rmsd_cmd->add_option("trajectory", rmsd.trajectory_path, "Amber ASCII trajectory (mdcrd)")->required();
+  rmsd_cmd->add_option("-o,--output", rmsd.output_path, "Write the frame / RMSD table here instead of stdout");
+  rmsd_cmd->add_option("--fitted", rmsd.fitted_path, "Also write the trajectory superposed onto the reference");
+  rmsd_cmd->add_option("--mask", rmsd.mask, "Amber mask of the atoms to fit (e.g. ':1-250@CA')");
+  rmsd_cmd->add_flag("--mass", rmsd.mass_weighted, "Weight atoms by their topology MASS");
+
+  PairwiseCliOptions pairwise{};
+  auto *pairwise_cmd = app.add_subcommand("pairwise", "All-vs-all frame RMSD matrix (condensed float32 file)");
+  pairwise_cmd->add_option("parm7", options.parm7_path, "Path to Amber parm7/prmtop topology file")->required();
+  pairwise_cmd->add_option("trajectory", pairwise.trajectory_path, "Amber ASCII trajectory (mdcrd)")->required();
+  pairwise_cmd->add_option("-o,--output", pairwise.matrix_path, "Matrix file to write")->required();
+  pairwise_cmd->add_option("--block", pairwise.block_frames, "Frames per tile side (0 = sized to the cache)")
+    ->default_val(0);
+  pairwise_cmd->add_option("--mask", pairwise.mask, "Amber mask of the atoms compared (e.g. '@CA')");
+  pairwise_cmd->add_flag("--mass", pairwise.mass_weighted, "Weight atoms by their topology MASS");
+  app.require_subcommand(0, 1);
 
   try {
     app.parse(argc, argv);
+    if (app.get_subcommands().empty() && options.parm7_path.empty()) {
+      throw CLI::RequiredError("parm7");
+    }
   } catch (const CLI::CallForHelp &) {
     fmt::print(stderr, "{}", app.help());
     return std::nullopt;
@@ -25,6 +54,13 @@ std::optional<CliOptions> parse_cli(int argc, char const *const argv[]) {
     return std::nullopt;
   }
 
+  options.use_cache = !no_cache;
+  if (rmsd_cmd->parsed()) {
+    options.rmsd = rmsd;
+  }
+  if (pairwise_cmd->parsed()) {
+    options.pairwise = pairwise;
+  }
   return options;
 }
 
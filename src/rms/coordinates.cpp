@@ -0,0 +1,214 @@
+#include "include/coordinates.hpp"
+#include "include/fixed_width.hpp"
+#include "include/mapped_file.hpp"
+#include "include/parallel.hpp"
+#include "include/utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+// Restart coordinates, velocities and the box are all written as 6F12.7.
+constexpr std::size_t kRst7FieldWidth = 12;
+constexpr std::size_t kRst7FieldsPerLine = 6;
+constexpr std::size_t kRst7Decimals = 7;
+// Lines handed to one worker at a time.
+constexpr std::size_t kLinesPerTask = 8192;
+
+[[nodiscard]] std::vector<std::string_view> split_lines(std::span<const char> buffer) {
+  std::vector<std::string_view> lines;
+  char const *pos = buffer.data();
+  char const *const end = buffer.data() + buffer.size();
+  while (pos < end) {
+    auto const *newline = static_cast<char const *>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+    char const *const line_end = newline != nullptr ? newline : end;
+    std::string_view line(pos, static_cast<std::size_t>(line_end - pos));
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    lines.push_back(line);
+    pos = newline != nullptr ? newline + 1 : end;
+  }
+  // Editors and some writers leave blank lines at the end.
+  while (!lines.empty() && trim(lines.back()).empty()) {
+    lines.pop_back();
+  }
+  return lines;
+}
+
+// Decodes the first `count` 12-wide fields of `line`: the fixed-point path takes
+// the well-formed leading run, the general parser whatever it stopped at.
+void decode_line(std::string_view line, std::size_t line_number, std::span<double> out) {
+  auto decoded = decode_fixed_fields(line, kRst7FieldWidth, kRst7Decimals, out);
+  for (; decoded < out.size(); ++decoded) {
+    auto const offset = decoded * kRst7FieldWidth;
+    auto const value =
+      offset < line.size() ? parse_fortran_double(line.substr(offset, kRst7FieldWidth)) : std::nullopt;
+    if (!value) {
+      throw std::runtime_error(fmt::format("rst7 line {}: expected {} values", line_number, out.size()));
+    }
+    out[decoded] = *value;
+  }
+}
+
+// Fills `out` from the interleaved x y z values of `lines`, which start at file
+// line `first_line` (0-based). Each full line holds exactly two atoms.
+void decode_block(std::span<const std::string_view> lines, std::size_t first_line, Coordinates &out,
+  std::size_t threads) {
+  auto const values = out.size() * 3;
+  auto const tasks = (lines.size() + kLinesPerTask - 1) / kLinesPerTask;
+  parallel_for(tasks, threads, [&](std::size_t task) {
+    auto const begin = task * kLinesPerTask;
+    auto const end = std::min(lines.size(), begin + kLinesPerTask);
+    std::array<double, kRst7FieldsPerLine> row{};
+    for (auto line = begin; line < end; ++line) {
+      auto const first_value = line * kRst7FieldsPerLine;
+      auto const count = std::min(kRst7FieldsPerLine, values - first_value);
+      decode_line(lines[line], first_line + line + 1, std::span(row).first(count));
+      auto const atom = line * 2;
+      out.x[atom] = row[0];
+      out.y[atom] = row[1];
+      out.z[atom] = row[2];
+      if (count == kRst7FieldsPerLine) {
+        out.x[atom + 1] = row[3];
+        out.y[atom + 1] = row[4];
+        out.z[atom + 1] = row[5];
+      }
+    }
+  });
+}
+
+[[nodiscard]] std::array<double, 6> decode_box(std::string_view line, std::size_t line_number) {
+  auto const fields = std::min(kRst7FieldsPerLine, trim_right(line).size() / kRst7FieldWidth);
+  if (fields != 3 && fields != kRst7FieldsPerLine) {
+    throw std::runtime_error(fmt::format("rst7 line {}: box line must hold 3 or 6 values", line_number));
+  }
+  std::array<double, 6> box = {0.0, 0.0, 0.0, 90.0, 90.0, 90.0};
+  decode_line(line, line_number, std::span(box).first(fields));
+  return box;
+}
+
+void write_block(std::string &out, const Coordinates &values) {
+  for (std::size_t atom = 0; atom < values.size(); ++atom) {
+    fmt::format_to(
+      std::back_inserter(out), "{:12.7f}{:12.7f}{:12.7f}", values.x[atom], values.y[atom], values.z[atom]);
+    if (atom % 2 == 1 || atom + 1 == values.size()) {
+      out.push_back('\n');
+    }
+  }
+}
+
+} // namespace
+
+Rst7 parse_rst7_file(const std::filesystem::path &path, const Rst7ParseOptions &options) {
+  MappedFile file;
+  try {
+    file = MappedFile(path);
+  } catch (const std::runtime_error &) {
+    throw std::runtime_error(fmt::format("Failed to open rst7 file: {}", path.string()));
+  }
+  return parse_rst7_buffer(file.bytes(), options);
+}
+
+Rst7 parse_rst7_file(const std::filesystem::path &path, const Parm7Topology &topo, const Rst7ParseOptions &options) {
+  auto rst7 = parse_rst7_file(path, options);
+  check_rst7(topo, rst7);
+  return rst7;
+}
+
+Rst7 parse_rst7_buffer(std::span<const char> buffer, const Rst7ParseOptions &options) {
+  auto const lines = split_lines(buffer);
+  if (lines.size() < 2) {
+    throw std::runtime_error("rst7 is missing the title or atom count line");
+  }
+
+  Rst7 rst7;
+  rst7.title = std::string(trim_right(lines[0]));
+
+  // "NATOM [time]", written as I5 (I6 past 99999 atoms) and E15.7; read as tokens.
+  std::optional<int> natom;
+  std::size_t tokens = 0;
+  for_each_token(lines[1], [&](std::string_view token) {
+    if (tokens == 0) {
+      natom = to_int(token);
+    } else if (tokens == 1) {
+      rst7.time = to_double(token);
+    }
+    ++tokens;
+  });
+  if (!natom || *natom < 0) {
+    throw std::runtime_error(fmt::format("rst7 has an invalid atom count line: '{}'", trim(lines[1])));
+  }
+
+  auto const atoms = static_cast<std::size_t>(*natom);
+  auto const block_lines = (atoms * 3 + kRst7FieldsPerLine - 1) / kRst7FieldsPerLine;
+  auto const body = std::span(lines).subspan(2);
+  if (body.size() < block_lines) {
+    throw std::runtime_error(
+      fmt::format("rst7 holds {} coordinate lines, but {} atoms need {}", body.size(), atoms, block_lines));
+  }
+
+  // What follows the positions is told apart by line count: a full velocity
+  // block, then at most one box line. A single extra line is read as the box,
+  // as the Amber tools do for one- and two-atom systems.
+  auto const extra = body.size() - block_lines;
+  bool const has_velocities = extra > 1 && (extra == block_lines || extra == block_lines + 1);
+  bool const has_box = extra == 1 || (has_velocities && extra == block_lines + 1);
+  if (extra > 0 && !has_velocities && !has_box) {
+    throw std::runtime_error(fmt::format("rst7 has {} unexpected lines after the coordinates", extra));
+  }
+
+  rst7.positions = Coordinates(atoms);
+  decode_block(body.first(block_lines), 2, rst7.positions, options.threads);
+  if (has_velocities) {
+    rst7.velocities.emplace(atoms);
+    decode_block(body.subspan(block_lines, block_lines), 2 + block_lines, *rst7.velocities, options.threads);
+  }
+  if (has_box) {
+    rst7.box = decode_box(body.back(), lines.size());
+  }
+  return rst7;
+}
+
+std::string format_rst7(const Rst7 &rst7) {
+  std::string out;
+  // 36 bytes per atom and block, plus a newline per atom pair.
+  out.reserve(256 + rst7.natom() * (rst7.velocities ? 2 : 1) * 37);
+  fmt::format_to(std::back_inserter(out), "{:<80}\n", rst7.title);
+  fmt::format_to(std::back_inserter(out), "{:{}d}", rst7.natom(), rst7.natom() > 99999 ? 6 : 5);
+  if (rst7.time) {
+    fmt::format_to(std::back_inserter(out), "{:15.7E}", *rst7.time);
+  }
+  out.push_back('\n');
+  write_block(out, rst7.positions);
+  if (rst7.velocities) {
+    write_block(out, *rst7.velocities);
+  }
+  if (rst7.box) {
+    for (auto const value : *rst7.box) {
+      fmt::format_to(std::back_inserter(out), "{:12.7f}", value);
+    }
+    out.push_back('\n');
+  }
+  return out;
+}
+
+void check_rst7(const Parm7Topology &topo, const Rst7 &rst7) {
+  if (rst7.natom() != static_cast<std::size_t>(topo.pointers.natom)) {
+    throw std::runtime_error(
+      fmt::format("rst7 has {} atoms, but the topology has NATOM = {}", rst7.natom(), topo.pointers.natom));
+  }
+}
+
+} // namespace rms
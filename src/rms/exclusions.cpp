@@ -0,0 +1,117 @@
+#include "include/exclusions.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kAtomsPerTask = 4096;
+
+} // namespace
+
+ExclusionList::ExclusionList(const Parm7Topology &topo, std::size_t threads) {
+  auto const natom = static_cast<std::size_t>(topo.pointers.natom);
+  auto const &counts = topo.number_excluded_atoms;
+  auto const &list = topo.excluded_atoms_list;
+  if (counts.size() != natom) {
+    throw std::runtime_error(fmt::format("ExclusionList needs NUMBER_EXCLUDED_ATOMS with {} entries, got {}", natom,
+      counts.size()));
+  }
+
+  std::vector<std::size_t> source(natom + 1, 0);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    if (counts[atom] < 0) {
+      throw std::runtime_error(fmt::format("NUMBER_EXCLUDED_ATOMS entry {} is negative: {}", atom, counts[atom]));
+    }
+    source[atom + 1] = source[atom] + static_cast<std::size_t>(counts[atom]);
+  }
+  if (source.back() != list.size()) {
+    throw std::runtime_error(fmt::format("NUMBER_EXCLUDED_ATOMS sums to {}, but EXCLUDED_ATOMS_LIST has {} entries",
+      source.back(), list.size()));
+  }
+
+  // Pass 1: clean each row in a scratch copy (drop placeholders and self
+  // entries, sort, dedupe). Amber lists only higher partners; note any row that
+  // does not, since those pairs then belong to another row.
+  std::vector<int> rows(list.begin(), list.end());
+  std::vector<std::size_t> kept(natom, 0);
+  std::atomic<bool> upper_only{true};
+  std::size_t const tasks = (natom + kAtomsPerTask - 1) / kAtomsPerTask;
+  parallel_for(tasks, threads, [&](std::size_t task) {
+    std::size_t const end = std::min(natom, (task + 1) * kAtomsPerTask);
+    for (std::size_t atom = task * kAtomsPerTask; atom < end; ++atom) {
+      auto const first = rows.begin() + static_cast<std::ptrdiff_t>(source[atom]);
+      auto last = rows.begin() + static_cast<std::ptrdiff_t>(source[atom + 1]);
+      for (auto it = first; it != last; ++it) {
+        if (*it < -1 || *it >= static_cast<int>(natom)) {
+          throw std::runtime_error(fmt::format("EXCLUDED_ATOMS_LIST entry for atom {} is out of range: {}", atom,
+            *it + 1));
+        }
+      }
+      int const self = static_cast<int>(atom);
+      last = std::remove_if(first, last, [self](int partner) { return partner < 0 || partner == self; });
+      std::sort(first, last);
+      last = std::unique(first, last);
+      if (first != last && *first < self) {
+        upper_only.store(false, std::memory_order_relaxed);
+      }
+      kept[atom] = static_cast<std::size_t>(last - first);
+    }
+  });
+
+  if (!upper_only.load()) {
+    // Rare: re-home every pair under its lower atom, then rebuild the rows.
+    std::vector<std::pair<int, int>> pairs;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      for (std::size_t idx = source[atom]; idx < source[atom] + kept[atom]; ++idx) {
+        int const self = static_cast<int>(atom);
+        pairs.emplace_back(std::min(self, rows[idx]), std::max(self, rows[idx]));
+      }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    std::fill(kept.begin(), kept.end(), 0);
+    rows.clear();
+    for (auto const &[low, high] : pairs) {
+      ++kept[static_cast<std::size_t>(low)];
+      rows.push_back(high);
+    }
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      source[atom + 1] = source[atom] + kept[atom];
+    }
+  }
+
+  // Pass 2: compact the rows and fill the short-range masks.
+  offsets_.assign(natom + 1, 0);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    offsets_[atom + 1] = offsets_[atom] + kept[atom];
+  }
+  partners_.resize(offsets_.back());
+  window_.assign(natom, 0);
+  parallel_for(tasks, threads, [&](std::size_t task) {
+    std::size_t const end = std::min(natom, (task + 1) * kAtomsPerTask);
+    for (std::size_t atom = task * kAtomsPerTask; atom < end; ++atom) {
+      auto const first = rows.begin() + static_cast<std::ptrdiff_t>(source[atom]);
+      auto const last = first + static_cast<std::ptrdiff_t>(kept[atom]);
+      std::copy(first, last, partners_.begin() + static_cast<std::ptrdiff_t>(offsets_[atom]));
+      for (auto it = first; it != last; ++it) {
+        auto const gap = static_cast<std::size_t>(*it) - atom;
+        if (gap > kExclusionWindow) {
+          break;
+        }
+        window_[atom] |= std::uint64_t{1} << (gap - 1);
+      }
+    }
+  });
+}
+
+} // namespace rms
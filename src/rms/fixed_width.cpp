@@ -0,0 +1,448 @@
+#include "include/fixed_width.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+using DecodeI8Fn = std::size_t (*)(char const *, std::size_t, int *) noexcept;
+
+[[nodiscard]] bool decode_i8_field(char const *field, int &value) noexcept {
+  std::size_t pos = 0;
+  while (pos < kI8FieldWidth && field[pos] == ' ') {
+    ++pos;
+  }
+  bool negative = false;
+  if (pos < kI8FieldWidth && field[pos] == '-') {
+    negative = true;
+    ++pos;
+  }
+  if (pos == kI8FieldWidth) {
+    return false;
+  }
+  int result = 0;
+  for (; pos < kI8FieldWidth; ++pos) {
+    auto const digit = static_cast<unsigned>(field[pos]) - static_cast<unsigned>('0');
+    if (digit > 9U) {
+      return false;
+    }
+    result = result * 10 + static_cast<int>(digit);
+  }
+  value = negative ? -result : result;
+  return true;
+}
+
+std::size_t decode_i8_scalar(char const *text, std::size_t fields, int *out) noexcept {
+  for (std::size_t idx = 0; idx < fields; ++idx) {
+    if (!decode_i8_field(text + idx * kI8FieldWidth, out[idx])) {
+      return idx;
+    }
+  }
+  return fields;
+}
+
+#if RMS_X86_DISPATCH
+// Validates one field from its per-byte class masks (bit i = byte i): the
+// digits must be a non-empty suffix, optionally preceded by a single '-',
+// and every other byte must be a blank.
+[[nodiscard]] constexpr bool valid_i8_masks(unsigned digits, unsigned minus, unsigned space) noexcept {
+  unsigned const lowest = digits & (0U - digits);
+  if (digits == 0 || digits + lowest != 0x100U) {
+    return false;
+  }
+  unsigned const prefix = lowest - 1U;
+  if (minus == 0) {
+    return space == prefix;
+  }
+  return lowest > 1U && minus == (lowest >> 1U) && space == (prefix & ~minus);
+}
+
+// Checks `count` fields packed into the low bits of the movemask results and
+// collects a bit per negative field.
+[[nodiscard]] constexpr bool valid_i8_block(std::uint32_t digits, std::uint32_t minus, std::uint32_t space,
+  std::size_t count, unsigned &negative) noexcept {
+  negative = 0;
+  for (std::size_t field = 0; field < count; ++field) {
+    auto const shift = static_cast<unsigned>(field * kI8FieldWidth);
+    unsigned const d = (digits >> shift) & 0xFFU;
+    unsigned const m = (minus >> shift) & 0xFFU;
+    unsigned const s = (space >> shift) & 0xFFU;
+    if (!valid_i8_masks(d, m, s)) {
+      return false;
+    }
+    negative |= (m != 0 ? 1U : 0U) << field;
+  }
+  return true;
+}
+
+// Folds the digits of each 8-byte field into one int32: pairs (x10), quads
+// (x100), then the two quads of a field (x10000). Always inlined so the AVX2
+// kernel gets a VEX-encoded copy for its tail and never mixes in legacy SSE.
+[[gnu::always_inline]] RMS_TARGET("sse4.2") inline std::size_t decode_i8_pairs(char const *text, std::size_t fields,
+  int *out) noexcept {
+  __m128i const zero_char = _mm_set1_epi8('0');
+  __m128i const nine = _mm_set1_epi8(9);
+  __m128i const minus_char = _mm_set1_epi8('-');
+  __m128i const space_char = _mm_set1_epi8(' ');
+  __m128i const w10 = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+  __m128i const w100 = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+  __m128i const w10000 = _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
+
+  std::size_t idx = 0;
+  for (; idx + 2 <= fields; idx += 2) {
+    __m128i const chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(text + idx * kI8FieldWidth));
+    __m128i const digits = _mm_sub_epi8(chars, zero_char);
+    __m128i const is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+
+    unsigned negative = 0;
+    if (!valid_i8_block(static_cast<std::uint32_t>(_mm_movemask_epi8(is_digit)),
+          static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, minus_char))),
+          static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, space_char))), 2, negative)) {
+      break;
+    }
+
+    __m128i const pairs = _mm_maddubs_epi16(_mm_and_si128(digits, is_digit), w10);
+    __m128i const quads = _mm_madd_epi16(pairs, w100);
+    __m128i const values = _mm_madd_epi16(_mm_packus_epi32(quads, quads), w10000);
+    __m128i const signs = _mm_setr_epi32((negative & 1U) != 0 ? -1 : 1, (negative & 2U) != 0 ? -1 : 1, 1, 1);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + idx), _mm_sign_epi32(values, signs));
+  }
+  return idx + decode_i8_scalar(text + idx * kI8FieldWidth, fields - idx, out + idx);
+}
+
+RMS_TARGET("sse4.2") std::size_t decode_i8_sse42(char const *text, std::size_t fields, int *out) noexcept {
+  return decode_i8_pairs(text, fields, out);
+}
+
+RMS_TARGET("avx2") std::size_t decode_i8_avx2(char const *text, std::size_t fields, int *out) noexcept {
+  __m256i const zero_char = _mm256_set1_epi8('0');
+  __m256i const nine = _mm256_set1_epi8(9);
+  __m256i const minus_char = _mm256_set1_epi8('-');
+  __m256i const space_char = _mm256_set1_epi8(' ');
+  __m256i const w10 = _mm256_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+    10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+  __m256i const w100 = _mm256_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1);
+  __m256i const w10000 =
+    _mm256_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1);
+  __m256i const gather = _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5);
+
+  std::size_t idx = 0;
+  for (; idx + 4 <= fields; idx += 4) {
+    __m256i const chars = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(text + idx * kI8FieldWidth));
+    __m256i const digits = _mm256_sub_epi8(chars, zero_char);
+    __m256i const is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, nine), digits);
+
+    unsigned negative = 0;
+    if (!valid_i8_block(static_cast<std::uint32_t>(_mm256_movemask_epi8(is_digit)),
+          static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, minus_char))),
+          static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, space_char))), 4, negative)) {
+      break;
+    }
+
+    __m256i const pairs = _mm256_maddubs_epi16(_mm256_and_si256(digits, is_digit), w10);
+    __m256i const quads = _mm256_madd_epi16(pairs, w100);
+    __m256i const values = _mm256_madd_epi16(_mm256_packus_epi32(quads, quads), w10000);
+    __m128i const packed = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(values, gather));
+    __m128i const signs = _mm_setr_epi32((negative & 1U) != 0 ? -1 : 1, (negative & 2U) != 0 ? -1 : 1,
+      (negative & 4U) != 0 ? -1 : 1, (negative & 8U) != 0 ? -1 : 1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + idx), _mm_sign_epi32(packed, signs));
+  }
+  // GCC 12 emits no vzeroupper on this function's way out, and legacy SSE code
+  // run later with dirty upper halves (libm's log, for one) slows down ~25x.
+  _mm256_zeroupper();
+  return idx + decode_i8_pairs(text + idx * kI8FieldWidth, fields - idx, out + idx);
+}
+#endif
+
+[[nodiscard]] DecodeI8Fn select_decode_i8(SimdLevel level) noexcept {
+#if RMS_X86_DISPATCH
+  level = std::min(level, detected_simd_level());
+  if (level >= SimdLevel::Avx2) {
+    return &decode_i8_avx2;
+  }
+  if (level >= SimdLevel::Sse42) {
+    return &decode_i8_sse42;
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return &decode_i8_scalar;
+}
+
+// Powers of ten that are exactly representable as doubles.
+constexpr std::array<double, 23> kExactPowersOf10 = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Exact path for plain decimal reals such as E16.8 output: when the decimal
+// mantissa fits in 53 bits and the power of ten is exact, a single multiply or
+// divide is correctly rounded (Clinger's fast path). Returns false whenever
+// that does not hold, or when `text` is not entirely a number.
+[[nodiscard]] bool parse_real_exact(std::string_view text, double &value) noexcept {
+  std::size_t pos = 0;
+  bool negative = false;
+  if (text[pos] == '-' || text[pos] == '+') {
+    negative = text[pos] == '-';
+    ++pos;
+  }
+
+  std::uint64_t mantissa = 0;
+  int significant = 0;
+  int fraction_digits = 0;
+  bool seen_digit = false;
+  bool seen_dot = false;
+  for (; pos < text.size(); ++pos) {
+    char const ch = text[pos];
+    auto const digit = static_cast<unsigned>(ch) - static_cast<unsigned>('0');
+    if (digit <= 9U) {
+      seen_digit = true;
+      if ((mantissa != 0 || digit != 0) && ++significant > 19) {
+        return false;
+      }
+      mantissa = mantissa * 10U + digit;
+      fraction_digits += seen_dot ? 1 : 0;
+    } else if (ch == '.' && !seen_dot) {
+      seen_dot = true;
+    } else {
+      break;
+    }
+  }
+  if (!seen_digit) {
+    return false;
+  }
+
+  int exponent = 0;
+  if (pos < text.size()) {
+    char const marker = text[pos];
+    if (marker == 'E' || marker == 'e' || marker == 'D' || marker == 'd') {
+      ++pos;
+    } else if (marker != '+' && marker != '-') {
+      return false;
+    }
+    bool negative_exponent = false;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+      negative_exponent = text[pos] == '-';
+      ++pos;
+    }
+    if (pos == text.size()) {
+      return false;
+    }
+    for (; pos < text.size(); ++pos) {
+      auto const digit = static_cast<unsigned>(text[pos]) - static_cast<unsigned>('0');
+      if (digit > 9U) {
+        return false;
+      }
+      exponent = std::min(exponent * 10 + static_cast<int>(digit), 10000);
+    }
+    exponent = negative_exponent ? -exponent : exponent;
+  }
+
+  int const scale = exponent - fraction_digits;
+  if (mantissa > (std::uint64_t{1} << 53U) || scale < -22 || scale > 22) {
+    return false;
+  }
+  auto const magnitude = static_cast<double>(mantissa);
+  value = scale < 0 ? magnitude / kExactPowersOf10[static_cast<std::size_t>(-scale)]
+                    : magnitude * kExactPowersOf10[static_cast<std::size_t>(scale)];
+  value = negative ? -value : value;
+  return true;
+}
+
+// General path: rewrites the field into C syntax on the stack ('D' -> 'E',
+// "1.5-100" -> "1.5E-100", no leading '+') and hands it to std::from_chars.
+[[nodiscard]] std::optional<double> parse_real_general(std::string_view text) noexcept {
+  std::array<char, 64> buffer{};
+  std::size_t len = 0;
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+  }
+  double value = 0.0;
+  if (text.size() * 2 + 1 > buffer.size()) {
+    // Far wider than any parm7 field; parse it as plain C syntax in place.
+    auto const [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || ptr == text.data()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  bool seen_exponent = false;
+  for (std::size_t pos = 0; pos < text.size(); ++pos) {
+    char ch = text[pos];
+    if (ch == 'D' || ch == 'd' || ch == 'E' || ch == 'e') {
+      ch = 'E';
+      seen_exponent = true;
+    } else if ((ch == '+' || ch == '-') && !seen_exponent && pos > 0
+               && (std::isdigit(static_cast<unsigned char>(text[pos - 1])) != 0 || text[pos - 1] == '.')) {
+      buffer[len++] = 'E';
+      seen_exponent = true;
+    }
+    buffer[len++] = ch;
+  }
+
+  auto const [ptr, ec] = std::from_chars(buffer.data(), buffer.data() + len, value);
+  if (ec == std::errc::result_out_of_range) {
+    // Keep strtod's overflow/underflow results; the buffer is NUL-terminated.
+    return std::strtod(buffer.data(), nullptr);
+  }
+  if (ec != std::errc() || ptr == buffer.data()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+constexpr std::uint64_t kAsciiZeros = 0x3030303030303030ULL;
+
+// True when all eight bytes of `chunk` are ASCII digits.
+[[nodiscard]] constexpr bool is_eight_digits(std::uint64_t chunk) noexcept {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4U))
+    == 0x3333333333333333ULL;
+}
+
+// Value of eight ASCII digits loaded little-endian (first byte most
+// significant), in three multiplies: pairs, then quads, then the halves.
+[[nodiscard]] constexpr std::uint64_t eight_digits_value(std::uint64_t chunk) noexcept {
+  constexpr std::uint64_t kMask = 0x000000FF000000FFULL;
+  constexpr std::uint64_t kMul1 = 100 + (1000000ULL << 32U);
+  constexpr std::uint64_t kMul2 = 1 + (10000ULL << 32U);
+  chunk -= kAsciiZeros;
+  chunk = chunk * 10 + (chunk >> 8U);
+  return (((chunk & kMask) * kMul1) + (((chunk >> 16U) & kMask) * kMul2)) >> 32U;
+}
+
+[[nodiscard]] std::uint64_t load_le64(char const *bytes) noexcept {
+  std::uint64_t chunk = 0;
+  std::memcpy(&chunk, bytes, sizeof(chunk));
+  if constexpr (std::endian::native != std::endian::little) {
+    chunk = std::byteswap(chunk);
+  }
+  return chunk;
+}
+
+// Mask of the low `count` (0..8) bytes.
+[[nodiscard]] constexpr std::uint64_t low_bytes(std::size_t count) noexcept {
+  return count >= 8 ? ~std::uint64_t{0} : (std::uint64_t{1} << (count * 8U)) - 1U;
+}
+
+// The `decimals` (1..8) digits ending at `end`, or nothing if any is not a digit.
+[[nodiscard]] std::optional<std::uint64_t> fraction_digits(char const *end, std::size_t decimals) noexcept {
+  // Drop the bytes before the fraction and refill them with '0'.
+  auto const keep = ~low_bytes(8 - decimals);
+  auto const chunk = (load_le64(end - 8) & keep) | (kAsciiZeros & ~keep);
+  if (!is_eight_digits(chunk)) {
+    return std::nullopt;
+  }
+  return eight_digits_value(chunk);
+}
+
+[[nodiscard]] bool decode_fixed_field(char const *field, std::size_t width, std::size_t decimals,
+  double &value) noexcept {
+  std::size_t const point = width - decimals - 1;
+  if (field[point] != '.') {
+    return false;
+  }
+  std::size_t pos = 0;
+  while (pos < point && field[pos] == ' ') {
+    ++pos;
+  }
+  bool const negative = pos < point && field[pos] == '-';
+  pos += negative ? 1 : 0;
+  // Up to 15 digits in all, the scaled integer fits the 53-bit significand and
+  // one division is exact (Clinger); longer fields take the general path.
+  if (pos == point || point - pos + decimals > 15) {
+    return false;
+  }
+  std::uint64_t whole = 0;
+  for (; pos < point; ++pos) {
+    auto const digit = static_cast<unsigned>(field[pos]) - static_cast<unsigned>('0');
+    if (digit > 9U) {
+      return false;
+    }
+    whole = whole * 10U + digit;
+  }
+  auto const fraction = fraction_digits(field + width, decimals);
+  if (!fraction) {
+    return false;
+  }
+  auto const scale = static_cast<std::uint64_t>(kExactPowersOf10[decimals]);
+  auto const magnitude = static_cast<double>(whole * scale + *fraction) / kExactPowersOf10[decimals];
+  value = negative ? -magnitude : magnitude;
+  return true;
+}
+
+} // namespace
+
+std::optional<double> parse_fortran_double(std::string_view field) noexcept {
+  // Fixed-width fields are mostly leading blanks; skip them without trim()'s character-set search.
+  auto is_blank = [](char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); };
+  std::size_t first = 0;
+  std::size_t last = field.size();
+  while (first < last && is_blank(field[first])) {
+    ++first;
+  }
+  while (last > first && is_blank(field[last - 1])) {
+    --last;
+  }
+  auto const trimmed = field.substr(first, last - first);
+  if (trimmed.empty()) {
+    return std::nullopt;
+  }
+  double value = 0.0;
+  if (parse_real_exact(trimmed, value)) {
+    return value;
+  }
+  return parse_real_general(trimmed);
+}
+
+std::size_t decode_real_fields(std::string_view text, std::size_t width, std::span<double> out) noexcept {
+  if (width == 0) {
+    return 0;
+  }
+  std::size_t const fields = std::min(text.size() / width, out.size());
+  for (std::size_t idx = 0; idx < fields; ++idx) {
+    auto const value = parse_fortran_double(text.substr(idx * width, width));
+    if (!value) {
+      return idx;
+    }
+    out[idx] = *value;
+  }
+  return fields;
+}
+
+std::size_t decode_fixed_fields(std::string_view text, std::size_t width, std::size_t decimals,
+  std::span<double> out) noexcept {
+  // The fraction is read as one eight-byte load ending at the field's end.
+  if (decimals == 0 || decimals > 8 || width < 8 || width < decimals + 2) {
+    return 0;
+  }
+  std::size_t const fields = std::min(text.size() / width, out.size());
+  for (std::size_t idx = 0; idx < fields; ++idx) {
+    if (!decode_fixed_field(text.data() + idx * width, width, decimals, out[idx])) {
+      return idx;
+    }
+  }
+  return fields;
+}
+
+std::size_t decode_i8_fields(std::string_view text, std::span<int> out) noexcept {
+  static DecodeI8Fn const decode = select_decode_i8(detected_simd_level());
+  std::size_t const fields = std::min(text.size() / kI8FieldWidth, out.size());
+  return decode(text.data(), fields, out.data());
+}
+
+std::size_t decode_i8_fields(std::string_view text, std::span<int> out, SimdLevel level) noexcept {
+  std::size_t const fields = std::min(text.size() / kI8FieldWidth, out.size());
+  return select_decode_i8(level)(text.data(), fields, out.data());
+}
+
+} // namespace rms
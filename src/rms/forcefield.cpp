@@ -2,11 +2,15 @@
 #include "include/parsers.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <optional>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include <fmt/format.h>
+
 namespace rms {
 
 std::vector<int> build_atom_residue_map(const Parm7Topology &topo) {
@@ -68,4 +72,34 @@ std::optional<std::pair<double, double>> lj_pair_coeffs(const Parm7Topology &top
   return std::pair<double, double>{topo.lennard_jones_acoeff[*idx], topo.lennard_jones_bcoeff[*idx]};
 }
 
+LJTable::LJTable(const Parm7Topology &topo) : ntypes_(static_cast<std::size_t>(topo.pointers.ntypes)) {
+  std::size_t const pairs = ntypes_ * ntypes_;
+  if (topo.nonbonded_parm_index.size() != pairs) {
+    throw std::runtime_error(fmt::format("LJTable needs NONBONDED_PARM_INDEX with {} entries, got {}", pairs,
+      topo.nonbonded_parm_index.size()));
+  }
+
+  coefficients_.assign(2 * pairs, 0.0);
+  sigma_epsilon_.assign(2 * pairs, 0.0);
+  for (std::size_t idx = 0; idx < pairs; ++idx) {
+    int const param_index = topo.nonbonded_parm_index[idx];
+    if (param_index < 0) {
+      continue;
+    }
+    auto const param = static_cast<std::size_t>(param_index);
+    if (param >= topo.lennard_jones_acoeff.size() || param >= topo.lennard_jones_bcoeff.size()) {
+      throw std::runtime_error(fmt::format("NONBONDED_PARM_INDEX entry {} points past the LJ coefficients", idx));
+    }
+
+    double const acoef = topo.lennard_jones_acoeff[param];
+    double const bcoef = topo.lennard_jones_bcoeff[param];
+    coefficients_[2 * idx] = acoef;
+    coefficients_[2 * idx + 1] = bcoef;
+    if (acoef > 0.0 && bcoef > 0.0) {
+      sigma_epsilon_[2 * idx] = std::pow(acoef / bcoef, 1.0 / 6.0);
+      sigma_epsilon_[2 * idx + 1] = bcoef * bcoef / (4.0 * acoef);
+    }
+  }
+}
+
 } // namespace rms
@@ -0,0 +1,640 @@
+#include "include/generalized_born.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+// Atoms per task in both passes; the energy is summed per task in task order.
+constexpr std::size_t kAtomsPerTask = 64;
+// kappa^2 per mol/L of monovalent salt at 300 K, as sander sets it.
+constexpr double kKappaSquaredPerMolar = 0.10806;
+// sander's Born radius when HCT descreening overshoots 1 / rho.
+constexpr double kFallbackBornRadius = 30.0;
+// exp() arguments are clamped here, well past where the result stops mattering.
+constexpr double kExpFloor = -700.0;
+
+struct GbView {
+  double const *x;
+  double const *y;
+  double const *z;
+  double const *rho;
+  double const *inv_rho;
+  double const *scaled;
+  double const *charge;
+  double const *born;
+  double const *inv_born;
+  double rgbmax;
+  double cutoff2;
+  double kappa;
+  double inv_solute;
+  double inv_solvent;
+};
+
+// Sum over partners [begin, end) of twice atom i's descreening integral.
+using DescreenFn = double (*)(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept;
+// Sum over partners [begin, end) of q_j g(f_ij) / f_ij for atom i.
+using PairsFn = double (*)(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept;
+
+// The HCT integral of 1 / r^4 over the sphere of radius s at distance r,
+// outside radius rho and inside rgbmax, in closed form between
+// L = max(rho, |r - s|) and U = min(r + s, rgbmax); doubled, plus the
+// 2 (1 / rho - 1 / L) of an atom buried inside the sphere.
+[[gnu::always_inline]] inline double descreen_pair(const GbView &v, std::size_t i, std::size_t j) noexcept {
+  double const dx = v.x[j] - v.x[i];
+  double const dy = v.y[j] - v.y[i];
+  double const dz = v.z[j] - v.z[i];
+  double const r = std::sqrt(dx * dx + dy * dy + dz * dz);
+  double const s = v.scaled[j];
+  double const upper = std::min(r + s, v.rgbmax);
+  double const lower = std::max(v.rho[i], std::abs(r - s));
+  if (!(lower < upper)) {
+    return 0.0;
+  }
+  // 1 / r, 1 / L and 1 / U from one division.
+  double const inv_rlu = 1.0 / (r * lower * upper);
+  double const inv_r = lower * upper * inv_rlu;
+  double const inv_l = r * upper * inv_rlu;
+  double const inv_u = r * lower * inv_rlu;
+  double term = inv_l - inv_u + 0.25 * (r - s * s * inv_r) * (inv_u * inv_u - inv_l * inv_l)
+              + 0.5 * inv_r * std::log(lower * inv_u);
+  if (v.rho[i] < s - r) {
+    term += 2.0 * (v.inv_rho[i] - inv_l);
+  }
+  return term;
+}
+
+double descreen_scalar(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  double sum = 0.0;
+  for (std::size_t j = begin; j < end; ++j) {
+    sum += descreen_pair(v, i, j);
+  }
+  return sum;
+}
+
+template <bool Salt>
+[[gnu::always_inline]] inline double pair_term(const GbView &v, std::size_t i, std::size_t j) noexcept {
+  double const dx = v.x[j] - v.x[i];
+  double const dy = v.y[j] - v.y[i];
+  double const dz = v.z[j] - v.z[i];
+  double const r2 = dx * dx + dy * dy + dz * dz;
+  if (!(r2 < v.cutoff2)) {
+    return 0.0;
+  }
+  double const rr = v.born[i] * v.born[j];
+  double const f =
+    std::sqrt(r2 + rr * std::exp(std::max(-0.25 * r2 * v.inv_born[i] * v.inv_born[j], kExpFloor)));
+  double const g = Salt ? v.inv_solute - std::exp(-v.kappa * f) * v.inv_solvent : v.inv_solute - v.inv_solvent;
+  return v.charge[j] * g / f;
+}
+
+template <bool Salt>
+double pairs_scalar(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  double sum = 0.0;
+  for (std::size_t j = begin; j < end; ++j) {
+    sum += pair_term<Salt>(v, i, j);
+  }
+  return sum;
+}
+
+#if RMS_X86_DISPATCH
+// Cephes' exp: n = round(x / ln 2), a rational approximation of e^(x - n ln 2)
+// on [-ln 2 / 2, ln 2 / 2], then scaled by 2^n. Good to about 1 ulp.
+constexpr std::array<double, 3> kExpP = {
+  1.26177193074810590878e-4, 3.02994407707441961300e-2, 9.99999999999999999910e-1};
+constexpr std::array<double, 4> kExpQ = {
+  3.00198505138664455042e-6, 2.52448340349684104192e-3, 2.27265548208155028766e-1, 2.00000000000000000009e0};
+constexpr double kLn2High = 6.93145751953125e-1;
+constexpr double kLn2Low = 1.42860682030941723212e-6;
+// Cephes' log: x = m 2^e with m in [sqrt(1/2), sqrt(2)), then a rational
+// approximation of log(m) around 1. Good to about 1 ulp for normal x > 0.
+constexpr std::array<double, 6> kLogP = {1.01875663804580931796e-4, 4.97494994976747001425e-1,
+  4.70579119878881725854e0, 1.44989225341610930846e1, 1.79368678507819816313e1, 7.70838733755885391666e0};
+constexpr std::array<double, 5> kLogQ = {1.12873587189167450590e1, 4.52279145837532221105e1,
+  8.29875266912776603211e1, 7.11544750618563894466e1, 2.31251620126765340583e1};
+constexpr double kLogHigh = 0.693359375;
+constexpr double kLogLow = -2.121944400546905827679e-4;
+
+struct Avx2Ops {
+  using Vec = __m256d;
+  using Mask = __m256d;
+  static constexpr std::size_t kWidth = 4;
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec load(double const *p) noexcept {
+    return _mm256_loadu_pd(p);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec zero() noexcept { return _mm256_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec set1(double v) noexcept { return _mm256_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec add(Vec a, Vec b) noexcept { return _mm256_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec div(Vec a, Vec b) noexcept { return _mm256_div_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  // c - a * b
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec fnma(Vec a, Vec b, Vec c) noexcept {
+    return _mm256_fnmadd_pd(a, b, c);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec sqrt(Vec v) noexcept { return _mm256_sqrt_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec max(Vec a, Vec b) noexcept { return _mm256_max_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec min(Vec a, Vec b) noexcept { return _mm256_min_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec abs(Vec v) noexcept {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Mask less(Vec a, Vec b) noexcept {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static bool any(Mask mask) noexcept {
+    return _mm256_movemask_pd(mask) != 0;
+  }
+  // mask ? a : b
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec select(Mask mask, Vec a, Vec b) noexcept {
+    return _mm256_blendv_pd(b, a, mask);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static double sum(Vec v) noexcept {
+    __m128d const pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+  }
+  // e^x for x <= 0.
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec exp(Vec x) noexcept {
+    x = max(x, set1(kExpFloor));
+    Vec const n =
+      _mm256_round_pd(mul(x, set1(std::numbers::log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = fnma(n, set1(kLn2Low), fnma(n, set1(kLn2High), x));
+    Vec const xx = mul(x, x);
+    Vec p = set1(kExpP[0]);
+    for (std::size_t c = 1; c < kExpP.size(); ++c) {
+      p = fma(p, xx, set1(kExpP[c]));
+    }
+    p = mul(p, x);
+    Vec q = set1(kExpQ[0]);
+    for (std::size_t c = 1; c < kExpQ.size(); ++c) {
+      q = fma(q, xx, set1(kExpQ[c]));
+    }
+    Vec const m = fma(set1(2.0), div(p, sub(q, p)), set1(1.0));
+    // 2^n built in the exponent field; n >= -1010 after the clamp.
+    __m256i const biased = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n)), _mm256_set1_epi64x(1023));
+    return mul(m, _mm256_castsi256_pd(_mm256_slli_epi64(biased, 52)));
+  }
+  // log(x) for normal x > 0.
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec log(Vec x) noexcept {
+    __m256i const bits = _mm256_castpd_si256(x);
+    // The exponent field as a double: placed in the mantissa of 2^52, which
+    // is then subtracted along with the bias, so e is exact.
+    __m256i const field = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000));
+    Vec e = sub(_mm256_castsi256_pd(field), set1(0x1p52 + 1022.0));
+    // Mantissa in [0.5, 1).
+    Vec m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFF)),
+      _mm256_set1_epi64x(0x3FE0000000000000)));
+    Mask const low = less(m, set1(std::numbers::sqrt2 / 2.0));
+    e = select(low, sub(e, set1(1.0)), e);
+    m = sub(select(low, add(m, m), m), set1(1.0));
+    Vec const z = mul(m, m);
+    Vec p = set1(kLogP[0]);
+    for (std::size_t c = 1; c < kLogP.size(); ++c) {
+      p = fma(p, m, set1(kLogP[c]));
+    }
+    Vec q = add(m, set1(kLogQ[0]));
+    for (std::size_t c = 1; c < kLogQ.size(); ++c) {
+      q = fma(q, m, set1(kLogQ[c]));
+    }
+    Vec y = fma(e, set1(kLogLow), mul(m, mul(z, div(p, q))));
+    y = fnma(set1(0.5), z, y);
+    return fma(e, set1(kLogHigh), add(m, y));
+  }
+};
+
+struct Avx512Ops {
+  using Vec = __m512d;
+  using Mask = __mmask8;
+  static constexpr std::size_t kWidth = 8;
+  static constexpr __mmask8 kAll = 0xFF;
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec load(double const *p) noexcept {
+    return _mm512_loadu_pd(p);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec zero() noexcept { return _mm512_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec set1(double v) noexcept { return _mm512_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec add(Vec a, Vec b) noexcept { return _mm512_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec sub(Vec a, Vec b) noexcept { return _mm512_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec mul(Vec a, Vec b) noexcept { return _mm512_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec div(Vec a, Vec b) noexcept { return _mm512_div_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+  // c - a * b
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec fnma(Vec a, Vec b, Vec c) noexcept {
+    return _mm512_fnmadd_pd(a, b, c);
+  }
+  // Masked sqrt, min, max and friends: the plain forms start from an
+  // undefined register, which GCC 12 reports as uninitialized.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec sqrt(Vec v) noexcept {
+    return _mm512_maskz_sqrt_pd(kAll, v);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec max(Vec a, Vec b) noexcept {
+    return _mm512_maskz_max_pd(kAll, a, b);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec min(Vec a, Vec b) noexcept {
+    return _mm512_maskz_min_pd(kAll, a, b);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec abs(Vec v) noexcept { return _mm512_abs_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Mask less(Vec a, Vec b) noexcept {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static bool any(Mask mask) noexcept { return mask != 0; }
+  // mask ? a : b
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec select(Mask mask, Vec a, Vec b) noexcept {
+    return _mm512_mask_blend_pd(mask, b, a);
+  }
+  // Stored rather than reduced in-register; GCC flags the undefined upper
+  // halves of _mm512_reduce_add_pd.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static double sum(Vec v) noexcept {
+    alignas(64) std::array<double, kWidth> lanes;
+    _mm512_store_pd(lanes.data(), v);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+  // e^x for x <= 0; the same reduction as the AVX2 form, with scalef for 2^n.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec exp(Vec x) noexcept {
+    x = max(x, set1(kExpFloor));
+    Vec const n = _mm512_maskz_roundscale_pd(
+      kAll, mul(x, set1(std::numbers::log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = fnma(n, set1(kLn2Low), fnma(n, set1(kLn2High), x));
+    Vec const xx = mul(x, x);
+    Vec p = set1(kExpP[0]);
+    for (std::size_t c = 1; c < kExpP.size(); ++c) {
+      p = fma(p, xx, set1(kExpP[c]));
+    }
+    p = mul(p, x);
+    Vec q = set1(kExpQ[0]);
+    for (std::size_t c = 1; c < kExpQ.size(); ++c) {
+      q = fma(q, xx, set1(kExpQ[c]));
+    }
+    Vec const m = fma(set1(2.0), div(p, sub(q, p)), set1(1.0));
+    return _mm512_maskz_scalef_pd(kAll, m, n);
+  }
+  // log(x) for normal x > 0; getexp / getmant split x = m 2^e, m in [0.5, 1).
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec log(Vec x) noexcept {
+    Vec e = add(_mm512_maskz_getexp_pd(kAll, x), set1(1.0));
+    Vec m = _mm512_maskz_getmant_pd(kAll, x, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero);
+    Mask const low = less(m, set1(std::numbers::sqrt2 / 2.0));
+    e = select(low, sub(e, set1(1.0)), e);
+    m = sub(select(low, add(m, m), m), set1(1.0));
+    Vec const z = mul(m, m);
+    Vec p = set1(kLogP[0]);
+    for (std::size_t c = 1; c < kLogP.size(); ++c) {
+      p = fma(p, m, set1(kLogP[c]));
+    }
+    Vec q = add(m, set1(kLogQ[0]));
+    for (std::size_t c = 1; c < kLogQ.size(); ++c) {
+      q = fma(q, m, set1(kLogQ[c]));
+    }
+    Vec y = fma(e, set1(kLogLow), mul(m, mul(z, div(p, q))));
+    y = fnma(set1(0.5), z, y);
+    return fma(e, set1(kLogHigh), add(m, y));
+  }
+};
+
+// The AVX2 and AVX-512 kernels share one body, written out per target because
+// a function's ISA cannot be a template parameter. They mirror descreen_pair
+// and pair_term lane for lane; partners are contiguous, so every load is a
+// plain unaligned load.
+RMS_TARGET("avx2,fma")
+double descreen_avx2(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  using Ops = Avx2Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const xi = Ops::set1(v.x[i]);
+  Vec const yi = Ops::set1(v.y[i]);
+  Vec const zi = Ops::set1(v.z[i]);
+  Vec const rho = Ops::set1(v.rho[i]);
+  Vec const inv_rho = Ops::set1(v.inv_rho[i]);
+  Vec const rgbmax = Ops::set1(v.rgbmax);
+  Vec const one = Ops::set1(1.0);
+  Vec sum = Ops::zero();
+  for (std::size_t j = begin; j < vector_end; j += Ops::kWidth) {
+    Vec const dx = Ops::sub(Ops::load(v.x + j), xi);
+    Vec const dy = Ops::sub(Ops::load(v.y + j), yi);
+    Vec const dz = Ops::sub(Ops::load(v.z + j), zi);
+    Vec const r = Ops::sqrt(Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx))));
+    Vec const s = Ops::load(v.scaled + j);
+    Vec const upper = Ops::min(Ops::add(r, s), rgbmax);
+    Vec const lower = Ops::max(rho, Ops::abs(Ops::sub(r, s)));
+    auto const active = Ops::less(lower, upper);
+    if (!Ops::any(active)) {
+      continue;
+    }
+    Vec const lu = Ops::mul(lower, upper);
+    Vec const inv_rlu = Ops::div(one, Ops::mul(r, lu));
+    Vec const inv_r = Ops::mul(lu, inv_rlu);
+    Vec const inv_l = Ops::mul(Ops::mul(r, upper), inv_rlu);
+    Vec const inv_u = Ops::mul(Ops::mul(r, lower), inv_rlu);
+    Vec const squares = Ops::fnma(inv_l, inv_l, Ops::mul(inv_u, inv_u));
+    Vec term = Ops::sub(inv_l, inv_u);
+    term = Ops::fma(Ops::mul(Ops::set1(0.25), Ops::fnma(Ops::mul(s, s), inv_r, r)), squares, term);
+    term = Ops::fma(Ops::mul(Ops::set1(0.5), inv_r), Ops::log(Ops::mul(lower, inv_u)), term);
+    Vec const buried = Ops::mul(Ops::set1(2.0), Ops::sub(inv_rho, inv_l));
+    term = Ops::add(term, Ops::select(Ops::less(rho, Ops::sub(s, r)), buried, Ops::zero()));
+    sum = Ops::add(sum, Ops::select(active, term, Ops::zero()));
+  }
+  return Ops::sum(sum) + descreen_scalar(v, i, vector_end, end);
+}
+
+template <bool Salt>
+RMS_TARGET("avx2,fma")
+double pairs_avx2(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  using Ops = Avx2Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const xi = Ops::set1(v.x[i]);
+  Vec const yi = Ops::set1(v.y[i]);
+  Vec const zi = Ops::set1(v.z[i]);
+  Vec const born_i = Ops::set1(v.born[i]);
+  Vec const neg_quarter_inv_born_i = Ops::set1(-0.25 * v.inv_born[i]);
+  Vec const cutoff2 = Ops::set1(v.cutoff2);
+  Vec const inv_solute = Ops::set1(v.inv_solute);
+  Vec const inv_solvent = Ops::set1(v.inv_solvent);
+  Vec const neg_kappa = Ops::set1(-v.kappa);
+  Vec sum = Ops::zero();
+  for (std::size_t j = begin; j < vector_end; j += Ops::kWidth) {
+    Vec const dx = Ops::sub(Ops::load(v.x + j), xi);
+    Vec const dy = Ops::sub(Ops::load(v.y + j), yi);
+    Vec const dz = Ops::sub(Ops::load(v.z + j), zi);
+    Vec const r2 = Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx)));
+    auto const inside = Ops::less(r2, cutoff2);
+    if (!Ops::any(inside)) {
+      continue;
+    }
+    Vec const rr = Ops::mul(born_i, Ops::load(v.born + j));
+    Vec const exponent = Ops::mul(Ops::mul(neg_quarter_inv_born_i, r2), Ops::load(v.inv_born + j));
+    Vec const f = Ops::sqrt(Ops::fma(rr, Ops::exp(exponent), r2));
+    Vec g = Ops::sub(inv_solute, inv_solvent);
+    if constexpr (Salt) {
+      g = Ops::fnma(Ops::exp(Ops::mul(neg_kappa, f)), inv_solvent, inv_solute);
+    }
+    Vec const term = Ops::div(Ops::mul(Ops::load(v.charge + j), g), f);
+    sum = Ops::add(sum, Ops::select(inside, term, Ops::zero()));
+  }
+  return Ops::sum(sum) + pairs_scalar<Salt>(v, i, vector_end, end);
+}
+
+RMS_TARGET("avx512f")
+double descreen_avx512(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  using Ops = Avx512Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const xi = Ops::set1(v.x[i]);
+  Vec const yi = Ops::set1(v.y[i]);
+  Vec const zi = Ops::set1(v.z[i]);
+  Vec const rho = Ops::set1(v.rho[i]);
+  Vec const inv_rho = Ops::set1(v.inv_rho[i]);
+  Vec const rgbmax = Ops::set1(v.rgbmax);
+  Vec const one = Ops::set1(1.0);
+  Vec sum = Ops::zero();
+  for (std::size_t j = begin; j < vector_end; j += Ops::kWidth) {
+    Vec const dx = Ops::sub(Ops::load(v.x + j), xi);
+    Vec const dy = Ops::sub(Ops::load(v.y + j), yi);
+    Vec const dz = Ops::sub(Ops::load(v.z + j), zi);
+    Vec const r = Ops::sqrt(Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx))));
+    Vec const s = Ops::load(v.scaled + j);
+    Vec const upper = Ops::min(Ops::add(r, s), rgbmax);
+    Vec const lower = Ops::max(rho, Ops::abs(Ops::sub(r, s)));
+    auto const active = Ops::less(lower, upper);
+    if (!Ops::any(active)) {
+      continue;
+    }
+    Vec const lu = Ops::mul(lower, upper);
+    Vec const inv_rlu = Ops::div(one, Ops::mul(r, lu));
+    Vec const inv_r = Ops::mul(lu, inv_rlu);
+    Vec const inv_l = Ops::mul(Ops::mul(r, upper), inv_rlu);
+    Vec const inv_u = Ops::mul(Ops::mul(r, lower), inv_rlu);
+    Vec const squares = Ops::fnma(inv_l, inv_l, Ops::mul(inv_u, inv_u));
+    Vec term = Ops::sub(inv_l, inv_u);
+    term = Ops::fma(Ops::mul(Ops::set1(0.25), Ops::fnma(Ops::mul(s, s), inv_r, r)), squares, term);
+    term = Ops::fma(Ops::mul(Ops::set1(0.5), inv_r), Ops::log(Ops::mul(lower, inv_u)), term);
+    Vec const buried = Ops::mul(Ops::set1(2.0), Ops::sub(inv_rho, inv_l));
+    term = Ops::add(term, Ops::select(Ops::less(rho, Ops::sub(s, r)), buried, Ops::zero()));
+    sum = Ops::add(sum, Ops::select(active, term, Ops::zero()));
+  }
+  return Ops::sum(sum) + descreen_scalar(v, i, vector_end, end);
+}
+
+template <bool Salt>
+RMS_TARGET("avx512f")
+double pairs_avx512(const GbView &v, std::size_t i, std::size_t begin, std::size_t end) noexcept {
+  using Ops = Avx512Ops;
+  using Vec = Ops::Vec;
+  auto const vector_end = begin + (end - begin) / Ops::kWidth * Ops::kWidth;
+  Vec const xi = Ops::set1(v.x[i]);
+  Vec const yi = Ops::set1(v.y[i]);
+  Vec const zi = Ops::set1(v.z[i]);
+  Vec const born_i = Ops::set1(v.born[i]);
+  Vec const neg_quarter_inv_born_i = Ops::set1(-0.25 * v.inv_born[i]);
+  Vec const cutoff2 = Ops::set1(v.cutoff2);
+  Vec const inv_solute = Ops::set1(v.inv_solute);
+  Vec const inv_solvent = Ops::set1(v.inv_solvent);
+  Vec const neg_kappa = Ops::set1(-v.kappa);
+  Vec sum = Ops::zero();
+  for (std::size_t j = begin; j < vector_end; j += Ops::kWidth) {
+    Vec const dx = Ops::sub(Ops::load(v.x + j), xi);
+    Vec const dy = Ops::sub(Ops::load(v.y + j), yi);
+    Vec const dz = Ops::sub(Ops::load(v.z + j), zi);
+    Vec const r2 = Ops::fma(dz, dz, Ops::fma(dy, dy, Ops::mul(dx, dx)));
+    auto const inside = Ops::less(r2, cutoff2);
+    if (!Ops::any(inside)) {
+      continue;
+    }
+    Vec const rr = Ops::mul(born_i, Ops::load(v.born + j));
+    Vec const exponent = Ops::mul(Ops::mul(neg_quarter_inv_born_i, r2), Ops::load(v.inv_born + j));
+    Vec const f = Ops::sqrt(Ops::fma(rr, Ops::exp(exponent), r2));
+    Vec g = Ops::sub(inv_solute, inv_solvent);
+    if constexpr (Salt) {
+      g = Ops::fnma(Ops::exp(Ops::mul(neg_kappa, f)), inv_solvent, inv_solute);
+    }
+    Vec const term = Ops::div(Ops::mul(Ops::load(v.charge + j), g), f);
+    sum = Ops::add(sum, Ops::select(inside, term, Ops::zero()));
+  }
+  return Ops::sum(sum) + pairs_scalar<Salt>(v, i, vector_end, end);
+}
+#endif
+
+[[nodiscard]] DescreenFn select_descreen(SimdLevel level) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return &descreen_avx512;
+  }
+  if (level >= SimdLevel::Avx2) {
+    return &descreen_avx2;
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return &descreen_scalar;
+}
+
+[[nodiscard]] PairsFn select_pairs(SimdLevel level, bool salt) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return salt ? &pairs_avx512<true> : &pairs_avx512<false>;
+  }
+  if (level >= SimdLevel::Avx2) {
+    return salt ? &pairs_avx2<true> : &pairs_avx2<false>;
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return salt ? &pairs_scalar<true> : &pairs_scalar<false>;
+}
+
+void require_size(std::string_view name, std::size_t size, std::size_t expected) {
+  if (size != expected) {
+    throw std::runtime_error(
+      fmt::format("GeneralizedBornEngine needs {} with {} entries, got {}", name, expected, size));
+  }
+}
+
+} // namespace
+
+GeneralizedBornEngine::GeneralizedBornEngine(const Parm7Topology &topo, const GeneralizedBornOptions &options)
+    : GeneralizedBornEngine(topo, AtomSelection::all(static_cast<std::size_t>(topo.pointers.natom)), options) {}
+
+GeneralizedBornEngine::GeneralizedBornEngine(const Parm7Topology &topo, const AtomSelection &selection,
+  const GeneralizedBornOptions &options)
+    : options_(options), natom_(static_cast<std::size_t>(topo.pointers.natom)) {
+  options_.level = std::min(options_.level, detected_simd_level());
+  if (!(options_.solute_dielectric > 0.0) || !(options_.solvent_dielectric > 0.0)) {
+    throw std::invalid_argument(fmt::format("GB dielectrics {} and {} must be positive", options_.solute_dielectric,
+      options_.solvent_dielectric));
+  }
+  if (!(options_.cutoff > 0.0) || !(options_.rgbmax > 0.0)) {
+    throw std::invalid_argument(
+      fmt::format("GB cutoff {} and rgbmax {} must be positive", options_.cutoff, options_.rgbmax));
+  }
+  if (!(options_.offset >= 0.0) || !(options_.salt_concentration >= 0.0) || !std::isfinite(options_.offset)
+      || !std::isfinite(options_.salt_concentration)) {
+    throw std::invalid_argument(fmt::format("GB offset {} and salt concentration {} must be non-negative",
+      options_.offset, options_.salt_concentration));
+  }
+  kappa_ = std::sqrt(kKappaSquaredPerMolar * options_.salt_concentration);
+
+  if (selection.natom() != natom_) {
+    throw std::invalid_argument(
+      fmt::format("GB selection is for {} atoms, but the topology has {}", selection.natom(), natom_));
+  }
+  require_size("CHARGE", topo.charge.size(), natom_);
+  require_size("RADII", topo.radii.size(), natom_);
+  require_size("SCREEN", topo.screen.size(), natom_);
+  if (selection.size() != natom_) {
+    atoms_.assign(selection.indices().begin(), selection.indices().end());
+  }
+  std::size_t const count = selection.size();
+  charge_.resize(count);
+  rho_.resize(count);
+  inv_rho_.resize(count);
+  inv_radius_.resize(count);
+  scaled_.resize(count);
+  for (std::size_t idx = 0; idx < count; ++idx) {
+    auto const atom = static_cast<std::size_t>(selection.indices()[idx]);
+    double const radius = topo.radii[atom];
+    if (!(radius > options_.offset) || !std::isfinite(radius)) {
+      throw std::runtime_error(
+        fmt::format("RADII entry {} is {}, not above the GB offset {}", atom, radius, options_.offset));
+    }
+    charge_[idx] = topo.charge[atom];
+    rho_[idx] = radius - options_.offset;
+    inv_rho_[idx] = 1.0 / rho_[idx];
+    inv_radius_[idx] = 1.0 / radius;
+    scaled_[idx] = topo.screen[atom] * rho_[idx];
+  }
+}
+
+double GeneralizedBornEngine::evaluate(const Coordinates &positions) {
+  if (positions.size() != natom_ || positions.y.size() != natom_ || positions.z.size() != natom_) {
+    throw std::invalid_argument(
+      fmt::format("GeneralizedBornEngine expects {} atoms, got {}", natom_, positions.size()));
+  }
+  Coordinates const *scored = &positions;
+  if (charge_.size() != natom_) {
+    gather(positions, atoms_, selected_);
+    scored = &selected_;
+  }
+  std::size_t const natom = charge_.size();
+  born_.resize(natom);
+  inv_born_.resize(natom);
+  GbView const view{.x = scored->x.data(),
+    .y = scored->y.data(),
+    .z = scored->z.data(),
+    .rho = rho_.data(),
+    .inv_rho = inv_rho_.data(),
+    .scaled = scaled_.data(),
+    .charge = charge_.data(),
+    .born = born_.data(),
+    .inv_born = inv_born_.data(),
+    .rgbmax = options_.rgbmax,
+    .cutoff2 = options_.cutoff * options_.cutoff,
+    .kappa = kappa_,
+    .inv_solute = 1.0 / options_.solute_dielectric,
+    .inv_solvent = 1.0 / options_.solvent_dielectric};
+  std::size_t const tasks = (natom + kAtomsPerTask - 1) / kAtomsPerTask;
+
+  // Born radii: every atom sweeps all others, so tasks cost the same.
+  DescreenFn const descreen = select_descreen(options_.level);
+  // OBC's alpha, beta and gamma.
+  std::array<double, 3> const obc = [&]() -> std::array<double, 3> {
+    switch (options_.model) {
+      case GbModel::ObcI:
+        return {0.8, 0.0, 2.909125};
+      case GbModel::ObcII:
+        return {1.0, 0.8, 4.85};
+      default:
+        return {0.0, 0.0, 0.0};
+    }
+  }();
+  parallel_for(tasks, options_.threads, [&](std::size_t task) {
+    std::size_t const end = std::min(natom, (task + 1) * kAtomsPerTask);
+    for (std::size_t i = task * kAtomsPerTask; i < end; ++i) {
+      double const integral = 0.5 * (descreen(view, i, 0, i) + descreen(view, i, i + 1, natom));
+      if (options_.model == GbModel::Hct) {
+        double const inverse = inv_rho_[i] - integral;
+        born_[i] = inverse > 0.0 ? 1.0 / inverse : kFallbackBornRadius;
+      } else {
+        double const psi = integral * rho_[i];
+        born_[i] = 1.0 / (inv_rho_[i] - std::tanh(psi * (obc[0] - psi * (obc[1] - obc[2] * psi))) * inv_radius_[i]);
+      }
+      inv_born_[i] = 1.0 / born_[i];
+    }
+  });
+
+  // Pair energies over j > i, so early tasks cost the most and go first; the
+  // self term rides along with each atom.
+  PairsFn const pairs = select_pairs(options_.level, kappa_ > 0.0);
+  std::vector<double> partial(tasks, 0.0);
+  parallel_for(tasks, options_.threads, [&](std::size_t task) {
+    std::size_t const end = std::min(natom, (task + 1) * kAtomsPerTask);
+    double sum = 0.0;
+    for (std::size_t i = task * kAtomsPerTask; i < end; ++i) {
+      double const self = view.inv_solute - std::exp(-kappa_ * born_[i]) * view.inv_solvent;
+      sum += charge_[i] * (pairs(view, i, i + 1, natom) + 0.5 * charge_[i] * self / born_[i]);
+    }
+    partial[task] = sum;
+  });
+  double energy = 0.0;
+  for (double const part : partial) {
+    energy -= part;
+  }
+  return energy;
+}
+
+} // namespace rms
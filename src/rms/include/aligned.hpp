@@ -0,0 +1,49 @@
+#ifndef RMS_ALIGNED_HPP
+#define RMS_ALIGNED_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace rms {
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// Allocator that places every block on an `Alignment` boundary, so SIMD kernels
+// can use aligned loads and hot arrays never straddle a cache line at index 0.
+template <typename T, std::size_t Alignment = kCacheLineSize>
+struct AlignedAllocator {
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0);
+
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  constexpr AlignedAllocator() noexcept = default;
+  template <typename U>
+  constexpr AlignedAllocator(const AlignedAllocator<U, Alignment> & /*other*/) noexcept {} // NOLINT(*-explicit-*)
+
+  [[nodiscard]] T *allocate(std::size_t count) {
+    if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+  }
+
+  void deallocate(T *ptr, std::size_t count) noexcept {
+    ::operator delete(ptr, count * sizeof(T), std::align_val_t{Alignment});
+  }
+
+  friend constexpr bool operator==(const AlignedAllocator &, const AlignedAllocator &) noexcept { return true; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+} // namespace rms
+
+#endif // RMS_ALIGNED_HPP
@@ -0,0 +1,70 @@
+#ifndef RMS_BOND_GRAPH_HPP
+#define RMS_BOND_GRAPH_HPP
+
+#include "parsers.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Undirected bond graph in compressed sparse rows: the neighbours of `atom` are
+// adjacency[offsets[atom], offsets[atom + 1]), ascending. Every bond appears in
+// both of its atoms' rows.
+class BondGraph
+{
+public:
+  BondGraph() = default;
+  // Built on up to `threads` workers (0 = all hardware threads). Throws
+  // std::runtime_error if the bonds are not loaded or name a missing atom.
+  explicit BondGraph(const Parm7Topology &topo, std::size_t threads = 0);
+
+  [[nodiscard]] std::size_t atom_count() const noexcept { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+  [[nodiscard]] std::size_t bond_count() const noexcept { return adjacency_.size() / 2; }
+
+  [[nodiscard]] std::span<const std::size_t> offsets() const noexcept { return offsets_; }
+  [[nodiscard]] std::span<const int> adjacency() const noexcept { return adjacency_; }
+
+  // Unchecked.
+  [[nodiscard]] std::span<const int> neighbors(int atom) const noexcept {
+    auto const row = static_cast<std::size_t>(atom);
+    return std::span<const int>(adjacency_).subspan(offsets_[row], offsets_[row + 1] - offsets_[row]);
+  }
+
+private:
+  std::vector<std::size_t> offsets_;
+  std::vector<int> adjacency_;
+};
+
+// Connected components of the bond graph, numbered by their lowest atom, so in
+// a standard topology molecule m is the m-th contiguous block of atoms.
+struct Molecules {
+  // Molecule of each atom.
+  std::vector<int> molecule_of;
+  // Atoms of molecule m are atoms[offsets[m], offsets[m + 1]), ascending.
+  std::vector<std::size_t> offsets;
+  std::vector<int> atoms;
+
+  [[nodiscard]] std::size_t size() const noexcept { return offsets.empty() ? 0 : offsets.size() - 1; }
+  [[nodiscard]] std::span<const int> atoms_of(std::size_t molecule) const noexcept {
+    return std::span<const int>(atoms).subspan(offsets[molecule], offsets[molecule + 1] - offsets[molecule]);
+  }
+};
+
+// Lock-free parallel union-find over the graph's bonds.
+[[nodiscard]] Molecules find_molecules(const BondGraph &graph, std::size_t threads = 0);
+
+// Compares `molecules` with SOLVENT_POINTERS (NSPM, the molecule count) and
+// ATOMS_PER_MOLECULE (contiguous molecule sizes) when the topology has them,
+// and throws std::runtime_error on the first disagreement.
+void check_molecules(const Parm7Topology &topo, const Molecules &molecules);
+
+// Index of the first solvent molecule (NSPSOL - 1); molecules from there on are
+// solvent. Without SOLVENT_POINTERS every molecule is solute and this is
+// molecules.size().
+[[nodiscard]] std::size_t first_solvent_molecule(const Parm7Topology &topo, const Molecules &molecules);
+
+} // namespace rms
+
+#endif // RMS_BOND_GRAPH_HPP
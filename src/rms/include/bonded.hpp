@@ -0,0 +1,117 @@
+#ifndef RMS_BONDED_HPP
+#define RMS_BONDED_HPP
+
+#include "aligned.hpp"
+#include "coordinates.hpp"
+#include "parsers.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Bonded energy terms in kcal/mol; `dihedral` excludes the impropers, which
+// sander reports inside DIHED.
+struct BondedEnergy {
+  double bond = 0.0;
+  double angle = 0.0;
+  double dihedral = 0.0;
+  double improper = 0.0;
+
+  [[nodiscard]] double total() const noexcept { return bond + angle + dihedral + improper; }
+};
+
+struct BondedOptions {
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Kernel tier, capped at detected_simd_level().
+  SimdLevel level = detected_simd_level();
+};
+
+// Amber bond, angle and dihedral energies and forces:
+//   k (r - r0)^2,  k (theta - theta0)^2,  k (1 + cos(n phi - gamma)).
+// The constructor copies each term's atoms and parameters out of the
+// topology's parallel arrays into per-term aligned arrays (no type lookups in
+// the kernels), turns the improper flag into a 0 / 1 weight and the phase
+// into its cosine and sine, and evaluates cos(n phi) by recurrence, so the
+// kernels have no per-term branches. The suppress-1-4 flag does not change a
+// torsion's own energy and is ignored here.
+//
+// Terms of each kind are grouped into batches whose terms share no atom
+// (greedy colouring in topology order), so within a batch every term, SIMD
+// lane and thread adds its forces straight into the output without atomics.
+// Batches run one after another, each atom gets at most one contribution per
+// batch, and partial energies are summed per fixed chunk, so results do not
+// depend on the thread count. Positions are used as given: molecules must be
+// whole.
+class BondedEngine
+{
+public:
+  // Throws std::runtime_error if a bond, angle or dihedral section (terms or
+  // parameters) is not loaded, or a term names an atom or type out of range or
+  // a periodicity that is not an integer in [0, 12].
+  explicit BondedEngine(const Parm7Topology &topo, const BondedOptions &options = {});
+
+  [[nodiscard]] const BondedOptions &options() const noexcept { return options_; }
+  [[nodiscard]] std::size_t atom_count() const noexcept { return natom_; }
+  [[nodiscard]] std::size_t bond_count() const noexcept { return bonds_.force.size(); }
+  [[nodiscard]] std::size_t angle_count() const noexcept { return angles_.force.size(); }
+  [[nodiscard]] std::size_t dihedral_count() const noexcept { return dihedrals_.force.size(); }
+  // Batch b holds the stored terms [batches[b], batches[b + 1]); the atoms of
+  // stored term t are atoms[arity * t, arity * t + arity).
+  [[nodiscard]] std::span<const std::size_t> bond_batches() const noexcept { return bonds_.batches; }
+  [[nodiscard]] std::span<const std::size_t> angle_batches() const noexcept { return angles_.batches; }
+  [[nodiscard]] std::span<const std::size_t> dihedral_batches() const noexcept { return dihedrals_.batches; }
+  [[nodiscard]] std::vector<int> bond_atoms() const;
+  [[nodiscard]] std::vector<int> angle_atoms() const;
+  [[nodiscard]] std::vector<int> dihedral_atoms() const;
+
+  // Energies at `positions`. When `forces` is set it is resized and receives
+  // -dE/dr per atom (kcal/mol/angstrom). Throws std::invalid_argument for a
+  // wrong atom count.
+  BondedEnergy evaluate(const Coordinates &positions, Coordinates *forces = nullptr) const;
+
+private:
+  struct BondTerms {
+    AlignedVector<int> i;
+    AlignedVector<int> j;
+    AlignedVector<double> force;
+    AlignedVector<double> equil;
+    std::vector<std::size_t> batches;
+  };
+  struct AngleTerms {
+    AlignedVector<int> i;
+    AlignedVector<int> j;
+    AlignedVector<int> k;
+    AlignedVector<double> force;
+    AlignedVector<double> equil;
+    std::vector<std::size_t> batches;
+  };
+  struct DihedralTerms {
+    AlignedVector<int> i;
+    AlignedVector<int> j;
+    AlignedVector<int> k;
+    AlignedVector<int> l;
+    AlignedVector<double> force;
+    AlignedVector<double> period;
+    AlignedVector<double> cos_phase;
+    AlignedVector<double> sin_phase;
+    // 1 for impropers, 0 for proper torsions.
+    AlignedVector<double> improper;
+    std::vector<std::size_t> batches;
+  };
+
+  BondedOptions options_;
+  std::size_t natom_ = 0;
+  BondTerms bonds_;
+  AngleTerms angles_;
+  DihedralTerms dihedrals_;
+  // Highest periodicity, i.e. recurrence steps per dihedral.
+  int max_period_ = 0;
+};
+
+} // namespace rms
+
+#endif // RMS_BONDED_HPP
@@ -4,12 +4,44 @@
 #include <cstddef>
 #include <filesystem>
 #include <optional>
+#include <string>
 
 namespace rms {
 
+// `rms rmsd <parm7> <reference> <trajectory>`: per-frame RMSD of an mdcrd
+// trajectory against an rst7 reference.
+struct RmsdCliOptions {
+  std::filesystem::path reference_path;
+  std::filesystem::path trajectory_path;
+  // Empty writes the table to stdout.
+  std::filesystem::path output_path;
+  // Non-empty also writes the superposed trajectory there.
+  std::filesystem::path fitted_path;
+  // Amber mask of the atoms to fit; empty fits every atom.
+  std::string mask;
+  bool mass_weighted = false;
+};
+
+// `rms pairwise <parm7> <trajectory> -o <matrix>`: all-vs-all frame RMSD,
+// written as a memory-mapped float32 matrix.
+struct PairwiseCliOptions {
+  std::filesystem::path trajectory_path;
+  std::filesystem::path matrix_path;
+  // Frames per tile side (0 = sized to the cache).
+  std::size_t block_frames = 0;
+  // Amber mask of the atoms compared; empty compares every atom.
+  std::string mask;
+  bool mass_weighted = false;
+};
+
 struct CliOptions {
   std::filesystem::path parm7_path;
   std::size_t sample_count = 5;
+  std::size_t threads = 0;
+  bool use_cache = true;
+  // Set when a subcommand was given instead of the summary.
+  std::optional<RmsdCliOptions> rmsd;
+  std::optional<PairwiseCliOptions> pairwise;
 };
 
 std::optional<CliOptions> parse_cli(int argc, char const *const argv[]);
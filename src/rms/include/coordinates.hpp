@@ -0,0 +1,93 @@
+#ifndef RMS_COORDINATES_HPP
+#define RMS_COORDINATES_HPP
+
+#include "aligned.hpp"
+#include "parsers.hpp"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace rms {
+
+// Per-atom x / y / z values stored as three 64-byte aligned arrays, so kernels
+// stream one component at a time with aligned vector loads.
+template <typename T>
+struct BasicCoordinates {
+  AlignedVector<T> x;
+  AlignedVector<T> y;
+  AlignedVector<T> z;
+
+  BasicCoordinates() = default;
+  explicit BasicCoordinates(std::size_t natom) : x(natom), y(natom), z(natom) {}
+
+  [[nodiscard]] std::size_t size() const noexcept { return x.size(); }
+  [[nodiscard]] bool empty() const noexcept { return x.empty(); }
+
+  void resize(std::size_t natom) {
+    x.resize(natom);
+    y.resize(natom);
+    z.resize(natom);
+  }
+
+  friend bool operator==(const BasicCoordinates &, const BasicCoordinates &) = default;
+};
+
+// Files decode to double; single precision halves the bandwidth of analysis kernels.
+using Coordinates = BasicCoordinates<double>;
+using CoordinatesF = BasicCoordinates<float>;
+
+// Single-precision copy of `coords`.
+[[nodiscard]] inline CoordinatesF to_float(const Coordinates &coords) {
+  CoordinatesF out(coords.size());
+  for (std::size_t atom = 0; atom < coords.size(); ++atom) {
+    out.x[atom] = static_cast<float>(coords.x[atom]);
+    out.y[atom] = static_cast<float>(coords.y[atom]);
+    out.z[atom] = static_cast<float>(coords.z[atom]);
+  }
+  return out;
+}
+
+// An Amber restart (rst7 / inpcrd, ASCII): the title, NATOM and optional time
+// line, 6F12.7 positions, then optional velocities and an optional box line.
+struct Rst7 {
+  std::string title;
+  std::optional<double> time;
+  Coordinates positions;
+  std::optional<Coordinates> velocities;
+  // a, b, c, alpha, beta, gamma; a three-value box line gets 90 degree angles.
+  std::optional<std::array<double, 6>> box;
+
+  [[nodiscard]] std::size_t natom() const noexcept { return positions.size(); }
+
+  friend bool operator==(const Rst7 &, const Rst7 &) = default;
+};
+
+struct Rst7ParseOptions {
+  // Worker threads used to decode the coordinate lines (0 = all hardware threads).
+  std::size_t threads = 0;
+};
+
+// Memory-maps the file and decodes it in place.
+[[nodiscard]] Rst7 parse_rst7_file(const std::filesystem::path &path, const Rst7ParseOptions &options = {});
+
+// Same as above, and throws unless the restart has one entry per topology atom.
+[[nodiscard]] Rst7 parse_rst7_file(const std::filesystem::path &path, const Parm7Topology &topo,
+  const Rst7ParseOptions &options = {});
+
+// Decodes an rst7 image that is already in memory.
+[[nodiscard]] Rst7 parse_rst7_buffer(std::span<const char> buffer, const Rst7ParseOptions &options = {});
+
+// Writes `rst7` as Amber does: 6F12.7 blocks after an I5 (I6 past 99999 atoms)
+// atom count and the E15.7 time, if set.
+[[nodiscard]] std::string format_rst7(const Rst7 &rst7);
+
+// Throws std::runtime_error unless `rst7` holds NATOM atoms of `topo`.
+void check_rst7(const Parm7Topology &topo, const Rst7 &rst7);
+
+} // namespace rms
+
+#endif // RMS_COORDINATES_HPP
@@ -0,0 +1,68 @@
+#ifndef RMS_EXCLUSIONS_HPP
+#define RMS_EXCLUSIONS_HPP
+
+#include "parsers.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Excluded atom pairs in compressed sparse rows, built from NUMBER_EXCLUDED_ATOMS
+// and EXCLUDED_ATOMS_LIST. Each pair is stored once, under its lower atom: the
+// partners of `atom` are the higher-indexed atoms in
+// partners[offsets[atom], offsets[atom + 1]), ascending, without the
+// placeholder entries parm7 writes for atoms that exclude nothing. Partners
+// within kExclusionWindow of an atom are also kept as a bitmask, so the common
+// short-range check is a single bit test; farther ones use binary search.
+class ExclusionList
+{
+public:
+  static constexpr std::size_t kExclusionWindow = 64;
+
+  ExclusionList() = default;
+  // Rows are cleaned and sorted on up to `threads` workers (0 = all hardware
+  // threads). Throws std::runtime_error if the sections are missing, their
+  // sizes disagree, or an entry is not an atom index.
+  explicit ExclusionList(const Parm7Topology &topo, std::size_t threads = 0);
+
+  [[nodiscard]] std::size_t atom_count() const noexcept { return window_.size(); }
+  [[nodiscard]] std::size_t pair_count() const noexcept { return partners_.size(); }
+
+  [[nodiscard]] std::span<const std::size_t> offsets() const noexcept { return offsets_; }
+  [[nodiscard]] std::span<const int> partners() const noexcept { return partners_; }
+
+  // Higher-indexed partners of `atom`, ascending. Unchecked.
+  [[nodiscard]] std::span<const int> partners(int atom) const noexcept {
+    auto const row = static_cast<std::size_t>(atom);
+    return std::span<const int>(partners_).subspan(offsets_[row], offsets_[row + 1] - offsets_[row]);
+  }
+
+  // Whether the pair is excluded, in either order. Unchecked.
+  [[nodiscard]] bool excluded(int atom_i, int atom_j) const noexcept {
+    int const low = std::min(atom_i, atom_j);
+    int const high = std::max(atom_i, atom_j);
+    auto const gap = static_cast<std::size_t>(high - low);
+    if (gap == 0) {
+      return false;
+    }
+    if (gap <= kExclusionWindow) {
+      return ((window_[static_cast<std::size_t>(low)] >> (gap - 1)) & 1U) != 0;
+    }
+    auto const row = partners(low);
+    return std::binary_search(row.begin(), row.end(), high);
+  }
+
+private:
+  std::vector<std::size_t> offsets_;
+  std::vector<int> partners_;
+  // Bit k of window_[atom]: atom + 1 + k is a partner.
+  std::vector<std::uint64_t> window_;
+};
+
+} // namespace rms
+
+#endif // RMS_EXCLUSIONS_HPP
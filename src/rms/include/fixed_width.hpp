@@ -0,0 +1,52 @@
+#ifndef RMS_FIXED_WIDTH_HPP
+#define RMS_FIXED_WIDTH_HPP
+
+#include "simd.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace rms {
+
+// Field width of the integer sections, which are all written as %FORMAT(10I8).
+constexpr std::size_t kI8FieldWidth = 8;
+
+// Decodes consecutive right-justified I8 fields from the start of `text` into
+// `out`, up to min(text.size() / 8, out.size()) fields, and returns how many
+// leading fields were decoded. Decoding stops at the first field that is not
+// `[ ]*-?[0-9]+` (blank, '+', embedded spaces, ...) so the caller can resume
+// with the general parser from there. Uses the widest SIMD tier available.
+[[nodiscard]] std::size_t decode_i8_fields(std::string_view text, std::span<int> out) noexcept;
+
+// Same as above, pinned to `level` (clamped to what the CPU supports). Intended
+// for tests and benchmarks.
+[[nodiscard]] std::size_t decode_i8_fields(std::string_view text, std::span<int> out, SimdLevel level) noexcept;
+
+// Parses one Fortran real field (E/D/F/G output) without allocating. Accepts
+// 'D' exponents and the exponent-letter-less form Fortran writes for three
+// digit exponents ("1.5-100"). Results are correctly rounded: common E16.8
+// values take an exact fast path, everything else goes through std::from_chars.
+// Like strtod, a valid leading number followed by trailing junk is accepted.
+[[nodiscard]] std::optional<double> parse_fortran_double(std::string_view field) noexcept;
+
+// Decodes consecutive `width`-wide real fields (e.g. one 5E16.8 line) into
+// `out`, up to min(text.size() / width, out.size()) fields, and returns how
+// many leading fields were decoded. Stops at the first blank or malformed
+// field so the caller can resume with the general parser from there.
+[[nodiscard]] std::size_t decode_real_fields(std::string_view text, std::size_t width, std::span<double> out) noexcept;
+
+// Same contract as decode_real_fields for Fortran F fields with `decimals`
+// digits after the point (e.g. 6F12.7 restart lines), on a fixed-layout fast
+// path: the point must sit in its column, with blanks, an optional '-' and at
+// least one digit before it, and up to eight fraction digits are converted in
+// one go. Fields outside that layout (exponents, '*' overflow, blanks) stop the
+// decode so the caller can resume with decode_real_fields. Results are
+// correctly rounded, so both paths agree bit for bit.
+[[nodiscard]] std::size_t decode_fixed_fields(std::string_view text, std::size_t width, std::size_t decimals,
+  std::span<double> out) noexcept;
+
+} // namespace rms
+
+#endif // RMS_FIXED_WIDTH_HPP
@@ -1,14 +1,19 @@
 #ifndef RMS_FORCEFIELD_HPP
 #define RMS_FORCEFIELD_HPP
 
+#include "aligned.hpp"
 #include "parsers.hpp"
 
+#include <cstddef>
 #include <optional>
+#include <span>
 #include <utility>
 #include <vector>
 
 namespace rms {
 
+// Materializes one entry per atom (-1 outside every residue). ResidueIndex
+// answers the same query from the residue table without the allocation.
 [[nodiscard]] std::vector<int> build_atom_residue_map(const Parm7Topology &topo);
 
 [[nodiscard]] std::optional<std::size_t> lj_pair_index(const Parm7Topology &topo, int type_i, int type_j);
@@ -16,6 +21,50 @@ namespace rms {
 [[nodiscard]] std::optional<std::pair<double, double>> lj_pair_coeffs(const Parm7Topology &topo, int type_i,
   int type_j);
 
+struct LJPair {
+  double a = 0.0;
+  double b = 0.0;
+};
+
+// Lennard-Jones coefficients for every ordered pair of atom types, resolved
+// once from NONBONDED_PARM_INDEX into a flat ntypes x ntypes table. A and B sit
+// next to each other, so a lookup is one 16-byte load, and a SIMD kernel can
+// gather both with index 2 * (type_i * ntypes + type_j). Pairs without a 12-6
+// term (negative index, i.e. 10-12 hydrogen bonds) hold zeros. Accessors are
+// unchecked; types must be in [0, ntypes).
+class LJTable
+{
+public:
+  LJTable() = default;
+  // Throws std::runtime_error if the LJ sections are not loaded or inconsistent.
+  explicit LJTable(const Parm7Topology &topo);
+
+  [[nodiscard]] std::size_t ntypes() const noexcept { return ntypes_; }
+
+  [[nodiscard]] std::size_t index(int type_i, int type_j) const noexcept {
+    return static_cast<std::size_t>(type_i) * ntypes_ + static_cast<std::size_t>(type_j);
+  }
+  [[nodiscard]] LJPair pair(int type_i, int type_j) const noexcept {
+    auto const idx = 2 * index(type_i, type_j);
+    return {coefficients_[idx], coefficients_[idx + 1]};
+  }
+  // sigma = (A / B)^(1/6) and epsilon = B^2 / (4 A), zero where A or B is.
+  [[nodiscard]] double sigma(int type_i, int type_j) const noexcept {
+    return sigma_epsilon_[2 * index(type_i, type_j)];
+  }
+  [[nodiscard]] double epsilon(int type_i, int type_j) const noexcept {
+    return sigma_epsilon_[2 * index(type_i, type_j) + 1];
+  }
+
+  // Interleaved {A, B} for all pairs, row-major by type_i; 64-byte aligned.
+  [[nodiscard]] std::span<const double> coefficients() const noexcept { return coefficients_; }
+
+private:
+  std::size_t ntypes_ = 0;
+  AlignedVector<double> coefficients_;
+  AlignedVector<double> sigma_epsilon_;
+};
+
 } // namespace rms
 
 #endif // RMS_FORCEFIELD_HPP
@@ -0,0 +1,115 @@
+#ifndef RMS_GENERALIZED_BORN_HPP
+#define RMS_GENERALIZED_BORN_HPP
+
+#include "aligned.hpp"
+#include "coordinates.hpp"
+#include "mask.hpp"
+#include "parsers.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Effective Born radius models, by sander's igb number.
+enum class GbModel {
+  // Hawkins-Cramer-Truhlar (igb = 1).
+  Hct,
+  // Onufriev-Bashford-Case with alpha, beta, gamma = 0.8, 0, 2.909125 (igb = 2).
+  ObcI,
+  // Onufriev-Bashford-Case with alpha, beta, gamma = 1.0, 0.8, 4.85 (igb = 5).
+  ObcII
+};
+
+struct GeneralizedBornOptions {
+  GbModel model = GbModel::ObcII;
+  double solute_dielectric = 1.0;
+  double solvent_dielectric = 78.5;
+  // Monovalent salt (mol/L) for Debye-Huckel screening; 0 = none.
+  double salt_concentration = 0.0;
+  // Pairs at or beyond this distance (angstrom) add no GB energy.
+  double cutoff = std::numeric_limits<double>::infinity();
+  // Descreening only counts the part of each neighbour's sphere within
+  // this distance of the atom (sander's rgbmax).
+  double rgbmax = 25.0;
+  // Subtracted from RADII before descreening (sander's offset).
+  double offset = 0.09;
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Kernel tier, capped at detected_simd_level().
+  SimdLevel level = detected_simd_level();
+};
+
+// Generalized Born polar solvation energy (sander's EGB) from the topology's
+// RADII, SCREEN and CHARGE:
+//   E = -sum_{i<j} qi qj g(f) / f - 1/2 sum_i qi^2 g(Ri) / Ri,
+//   f = sqrt(r^2 + Ri Rj exp(-r^2 / (4 Ri Rj))),
+//   g(f) = 1 / eps_in - exp(-kappa f) / eps_out.
+// Born radii come from the pairwise descreening integral over each
+// neighbour's sphere of radius SCREEN * (RADII - offset), evaluated in closed
+// form between max(rho_i, |r - s_j|) and min(r + s_j, rgbmax) rather than
+// through sander's branches and tail series, which it matches to about 1e-6
+// per pair. Charges are in Amber's internal units (e * 18.2223), so the
+// energy is already kcal/mol.
+//
+// The constructor caches everything per atom that does not move (offset and
+// scaled radii, their inverses, charges). Both passes are all-pairs over
+// contiguous arrays: a worker takes a fixed block of atoms and sweeps every
+// partner 4 (AVX2) or 8 (AVX-512) at a time, with vector log and exp. Born
+// radii do not depend on the block split, and the energy is summed per
+// fixed block in block order, so results are the same for any thread count.
+// There is no box: GB is for non-periodic systems.
+class GeneralizedBornEngine
+{
+public:
+  // Throws std::runtime_error if RADII, SCREEN or CHARGE are not loaded or
+  // a radius is not above the offset, and std::invalid_argument for
+  // non-positive dielectrics, cutoff or rgbmax, or a negative offset or salt
+  // concentration.
+  explicit GeneralizedBornEngine(const Parm7Topology &topo, const GeneralizedBornOptions &options = {});
+  // Scores only the atoms in `selection`, as a system of their own: just they
+  // descreen each other and pair up, as for the complex, receptor and ligand
+  // terms of MM/GBSA. evaluate still takes positions for every topology atom.
+  // Also throws std::invalid_argument if `selection` was compiled for another
+  // atom count.
+  GeneralizedBornEngine(const Parm7Topology &topo, const AtomSelection &selection,
+    const GeneralizedBornOptions &options = {});
+
+  [[nodiscard]] const GeneralizedBornOptions &options() const noexcept { return options_; }
+  // Atoms evaluate expects (the whole topology, even with a selection).
+  [[nodiscard]] std::size_t atom_count() const noexcept { return natom_; }
+  // Effective Born radii (angstrom) from the last evaluate, one per scored
+  // atom in atom order.
+  [[nodiscard]] std::span<const double> born_radii() const noexcept { return born_; }
+
+  // Polar solvation energy at `positions` in kcal/mol. No two scored atoms
+  // may coincide. Throws std::invalid_argument for a wrong atom count.
+  double evaluate(const Coordinates &positions);
+
+private:
+  GeneralizedBornOptions options_;
+  std::size_t natom_ = 0;
+  // Scored atoms when they are not the whole system, and their positions
+  // gathered by the last evaluate.
+  std::vector<int> atoms_;
+  Coordinates selected_;
+  // Debye-Huckel inverse length (1 / angstrom) of the salt concentration.
+  double kappa_ = 0.0;
+  AlignedVector<double> charge_;
+  // RADII - offset, its inverse, and 1 / RADII.
+  AlignedVector<double> rho_;
+  AlignedVector<double> inv_rho_;
+  AlignedVector<double> inv_radius_;
+  // SCREEN * (RADII - offset), the radius each atom descreens with.
+  AlignedVector<double> scaled_;
+  // Born radii of the last evaluate, and their inverses.
+  AlignedVector<double> born_;
+  AlignedVector<double> inv_born_;
+};
+
+} // namespace rms
+
+#endif // RMS_GENERALIZED_BORN_HPP
@@ -0,0 +1,72 @@
+#ifndef RMS_MAPPED_FILE_HPP
+#define RMS_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Read-only view of a whole file. Uses mmap on POSIX systems and falls back to
+// reading the file into an owned buffer elsewhere.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::filesystem::path &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  [[nodiscard]] std::span<const char> bytes() const noexcept { return {data_, size_}; }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+private:
+  void release() noexcept;
+
+  char const *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  std::vector<char> fallback_;
+};
+
+// Writable view of a file created (or truncated) at a fixed size. Uses a
+// shared mmap on POSIX systems, so the file may be larger than RAM and dirty
+// pages are written back by the kernel; elsewhere it fills an owned buffer.
+// Call sync() to make the contents durable (and, without mmap, to write them).
+class MappedOutputFile
+{
+public:
+  MappedOutputFile() = default;
+  MappedOutputFile(const std::filesystem::path &path, std::size_t size);
+  ~MappedOutputFile();
+
+  MappedOutputFile(const MappedOutputFile &) = delete;
+  MappedOutputFile &operator=(const MappedOutputFile &) = delete;
+  MappedOutputFile(MappedOutputFile &&other) noexcept;
+  MappedOutputFile &operator=(MappedOutputFile &&other) noexcept;
+
+  [[nodiscard]] std::span<char> bytes() const noexcept { return {data_, size_}; }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+  // Flushes the contents to the file; throws std::runtime_error on failure.
+  void sync();
+
+private:
+  void release() noexcept;
+
+  std::filesystem::path path_;
+  char *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  std::vector<char> fallback_;
+};
+
+} // namespace rms
+
+#endif // RMS_MAPPED_FILE_HPP
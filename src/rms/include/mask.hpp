@@ -0,0 +1,98 @@
+#ifndef RMS_MASK_HPP
+#define RMS_MASK_HPP
+
+#include "coordinates.hpp"
+#include "parsers.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace rms {
+
+// A set of atoms kept two ways: a packed bitset (bit a % 64 of word a / 64)
+// for membership tests and set algebra, and the sorted 0-based indices for
+// gathers. Built by compile_mask. RMSD fitting and the nonbonded and GB
+// engines take selections; BondedEngine always sees the whole topology.
+class AtomSelection
+{
+public:
+  AtomSelection() = default;
+  // Takes the bitset of a `natom`-atom system; bits past natom must be clear.
+  AtomSelection(std::size_t natom, std::vector<std::uint64_t> bits);
+
+  // Every atom of a `natom`-atom system.
+  [[nodiscard]] static AtomSelection all(std::size_t natom);
+
+  [[nodiscard]] std::size_t natom() const noexcept { return natom_; }
+  // Number of selected atoms.
+  [[nodiscard]] std::size_t size() const noexcept { return indices_.size(); }
+  [[nodiscard]] bool empty() const noexcept { return indices_.empty(); }
+
+  [[nodiscard]] std::span<const std::uint64_t> bits() const noexcept { return bits_; }
+  [[nodiscard]] std::span<const int> indices() const noexcept { return indices_; }
+
+  // Unchecked; `atom` must be in [0, natom()).
+  [[nodiscard]] bool contains(std::size_t atom) const noexcept { return ((bits_[atom / 64] >> (atom % 64)) & 1U) != 0; }
+
+  // The selected entries of a per-atom array (e.g. topo.mass), in atom order.
+  template <typename T>
+  [[nodiscard]] std::vector<T> gather(std::span<const T> values) const {
+    std::vector<T> out;
+    out.reserve(indices_.size());
+    for (int const atom : indices_) {
+      out.push_back(values[static_cast<std::size_t>(atom)]);
+    }
+    return out;
+  }
+
+  friend bool operator==(const AtomSelection &, const AtomSelection &) = default;
+
+private:
+  std::size_t natom_ = 0;
+  std::vector<std::uint64_t> bits_;
+  std::vector<int> indices_;
+};
+
+// Compiles an Amber mask against `topo`:
+//   :<residues>         residue numbers (1-based, `1-250`) or names (`WAT,Na+`)
+//   @<atoms>            atom numbers or names (`CA,C,N`)
+//   @%<types>           amber atom types (`CT,HC`)
+//   @/<elements>        element symbols from ATOMIC_NUMBER (`C,N`)
+//   :<residues>@<atoms> atoms in those residues; `*` alone selects everything
+// combined with `!`, `&`, `|` (tightest first) and parentheses. Names take
+// `*` (any run) and `?` (one character) wildcards. Patterns are matched once
+// against the 4-byte packed names (or the interned tables), and the atoms are
+// then swept in bulk: whole-word bit fills for residue and number ranges,
+// branch-free compares of 32-bit names, table lookups by interned id.
+// Throws std::invalid_argument (naming the offending column) on a malformed
+// mask or an unsupported distance operator, and std::runtime_error if a
+// needed section is not loaded.
+[[nodiscard]] AtomSelection compile_mask(std::string_view mask, const Parm7Topology &topo);
+
+// Copies the atoms listed in `atoms` (e.g. AtomSelection::indices()) from `in`
+// into `out`, in order, reusing its storage.
+template <typename T>
+void gather(const BasicCoordinates<T> &in, std::span<const int> atoms, BasicCoordinates<T> &out) {
+  out.resize(atoms.size());
+  for (std::size_t idx = 0; idx < atoms.size(); ++idx) {
+    auto const atom = static_cast<std::size_t>(atoms[idx]);
+    out.x[idx] = in.x[atom];
+    out.y[idx] = in.y[atom];
+    out.z[idx] = in.z[atom];
+  }
+}
+
+template <typename T>
+[[nodiscard]] BasicCoordinates<T> gather(const BasicCoordinates<T> &in, std::span<const int> atoms) {
+  BasicCoordinates<T> out;
+  gather(in, atoms, out);
+  return out;
+}
+
+} // namespace rms
+
+#endif // RMS_MASK_HPP
@@ -0,0 +1,79 @@
+#ifndef RMS_NAMES_HPP
+#define RMS_NAMES_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace rms {
+
+// Longest name a Fortran a4 field can hold.
+constexpr std::size_t kPackedNameLength = 4;
+
+// An a4 name (atom name, amber type, residue label, ...) stored in four bytes:
+// the trimmed characters followed by zero padding. Equality is one 32-bit
+// compare, so scans over contiguous names vectorize.
+class PackedName
+{
+public:
+  constexpr PackedName() noexcept = default;
+
+  // Keeps the first kPackedNameLength characters of `text`.
+  constexpr explicit PackedName(std::string_view text) noexcept {
+    for (std::size_t idx = 0; idx < text.size() && idx < kPackedNameLength; ++idx) {
+      chars_[idx] = text[idx];
+    }
+  }
+
+  [[nodiscard]] constexpr std::string_view view() const noexcept {
+    std::size_t length = 0;
+    while (length < kPackedNameLength && chars_[length] != '\0') {
+      ++length;
+    }
+    return {chars_.data(), length};
+  }
+
+  [[nodiscard]] constexpr std::uint32_t value() const noexcept { return std::bit_cast<std::uint32_t>(chars_); }
+  [[nodiscard]] constexpr bool empty() const noexcept { return chars_[0] == '\0'; }
+
+  friend constexpr bool operator==(PackedName lhs, PackedName rhs) noexcept { return lhs.value() == rhs.value(); }
+  friend constexpr bool operator==(PackedName lhs, std::string_view rhs) noexcept { return lhs.view() == rhs; }
+
+private:
+  std::array<char, kPackedNameLength> chars_{};
+};
+
+static_assert(sizeof(PackedName) == 4);
+
+// Per-atom or per-residue names stored as ids into a table of the distinct
+// names, in first-seen order. Ids double as indices for per-name lookups.
+struct InternedNames {
+  InternedNames() = default;
+  explicit InternedNames(std::pmr::memory_resource *resource) : table(resource), ids(resource) {}
+
+  std::pmr::vector<PackedName> table;
+  std::pmr::vector<std::uint32_t> ids;
+
+  [[nodiscard]] std::size_t size() const noexcept { return ids.size(); }
+  [[nodiscard]] bool empty() const noexcept { return ids.empty(); }
+  [[nodiscard]] PackedName operator[](std::size_t idx) const { return table[ids[idx]]; }
+  [[nodiscard]] PackedName at(std::size_t idx) const { return table.at(ids.at(idx)); }
+
+  // Id of `name`, if any entry uses it.
+  [[nodiscard]] std::optional<std::uint32_t> find(PackedName name) const noexcept;
+
+  friend bool operator==(const InternedNames &, const InternedNames &) = default;
+};
+
+// Both arrays are allocated from `resource` at their final size.
+[[nodiscard]] InternedNames intern_names(std::span<const PackedName> names,
+  std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+} // namespace rms
+
+#endif // RMS_NAMES_HPP
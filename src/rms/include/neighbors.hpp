@@ -0,0 +1,168 @@
+#ifndef RMS_NEIGHBORS_HPP
+#define RMS_NEIGHBORS_HPP
+
+#include "coordinates.hpp"
+#include "exclusions.hpp"
+#include "parsers.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+using Vec3 = std::array<double, 3>;
+
+// A periodic cell in the Amber convention: a along x, b in the xy plane, so
+// the lattice vectors are the rows of a lower-triangular matrix. Covers
+// orthorhombic, monoclinic and the truncated octahedron (IFBOX 2), which
+// Amber stores as a triclinic cell with all angles 109.4712206 degrees.
+class PeriodicBox
+{
+public:
+  // a, b, c in angstrom and alpha, beta, gamma in degrees, as on an rst7 box
+  // line. Throws std::invalid_argument for a non-positive length or angles
+  // that do not make a cell.
+  explicit PeriodicBox(const std::array<double, 6> &parameters);
+
+  // From BOX_DIMENSIONS (beta, a, b, c) and IFBOX; nullopt when IFBOX is 0.
+  // Throws std::runtime_error if IFBOX is set but the section is not loaded.
+  [[nodiscard]] static std::optional<PeriodicBox> from_topology(const Parm7Topology &topo);
+
+  [[nodiscard]] const std::array<double, 6> &parameters() const noexcept { return parameters_; }
+  // Lattice vectors a, b, c.
+  [[nodiscard]] const std::array<Vec3, 3> &vectors() const noexcept { return vectors_; }
+  [[nodiscard]] bool orthorhombic() const noexcept { return orthorhombic_; }
+  [[nodiscard]] double volume() const noexcept { return vectors_[0][0] * vectors_[1][1] * vectors_[2][2]; }
+  // Distances between opposite faces (the cell's extent along each reciprocal vector).
+  [[nodiscard]] const Vec3 &widths() const noexcept { return widths_; }
+  // Longest cutoff for which every pair has at most one image in range.
+  [[nodiscard]] double max_cutoff() const noexcept;
+
+  [[nodiscard]] Vec3 fractional(const Vec3 &r) const noexcept {
+    double const sz = r[2] * inverse_diagonal_[2];
+    double const sy = (r[1] - vectors_[2][1] * sz) * inverse_diagonal_[1];
+    double const sx = (r[0] - vectors_[1][0] * sy - vectors_[2][0] * sz) * inverse_diagonal_[0];
+    return {sx, sy, sz};
+  }
+
+  [[nodiscard]] Vec3 cartesian(const Vec3 &s) const noexcept {
+    return {vectors_[0][0] * s[0] + vectors_[1][0] * s[1] + vectors_[2][0] * s[2],
+      vectors_[1][1] * s[1] + vectors_[2][1] * s[2], vectors_[2][2] * s[2]};
+  }
+
+  // Shortest periodic image of a displacement: fractional rounding, then (for
+  // a skewed cell) the best of the 27 neighbouring lattice shifts.
+  [[nodiscard]] Vec3 minimum_image(const Vec3 &d) const noexcept;
+
+  friend bool operator==(const PeriodicBox &lhs, const PeriodicBox &rhs) noexcept {
+    return lhs.parameters_ == rhs.parameters_;
+  }
+
+private:
+  std::array<double, 6> parameters_{};
+  std::array<Vec3, 3> vectors_{};
+  Vec3 inverse_diagonal_{};
+  Vec3 widths_{};
+  bool orthorhombic_ = true;
+};
+
+struct NeighborOptions {
+  // Pairs closer than cutoff + skin are listed (angstrom).
+  double cutoff = 8.0;
+  // The list stays valid until some atom has moved skin / 2.
+  double skin = 2.0;
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+};
+
+// Verlet pair list built from a cell list. Atoms are binned into cells at
+// least cutoff + skin wide (on a periodic grid in fractional coordinates, or
+// over the bounding box without a box), sorted by cell so each cell's
+// positions are contiguous [x | y | z] arrays, and each cell is searched
+// against itself and its 13 forward neighbours in parallel. Every pair in
+// range is stored once, in compressed rows kept in that cell order, so the
+// partners of a row are a few contiguous runs of rows: row r is atom
+// order()[r], and its partners are the rows partners()[offsets()[r],
+// offsets()[r + 1]). shifts() names the lattice translation in
+// shift_vectors() that makes positions[partner] + shift - positions[atom] the
+// displacement. Shifts are relative to the positions given to rebuild, so
+// atoms need not be wrapped into the cell. Pairs excluded by the topology are
+// dropped.
+class VerletList
+{
+public:
+  // `exclusions` (nullptr keeps every pair) is copied in.
+  explicit VerletList(const NeighborOptions &options = {}, const ExclusionList *exclusions = nullptr);
+
+  // Rebuilds unless the box is unchanged and no atom has moved more than
+  // skin / 2 since the last build; returns whether it rebuilt.
+  bool update(const Coordinates &positions, const std::optional<PeriodicBox> &box);
+  // Throws std::invalid_argument if cutoff + skin exceeds box->max_cutoff(),
+  // or if the exclusions cover a different atom count.
+  void rebuild(const Coordinates &positions, const std::optional<PeriodicBox> &box);
+
+  [[nodiscard]] const NeighborOptions &options() const noexcept { return options_; }
+  [[nodiscard]] std::size_t atom_count() const noexcept { return order_.size(); }
+  [[nodiscard]] std::size_t pair_count() const noexcept { return partners_.size(); }
+  [[nodiscard]] std::size_t rebuild_count() const noexcept { return rebuilds_; }
+  [[nodiscard]] const std::optional<PeriodicBox> &box() const noexcept { return box_; }
+
+  // Atom of each row (a permutation of the atoms).
+  [[nodiscard]] std::span<const int> order() const noexcept { return order_; }
+  [[nodiscard]] std::span<const std::size_t> offsets() const noexcept { return offsets_; }
+  [[nodiscard]] std::span<const int> partners() const noexcept { return partners_; }
+  [[nodiscard]] std::span<const std::uint16_t> shifts() const noexcept { return shifts_; }
+  [[nodiscard]] std::span<const Vec3> shift_vectors() const noexcept { return shift_vectors_; }
+
+  // Calls fn(i, j, dx, dy, dz, r2) for every listed pair within the cutoff
+  // (not the skin) at `positions`, with (dx, dy, dz) = r_j - r_i.
+  template <typename F>
+  void for_each_pair(const Coordinates &positions, F &&fn) const {
+    double const cutoff2 = options_.cutoff * options_.cutoff;
+    for (std::size_t row = 0; row < order_.size(); ++row) {
+      auto const atom = static_cast<std::size_t>(order_[row]);
+      double const xi = positions.x[atom];
+      double const yi = positions.y[atom];
+      double const zi = positions.z[atom];
+      for (std::size_t slot = offsets_[row]; slot < offsets_[row + 1]; ++slot) {
+        int const partner = order_[static_cast<std::size_t>(partners_[slot])];
+        auto const j = static_cast<std::size_t>(partner);
+        auto const &shift = shift_vectors_[shifts_[slot]];
+        double const dx = positions.x[j] + shift[0] - xi;
+        double const dy = positions.y[j] + shift[1] - yi;
+        double const dz = positions.z[j] + shift[2] - zi;
+        double const r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 < cutoff2) {
+          fn(order_[row], partner, dx, dy, dz, r2);
+        }
+      }
+    }
+  }
+
+private:
+  NeighborOptions options_;
+  std::size_t exclusion_atoms_ = 0;
+  // The exclusions in both directions (every partner of an atom, ascending),
+  // so the search tests a pair against rows of the atom it is already on.
+  std::vector<std::size_t> excluded_offsets_;
+  std::vector<int> excluded_;
+  bool has_exclusions_ = false;
+  std::optional<PeriodicBox> box_;
+  std::size_t rebuilds_ = 0;
+
+  std::vector<int> order_;
+  std::vector<std::size_t> offsets_;
+  std::vector<int> partners_;
+  std::vector<std::uint16_t> shifts_;
+  std::vector<Vec3> shift_vectors_;
+  // Positions at the last build, for the displacement test.
+  Coordinates built_at_;
+};
+
+} // namespace rms
+
+#endif // RMS_NEIGHBORS_HPP
@@ -0,0 +1,111 @@
+#ifndef RMS_NONBONDED_HPP
+#define RMS_NONBONDED_HPP
+
+#include "aligned.hpp"
+#include "coordinates.hpp"
+#include "mask.hpp"
+#include "neighbors.hpp"
+#include "one_four.hpp"
+#include "parsers.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace rms {
+
+// Nonbonded energy terms in kcal/mol.
+struct NonbondedEnergy {
+  double vdw = 0.0;
+  double elec = 0.0;
+  double vdw14 = 0.0;
+  double elec14 = 0.0;
+
+  [[nodiscard]] double total() const noexcept { return vdw + elec + vdw14 + elec14; }
+};
+
+struct NonbondedOptions {
+  // Pairs beyond the cutoff (angstrom) contribute nothing; there is no
+  // switching, long-range correction or Ewald sum.
+  double cutoff = 8.0;
+  // Verlet list skin (angstrom); see NeighborOptions.
+  double skin = 2.0;
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Kernel tier, capped at detected_simd_level().
+  SimdLevel level = detected_simd_level();
+};
+
+// Single-point Lennard-Jones + Coulomb energies and forces, as sander
+// computes them without PME: every pair within the cutoff that the topology
+// does not exclude, plus the 1-4 pairs of dihedrals without the suppress-1-4
+// flag, scaled by 1 / SCEE and 1 / SCNB. Charges are in Amber's internal units
+// (e * 18.2223), so qi qj / r is already kcal/mol. With no box and a cutoff
+// past the system's extent this is the exact all-pairs vacuum energy.
+//
+// Pairs come from a VerletList that is only rebuilt when atoms move past the
+// skin, so rescoring nearby frames reuses it. Each worker takes a contiguous
+// run of list rows holding an equal share of the pairs; within a row the
+// partners are processed 4 (AVX2) or 8 (AVX-512) at a time with gathered
+// positions, charges and LJ coefficients. Positions and charges are copied
+// into the list's cell order first, so a row's partners are nearly sequential
+// reads. Partial energies, and with forces one private force buffer per
+// worker (threads x NATOM x 24 bytes), are summed in worker order, so a given
+// thread count always gives the same bits.
+class NonbondedEngine
+{
+public:
+  // Throws std::runtime_error if CHARGE, ATOM_TYPE_INDEX, the LJ, exclusion,
+  // dihedral or SCEE / SCNB sections are not loaded, and std::invalid_argument
+  // for a bad cutoff or skin.
+  explicit NonbondedEngine(const Parm7Topology &topo, const NonbondedOptions &options = {});
+  // Scores only pairs (and 1-4 pairs) whose atoms are both in `selection`,
+  // e.g. the receptor or ligand terms of MM/GBSA; atoms outside it get no
+  // force. The other atoms keep their place in the list with zero charge and
+  // an all-zero LJ type, so a subset costs as much as the whole system. Also
+  // throws std::invalid_argument if `selection` was compiled for another atom
+  // count.
+  NonbondedEngine(const Parm7Topology &topo, const AtomSelection &selection, const NonbondedOptions &options = {});
+
+  [[nodiscard]] const NonbondedOptions &options() const noexcept { return options_; }
+  [[nodiscard]] std::size_t atom_count() const noexcept { return charge_.size(); }
+  [[nodiscard]] const VerletList &neighbors() const noexcept { return neighbors_; }
+  [[nodiscard]] const OneFourList &one_four_pairs() const noexcept { return one_four_; }
+
+  // Energies at `positions` (box = std::nullopt for vacuum). When `forces` is
+  // set it is resized and receives -dE/dr per atom (kcal/mol/angstrom).
+  // Throws std::invalid_argument for a wrong atom count or a cutoff + skin
+  // the box cannot hold.
+  NonbondedEnergy evaluate(const Coordinates &positions, const std::optional<PeriodicBox> &box,
+    Coordinates *forces = nullptr);
+
+private:
+  NonbondedOptions options_;
+  // The LJTable's {A, B} per type pair plus one all-zero type, which atoms
+  // outside the selection take; ntypes_ counts it.
+  std::size_t ntypes_ = 0;
+  AlignedVector<double> lj_;
+  // Per atom, zero charge and the zero type outside the selection.
+  AlignedVector<double> charge_;
+  std::vector<int> type_;
+  OneFourList one_four_;
+  VerletList neighbors_;
+  // Everything below is indexed by list row (VerletList::order()).
+  std::vector<int> row_of_;
+  // 2 * type * ntypes and 2 * type per row: the {A, B} of a pair sit at
+  // lj_row_[i] + lj_col_[j] in lj_.coefficients().
+  AlignedVector<int> lj_row_;
+  AlignedVector<int> lj_col_;
+  // {x, y, z, charge} per row at the last evaluate.
+  AlignedVector<double> records_;
+  // Shift vectors of the current list as [x | y | z] arrays, for gathers.
+  AlignedVector<double> shift_x_;
+  AlignedVector<double> shift_y_;
+  AlignedVector<double> shift_z_;
+  std::vector<Coordinates> scratch_;
+};
+
+} // namespace rms
+
+#endif // RMS_NONBONDED_HPP
@@ -0,0 +1,50 @@
+#ifndef RMS_ONE_FOUR_HPP
+#define RMS_ONE_FOUR_HPP
+
+#include "aligned.hpp"
+#include "parsers.hpp"
+
+#include <cstddef>
+#include <span>
+
+namespace rms {
+
+// The 1-4 nonbonded pairs: the end atoms (dihedral_i, dihedral_l) of every
+// dihedral without the suppress-1-4 flag (bit 0), once each, with the SCEE
+// and SCNB divisors of the first such dihedral that names the pair (1.2 and
+// 2.0 when the topology predates those sections). Pairs are stored as
+// parallel arrays with i < j, sorted by (i, j).
+//
+// Built without comparisons: each pair becomes the key i * 2^b + j (b bits
+// per atom index), the keys are LSD radix-sorted 11 bits a pass, and runs of
+// equal keys collapse to their first entry. Each pass counts digits per
+// contiguous block on its own worker, so the sort is stable and the result is
+// the same for any thread count.
+class OneFourList
+{
+public:
+  OneFourList() = default;
+  // Works on up to `threads` workers (0 = all hardware threads). Throws
+  // std::runtime_error if the dihedral sections are not loaded, SCEE / SCNB
+  // do not match the dihedral types, or a dihedral's end atoms are out of
+  // range or equal.
+  explicit OneFourList(const Parm7Topology &topo, std::size_t threads = 0);
+
+  [[nodiscard]] std::size_t size() const noexcept { return i_.size(); }
+  [[nodiscard]] bool empty() const noexcept { return i_.empty(); }
+
+  [[nodiscard]] std::span<const int> i() const noexcept { return i_; }
+  [[nodiscard]] std::span<const int> j() const noexcept { return j_; }
+  [[nodiscard]] std::span<const double> scee() const noexcept { return scee_; }
+  [[nodiscard]] std::span<const double> scnb() const noexcept { return scnb_; }
+
+private:
+  AlignedVector<int> i_;
+  AlignedVector<int> j_;
+  AlignedVector<double> scee_;
+  AlignedVector<double> scnb_;
+};
+
+} // namespace rms
+
+#endif // RMS_ONE_FOUR_HPP
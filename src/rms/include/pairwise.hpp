@@ -0,0 +1,116 @@
+#ifndef RMS_PAIRWISE_HPP
+#define RMS_PAIRWISE_HPP
+
+#include "aligned.hpp"
+#include "mapped_file.hpp"
+#include "rmsd.hpp"
+#include "simd.hpp"
+#include "trajectory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Bumped whenever the matrix file layout changes.
+constexpr std::uint32_t kRmsdMatrixVersion = 1;
+
+// Position of pair (i, j), i < j, in the condensed upper triangle of an n x n
+// matrix: rows in order, diagonal left out (the layout of scipy's pdist).
+[[nodiscard]] constexpr std::size_t condensed_index(std::size_t n, std::size_t i, std::size_t j) noexcept {
+  return n * i - i * (i + 1) / 2 + (j - i - 1);
+}
+
+// Trajectory frames prepared once for pairwise QCP. Each frame is centred on
+// its weighted centroid, scaled by sqrt(weight), and packed as [x | y | z]
+// float blocks of stride() values (zero-padded to kPackedFrameAlign atoms),
+// with its inner product kept. A pair then costs the 9 covariance sums and the
+// O(1) solve. Holds frame_count() * stride() * 12 bytes.
+class PackedFrames
+{
+public:
+  // Decodes every frame on `threads` workers (0 = all hardware threads).
+  // `atoms` (e.g. AtomSelection::indices()) keeps only those atoms; empty
+  // keeps all. `weights` is empty for plain RMSD, or one non-negative weight
+  // per kept atom.
+  explicit PackedFrames(const MdcrdTrajectory &trajectory, std::span<const double> weights = {},
+    std::size_t threads = 0, std::span<const int> atoms = {});
+
+  [[nodiscard]] std::size_t frame_count() const noexcept { return inner_.size(); }
+  [[nodiscard]] std::size_t natom() const noexcept { return natom_; }
+  [[nodiscard]] std::size_t stride() const noexcept { return stride_; }
+  [[nodiscard]] bool weighted() const noexcept { return weighted_; }
+  [[nodiscard]] double total_weight() const noexcept { return total_weight_; }
+  [[nodiscard]] float const *frame(std::size_t idx) const noexcept { return values_.data() + idx * 3 * stride_; }
+  [[nodiscard]] double inner(std::size_t idx) const noexcept { return inner_[idx]; }
+
+  // RMSD of frames i and j after optimal superposition. `level` must not
+  // exceed detected_simd_level().
+  [[nodiscard]] double rmsd(std::size_t i, std::size_t j, SimdLevel level = detected_simd_level()) const noexcept {
+    return qcp_rmsd(packed_covariance(frame(i), frame(j), stride_, level), inner_[i], inner_[j], total_weight_);
+  }
+
+private:
+  std::size_t natom_ = 0;
+  std::size_t stride_ = 0;
+  bool weighted_ = false;
+  double total_weight_ = 0.0;
+  AlignedVector<float> values_;
+  std::vector<double> inner_;
+};
+
+struct PairwiseRmsdOptions {
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Frames per tile side; 0 sizes two tiles of frames to fit in L2.
+  std::size_t block_frames = 0;
+  // Kernel tier, clamped to what the CPU supports.
+  SimdLevel level = detected_simd_level();
+};
+
+// Writes the all-vs-all RMSD matrix of `frames` to `out`, memory-mapped: a
+// 64-byte header, then the condensed upper triangle as float32. The frame set
+// is cut into blocks of block_frames, and each task computes one tile (block I
+// x block J, I <= J) on the upper triangle, so both blocks stay in cache while
+// each row segment is written contiguously. The matrix may exceed RAM: pages
+// are written back as they fill. Throws std::runtime_error on I/O failure.
+void write_pairwise_rmsd(const std::filesystem::path &out, const PackedFrames &frames,
+  const PairwiseRmsdOptions &options = {});
+
+// Read-only view of a matrix written by write_pairwise_rmsd. Throws
+// std::runtime_error unless the file has the expected magic, version, byte
+// order and size.
+class RmsdMatrix
+{
+public:
+  explicit RmsdMatrix(const std::filesystem::path &path);
+
+  // Frames per side.
+  [[nodiscard]] std::size_t size() const noexcept { return frames_; }
+  [[nodiscard]] std::size_t natom() const noexcept { return natom_; }
+  [[nodiscard]] bool weighted() const noexcept { return weighted_; }
+  // The upper triangle in condensed_index order.
+  [[nodiscard]] std::span<const float> condensed() const noexcept { return values_; }
+
+  // RMSD of frames i and j, in either order; zero on the diagonal.
+  [[nodiscard]] float operator()(std::size_t i, std::size_t j) const noexcept {
+    if (i == j) {
+      return 0.0F;
+    }
+    return i < j ? values_[condensed_index(frames_, i, j)] : values_[condensed_index(frames_, j, i)];
+  }
+
+private:
+  MappedFile file_;
+  std::size_t frames_ = 0;
+  std::size_t natom_ = 0;
+  bool weighted_ = false;
+  std::span<const float> values_;
+};
+
+} // namespace rms
+
+#endif // RMS_PAIRWISE_HPP
@@ -0,0 +1,220 @@
+#ifndef RMS_PARALLEL_HPP
+#define RMS_PARALLEL_HPP
+
+#include "aligned.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace rms {
+
+// Resolves a requested thread count: 0 means "all hardware threads".
+[[nodiscard]] inline std::size_t resolve_thread_count(std::size_t requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Persistent workers behind parallel_for and parallel_for_stealing, so a call
+// costs a wake-up instead of creating and joining threads. Threads start on
+// first use, as many as the largest worker count asked for so far, and live
+// until exit. One job runs at a time (other callers wait for it), and a loop
+// started from inside a job runs inline on the thread that started it.
+class ThreadPool
+{
+public:
+  [[nodiscard]] static ThreadPool &instance();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  // Calls job(worker) for every worker in [0, workers), worker 0 on the
+  // calling thread, and returns once all have returned. Each call must keep
+  // taking work until none is left, so that job(0) alone also finishes it,
+  // and must not throw.
+  template <typename F>
+  void run(std::size_t workers, const F &job) {
+    dispatch(
+      workers, [](void const *context, std::size_t worker) { (*static_cast<F const *>(context))(worker); }, &job);
+  }
+
+private:
+  using Call = void (*)(void const *, std::size_t);
+
+  ThreadPool() = default;
+  void dispatch(std::size_t workers, Call call, void const *context);
+  void work(std::size_t worker, std::uint64_t seen);
+
+  // Held for the whole of a job.
+  std::mutex jobs_;
+  std::vector<std::jthread> threads_;
+  // Bumped to publish a job or shutdown; idle threads wait on it.
+  std::atomic<std::uint64_t> generation_{0};
+  // Threads yet to finish the current generation, idle ones included.
+  std::atomic<std::size_t> pending_{0};
+  // The current job, written only while no thread is inside one.
+  std::size_t workers_ = 0;
+  Call call_ = nullptr;
+  void const *context_ = nullptr;
+  bool stopping_ = false;
+};
+
+// Runs fn(index) for every index in [0, count) on up to `threads` workers.
+// Indices are handed out dynamically, so callers should order them from the
+// most to the least expensive. The first exception thrown by any task is
+// rethrown on the calling thread after all workers have stopped.
+template <typename F>
+void parallel_for(std::size_t count, std::size_t threads, F &&fn) {
+  std::size_t const workers = std::min(resolve_thread_count(threads), count);
+  if (workers <= 1) {
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      fn(idx);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    while (!failed.load(std::memory_order_relaxed)) {
+      std::size_t const idx = next.fetch_add(1, std::memory_order_relaxed);
+      if (idx >= count) {
+        return;
+      }
+      try {
+        fn(idx);
+      } catch (...) {
+        std::scoped_lock const lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  ThreadPool::instance().run(workers, [&](std::size_t) { worker(); });
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// Runs fn(worker, index) for every index in [0, count) on up to `threads`
+// workers, with worker in [0, workers) so callers can keep per-worker buffers.
+// Each worker starts on its own contiguous block and takes indices from its
+// front, so neighbouring indices (e.g. frames adjacent in a file) stay on one
+// core and there is no shared counter to contend on. A worker that runs dry
+// steals the back half of the largest block left, so slow indices do not
+// stall the rest. Exceptions are handled as in parallel_for. Throws
+// std::length_error past 2^32 - 1 indices.
+template <typename F>
+void parallel_for_stealing(std::size_t count, std::size_t threads, F &&fn) {
+  std::size_t const workers = std::min(resolve_thread_count(threads), count);
+  if (workers <= 1) {
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      fn(std::size_t{0}, idx);
+    }
+    return;
+  }
+  if (count > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("parallel_for_stealing supports at most 2^32 - 1 indices");
+  }
+
+  // A block is [begin, end) packed as begin << 32 | end, so the owner taking
+  // one index and a thief taking half are each a single compare-exchange.
+  struct alignas(kCacheLineSize) Block {
+    std::atomic<std::uint64_t> range{0};
+  };
+  auto const pack = [](std::uint64_t begin, std::uint64_t end) { return begin << 32U | end; };
+  auto const begin_of = [](std::uint64_t range) { return range >> 32U; };
+  auto const end_of = [](std::uint64_t range) { return range & 0xFFFFFFFFU; };
+
+  auto const blocks = std::make_unique<Block[]>(workers);
+  for (std::size_t w = 0; w < workers; ++w) {
+    blocks[w].range.store(pack(count * w / workers, count * (w + 1) / workers), std::memory_order_relaxed);
+  }
+
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  // Moves the back half (rounded up) of the fullest other block into `self`.
+  auto const steal = [&](std::size_t self) {
+    for (;;) {
+      std::size_t victim = workers;
+      std::uint64_t seen = 0;
+      std::uint64_t most = 0;
+      for (std::size_t offset = 1; offset < workers; ++offset) {
+        auto const w = (self + offset) % workers;
+        auto const range = blocks[w].range.load(std::memory_order_acquire);
+        auto const left = end_of(range) > begin_of(range) ? end_of(range) - begin_of(range) : 0;
+        if (left > most) {
+          victim = w;
+          seen = range;
+          most = left;
+        }
+      }
+      if (victim == workers) {
+        return false;
+      }
+      auto const begin = begin_of(seen);
+      auto const end = end_of(seen);
+      auto const mid = begin + (end - begin) / 2;
+      if (blocks[victim].range.compare_exchange_weak(seen, pack(begin, mid), std::memory_order_acq_rel)) {
+        blocks[self].range.store(pack(mid, end), std::memory_order_release);
+        return true;
+      }
+    }
+  };
+
+  auto worker = [&](std::size_t self) {
+    auto &own = blocks[self].range;
+    while (!failed.load(std::memory_order_relaxed)) {
+      auto range = own.load(std::memory_order_acquire);
+      auto const begin = begin_of(range);
+      if (begin >= end_of(range)) {
+        if (!steal(self)) {
+          return;
+        }
+        continue;
+      }
+      if (!own.compare_exchange_weak(range, pack(begin + 1, end_of(range)), std::memory_order_acq_rel)) {
+        continue;
+      }
+      try {
+        fn(self, static_cast<std::size_t>(begin));
+      } catch (...) {
+        std::scoped_lock const lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  ThreadPool::instance().run(workers, worker);
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace rms
+
+#endif // RMS_PARALLEL_HPP
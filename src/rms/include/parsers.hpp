@@ -1,10 +1,17 @@
 #ifndef RMS_PARSERS_HPP
 #define RMS_PARSERS_HPP
 
+#include "names.hpp"
+
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -13,136 +20,312 @@ namespace rms {
 constexpr double kAmberChargeScale = 18.2223;
 constexpr int kParm7PointerCount = 31;
 
+// %FLAG sections understood by the parser, in the order LEaP writes them. The
+// underlying value is the bit position in a Parm7SectionMask.
+enum class Parm7Section : std::uint8_t {
+  Title,
+  Pointers,
+  AtomName,
+  Charge,
+  AtomicNumber,
+  Mass,
+  AtomTypeIndex,
+  NumberExcludedAtoms,
+  ExcludedAtomsList,
+  NonbondedParmIndex,
+  ResidueLabel,
+  ResiduePointer,
+  BondForceConstant,
+  BondEquilValue,
+  AngleForceConstant,
+  AngleEquilValue,
+  DihedralForceConstant,
+  DihedralPeriodicity,
+  DihedralPhase,
+  SceeScaleFactor,
+  ScnbScaleFactor,
+  Solty,
+  LennardJonesAcoef,
+  LennardJonesBcoef,
+  BondsIncHydrogen,
+  BondsWithoutHydrogen,
+  AnglesIncHydrogen,
+  AnglesWithoutHydrogen,
+  DihedralsIncHydrogen,
+  DihedralsWithoutHydrogen,
+  HbondAcoef,
+  HbondBcoef,
+  HbondCut,
+  AmberAtomType,
+  TreeChainClassification,
+  JoinArray,
+  Irotat,
+  SolventPointers,
+  AtomsPerMolecule,
+  BoxDimensions,
+  RadiusSet,
+  Radii,
+  Screen,
+  Ipol
+};
+
+constexpr std::size_t kParm7SectionCount = static_cast<std::size_t>(Parm7Section::Ipol) + 1;
+
+using Parm7SectionMask = std::uint64_t;
+
+[[nodiscard]] constexpr Parm7SectionMask section_bit(Parm7Section section) noexcept {
+  return Parm7SectionMask{1} << static_cast<unsigned>(section);
+}
+
+[[nodiscard]] constexpr Parm7SectionMask section_mask(std::initializer_list<Parm7Section> sections) noexcept {
+  Parm7SectionMask mask = 0;
+  for (auto const section : sections) {
+    mask |= section_bit(section);
+  }
+  return mask;
+}
+
+constexpr Parm7SectionMask kAllParm7Sections = (Parm7SectionMask{1} << kParm7SectionCount) - 1;
+
+// Per-atom and per-residue metadata most analysis tools need (no parameters or connectivity).
+constexpr Parm7SectionMask kParm7AtomSections = section_mask({Parm7Section::Title, Parm7Section::Pointers,
+  Parm7Section::AtomName, Parm7Section::Charge, Parm7Section::AtomicNumber, Parm7Section::Mass,
+  Parm7Section::AmberAtomType, Parm7Section::ResidueLabel, Parm7Section::ResiduePointer,
+  Parm7Section::SolventPointers, Parm7Section::AtomsPerMolecule, Parm7Section::BoxDimensions});
+
+// Counts are I8 fields in the file, so they can exceed 65535 but never INT32_MAX;
+// parse_pointers rejects negative values and counts that would overflow the
+// int-based atom and coordinate indices.
 struct Parm7Pointers {
   // NATOM: total number of atoms.
-  std::uint16_t natom = 0;
+  std::int32_t natom = 0;
   // NTYPES: total number of distinct atom types (LJ types).
-  std::uint16_t ntypes = 0;
+  std::int32_t ntypes = 0;
   // NBONH: number of bonds containing hydrogen.
-  std::uint16_t nbonh = 0;
+  std::int32_t nbonh = 0;
   // MBONA: number of bonds not containing hydrogen.
-  std::uint16_t mbona = 0;
+  std::int32_t mbona = 0;
   // NTHETH: number of angles containing hydrogen.
-  std::uint16_t ntheth = 0;
+  std::int32_t ntheth = 0;
   // MTHETA: number of angles not containing hydrogen.
-  std::uint16_t mtheta = 0;
+  std::int32_t mtheta = 0;
   // NPHIH: number of dihedrals containing hydrogen.
-  std::uint16_t nphih = 0;
+  std::int32_t nphih = 0;
   // MPHIA: number of dihedrals not containing hydrogen.
-  std::uint16_t mphia = 0;
+  std::int32_t mphia = 0;
   // NHPARM: currently not used.
-  std::uint16_t nhparm = 0;
+  std::int32_t nhparm = 0;
   // NPARM: currently not used.
-  std::uint16_t nparm = 0;
+  std::int32_t nparm = 0;
   // NEXT/NNB: total number of excluded atoms.
-  std::uint16_t nnb = 0;
+  std::int32_t nnb = 0;
   // NRES: number of residues.
-  std::uint16_t nres = 0;
+  std::int32_t nres = 0;
   // NBONA: MBONA plus constraint bonds.
-  std::uint16_t nbona = 0;
+  std::int32_t nbona = 0;
   // NTHETA: MTHETA plus constraint angles.
-  std::uint16_t ntheta = 0;
+  std::int32_t ntheta = 0;
   // NPHIA: MPHIA plus constraint dihedrals.
-  std::uint16_t nphia = 0;
+  std::int32_t nphia = 0;
   // NUMBND: number of unique bond types.
-  std::uint16_t numbnd = 0;
+  std::int32_t numbnd = 0;
   // NUMANG: number of unique angle types.
-  std::uint16_t numang = 0;
+  std::int32_t numang = 0;
   // NPTRA: number of unique dihedral types.
-  std::uint16_t nptra = 0;
+  std::int32_t nptra = 0;
   // NATYP: number of atom types in parameter file (SOLTY count).
-  std::uint16_t natyp = 0;
+  std::int32_t natyp = 0;
   // NPHB: number of distinct 10-12 hydrogen bond pair types.
-  std::uint16_t nphb = 0;
+  std::int32_t nphb = 0;
   // IFPERT: perturbation flag (1 means perturbation info present).
-  std::uint16_t ifpert = 0;
+  std::int32_t ifpert = 0;
   // NBPER: number of bonds to be perturbed.
-  std::uint16_t nbper = 0;
+  std::int32_t nbper = 0;
   // NGPER: number of angles to be perturbed.
-  std::uint16_t ngper = 0;
+  std::int32_t ngper = 0;
   // NDPER: number of dihedrals to be perturbed.
-  std::uint16_t ndper = 0;
+  std::int32_t ndper = 0;
   // MBPER: number of bonds with atoms entirely in perturbed group.
-  std::uint16_t mbper = 0;
+  std::int32_t mbper = 0;
   // MGPER: number of angles with atoms entirely in perturbed group.
-  std::uint16_t mgper = 0;
+  std::int32_t mgper = 0;
   // MDPER: number of dihedrals with atoms entirely in perturbed group.
-  std::uint16_t mdper = 0;
+  std::int32_t mdper = 0;
   // IFBOX: periodic box flag (0 none, 1 orthorhombic, 2 truncated octahedron, 3 triclinic).
-  std::uint16_t ifbox = 0;
+  std::int32_t ifbox = 0;
   // NMXRS: number of atoms in the largest residue.
-  std::uint16_t nmxrs = 0;
+  std::int32_t nmxrs = 0;
   // IFCAP: CAP option flag.
-  std::uint16_t ifcap = 0;
+  std::int32_t ifcap = 0;
   // NUMEXTRA: number of extra points (virtual sites).
-  std::uint16_t numextra = 0;
+  std::int32_t numextra = 0;
   // NCOPY: number of copies for advanced simulations (optional).
-  std::optional<std::uint16_t> ncopy;
+  std::optional<std::int32_t> ncopy;
+};
+
+struct Parm7DeferredSection {
+  Parm7Section section = Parm7Section::Title;
+  std::size_t offset = 0;
+  std::size_t size = 0;
+};
+
+// Where a topology's arrays allocate from. It is a base of Parm7Topology, so
+// the arena is destroyed after the arrays. A copy starts over on the default
+// resource without an arena, which is where copied std::pmr arrays allocate.
+struct Parm7Storage {
+  Parm7Storage() = default;
+  Parm7Storage(std::pmr::memory_resource *storage, std::shared_ptr<std::pmr::memory_resource> owner) noexcept
+    : arena(std::move(owner)), resource(storage) {}
+  Parm7Storage(const Parm7Storage &) noexcept {}
+  Parm7Storage(Parm7Storage &&) noexcept = default;
+  Parm7Storage &operator=(const Parm7Storage &) = delete;
+  Parm7Storage &operator=(Parm7Storage &&) = delete;
+  ~Parm7Storage() = default;
+
+  // Arena owned by the topology (Parm7ParseOptions::use_arena).
+  std::shared_ptr<std::pmr::memory_resource> arena;
+  // Where the arrays, including sections loaded later, allocate from.
+  std::pmr::memory_resource *resource = std::pmr::get_default_resource();
 };
 
-struct Parm7Topology {
+struct Parm7Topology : Parm7Storage {
+  Parm7Topology() = default;
+  // Allocates every array from `storage`; `owner`, if set, is kept alive with the topology.
+  explicit Parm7Topology(std::pmr::memory_resource *storage, std::shared_ptr<std::pmr::memory_resource> owner = {})
+    : Parm7Storage(storage, std::move(owner)) {}
+  Parm7Topology(const Parm7Topology &) = default;
+  Parm7Topology(Parm7Topology &&) noexcept = default;
+  // std::pmr arrays keep their own allocator when assigned to, so a
+  // member-wise assignment would fill them from the arena it just released.
+  // The whole topology, storage included, is replaced instead.
+  Parm7Topology &operator=(Parm7Topology &&other) noexcept {
+    if (this != &other) {
+      std::destroy_at(this);
+      std::construct_at(this, std::move(other));
+    }
+    return *this;
+  }
+  Parm7Topology &operator=(const Parm7Topology &other) {
+    if (this != &other) {
+      *this = Parm7Topology(other);
+    }
+    return *this;
+  }
+  ~Parm7Topology() = default;
+
   std::string version;
   std::string title;
   Parm7Pointers pointers;
 
-  std::vector<std::string> atom_name;
-  std::vector<double> charge;
-  std::vector<int> atomic_number;
-  std::vector<double> mass;
-  std::vector<int> atom_type_index;
-  std::vector<int> number_excluded_atoms;
-  std::vector<int> excluded_atoms_list;
-  std::vector<int> nonbonded_parm_index;
-  std::vector<std::string> residue_label;
-  std::vector<int> residue_pointer;
-
-  std::vector<double> bond_force_constant;
-  std::vector<double> bond_equil_value;
-  std::vector<double> angle_force_constant;
-  std::vector<double> angle_equil_value;
-  std::vector<double> dihedral_force_constant;
-  std::vector<double> dihedral_periodicity;
-  std::vector<double> dihedral_phase;
-  std::vector<double> scee_scale_factor;
-  std::vector<double> scnb_scale_factor;
-  std::vector<double> solty;
-  std::vector<double> lennard_jones_acoeff;
-  std::vector<double> lennard_jones_bcoeff;
-
-  std::vector<int> bond_i;
-  std::vector<int> bond_j;
-  std::vector<int> bond_type;
-  std::vector<int> angle_i;
-  std::vector<int> angle_j;
-  std::vector<int> angle_k;
-  std::vector<int> angle_type;
-  std::vector<int> dihedral_i;
-  std::vector<int> dihedral_j;
-  std::vector<int> dihedral_k;
-  std::vector<int> dihedral_l;
-  std::vector<int> dihedral_type;
-  std::vector<std::uint8_t> dihedral_flags;
-
-  std::vector<double> hbond_acoeff;
-  std::vector<double> hbond_bcoeff;
+  std::pmr::vector<PackedName> atom_name{resource};
+  std::pmr::vector<double> charge{resource};
+  std::pmr::vector<int> atomic_number{resource};
+  std::pmr::vector<double> mass{resource};
+  std::pmr::vector<int> atom_type_index{resource};
+  std::pmr::vector<int> number_excluded_atoms{resource};
+  std::pmr::vector<int> excluded_atoms_list{resource};
+  std::pmr::vector<int> nonbonded_parm_index{resource};
+  InternedNames residue_label{resource};
+  std::pmr::vector<int> residue_pointer{resource};
+
+  std::pmr::vector<double> bond_force_constant{resource};
+  std::pmr::vector<double> bond_equil_value{resource};
+  std::pmr::vector<double> angle_force_constant{resource};
+  std::pmr::vector<double> angle_equil_value{resource};
+  std::pmr::vector<double> dihedral_force_constant{resource};
+  std::pmr::vector<double> dihedral_periodicity{resource};
+  std::pmr::vector<double> dihedral_phase{resource};
+  std::pmr::vector<double> scee_scale_factor{resource};
+  std::pmr::vector<double> scnb_scale_factor{resource};
+  std::pmr::vector<double> solty{resource};
+  std::pmr::vector<double> lennard_jones_acoeff{resource};
+  std::pmr::vector<double> lennard_jones_bcoeff{resource};
+
+  std::pmr::vector<int> bond_i{resource};
+  std::pmr::vector<int> bond_j{resource};
+  std::pmr::vector<int> bond_type{resource};
+  std::pmr::vector<int> angle_i{resource};
+  std::pmr::vector<int> angle_j{resource};
+  std::pmr::vector<int> angle_k{resource};
+  std::pmr::vector<int> angle_type{resource};
+  std::pmr::vector<int> dihedral_i{resource};
+  std::pmr::vector<int> dihedral_j{resource};
+  std::pmr::vector<int> dihedral_k{resource};
+  std::pmr::vector<int> dihedral_l{resource};
+  std::pmr::vector<int> dihedral_type{resource};
+  std::pmr::vector<std::uint8_t> dihedral_flags{resource};
+
+  std::pmr::vector<double> hbond_acoeff{resource};
+  std::pmr::vector<double> hbond_bcoeff{resource};
   std::optional<double> hbond_cut;
 
-  std::vector<std::string> amber_atom_type;
-  std::vector<std::string> tree_chain_classification;
-  std::vector<int> join_array;
-  std::vector<int> irotat;
+  InternedNames amber_atom_type{resource};
+  std::pmr::vector<PackedName> tree_chain_classification{resource};
+  std::pmr::vector<int> join_array{resource};
+  std::pmr::vector<int> irotat{resource};
 
   std::optional<std::array<int, 3>> solvent_pointers;
-  std::vector<int> atoms_per_molecule;
+  std::pmr::vector<int> atoms_per_molecule{resource};
   std::optional<std::array<double, 4>> box_dimensions;
 
   std::string radius_set;
-  std::vector<double> radii;
-  std::vector<double> screen;
+  std::pmr::vector<double> radii{resource};
+  std::pmr::vector<double> screen{resource};
   std::optional<int> ipol;
+
+  // Sections decoded so far; POINTERS is always among them.
+  Parm7SectionMask loaded_sections = 0;
+  // %FLAG blocks that were present but skipped, as byte ranges (from the %FLAG
+  // line to the next header) in the parsed buffer; see load_parm7_sections.
+  std::vector<Parm7DeferredSection> deferred_sections;
+};
+
+struct Parm7ParseOptions {
+  // Worker threads used to decode independent %FLAG sections (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Sections to decode. Others are only located, without tokenizing, and are
+  // recorded in Parm7Topology::deferred_sections. POINTERS is always decoded,
+  // and the H / non-H halves of bonds, angles and dihedrals load together.
+  Parm7SectionMask sections = kAllParm7Sections;
+  // Upstream for the topology arrays (nullptr = std::pmr::get_default_resource()).
+  // Storage is reserved from the calling thread before sections decode in
+  // parallel, so the resource does not need to be thread-safe.
+  std::pmr::memory_resource *resource = nullptr;
+  // Carves the arrays out of one monotonic arena, sized with parm7_storage_bytes
+  // and owned by the topology: a parse is a single upstream allocation, and
+  // destroying the topology releases it in one step.
+  bool use_arena = false;
 };
 
-[[nodiscard]] Parm7Topology parse_parm7_file(const std::filesystem::path &path);
+// Bytes of array storage that decoding `sections` needs, computed from POINTERS
+// alone. To size a caller-owned arena, parse with only the POINTERS bit set first.
+[[nodiscard]] std::size_t parm7_storage_bytes(const Parm7Pointers &pointers,
+  Parm7SectionMask sections = kAllParm7Sections);
+
+// An empty topology whose arrays allocate as `options.resource` and
+// `options.use_arena` ask, with an arena sized for `options.sections`.
+[[nodiscard]] Parm7Topology make_parm7_topology(const Parm7Pointers &pointers, const Parm7ParseOptions &options = {});
+
+// Runs the size checks every parse applies to `sections` of a topology built
+// some other way: each array must have the length POINTERS declares. Throws
+// std::runtime_error on the first mismatch.
+void validate_parm7_sections(const Parm7Topology &topo, Parm7SectionMask sections = kAllParm7Sections);
+
+// Memory-maps the file and parses it in place; no per-line copies are made.
+[[nodiscard]] Parm7Topology parse_parm7_file(const std::filesystem::path &path,
+  const Parm7ParseOptions &options = {});
+
+// Parses a parm7/prmtop image that is already in memory (e.g. from a cache or an archive).
+[[nodiscard]] Parm7Topology parse_parm7_buffer(std::span<const char> buffer, const Parm7ParseOptions &options = {});
+
+// Decodes deferred sections selected by `sections` into `topo`, validating them
+// as a full parse would. `buffer` must hold the bytes `topo` was parsed from.
+void load_parm7_sections(Parm7Topology &topo, std::span<const char> buffer, Parm7SectionMask sections,
+  const Parm7ParseOptions &options = {});
+
+// Same as above, re-mapping the file the topology was parsed from.
+void load_parm7_file_sections(Parm7Topology &topo, const std::filesystem::path &path, Parm7SectionMask sections,
+  const Parm7ParseOptions &options = {});
 
 } // namespace rms
 
@@ -0,0 +1,77 @@
+#ifndef RMS_RESIDUES_HPP
+#define RMS_RESIDUES_HPP
+
+#include "parsers.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+// Half-open atom range [begin, end).
+struct AtomRange {
+  int begin = 0;
+  int end = 0;
+
+  [[nodiscard]] std::size_t size() const noexcept { return static_cast<std::size_t>(end - begin); }
+  [[nodiscard]] bool contains(int atom) const noexcept { return atom >= begin && atom < end; }
+};
+
+// RESIDUE_POINTER kept as a range table: residue r owns atoms
+// [starts[r], starts[r + 1]), with starts[nres] = NATOM. Atom -> residue is a
+// branchless binary search over the table, residue -> atoms is two loads, and
+// nothing per atom is stored unless build_atom_map is called.
+class ResidueIndex
+{
+public:
+  ResidueIndex() = default;
+  // Throws std::runtime_error if RESIDUE_POINTER is not loaded, does not start
+  // at atom 0, decreases, or points past NATOM.
+  explicit ResidueIndex(const Parm7Topology &topo);
+
+  [[nodiscard]] std::size_t residue_count() const noexcept { return starts_.empty() ? 0 : starts_.size() - 1; }
+  [[nodiscard]] std::size_t atom_count() const noexcept {
+    return starts_.empty() ? 0 : static_cast<std::size_t>(starts_.back());
+  }
+
+  // First atom of every residue, then NATOM.
+  [[nodiscard]] std::span<const int> starts() const noexcept { return starts_; }
+
+  // Unchecked; `residue` must be in [0, residue_count()).
+  [[nodiscard]] AtomRange atoms_of(int residue) const noexcept {
+    auto const idx = static_cast<std::size_t>(residue);
+    return {starts_[idx], starts_[idx + 1]};
+  }
+
+  // Unchecked; `atom` must be in [0, atom_count()). Empty residues are never returned.
+  [[nodiscard]] int residue_of(int atom) const noexcept {
+    int const *base = starts_.data();
+    std::size_t count = residue_count();
+    while (count > 1) {
+      std::size_t const half = count / 2;
+      base = base[half] <= atom ? base + half : base;
+      count -= half;
+    }
+    return static_cast<int>(base - starts_.data());
+  }
+
+  // Calls fn(residue, AtomRange) for every residue, in order.
+  template <typename F>
+  void for_each_residue(F &&fn) const {
+    for (std::size_t residue = 0; residue < residue_count(); ++residue) {
+      fn(static_cast<int>(residue), AtomRange{starts_[residue], starts_[residue + 1]});
+    }
+  }
+
+  // Per-atom residue ids, filled residue by residue on up to `threads` workers
+  // (0 = all hardware threads). Only for callers that really need NATOM entries.
+  [[nodiscard]] std::vector<int> build_atom_map(std::size_t threads = 0) const;
+
+private:
+  std::vector<int> starts_;
+};
+
+} // namespace rms
+
+#endif // RMS_RESIDUES_HPP
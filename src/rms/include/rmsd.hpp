@@ -0,0 +1,112 @@
+#ifndef RMS_RMSD_HPP
+#define RMS_RMSD_HPP
+
+#include "aligned.hpp"
+#include "coordinates.hpp"
+#include "parsers.hpp"
+#include "simd.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
+
+namespace rms {
+
+// Weighted sums over the atom pairs of a frame `a` and a centred reference `b`:
+// the frame's first and second moments and the covariance, row-major with
+// ab[3 * i + j] = sum w a_i b_j. The frame enters shifted by `origin`, its
+// centroid from a first pass, so the centring correction cancels nothing
+// for structures far from the coordinate origin.
+struct RmsdSums {
+  std::array<double, 3> origin{};
+  std::array<double, 3> a{};
+  double aa = 0.0;
+  std::array<double, 9> ab{};
+};
+
+// A frame's superposition onto a reference: x' = rotation (x - centroid) +
+// the reference centroid, with `rotation` row-major.
+struct RmsdFit {
+  double rmsd = 0.0;
+  std::array<double, 9> rotation{1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  std::array<double, 3> centroid{};
+};
+
+// RMSD after optimal superposition, by the quaternion characteristic
+// polynomial method (Theobald 2005; Liu, Agrafiotis and Theobald 2010): Newton
+// iterations for the largest eigenvalue of the 4x4 key matrix, started from
+// (inner_a + inner_b) / 2. `covariance` is sum w a_i b_j over centred
+// coordinates and the inner products are sum w |a|^2 and sum w |b|^2. If
+// `rotation` is set it receives the row-major matrix R with R a ~ b.
+[[nodiscard]] double qcp_rmsd(const std::array<double, 9> &covariance, double inner_a, double inner_b,
+  double total_weight, std::array<double, 9> *rotation = nullptr) noexcept;
+
+// Atoms that packed frames are padded to: one cache line of floats per
+// component, and whole vectors for every kernel tier.
+constexpr std::size_t kPackedFrameAlign = 16;
+
+// Covariance sum a_i b_j of two frames packed as [x | y | z] float blocks of
+// `stride` values each (a multiple of kPackedFrameAlign, zero-padded), already
+// centred. `level` must not exceed detected_simd_level().
+[[nodiscard]] std::array<double, 9> packed_covariance(float const *a, float const *b, std::size_t stride,
+  SimdLevel level) noexcept;
+
+// A reference structure, centred once, against which frames are superposed.
+// The per-frame work is one pass over both structures (13 running sums, with
+// AVX2 / AVX-512 kernels picked at runtime) followed by the O(1) QCP solve.
+template <typename T>
+class BasicRmsdReference
+{
+public:
+  // `weights` is empty for plain RMSD, or one weight per atom. `level` pins
+  // the kernel tier (clamped to what the CPU supports) for tests and benchmarks.
+  explicit BasicRmsdReference(const BasicCoordinates<T> &reference, std::span<const double> weights = {},
+    SimdLevel level = detected_simd_level());
+
+  // Mass-weighted RMSD, with the weights taken from `topo.mass`.
+  BasicRmsdReference(const BasicCoordinates<T> &reference, const Parm7Topology &topo,
+    SimdLevel level = detected_simd_level());
+
+  [[nodiscard]] std::size_t size() const noexcept { return centred_.size(); }
+  [[nodiscard]] bool weighted() const noexcept { return !weights_.empty(); }
+  [[nodiscard]] SimdLevel level() const noexcept { return level_; }
+  // Weighted centroid the reference was moved from.
+  [[nodiscard]] const std::array<double, 3> &centroid() const noexcept { return centroid_; }
+
+  // RMSD of `frame` after optimal superposition onto the reference. Throws
+  // std::invalid_argument unless the frame has one entry per reference atom.
+  [[nodiscard]] double rmsd(const BasicCoordinates<T> &frame) const;
+
+  // As above; `rotation` receives R (row-major) with R (a - centroid(a)) ~ (b - centroid()).
+  [[nodiscard]] double rmsd(const BasicCoordinates<T> &frame, std::array<double, 9> &rotation) const;
+
+  // RMSD, rotation and the frame's weighted centroid, for superpose().
+  [[nodiscard]] RmsdFit fit(const BasicCoordinates<T> &frame) const;
+
+  // Moves `frame` onto the reference in place, by a fit computed for it.
+  void superpose(BasicCoordinates<T> &frame, const RmsdFit &fit) const;
+
+  // The per-frame sums alone.
+  [[nodiscard]] RmsdSums sums(const BasicCoordinates<T> &frame) const;
+
+private:
+  BasicCoordinates<T> centred_;
+  AlignedVector<T> weights_;
+  SimdLevel level_;
+  std::array<double, 3> centroid_{};
+  // Sum of the weights, sum w b over the stored (rounded) reference, and the
+  // reference's centred inner product.
+  double total_weight_ = 0.0;
+  std::array<double, 3> residual_{};
+  double inner_ = 0.0;
+};
+
+using RmsdReference = BasicRmsdReference<double>;
+using RmsdReferenceF = BasicRmsdReference<float>;
+
+extern template class BasicRmsdReference<double>;
+extern template class BasicRmsdReference<float>;
+
+} // namespace rms
+
+#endif // RMS_RMSD_HPP
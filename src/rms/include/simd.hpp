@@ -0,0 +1,62 @@
+#ifndef RMS_SIMD_HPP
+#define RMS_SIMD_HPP
+
+#include <string_view>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RMS_X86_DISPATCH 1
+#define RMS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RMS_X86_DISPATCH 0
+#define RMS_TARGET(isa)
+#endif
+
+namespace rms {
+
+// Instruction-set tiers used by the runtime-dispatched kernels, lowest first.
+enum class SimdLevel {
+  Scalar,
+  Sse42,
+  Avx2,
+  Avx512
+};
+
+// Highest tier supported by the running CPU (detected once).
+[[nodiscard]] inline SimdLevel detected_simd_level() noexcept {
+#if RMS_X86_DISPATCH
+  static SimdLevel const level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vl")) {
+      return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return SimdLevel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return SimdLevel::Sse42;
+    }
+    return SimdLevel::Scalar;
+  }();
+  return level;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+[[nodiscard]] constexpr std::string_view simd_level_name(SimdLevel level) noexcept {
+  switch (level) {
+    case SimdLevel::Sse42:
+      return "sse4.2";
+    case SimdLevel::Avx2:
+      return "avx2";
+    case SimdLevel::Avx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+} // namespace rms
+
+#endif // RMS_SIMD_HPP
@@ -0,0 +1,38 @@
+#ifndef RMS_SYNTHETIC_HPP
+#define RMS_SYNTHETIC_HPP
+
+#include "coordinates.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace rms {
+
+// Shape of a generated test system: a linear solute chain followed by
+// three-site waters in a periodic box.
+struct SyntheticSystem {
+  std::size_t solute_atoms = 64;
+  std::size_t waters = 0;
+};
+
+// Smallest system with the default solute and at least `natom` atoms.
+[[nodiscard]] SyntheticSystem synthetic_system_for_atoms(std::size_t natom);
+
+// Writes a complete, self-consistent parm7 file for `system`. Used to test and
+// benchmark the parser at sizes beyond the bundled topologies.
+[[nodiscard]] std::string make_synthetic_parm7(const SyntheticSystem &system);
+
+// Edge of the cubic box: waters on a simple cubic lattice at liquid density.
+[[nodiscard]] double synthetic_box_edge(const SyntheticSystem &system);
+
+// Restart matching make_synthetic_parm7(system): the solute zig-zags across the
+// z = 0 face, each water sits in its own lattice cell, and the box is cubic.
+// Velocities, when asked for, are small deterministic values.
+[[nodiscard]] Rst7 make_synthetic_coordinates(const SyntheticSystem &system, bool with_velocities = false);
+
+// make_synthetic_coordinates written out as rst7 text.
+[[nodiscard]] std::string make_synthetic_rst7(const SyntheticSystem &system, bool with_velocities = false);
+
+} // namespace rms
+
+#endif // RMS_SYNTHETIC_HPP
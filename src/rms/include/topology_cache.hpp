@@ -0,0 +1,94 @@
+#ifndef RMS_TOPOLOGY_CACHE_HPP
+#define RMS_TOPOLOGY_CACHE_HPP
+
+#include "mapped_file.hpp"
+#include "parsers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rms {
+
+// Bumped whenever the on-disk layout changes; older caches are rebuilt.
+constexpr std::uint32_t kTopologyCacheVersion = 2;
+
+// Identifies the parm7 file a cache was built from. The hash covers the first
+// and last 64 KiB, which catches rewrites that keep size and mtime.
+struct TopologyCacheKey {
+  std::uint64_t size = 0;
+  std::int64_t mtime_ns = 0;
+  std::uint64_t hash = 0;
+
+  friend bool operator==(const TopologyCacheKey &, const TopologyCacheKey &) = default;
+};
+
+[[nodiscard]] TopologyCacheKey topology_cache_key(const std::filesystem::path &parm7_path);
+
+// Cache file used for `parm7_path`: "<parm7_path>.rmscache".
+[[nodiscard]] std::filesystem::path topology_cache_path(const std::filesystem::path &parm7_path);
+
+// Serializes a fully loaded topology: a versioned header, then every array at a
+// 64-byte aligned offset. Names are stored as PackedName arrays, interned names
+// as their table plus ids, and the few free-form strings as an offset table
+// plus a character blob. The file is written to a temporary name and renamed
+// into place, so concurrent readers never see a partial cache.
+void write_topology_cache(const std::filesystem::path &cache_path, const Parm7Topology &topo,
+  const TopologyCacheKey &key);
+
+// Zero-copy view over a memory-mapped cache file. Arrays are spans into the
+// mapping and stay valid for the lifetime of the view. The constructor throws
+// std::runtime_error on a missing, truncated, foreign or out-of-date file.
+class TopologyCacheView
+{
+public:
+  explicit TopologyCacheView(const std::filesystem::path &cache_path);
+
+  [[nodiscard]] const TopologyCacheKey &key() const noexcept { return key_; }
+  [[nodiscard]] const Parm7Pointers &pointers() const noexcept { return pointers_; }
+
+  [[nodiscard]] std::span<const int> array(std::pmr::vector<int> Parm7Topology::*member) const;
+  [[nodiscard]] std::span<const double> array(std::pmr::vector<double> Parm7Topology::*member) const;
+  [[nodiscard]] std::span<const std::uint8_t> array(std::pmr::vector<std::uint8_t> Parm7Topology::*member) const;
+
+  [[nodiscard]] std::span<const PackedName> array(std::pmr::vector<PackedName> Parm7Topology::*member) const;
+  [[nodiscard]] std::span<const PackedName> name_table(InternedNames Parm7Topology::*member) const;
+  [[nodiscard]] std::span<const std::uint32_t> name_ids(InternedNames Parm7Topology::*member) const;
+
+  // Copies the cached data into an owning topology, allocated as
+  // `options.resource` and `options.use_arena` ask (see make_parm7_topology).
+  // Throws std::runtime_error if an array's length does not match POINTERS,
+  // as parsing the text would.
+  [[nodiscard]] Parm7Topology to_topology(const Parm7ParseOptions &options = {}) const;
+
+private:
+  struct Slot {
+    std::uint64_t offset = 0;
+    std::uint64_t count = 0;
+  };
+
+  template <typename T>
+  [[nodiscard]] std::span<const T> slot_data(std::size_t slot) const;
+  [[nodiscard]] std::string_view scalar_string(std::size_t idx) const;
+
+  std::filesystem::path path_;
+  MappedFile file_;
+  TopologyCacheKey key_;
+  Parm7Pointers pointers_;
+  std::vector<Slot> slots_;
+};
+
+// Loads `parm7_path` through its cache: reuses a cache whose key matches the
+// file, otherwise parses the text and rewrites the cache (best effort; an
+// unwritable directory only costs the reuse). Always returns a fully loaded
+// topology, whatever `options.sections` says.
+[[nodiscard]] Parm7Topology load_parm7_cached(const std::filesystem::path &parm7_path,
+  const Parm7ParseOptions &options = {});
+
+} // namespace rms
+
+#endif // RMS_TOPOLOGY_CACHE_HPP
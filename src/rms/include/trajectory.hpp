@@ -0,0 +1,125 @@
+#ifndef RMS_TRAJECTORY_HPP
+#define RMS_TRAJECTORY_HPP
+
+#include "coordinates.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "parsers.hpp"
+#include "topology_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rms {
+
+// Bumped whenever the sidecar layout changes; older indexes are rebuilt.
+constexpr std::uint32_t kMdcrdIndexVersion = 1;
+
+// One decoded trajectory frame. The box is the a, b, c line some frames carry.
+struct MdcrdFrame {
+  Coordinates positions;
+  std::optional<std::array<double, 3>> box;
+};
+
+struct MdcrdOptions {
+  // Worker threads used to build the frame index (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Reuse and write the "<path>.rmsidx" sidecar. Writing is best effort.
+  bool use_index_file = true;
+};
+
+// Amber ASCII trajectory (mdcrd / crd): a title line, then per frame 3 * NATOM
+// values as 10F8.3 lines and an optional 3F8.3 box line. The file is mapped
+// once and indexed by frame start offsets, so frames are independent byte
+// ranges: any one decodes by random access, and ranges decode in parallel.
+// A partial frame at the end (a run still writing) is not counted.
+class MdcrdTrajectory
+{
+public:
+  // NATOM comes from `topo.pointers`. The index is read from the sidecar when
+  // its key matches the file, otherwise built in one parallel newline scan and
+  // written back. Throws std::runtime_error on an unreadable or malformed file.
+  MdcrdTrajectory(const std::filesystem::path &path, const Parm7Topology &topo, const MdcrdOptions &options = {});
+
+  [[nodiscard]] std::size_t natom() const noexcept { return natom_; }
+  [[nodiscard]] std::size_t frame_count() const noexcept { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+  [[nodiscard]] bool has_box() const noexcept { return has_box_; }
+  [[nodiscard]] const std::string &title() const noexcept { return title_; }
+  // Byte offset of every frame start, then the end of the last complete frame.
+  [[nodiscard]] std::span<const std::uint64_t> offsets() const noexcept { return offsets_; }
+  // Whether the index came from the sidecar rather than a scan.
+  [[nodiscard]] bool index_reused() const noexcept { return index_reused_; }
+
+  // Decodes `frame` into `out`, reusing its storage. Safe to call concurrently.
+  void read_frame(std::size_t frame, MdcrdFrame &out) const;
+  [[nodiscard]] MdcrdFrame frame(std::size_t frame) const;
+
+  // Calls fn(index, frame) for frames [first, last) in order, through one buffer.
+  template <typename F>
+  void for_each_frame(std::size_t first, std::size_t last, F &&fn) const {
+    check_range(first, last);
+    MdcrdFrame buffer;
+    for (auto idx = first; idx < last; ++idx) {
+      read_frame(idx, buffer);
+      fn(idx, static_cast<const MdcrdFrame &>(buffer));
+    }
+  }
+
+  // Decodes frames [first, last) on up to `threads` workers, each reusing a
+  // buffer for a block of consecutive frames. fn(index, frame) runs
+  // concurrently and in no particular order.
+  template <typename F>
+  void for_each_frame_parallel(std::size_t first, std::size_t last, std::size_t threads, F &&fn) const {
+    check_range(first, last);
+    auto const count = last - first;
+    auto const block = std::max<std::size_t>(1, count / (resolve_thread_count(threads) * 8));
+    parallel_for((count + block - 1) / block, threads, [&](std::size_t task) {
+      MdcrdFrame buffer;
+      auto const end = std::min(last, first + (task + 1) * block);
+      for (auto idx = first + task * block; idx < end; ++idx) {
+        read_frame(idx, buffer);
+        fn(idx, static_cast<const MdcrdFrame &>(buffer));
+      }
+    });
+  }
+
+private:
+  void check_range(std::size_t first, std::size_t last) const {
+    if (first > last || last > frame_count()) {
+      throw std::out_of_range("Trajectory frame range out of bounds");
+    }
+  }
+  void build_index(std::size_t threads);
+  [[nodiscard]] bool load_index(const std::filesystem::path &index_path, const TopologyCacheKey &key);
+  void write_index(const std::filesystem::path &index_path, const TopologyCacheKey &key) const;
+
+  std::filesystem::path path_;
+  MappedFile file_;
+  std::string title_;
+  std::size_t natom_ = 0;
+  // 10F8.3 lines per frame; the box line, if any, follows them.
+  std::size_t coordinate_lines_ = 0;
+  bool has_box_ = false;
+  std::vector<std::uint64_t> offsets_;
+  bool index_reused_ = false;
+};
+
+// Sidecar index used for `mdcrd_path`: "<mdcrd_path>.rmsidx".
+[[nodiscard]] std::filesystem::path mdcrd_index_path(const std::filesystem::path &mdcrd_path);
+
+// Appends `frame` as Amber writes it: 10F8.3 coordinate lines, then a 3F8.3
+// box line if the frame carries one. A trajectory is a title line followed by
+// its frames.
+void append_mdcrd_frame(std::string &out, const MdcrdFrame &frame);
+
+} // namespace rms
+
+#endif // RMS_TRAJECTORY_HPP
@@ -0,0 +1,51 @@
+#ifndef RMS_TRAJECTORY_RMSD_HPP
+#define RMS_TRAJECTORY_RMSD_HPP
+
+#include "rmsd.hpp"
+#include "trajectory.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace rms {
+
+struct TrajectoryRmsdOptions {
+  // Worker threads (0 = all hardware threads).
+  std::size_t threads = 0;
+  // Keep each frame's rotation and centroid, for write_fitted_mdcrd.
+  bool keep_fits = false;
+  // Atoms to fit on (e.g. AtomSelection::indices()); empty fits every atom.
+  std::span<const int> atoms{};
+};
+
+// Per-frame results, indexed by frame.
+struct TrajectoryRmsd {
+  std::vector<double> rmsd;
+  // Empty unless TrajectoryRmsdOptions::keep_fits.
+  std::vector<RmsdFit> fits;
+};
+
+// RMSD of every frame of `trajectory` against `reference` after optimal
+// superposition. Frames are decoded and fitted on a work-stealing pool
+// (parallel_for_stealing): each worker walks its own run of adjacent frames
+// through one reused buffer, and results land in frame order. With
+// options.atoms, only those atoms are gathered and fitted. Throws
+// std::invalid_argument unless the reference has one atom per fitted atom.
+[[nodiscard]] TrajectoryRmsd trajectory_rmsd(const MdcrdTrajectory &trajectory, const RmsdReference &reference,
+  const TrajectoryRmsdOptions &options = {});
+
+// Writes `trajectory` with every frame superposed onto `reference` by `fits`
+// (from trajectory_rmsd with keep_fits), as an Amber ASCII trajectory under
+// the source title. Whole frames are moved, even when `atoms` (the fitted
+// atoms) is a subset. Frames are decoded again and formatted in parallel
+// blocks, then written in order. Throws std::runtime_error if `out` cannot be
+// written.
+void write_fitted_mdcrd(const std::filesystem::path &out, const MdcrdTrajectory &trajectory,
+  const RmsdReference &reference, std::span<const RmsdFit> fits, std::size_t threads = 0,
+  std::span<const int> atoms = {});
+
+} // namespace rms
+
+#endif // RMS_TRAJECTORY_RMSD_HPP
@@ -1,12 +1,10 @@
 #ifndef RMS_UTILS_HPP
 #define RMS_UTILS_HPP
 
-#include <algorithm>
+#include "fixed_width.hpp"
+
 #include <charconv>
-#include <cctype>
-#include <cstdlib>
 #include <optional>
-#include <string>
 #include <string_view>
 
 namespace rms {
@@ -47,25 +45,7 @@ namespace rms {
 }
 
 [[nodiscard]] inline std::optional<double> to_double(std::string_view sv) {
-  auto const trimmed = trim(sv);
-  if (trimmed.empty()) {
-    return std::nullopt;
-  }
-
-  // Handle Fortran-style D exponents by copying into a temporary string.
-  std::string tmp(trimmed);
-  for (char &ch : tmp) {
-    if (ch == 'D' || ch == 'd') {
-      ch = 'E';
-    }
-  }
-
-  char *end = nullptr;
-  double const value = std::strtod(tmp.c_str(), &end);
-  if (end != tmp.c_str()) {
-    return value;
-  }
-  return std::nullopt;
+  return parse_fortran_double(sv);
 }
 
 template <typename F>
@@ -1,15 +1,52 @@
 #include "include/cli.hpp"
+#include "include/coordinates.hpp"
 #include "include/forcefield.hpp"
+#include "include/mask.hpp"
+#include "include/pairwise.hpp"
 #include "include/parsers.hpp"
+#include "include/residues.hpp"
+#include "include/rmsd.hpp"
+#include "include/topology_cache.hpp"
+#include "include/trajectory.hpp"
+#include "include/trajectory_rmsd.hpp"
 
 #include <internal_use_only/config.hpp>
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace {
+// The atoms a subcommand's --mask picks (all of them without one), and their
+// masses when the RMSD is mass-weighted.
+struct MaskedAtoms {
+  rms::AtomSelection selection;
+  std::vector<double> weights;
+};
+
+[[nodiscard]] MaskedAtoms select_atoms(const rms::Parm7Topology &topo, const std::string &mask, bool mass_weighted) {
+  if (mass_weighted && topo.mass.empty()) {
+    throw std::runtime_error("Topology has no MASS section for a mass-weighted RMSD");
+  }
+  MaskedAtoms out;
+  out.selection = mask.empty() ? rms::AtomSelection::all(static_cast<std::size_t>(topo.pointers.natom))
+                               : rms::compile_mask(mask, topo);
+  if (out.selection.empty()) {
+    throw std::runtime_error(fmt::format("Mask '{}' selects no atoms", mask));
+  }
+  if (mass_weighted) {
+    out.weights = out.selection.gather(std::span<const double>(topo.mass));
+  }
+  return out;
+}
+
 [[nodiscard]] bool has_flag(int argc, char const *const argv[], std::string_view flag) {
   for (int i = 1; i < argc; ++i) {
     if (flag == argv[i]) {
@@ -18,6 +55,52 @@ namespace {
   }
   return false;
 }
+
+// `rms rmsd`: one "frame rmsd" row per trajectory frame, 1-based as in cpptraj.
+void run_rmsd(const rms::CliOptions &options, const rms::Parm7Topology &topo) {
+  auto const &rmsd = *options.rmsd;
+  rms::Rst7ParseOptions const rst7_options{.threads = options.threads};
+  auto const reference = rms::parse_rst7_file(rmsd.reference_path, topo, rst7_options);
+  rms::MdcrdTrajectory const trajectory(rmsd.trajectory_path, topo, rms::MdcrdOptions{.threads = options.threads});
+  auto const atoms = select_atoms(topo, rmsd.mask, rmsd.mass_weighted);
+  auto const indices = rmsd.mask.empty() ? std::span<const int>{} : atoms.selection.indices();
+  rms::RmsdReference const fit(rms::gather(reference.positions, atoms.selection.indices()), atoms.weights);
+
+  rms::TrajectoryRmsdOptions const rmsd_options{
+    .threads = options.threads, .keep_fits = !rmsd.fitted_path.empty(), .atoms = indices};
+  auto const result = rms::trajectory_rmsd(trajectory, fit, rmsd_options);
+
+  std::string table = "#Frame       RMSD\n";
+  for (std::size_t frame = 0; frame < result.rmsd.size(); ++frame) {
+    table += fmt::format("{:>6} {:>10.4f}\n", frame + 1, result.rmsd[frame]);
+  }
+  if (rmsd.output_path.empty()) {
+    fmt::print("{}", table);
+  } else {
+    std::ofstream file(rmsd.output_path, std::ios::binary | std::ios::trunc);
+    file << table;
+    file.close();
+    if (!file) {
+      throw std::runtime_error(fmt::format("Failed to write RMSD table: {}", rmsd.output_path.string()));
+    }
+  }
+  if (!rmsd.fitted_path.empty()) {
+    rms::write_fitted_mdcrd(rmsd.fitted_path, trajectory, fit, result.fits, options.threads, indices);
+  }
+}
+
+// `rms pairwise`: the all-vs-all matrix, then a one-line summary.
+void run_pairwise(const rms::CliOptions &options, const rms::Parm7Topology &topo) {
+  auto const &pairwise = *options.pairwise;
+  rms::MdcrdTrajectory const trajectory(pairwise.trajectory_path, topo, rms::MdcrdOptions{.threads = options.threads});
+  auto const atoms = select_atoms(topo, pairwise.mask, pairwise.mass_weighted);
+  auto const indices = pairwise.mask.empty() ? std::span<const int>{} : atoms.selection.indices();
+  rms::PackedFrames const frames(trajectory, atoms.weights, options.threads, indices);
+  rms::write_pairwise_rmsd(pairwise.matrix_path, frames,
+    rms::PairwiseRmsdOptions{.threads = options.threads, .block_frames = pairwise.block_frames});
+  fmt::println("Wrote {} x {} RMSD matrix ({} bytes): {}", frames.frame_count(), frames.frame_count(),
+    std::filesystem::file_size(pairwise.matrix_path), pairwise.matrix_path.string());
+}
 } // namespace
 
 int main(int argc, char const *const argv[]) {
@@ -36,7 +119,17 @@ int main(int argc, char const *const argv[]) {
   }
 
   try {
-    auto topo = rms::parse_parm7_file(options->parm7_path);
+    rms::Parm7ParseOptions const parse_options{.threads = options->threads};
+    auto topo = options->use_cache ? rms::load_parm7_cached(options->parm7_path, parse_options)
+                                   : rms::parse_parm7_file(options->parm7_path, parse_options);
+    if (options->rmsd) {
+      run_rmsd(*options, topo);
+      return 0;
+    }
+    if (options->pairwise) {
+      run_pairwise(*options, topo);
+      return 0;
+    }
 
     double const total_mass = std::accumulate(topo.mass.begin(), topo.mass.end(), 0.0);
     double const total_charge = std::accumulate(topo.charge.begin(), topo.charge.end(), 0.0);
@@ -78,19 +171,21 @@ int main(int argc, char const *const argv[]) {
 
     if (options->sample_count > 0) {
       std::size_t const sample_count = std::min<std::size_t>(options->sample_count, topo.atom_name.size());
-      auto const atom_to_res = rms::build_atom_residue_map(topo);
+      rms::ResidueIndex const residues(topo);
 
       fmt::println("Sample atoms (first {}):", sample_count);
       for (std::size_t atom = 0; atom < sample_count; ++atom) {
-        int const res = atom_to_res[atom];
+        int const res = atom < residues.atom_count() ? residues.residue_of(static_cast<int>(atom)) : -1;
+        rms::PackedName res_name;
         std::string_view res_label = "<none>";
         int res_index = 0;
         if (res >= 0 && static_cast<std::size_t>(res) < topo.residue_label.size()) {
-          res_label = topo.residue_label[static_cast<std::size_t>(res)];
+          res_name = topo.residue_label[static_cast<std::size_t>(res)];
+          res_label = res_name.view();
           res_index = res + 1;
         }
 
-        auto const name = topo.atom_name[atom];
+        auto const name = topo.atom_name[atom].view();
         auto const amber_type = topo.amber_atom_type[atom];
         int const lj_type = topo.atom_type_index[atom];
 
@@ -99,7 +194,7 @@ int main(int argc, char const *const argv[]) {
 
         fmt::println("Atom {:>6} {:<4} res {:<4} {}", atom + 1, name, res_label, res_index);
         fmt::println("  Z={} mass={:.6f} charge={:.6f} amber_type={}", topo.atomic_number[atom], topo.mass[atom],
-          topo.charge[atom], amber_type);
+          topo.charge[atom], amber_type.view());
         if (lj_type >= 0) {
           if (lj_idx && lj_coeffs) {
             fmt::println("  LJ type={} index={} A={:.6f} B={:.6f}", lj_type + 1, *lj_idx + 1, lj_coeffs->first,
@@ -0,0 +1,165 @@
+#include "include/mapped_file.hpp"
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RMS_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define RMS_HAS_MMAP 0
+#endif
+
+namespace rms {
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+#if RMS_HAS_MMAP
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(fmt::format("Failed to open file: {}", path.string()));
+  }
+
+  struct stat info {};
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error(fmt::format("Failed to stat file: {}", path.string()));
+  }
+
+  size_ = static_cast<std::size_t>(info.st_size);
+  if (size_ > 0) {
+    void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      throw std::runtime_error(fmt::format("Failed to map file: {}", path.string()));
+    }
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<char const *>(addr);
+    mapped_ = true;
+  }
+  ::close(fd);
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error(fmt::format("Failed to open file: {}", path.string()));
+  }
+  auto const end = file.tellg();
+  file.seekg(0);
+  fallback_.resize(static_cast<std::size_t>(end));
+  if (!fallback_.empty() && !file.read(fallback_.data(), static_cast<std::streamsize>(fallback_.size()))) {
+    throw std::runtime_error(fmt::format("Failed to read file: {}", path.string()));
+  }
+  data_ = fallback_.data();
+  size_ = fallback_.size();
+#endif
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+  : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+    mapped_(std::exchange(other.mapped_, false)), fallback_(std::move(other.fallback_)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapped_ = std::exchange(other.mapped_, false);
+    fallback_ = std::move(other.fallback_);
+  }
+  return *this;
+}
+
+void MappedFile::release() noexcept {
+#if RMS_HAS_MMAP
+  if (mapped_ && data_ != nullptr) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  fallback_.clear();
+}
+
+MappedOutputFile::MappedOutputFile(const std::filesystem::path &path, std::size_t size) : path_(path), size_(size) {
+#if RMS_HAS_MMAP
+  int const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    size_ = 0;
+    throw std::runtime_error(fmt::format("Failed to create file: {}", path.string()));
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    size_ = 0;
+    throw std::runtime_error(fmt::format("Failed to size file: {}", path.string()));
+  }
+  if (size_ > 0) {
+    void *addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      throw std::runtime_error(fmt::format("Failed to map file: {}", path.string()));
+    }
+    data_ = static_cast<char *>(addr);
+    mapped_ = true;
+  }
+  ::close(fd);
+#else
+  fallback_.assign(size, '\0');
+  data_ = fallback_.data();
+#endif
+}
+
+MappedOutputFile::~MappedOutputFile() { release(); }
+
+MappedOutputFile::MappedOutputFile(MappedOutputFile &&other) noexcept
+  : path_(std::move(other.path_)), data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+    mapped_(std::exchange(other.mapped_, false)), fallback_(std::move(other.fallback_)) {}
+
+MappedOutputFile &MappedOutputFile::operator=(MappedOutputFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    path_ = std::move(other.path_);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapped_ = std::exchange(other.mapped_, false);
+    fallback_ = std::move(other.fallback_);
+  }
+  return *this;
+}
+
+void MappedOutputFile::sync() {
+#if RMS_HAS_MMAP
+  if (mapped_ && ::msync(data_, size_, MS_SYNC) != 0) {
+    throw std::runtime_error(fmt::format("Failed to flush file: {}", path_.string()));
+  }
+#else
+  std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+  file.write(fallback_.data(), static_cast<std::streamsize>(fallback_.size()));
+  if (!file) {
+    throw std::runtime_error(fmt::format("Failed to write file: {}", path_.string()));
+  }
+#endif
+}
+
+void MappedOutputFile::release() noexcept {
+#if RMS_HAS_MMAP
+  if (mapped_ && data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  fallback_.clear();
+}
+
+} // namespace rms
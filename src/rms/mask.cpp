@@ -0,0 +1,493 @@
+#include "include/mask.hpp"
+#include "include/names.hpp"
+#include "include/residues.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kWordBits = 64;
+
+using Bits = std::vector<std::uint64_t>;
+
+// Element symbols by atomic number; index 0 is unused.
+constexpr std::array<std::string_view, 119> kElementSymbols = {"", "H", "He", "Li", "Be", "B", "C", "N", "O", "F",
+  "Ne", "Na", "Mg", "Al", "Si", "P", "S", "Cl", "Ar", "K", "Ca", "Sc", "Ti", "V", "Cr", "Mn", "Fe", "Co", "Ni", "Cu",
+  "Zn", "Ga", "Ge", "As", "Se", "Br", "Kr", "Rb", "Sr", "Y", "Zr", "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd",
+  "In", "Sn", "Sb", "Te", "I", "Xe", "Cs", "Ba", "La", "Ce", "Pr", "Nd", "Pm", "Sm", "Eu", "Gd", "Tb", "Dy", "Ho",
+  "Er", "Tm", "Yb", "Lu", "Hf", "Ta", "W", "Re", "Os", "Ir", "Pt", "Au", "Hg", "Tl", "Pb", "Bi", "Po", "At", "Rn",
+  "Fr", "Ra", "Ac", "Th", "Pa", "U", "Np", "Pu", "Am", "Cm", "Bk", "Cf", "Es", "Fm", "Md", "No", "Lr", "Rf", "Db",
+  "Sg", "Bh", "Hs", "Mt", "Ds", "Rg", "Cn", "Nh", "Fl", "Mc", "Lv", "Ts", "Og"};
+
+[[nodiscard]] std::size_t word_count(std::size_t natom) noexcept { return (natom + kWordBits - 1) / kWordBits; }
+
+// Shell-style match: `*` is any run, `?` exactly one character.
+[[nodiscard]] bool glob_match(std::string_view text, std::string_view pattern) noexcept {
+  std::size_t ti = 0;
+  std::size_t pi = 0;
+  std::size_t star = std::string_view::npos;
+  std::size_t resume = 0;
+  while (ti < text.size()) {
+    if (pi < pattern.size() && (pattern[pi] == '?' || pattern[pi] == text[ti])) {
+      ++ti;
+      ++pi;
+    } else if (pi < pattern.size() && pattern[pi] == '*') {
+      star = pi++;
+      resume = ti;
+    } else if (star != std::string_view::npos) {
+      pi = star + 1;
+      ti = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (pi < pattern.size() && pattern[pi] == '*') {
+    ++pi;
+  }
+  return pi == pattern.size();
+}
+
+// A name pattern compiled to a test on the packed 32-bit name: literal bytes
+// under `mask` must equal `value`, `?` bytes must be non-zero, and unless the
+// pattern ends in `*` the bytes past it must be zero. Patterns that do not fit
+// that form (a leading or inner `*`, more than four characters) are `general`
+// and go through glob_match.
+struct NamePattern {
+  std::string_view text;
+  std::uint32_t value = 0;
+  std::uint32_t mask = 0;
+  std::uint32_t present = 0;
+  bool general = false;
+
+  explicit NamePattern(std::string_view pattern) : text(pattern) {
+    std::array<unsigned char, kPackedNameLength> bytes{};
+    std::array<unsigned char, kPackedNameLength> literal{};
+    std::array<unsigned char, kPackedNameLength> required{};
+    std::size_t pos = 0;
+    bool open_end = false;
+    for (std::size_t idx = 0; idx < pattern.size(); ++idx) {
+      char const c = pattern[idx];
+      if (c == '*' && idx + 1 == pattern.size()) {
+        open_end = true;
+        break;
+      }
+      if (c == '*' || pos == kPackedNameLength) {
+        general = true;
+        return;
+      }
+      if (c == '?') {
+        required[pos] = 0x80;
+      } else {
+        bytes[pos] = static_cast<unsigned char>(c);
+        literal[pos] = 0xFF;
+      }
+      ++pos;
+    }
+    for (; !open_end && pos < kPackedNameLength; ++pos) {
+      literal[pos] = 0xFF;
+    }
+    value = std::bit_cast<std::uint32_t>(bytes);
+    mask = std::bit_cast<std::uint32_t>(literal);
+    present = std::bit_cast<std::uint32_t>(required);
+  }
+
+  [[nodiscard]] bool matches(PackedName name) const noexcept {
+    if (general) {
+      return glob_match(name.view(), text);
+    }
+    auto const x = name.value();
+    // High bit of every non-zero byte.
+    auto const nonzero = (((x & 0x7F7F7F7FU) + 0x7F7F7F7FU) | x) & 0x80808080U;
+    return ((x & mask) == value) & ((nonzero & present) == present);
+  }
+};
+
+// OR-s pred(index) into bit `index` for index in [0, count), a word at a time,
+// so the inner loop is a branch-free compare-and-shift.
+template <typename Pred>
+void sweep(std::size_t count, Bits &bits, Pred &&pred) {
+  for (std::size_t word = 0; word * kWordBits < count; ++word) {
+    auto const first = word * kWordBits;
+    auto const width = std::min(kWordBits, count - first);
+    std::uint64_t acc = 0;
+    for (std::size_t bit = 0; bit < width; ++bit) {
+      acc |= static_cast<std::uint64_t>(pred(first + bit)) << bit;
+    }
+    bits[word] |= acc;
+  }
+}
+
+// Sets bits [begin, end), filling whole words in between.
+void set_range(Bits &bits, std::size_t begin, std::size_t end) noexcept {
+  if (begin >= end) {
+    return;
+  }
+  auto const first = begin / kWordBits;
+  auto const last = (end - 1) / kWordBits;
+  auto const head = ~std::uint64_t{0} << (begin % kWordBits);
+  auto const tail = ~std::uint64_t{0} >> (kWordBits - 1 - (end - 1) % kWordBits);
+  if (first == last) {
+    bits[first] |= head & tail;
+    return;
+  }
+  bits[first] |= head;
+  std::fill(bits.begin() + static_cast<std::ptrdiff_t>(first + 1), bits.begin() + static_cast<std::ptrdiff_t>(last),
+    ~std::uint64_t{0});
+  bits[last] |= tail;
+}
+
+// A list item: a 1-based inclusive number range, or a name pattern.
+struct MaskItem {
+  std::optional<std::pair<std::size_t, std::size_t>> range;
+  std::string_view pattern;
+  std::size_t column = 0;
+};
+
+class MaskCompiler
+{
+public:
+  MaskCompiler(std::string_view text, const Parm7Topology &topo)
+      : text_(text), topo_(topo), natom_(static_cast<std::size_t>(topo.pointers.natom)) {}
+
+  [[nodiscard]] Bits compile() {
+    auto bits = parse_or();
+    skip_space();
+    if (pos_ < text_.size() && (text_[pos_] == '<' || text_[pos_] == '>')) {
+      fail("distance selections are not supported");
+    }
+    if (pos_ < text_.size()) {
+      fail(fmt::format("unexpected '{}'", text_[pos_]));
+    }
+    return bits;
+  }
+
+private:
+  [[noreturn]] void fail(std::string_view what) const { fail_at(what, pos_); }
+
+  [[noreturn]] void fail_at(std::string_view what, std::size_t column) const {
+    throw std::invalid_argument(fmt::format("Amber mask '{}': {} at column {}", text_, what, column + 1));
+  }
+
+  void require(Parm7Section section, std::string_view name) const {
+    if ((topo_.loaded_sections & section_bit(section)) == 0) {
+      throw std::runtime_error(fmt::format("Amber mask '{}' needs the {} section to be loaded", text_, name));
+    }
+  }
+
+  void skip_space() noexcept {
+    while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_])) != 0) {
+      ++pos_;
+    }
+  }
+
+  [[nodiscard]] bool accept(char c) noexcept {
+    skip_space();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  [[nodiscard]] Bits empty() const { return Bits(word_count(natom_), 0); }
+
+  [[nodiscard]] Bits parse_or() {
+    auto bits = parse_and();
+    while (accept('|')) {
+      auto const rhs = parse_and();
+      std::ranges::transform(bits, rhs, bits.begin(), std::bit_or<>());
+    }
+    return bits;
+  }
+
+  [[nodiscard]] Bits parse_and() {
+    auto bits = parse_unary();
+    while (accept('&')) {
+      auto const rhs = parse_unary();
+      std::ranges::transform(bits, rhs, bits.begin(), std::bit_and<>());
+    }
+    return bits;
+  }
+
+  [[nodiscard]] Bits parse_unary() {
+    if (!accept('!')) {
+      return parse_primary();
+    }
+    auto bits = parse_unary();
+    for (auto &word : bits) {
+      word = ~word;
+    }
+    if (natom_ % kWordBits != 0) {
+      bits.back() &= ~std::uint64_t{0} >> (kWordBits - natom_ % kWordBits);
+    }
+    return bits;
+  }
+
+  [[nodiscard]] Bits parse_primary() {
+    if (accept('(')) {
+      auto bits = parse_or();
+      if (!accept(')')) {
+        fail("expected ')'");
+      }
+      return bits;
+    }
+    skip_space();
+    if (pos_ == text_.size()) {
+      fail("expected a selection");
+    }
+    switch (text_[pos_]) {
+      case '*': {
+        ++pos_;
+        auto bits = empty();
+        set_range(bits, 0, natom_);
+        return bits;
+      }
+      case ':': {
+        ++pos_;
+        auto bits = residue_bits(parse_list());
+        if (pos_ < text_.size() && text_[pos_] == '@') {
+          ++pos_;
+          auto const atoms = atom_bits();
+          std::ranges::transform(bits, atoms, bits.begin(), std::bit_and<>());
+        }
+        return bits;
+      }
+      case '@':
+        ++pos_;
+        return atom_bits();
+      case '<':
+      case '>':
+        fail("distance selections are not supported");
+      default:
+        fail(fmt::format("expected ':', '@', '*', '!' or '(' but found '{}'", text_[pos_]));
+    }
+  }
+
+  [[nodiscard]] static bool ends_item(char c) noexcept {
+    return c == ',' || c == ':' || c == '@' || c == '&' || c == '|' || c == '!' || c == '(' || c == ')' || c == '<'
+           || c == '>' || std::isspace(static_cast<unsigned char>(c)) != 0;
+  }
+
+  // Comma-separated items up to the next operator; `1-250` and `7` are number
+  // ranges, anything not starting with a digit is a name pattern.
+  [[nodiscard]] std::vector<MaskItem> parse_list() {
+    std::vector<MaskItem> items;
+    do {
+      auto const start = pos_;
+      while (pos_ < text_.size() && !ends_item(text_[pos_])) {
+        ++pos_;
+      }
+      auto const token = text_.substr(start, pos_ - start);
+      if (token.empty()) {
+        fail("expected a number, range or name");
+      }
+      MaskItem item{.range = std::nullopt, .pattern = token, .column = start};
+      if (std::isdigit(static_cast<unsigned char>(token.front())) != 0) {
+        item.range = parse_range(token, start);
+      }
+      items.push_back(item);
+    } while (pos_ < text_.size() && text_[pos_] == ',' && ++pos_ != 0);
+    return items;
+  }
+
+  [[nodiscard]] std::pair<std::size_t, std::size_t> parse_range(std::string_view token, std::size_t column) const {
+    auto const number = [&](std::string_view digits) {
+      if (digits.empty() || !std::ranges::all_of(digits, [](char c) { return c >= '0' && c <= '9'; })
+          || digits.size() > 9) {
+        fail_at(fmt::format("'{}' is not a number or range", token), column);
+      }
+      std::size_t value = 0;
+      for (char const c : digits) {
+        value = value * 10 + static_cast<std::size_t>(c - '0');
+      }
+      return value;
+    };
+    auto const dash = token.find('-');
+    auto const first = number(token.substr(0, dash));
+    auto const last = dash == std::string_view::npos ? first : number(token.substr(dash + 1));
+    if (first == 0 || last < first) {
+      fail_at(fmt::format("'{}' is not a 1-based ascending range", token), column);
+    }
+    return {first, last};
+  }
+
+  // Flags for the entries of an interned table that match any pattern.
+  [[nodiscard]] static std::vector<std::uint8_t> match_table(
+    std::span<const PackedName> table, std::span<const NamePattern> patterns) {
+    std::vector<std::uint8_t> flags(table.size(), 0);
+    for (std::size_t id = 0; id < table.size(); ++id) {
+      flags[id] = std::ranges::any_of(patterns, [&](const NamePattern &p) { return p.matches(table[id]); }) ? 1 : 0;
+    }
+    return flags;
+  }
+
+  [[nodiscard]] static std::vector<NamePattern> patterns_of(std::span<const MaskItem> items) {
+    std::vector<NamePattern> patterns;
+    for (auto const &item : items) {
+      if (!item.range) {
+        patterns.emplace_back(item.pattern);
+      }
+    }
+    return patterns;
+  }
+
+  [[nodiscard]] Bits residue_bits(const std::vector<MaskItem> &items) {
+    require(Parm7Section::ResiduePointer, "RESIDUE_POINTER");
+    if (!residues_) {
+      residues_.emplace(topo_);
+    }
+    auto const starts = residues_->starts();
+    auto const nres = residues_->residue_count();
+    auto bits = empty();
+    for (auto const &item : items) {
+      if (item.range && item.range->first <= nres) {
+        auto const last = std::min(item.range->second, nres);
+        set_range(
+          bits, static_cast<std::size_t>(starts[item.range->first - 1]), static_cast<std::size_t>(starts[last]));
+      }
+    }
+    auto const patterns = patterns_of(items);
+    if (!patterns.empty()) {
+      require(Parm7Section::ResidueLabel, "RESIDUE_LABEL");
+      auto const &labels = topo_.residue_label;
+      auto const flags = match_table(labels.table, patterns);
+      for (std::size_t residue = 0; residue < nres && residue < labels.size(); ++residue) {
+        if (flags[labels.ids[residue]] != 0) {
+          set_range(bits, static_cast<std::size_t>(starts[residue]), static_cast<std::size_t>(starts[residue + 1]));
+        }
+      }
+    }
+    return bits;
+  }
+
+  [[nodiscard]] Bits atom_bits() {
+    if (pos_ < text_.size() && text_[pos_] == '%') {
+      ++pos_;
+      return type_bits(parse_list());
+    }
+    if (pos_ < text_.size() && text_[pos_] == '/') {
+      ++pos_;
+      return element_bits(parse_list());
+    }
+    auto const items = parse_list();
+    auto bits = empty();
+    for (auto const &item : items) {
+      if (item.range && item.range->first <= natom_) {
+        set_range(bits, item.range->first - 1, std::min(item.range->second, natom_));
+      }
+    }
+    auto const patterns = patterns_of(items);
+    if (patterns.empty()) {
+      return bits;
+    }
+    require(Parm7Section::AtomName, "ATOM_NAME");
+    auto const names = std::span<const PackedName>(topo_.atom_name).first(std::min(natom_, topo_.atom_name.size()));
+    for (auto const &pattern : patterns) {
+      if (!pattern.general) {
+        sweep(names.size(), bits, [&](std::size_t atom) { return pattern.matches(names[atom]); });
+        continue;
+      }
+      // Wildcards the packed form cannot express are matched once per
+      // distinct name, then swept by id.
+      if (!atom_names_) {
+        atom_names_.emplace(intern_names(names));
+      }
+      auto const flags = match_table(atom_names_->table, std::span(&pattern, 1));
+      sweep(names.size(), bits, [&](std::size_t atom) { return flags[atom_names_->ids[atom]] != 0; });
+    }
+    return bits;
+  }
+
+  [[nodiscard]] Bits type_bits(const std::vector<MaskItem> &items) {
+    require(Parm7Section::AmberAtomType, "AMBER_ATOM_TYPE");
+    std::vector<NamePattern> patterns;
+    for (auto const &item : items) {
+      patterns.emplace_back(item.pattern);
+    }
+    auto const &types = topo_.amber_atom_type;
+    auto const flags = match_table(types.table, patterns);
+    auto const ids = std::span<const std::uint32_t>(types.ids).first(std::min(natom_, types.size()));
+    auto bits = empty();
+    sweep(ids.size(), bits, [&](std::size_t atom) { return flags[ids[atom]] != 0; });
+    return bits;
+  }
+
+  [[nodiscard]] Bits element_bits(const std::vector<MaskItem> &items) {
+    require(Parm7Section::AtomicNumber, "ATOMIC_NUMBER");
+    std::array<std::uint8_t, kElementSymbols.size()> flags{};
+    for (auto const &item : items) {
+      bool matched = false;
+      for (std::size_t z = 1; z < kElementSymbols.size(); ++z) {
+        if (glob_match(kElementSymbols[z], item.pattern)) {
+          flags[z] = 1;
+          matched = true;
+        }
+      }
+      if (!matched) {
+        fail_at(fmt::format("'{}' is not an element symbol", item.pattern), item.column);
+      }
+    }
+    auto const numbers = std::span<const int>(topo_.atomic_number).first(std::min(natom_, topo_.atomic_number.size()));
+    auto bits = empty();
+    sweep(numbers.size(), bits, [&](std::size_t atom) {
+      auto const z = static_cast<std::size_t>(numbers[atom]);
+      return z < flags.size() && flags[z] != 0;
+    });
+    return bits;
+  }
+
+  std::string_view text_;
+  const Parm7Topology &topo_;
+  std::size_t natom_ = 0;
+  std::size_t pos_ = 0;
+  std::optional<ResidueIndex> residues_;
+  std::optional<InternedNames> atom_names_;
+};
+
+} // namespace
+
+AtomSelection::AtomSelection(std::size_t natom, std::vector<std::uint64_t> bits)
+    : natom_(natom), bits_(std::move(bits)) {
+  if (bits_.size() != word_count(natom_)) {
+    throw std::invalid_argument(
+      fmt::format("Selection bitset has {} words, but {} atoms need {}", bits_.size(), natom_, word_count(natom_)));
+  }
+  std::size_t count = 0;
+  for (auto const word : bits_) {
+    count += static_cast<std::size_t>(std::popcount(word));
+  }
+  indices_.reserve(count);
+  for (std::size_t word = 0; word < bits_.size(); ++word) {
+    for (auto rest = bits_[word]; rest != 0; rest &= rest - 1) {
+      indices_.push_back(static_cast<int>(word * kWordBits + static_cast<std::size_t>(std::countr_zero(rest))));
+    }
+  }
+  if (!indices_.empty() && static_cast<std::size_t>(indices_.back()) >= natom_) {
+    throw std::invalid_argument("Selection bitset has bits set past NATOM");
+  }
+}
+
+AtomSelection AtomSelection::all(std::size_t natom) {
+  Bits bits(word_count(natom), 0);
+  set_range(bits, 0, natom);
+  return {natom, std::move(bits)};
+}
+
+AtomSelection compile_mask(std::string_view mask, const Parm7Topology &topo) {
+  if (topo.pointers.natom < 0) {
+    throw std::invalid_argument("Topology has a negative atom count");
+  }
+  return {static_cast<std::size_t>(topo.pointers.natom), MaskCompiler(mask, topo).compile()};
+}
+
+} // namespace rms
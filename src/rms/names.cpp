@@ -0,0 +1,43 @@
+#include "include/names.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace rms {
+
+std::optional<std::uint32_t> InternedNames::find(PackedName name) const noexcept {
+  auto const found = std::find(table.begin(), table.end(), name);
+  if (found == table.end()) {
+    return std::nullopt;
+  }
+  return static_cast<std::uint32_t>(found - table.begin());
+}
+
+InternedNames intern_names(std::span<const PackedName> names, std::pmr::memory_resource *resource) {
+  InternedNames interned(resource);
+  interned.ids.reserve(names.size());
+  // The table grows as names are seen; build it on the heap and copy it once so
+  // a monotonic `resource` does not keep every outgrown buffer.
+  std::vector<PackedName> table;
+
+  std::unordered_map<std::uint32_t, std::uint32_t> id_of;
+  // Topologies list atoms residue by residue, so the previous name repeats often.
+  PackedName last;
+  std::uint32_t last_id = 0;
+  for (auto const name : names) {
+    if (table.empty() || name != last) {
+      auto const [it, inserted] = id_of.try_emplace(name.value(), static_cast<std::uint32_t>(table.size()));
+      if (inserted) {
+        table.push_back(name);
+      }
+      last = name;
+      last_id = it->second;
+    }
+    interned.ids.push_back(last_id);
+  }
+  interned.table.assign(table.begin(), table.end());
+  return interned;
+}
+
+} // namespace rms
@@ -0,0 +1,603 @@
+#include "include/neighbors.hpp"
+#include "include/aligned.hpp"
+#include "include/parallel.hpp"
+#include "include/simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kAtomsPerTask = 2048;
+constexpr double kTruncatedOctahedronAngle = 109.4712206;
+constexpr double kRightAngleTolerance = 1e-6;
+// Lattice shifts are packed 8 bits per axis; input positions may lie up to
+// kMaxImage cells outside the box, so a pair's shift always fits.
+constexpr int kMaxImage = 63;
+
+[[nodiscard]] Vec3 cross(const Vec3 &a, const Vec3 &b) noexcept {
+  return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+[[nodiscard]] double norm2(const Vec3 &v) noexcept { return v[0] * v[0] + v[1] * v[1] + v[2] * v[2]; }
+
+// Lattice translation t . H for integer t.
+[[nodiscard]] Vec3 lattice_shift(const std::array<Vec3, 3> &h, int ta, int tb, int tc) noexcept {
+  auto const a = static_cast<double>(ta);
+  auto const b = static_cast<double>(tb);
+  auto const c = static_cast<double>(tc);
+  return {a * h[0][0] + b * h[1][0] + c * h[2][0], b * h[1][1] + c * h[2][1], c * h[2][2]};
+}
+
+[[nodiscard]] std::uint32_t pack_shift(int ta, int tb, int tc) noexcept {
+  return (static_cast<std::uint32_t>(ta + 128) << 16U) | (static_cast<std::uint32_t>(tb + 128) << 8U)
+         | static_cast<std::uint32_t>(tc + 128);
+}
+
+[[nodiscard]] std::array<int, 3> unpack_shift(std::uint32_t key) noexcept {
+  return {static_cast<int>((key >> 16U) & 0xFFU) - 128, static_cast<int>((key >> 8U) & 0xFFU) - 128,
+    static_cast<int>(key & 0xFFU) - 128};
+}
+
+// Atoms binned into cells, with their positions copied out in cell order.
+struct CellGrid {
+  std::array<std::size_t, 3> dims{1, 1, 1};
+  std::vector<std::size_t> start;
+  std::vector<int> atoms;
+  AlignedVector<double> x;
+  AlignedVector<double> y;
+  AlignedVector<double> z;
+  // In cell order: the lattice cell each position was wrapped back from, as
+  // pack_shift (periodic only).
+  std::vector<std::uint32_t> image;
+
+  [[nodiscard]] std::size_t cell_count() const noexcept { return dims[0] * dims[1] * dims[2]; }
+};
+
+// Cells per axis: as many as fit at `range` wide, then coarsened until there
+// are not many more cells than atoms.
+[[nodiscard]] std::array<std::size_t, 3> grid_dims(const Vec3 &extent, double range, std::size_t natom) {
+  std::array<std::size_t, 3> dims{};
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    auto const fit = std::floor(extent[axis] / range);
+    dims[axis] = fit < 1.0 ? 1 : static_cast<std::size_t>(std::min(fit, 1.0e6));
+  }
+  auto const cap = 2 * natom + 1;
+  while (dims[0] * dims[1] * dims[2] > cap) {
+    auto &largest = *std::ranges::max_element(dims);
+    largest = std::max<std::size_t>(1, largest / 2);
+  }
+  return dims;
+}
+
+[[nodiscard]] CellGrid build_grid(
+  const Coordinates &positions, const std::optional<PeriodicBox> &box, double range, std::size_t threads) {
+  auto const natom = positions.size();
+  CellGrid grid;
+  Vec3 low{};
+  Vec3 extent{};
+  if (box) {
+    extent = box->widths();
+  } else {
+    Vec3 high{};
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      auto const &values = axis == 0 ? positions.x : (axis == 1 ? positions.y : positions.z);
+      auto const [lo, hi] = std::ranges::minmax_element(values);
+      low[axis] = natom > 0 ? *lo : 0.0;
+      high[axis] = natom > 0 ? *hi : 0.0;
+      extent[axis] = std::max(high[axis] - low[axis], range);
+    }
+  }
+  grid.dims = grid_dims(extent, range, natom);
+  auto const [nx, ny, nz] = grid.dims;
+
+  // Pass 1: cell of every atom, and its position wrapped into the box.
+  std::vector<std::uint32_t> cell(natom);
+  AlignedVector<double> wx(natom);
+  AlignedVector<double> wy(natom);
+  AlignedVector<double> wz(natom);
+  std::vector<std::uint32_t> image(box ? natom : 0);
+  auto const bin = [](double s, std::size_t count) {
+    return std::min(count - 1, static_cast<std::size_t>(std::max(0.0, s * static_cast<double>(count))));
+  };
+  std::size_t const tasks = (natom + kAtomsPerTask - 1) / kAtomsPerTask;
+  parallel_for(tasks, threads, [&](std::size_t task) {
+    std::size_t const end = std::min(natom, (task + 1) * kAtomsPerTask);
+    for (std::size_t atom = task * kAtomsPerTask; atom < end; ++atom) {
+      Vec3 const r{positions.x[atom], positions.y[atom], positions.z[atom]};
+      if (!std::isfinite(r[0]) || !std::isfinite(r[1]) || !std::isfinite(r[2])) {
+        throw std::invalid_argument(fmt::format("Atom {} has a non-finite position", atom));
+      }
+      Vec3 s{};
+      Vec3 wrapped = r;
+      if (box) {
+        s = box->fractional(r);
+        std::array<int, 3> cell_of{};
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+          double const whole = std::floor(s[axis]);
+          if (std::abs(whole) > kMaxImage) {
+            throw std::invalid_argument(
+              fmt::format("Atom {} lies more than {} cells outside the periodic box", atom, kMaxImage));
+          }
+          cell_of[axis] = static_cast<int>(whole);
+          s[axis] -= whole;
+        }
+        image[atom] = pack_shift(cell_of[0], cell_of[1], cell_of[2]);
+        wrapped = box->cartesian(s);
+      } else {
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+          s[axis] = (r[axis] - low[axis]) / extent[axis];
+        }
+      }
+      cell[atom] = static_cast<std::uint32_t>((bin(s[0], nx) * ny + bin(s[1], ny)) * nz + bin(s[2], nz));
+      wx[atom] = wrapped[0];
+      wy[atom] = wrapped[1];
+      wz[atom] = wrapped[2];
+    }
+  });
+
+  // Pass 2: counting sort by cell.
+  grid.start.assign(grid.cell_count() + 1, 0);
+  for (auto const c : cell) {
+    ++grid.start[c + 1];
+  }
+  for (std::size_t c = 0; c < grid.cell_count(); ++c) {
+    grid.start[c + 1] += grid.start[c];
+  }
+  grid.atoms.resize(natom);
+  grid.x.resize(natom);
+  grid.y.resize(natom);
+  grid.z.resize(natom);
+  grid.image.resize(image.size());
+  std::vector<std::size_t> fill(grid.start.begin(), grid.start.end() - 1);
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    auto const slot = fill[cell[atom]]++;
+    grid.atoms[slot] = static_cast<int>(atom);
+    grid.x[slot] = wx[atom];
+    grid.y[slot] = wy[atom];
+    grid.z[slot] = wz[atom];
+    if (box) {
+      grid.image[slot] = image[atom];
+    }
+  }
+  return grid;
+}
+
+// Candidate filter: writes the k in [0, count) with |r[k] - centre|^2 < range2
+// to `out` and returns how many. About one candidate in seven is in range, so
+// the vector kernels compare a register of candidates at once and walk the
+// set bits of the compare mask instead of branching per candidate.
+using FilterFn = std::size_t (*)(double const *x, double const *y, double const *z, std::size_t count,
+  const Vec3 &centre, double range2, std::uint32_t *out) noexcept;
+
+std::size_t filter_scalar(double const *x, double const *y, double const *z, std::size_t count, const Vec3 &centre,
+  double range2, std::uint32_t *out) noexcept {
+  std::size_t found = 0;
+  for (std::size_t k = 0; k < count; ++k) {
+    double const dx = x[k] - centre[0];
+    double const dy = y[k] - centre[1];
+    double const dz = z[k] - centre[2];
+    out[found] = static_cast<std::uint32_t>(k);
+    found += dx * dx + dy * dy + dz * dz < range2 ? 1U : 0U;
+  }
+  return found;
+}
+
+#if RMS_X86_DISPATCH
+RMS_TARGET("avx2,fma")
+std::size_t filter_avx2(double const *x, double const *y, double const *z, std::size_t count, const Vec3 &centre,
+  double range2, std::uint32_t *out) noexcept {
+  __m256d const cx = _mm256_set1_pd(centre[0]);
+  __m256d const cy = _mm256_set1_pd(centre[1]);
+  __m256d const cz = _mm256_set1_pd(centre[2]);
+  __m256d const limit = _mm256_set1_pd(range2);
+  std::size_t found = 0;
+  std::size_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    __m256d const dx = _mm256_sub_pd(_mm256_loadu_pd(x + k), cx);
+    __m256d const dy = _mm256_sub_pd(_mm256_loadu_pd(y + k), cy);
+    __m256d const dz = _mm256_sub_pd(_mm256_loadu_pd(z + k), cz);
+    __m256d const r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+    for (auto mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(r2, limit, _CMP_LT_OQ))); mask != 0;
+         mask &= mask - 1) {
+      out[found++] = static_cast<std::uint32_t>(k + static_cast<std::size_t>(std::countr_zero(mask)));
+    }
+  }
+  // Cleared by hand: GCC 12 emits no vzeroupper for this function, which
+  // leaves later legacy SSE code paying a transition penalty.
+  _mm256_zeroupper();
+  auto const tail = filter_scalar(x + k, y + k, z + k, count - k, centre, range2, out + found);
+  for (std::size_t idx = found; idx < found + tail; ++idx) {
+    out[idx] += static_cast<std::uint32_t>(k);
+  }
+  return found + tail;
+}
+
+RMS_TARGET("avx512f")
+std::size_t filter_avx512(double const *x, double const *y, double const *z, std::size_t count, const Vec3 &centre,
+  double range2, std::uint32_t *out) noexcept {
+  __m512d const cx = _mm512_set1_pd(centre[0]);
+  __m512d const cy = _mm512_set1_pd(centre[1]);
+  __m512d const cz = _mm512_set1_pd(centre[2]);
+  __m512d const limit = _mm512_set1_pd(range2);
+  __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  std::size_t found = 0;
+  std::size_t k = 0;
+  for (; k + 8 <= count; k += 8) {
+    __m512d const dx = _mm512_sub_pd(_mm512_loadu_pd(x + k), cx);
+    __m512d const dy = _mm512_sub_pd(_mm512_loadu_pd(y + k), cy);
+    __m512d const dz = _mm512_sub_pd(_mm512_loadu_pd(z + k), cz);
+    __m512d const r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+    __mmask8 const mask = _mm512_cmp_pd_mask(r2, limit, _CMP_LT_OQ);
+    // Compress-store the lane indices of the hits.
+    __m256i const index = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(k)));
+    _mm512_mask_compressstoreu_epi32(out + found, static_cast<__mmask16>(mask), _mm512_castsi256_si512(index));
+    found += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+  }
+  _mm256_zeroupper();
+  auto const tail = filter_scalar(x + k, y + k, z + k, count - k, centre, range2, out + found);
+  for (std::size_t idx = found; idx < found + tail; ++idx) {
+    out[idx] += static_cast<std::uint32_t>(k);
+  }
+  return found + tail;
+}
+#endif
+
+[[nodiscard]] FilterFn select_filter() noexcept {
+#if RMS_X86_DISPATCH
+  switch (detected_simd_level()) {
+    case SimdLevel::Avx512:
+      return filter_avx512;
+    case SimdLevel::Avx2:
+      return filter_avx2;
+    default:
+      break;
+  }
+#endif
+  return filter_scalar;
+}
+
+// The 13 neighbour cells ahead of a cell in (x, y, z) order; with the cell
+// itself they cover every adjacent pair once.
+constexpr std::array<std::array<int, 3>, 13> kForwardCells = {{{0, 0, 1}, {0, 1, -1}, {0, 1, 0}, {0, 1, 1},
+  {1, -1, -1}, {1, -1, 0}, {1, -1, 1}, {1, 0, -1}, {1, 0, 0}, {1, 0, 1}, {1, 1, -1}, {1, 1, 0}, {1, 1, 1}}};
+
+// Pairs found by one task: row lengths for its atoms in cell order, partners
+// as grid slots, and shift keys interned into a small task-local table.
+struct PairBuffer {
+  std::vector<std::size_t> counts;
+  std::vector<int> partners;
+  std::vector<std::uint16_t> local_shifts;
+  std::vector<std::uint32_t> keys;
+
+  [[nodiscard]] std::uint16_t intern(std::uint32_t key) {
+    if (!keys.empty() && keys.back() == key) {
+      return static_cast<std::uint16_t>(keys.size() - 1);
+    }
+    auto const found = std::ranges::find(keys, key);
+    if (found != keys.end()) {
+      return static_cast<std::uint16_t>(found - keys.begin());
+    }
+    keys.push_back(key);
+    return static_cast<std::uint16_t>(keys.size() - 1);
+  }
+};
+
+} // namespace
+
+PeriodicBox::PeriodicBox(const std::array<double, 6> &parameters) : parameters_(parameters) {
+  auto const [a, b, c, alpha, beta, gamma] = parameters;
+  for (double const length : {a, b, c}) {
+    if (!(length > 0.0) || !std::isfinite(length)) {
+      throw std::invalid_argument(fmt::format("Box length {} is not positive", length));
+    }
+  }
+  for (double const angle : {alpha, beta, gamma}) {
+    if (!(angle > 0.0 && angle < 180.0)) {
+      throw std::invalid_argument(fmt::format("Box angle {} is outside (0, 180) degrees", angle));
+    }
+  }
+  orthorhombic_ = std::abs(alpha - 90.0) < kRightAngleTolerance && std::abs(beta - 90.0) < kRightAngleTolerance
+                  && std::abs(gamma - 90.0) < kRightAngleTolerance;
+  auto const cosine = [this](double angle) {
+    return orthorhombic_ ? 0.0 : std::cos(angle * std::numbers::pi / 180.0);
+  };
+  double const cos_alpha = cosine(alpha);
+  double const cos_beta = cosine(beta);
+  double const cos_gamma = cosine(gamma);
+  double const sin_gamma = orthorhombic_ ? 1.0 : std::sin(gamma * std::numbers::pi / 180.0);
+  double const cx = c * cos_beta;
+  double const cy = c * (cos_alpha - cos_beta * cos_gamma) / sin_gamma;
+  double const cz2 = c * c - cx * cx - cy * cy;
+  if (!(cz2 > 1e-12 * c * c)) {
+    throw std::invalid_argument(
+      fmt::format("Box angles {}, {}, {} do not make a periodic cell", alpha, beta, gamma));
+  }
+  vectors_ = {Vec3{a, 0.0, 0.0}, Vec3{b * cos_gamma, b * sin_gamma, 0.0}, Vec3{cx, cy, std::sqrt(cz2)}};
+  inverse_diagonal_ = {1.0 / vectors_[0][0], 1.0 / vectors_[1][1], 1.0 / vectors_[2][2]};
+  double const v = volume();
+  widths_ = {v / std::sqrt(norm2(cross(vectors_[1], vectors_[2]))),
+    v / std::sqrt(norm2(cross(vectors_[2], vectors_[0]))), v / std::sqrt(norm2(cross(vectors_[0], vectors_[1])))};
+}
+
+std::optional<PeriodicBox> PeriodicBox::from_topology(const Parm7Topology &topo) {
+  if (topo.pointers.ifbox == 0) {
+    return std::nullopt;
+  }
+  if (!topo.box_dimensions) {
+    throw std::runtime_error(fmt::format("IFBOX is {}, but BOX_DIMENSIONS is not loaded", topo.pointers.ifbox));
+  }
+  auto const [beta, a, b, c] = *topo.box_dimensions;
+  if (topo.pointers.ifbox == 2) {
+    return PeriodicBox(
+      {a, b, c, kTruncatedOctahedronAngle, kTruncatedOctahedronAngle, kTruncatedOctahedronAngle});
+  }
+  return PeriodicBox({a, b, c, 90.0, beta, 90.0});
+}
+
+double PeriodicBox::max_cutoff() const noexcept {
+  // Two images of one pair in range differ by a lattice vector no longer than
+  // twice the cutoff; the cell grid also needs the cutoff within every width.
+  double shortest = std::numeric_limits<double>::max();
+  for (int ta = -1; ta <= 1; ++ta) {
+    for (int tb = -1; tb <= 1; ++tb) {
+      for (int tc = -1; tc <= 1; ++tc) {
+        if (ta != 0 || tb != 0 || tc != 0) {
+          shortest = std::min(shortest, norm2(lattice_shift(vectors_, ta, tb, tc)));
+        }
+      }
+    }
+  }
+  return std::min(0.5 * std::sqrt(shortest), *std::ranges::min_element(widths_));
+}
+
+Vec3 PeriodicBox::minimum_image(const Vec3 &d) const noexcept {
+  auto s = fractional(d);
+  for (double &value : s) {
+    value -= std::round(value);
+  }
+  auto best = cartesian(s);
+  if (orthorhombic_) {
+    return best;
+  }
+  auto const base = best;
+  double best2 = norm2(best);
+  for (int ta = -1; ta <= 1; ++ta) {
+    for (int tb = -1; tb <= 1; ++tb) {
+      for (int tc = -1; tc <= 1; ++tc) {
+        auto const shift = lattice_shift(vectors_, ta, tb, tc);
+        Vec3 const candidate{base[0] + shift[0], base[1] + shift[1], base[2] + shift[2]};
+        if (double const r2 = norm2(candidate); r2 < best2) {
+          best = candidate;
+          best2 = r2;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+VerletList::VerletList(const NeighborOptions &options, const ExclusionList *exclusions) : options_(options) {
+  if (!(options_.cutoff > 0.0) || !std::isfinite(options_.cutoff) || !(options_.skin >= 0.0)
+      || !std::isfinite(options_.skin)) {
+    throw std::invalid_argument(
+      fmt::format("Neighbor cutoff {} must be positive and skin {} non-negative", options_.cutoff, options_.skin));
+  }
+  if (exclusions == nullptr) {
+    return;
+  }
+  has_exclusions_ = true;
+  exclusion_atoms_ = exclusions->atom_count();
+  excluded_offsets_.assign(exclusion_atoms_ + 1, 0);
+  for (std::size_t atom = 0; atom < exclusion_atoms_; ++atom) {
+    for (int const partner : exclusions->partners(static_cast<int>(atom))) {
+      ++excluded_offsets_[atom + 1];
+      ++excluded_offsets_[static_cast<std::size_t>(partner) + 1];
+    }
+  }
+  for (std::size_t atom = 0; atom < exclusion_atoms_; ++atom) {
+    excluded_offsets_[atom + 1] += excluded_offsets_[atom];
+  }
+  // Lower partners land first (their rows are visited earlier), then the
+  // higher ones in order, so each row comes out ascending.
+  excluded_.resize(excluded_offsets_.back());
+  std::vector<std::size_t> fill(excluded_offsets_.begin(), excluded_offsets_.end() - 1);
+  for (std::size_t atom = 0; atom < exclusion_atoms_; ++atom) {
+    for (int const partner : exclusions->partners(static_cast<int>(atom))) {
+      excluded_[fill[static_cast<std::size_t>(partner)]++] = static_cast<int>(atom);
+    }
+  }
+  for (std::size_t atom = 0; atom < exclusion_atoms_; ++atom) {
+    for (int const partner : exclusions->partners(static_cast<int>(atom))) {
+      excluded_[fill[atom]++] = partner;
+    }
+  }
+}
+
+bool VerletList::update(const Coordinates &positions, const std::optional<PeriodicBox> &box) {
+  if (rebuilds_ == 0 || box != box_ || positions.size() != built_at_.size()) {
+    rebuild(positions, box);
+    return true;
+  }
+  double const limit = 0.25 * options_.skin * options_.skin;
+  std::size_t moved = 0;
+  for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+    double const dx = positions.x[atom] - built_at_.x[atom];
+    double const dy = positions.y[atom] - built_at_.y[atom];
+    double const dz = positions.z[atom] - built_at_.z[atom];
+    moved += dx * dx + dy * dy + dz * dz > limit ? 1U : 0U;
+  }
+  if (moved == 0) {
+    return false;
+  }
+  rebuild(positions, box);
+  return true;
+}
+
+void VerletList::rebuild(const Coordinates &positions, const std::optional<PeriodicBox> &box) {
+  auto const natom = positions.size();
+  if (positions.y.size() != natom || positions.z.size() != natom) {
+    throw std::invalid_argument("Positions have ragged x / y / z arrays");
+  }
+  if (natom > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    throw std::invalid_argument(fmt::format("VerletList supports at most INT_MAX atoms, got {}", natom));
+  }
+  if (has_exclusions_ && exclusion_atoms_ != natom) {
+    throw std::invalid_argument(
+      fmt::format("Exclusions cover {} atoms, but {} positions were given", exclusion_atoms_, natom));
+  }
+  double const range = options_.cutoff + options_.skin;
+  if (box && range > box->max_cutoff()) {
+    throw std::invalid_argument(fmt::format(
+      "Cutoff + skin ({:.3f}) exceeds the {:.3f} A the periodic box allows", range, box->max_cutoff()));
+  }
+
+  auto const grid = build_grid(positions, box, range, options_.threads);
+  auto const [nx, ny, nz] = grid.dims;
+  auto const cells = grid.cell_count();
+  double const range2 = range * range;
+  auto const filter = select_filter();
+  auto const &h = box ? box->vectors() : std::array<Vec3, 3>{};
+
+  // Search: tasks of whole cells with about kAtomsPerTask atoms each.
+  auto const cells_per_task = std::max<std::size_t>(1, cells * kAtomsPerTask / std::max<std::size_t>(1, natom));
+  auto const tasks = (cells + cells_per_task - 1) / cells_per_task;
+  std::vector<PairBuffer> buffers(tasks);
+  parallel_for(tasks, options_.threads, [&](std::size_t task) {
+    auto &out = buffers[task];
+    struct Neighbor {
+      std::size_t cell;
+      std::uint32_t wrap;
+      Vec3 shift;
+    };
+    std::vector<Neighbor> neighbors;
+    neighbors.reserve(kForwardCells.size());
+    std::vector<std::uint32_t> hits;
+    auto const last_cell = std::min(cells, (task + 1) * cells_per_task);
+    for (auto c = task * cells_per_task; c < last_cell; ++c) {
+      std::array<std::size_t, 3> const at = {c / (ny * nz), (c / nz) % ny, c % nz};
+      neighbors.clear();
+      for (auto const &offset : kForwardCells) {
+        std::array<std::size_t, 3> next{};
+        std::array<int, 3> wrap{};
+        bool inside = true;
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+          auto const count = static_cast<long>(grid.dims[axis]);
+          auto const raw = static_cast<long>(at[axis]) + offset[axis];
+          wrap[axis] = raw < 0 ? -1 : (raw >= count ? 1 : 0);
+          inside = inside && wrap[axis] == 0;
+          next[axis] = static_cast<std::size_t>(raw - wrap[axis] * count);
+        }
+        if (!inside && !box) {
+          continue;
+        }
+        neighbors.push_back(Neighbor{.cell = (next[0] * ny + next[1]) * nz + next[2],
+          .wrap = pack_shift(wrap[0], wrap[1], wrap[2]),
+          .shift = box ? lattice_shift(h, wrap[0], wrap[1], wrap[2]) : Vec3{}});
+      }
+
+      for (auto p = grid.start[c]; p < grid.start[c + 1]; ++p) {
+        int const atom = grid.atoms[p];
+        auto const home = box ? grid.image[p] : 0U;
+        auto const excluded = has_exclusions_ ? std::span<const int>(excluded_).subspan(
+                                                  excluded_offsets_[static_cast<std::size_t>(atom)],
+                                                  excluded_offsets_[static_cast<std::size_t>(atom) + 1]
+                                                    - excluded_offsets_[static_cast<std::size_t>(atom)])
+                                              : std::span<const int>{};
+        int const excluded_low = excluded.empty() ? 1 : excluded.front();
+        int const excluded_high = excluded.empty() ? 0 : excluded.back();
+        auto const before = out.partners.size();
+        auto const visit = [&](std::size_t first, std::size_t last, const Vec3 &shift, std::uint32_t wrap) {
+          Vec3 const centre{grid.x[p] - shift[0], grid.y[p] - shift[1], grid.z[p] - shift[2]};
+          hits.resize(last - first);
+          auto const count =
+            filter(grid.x.data() + first, grid.y.data() + first, grid.z.data() + first, last - first, centre, range2,
+              hits.data());
+          for (std::size_t hit = 0; hit < count; ++hit) {
+            auto const q = first + hits[hit];
+            int const partner = grid.atoms[q];
+            if (partner >= excluded_low && partner <= excluded_high
+                && std::binary_search(excluded.begin(), excluded.end(), partner)) {
+              continue;
+            }
+            // Shift relative to the unwrapped input positions: the cell wrap
+            // plus the difference of the two atoms' images. Each packed field
+            // stays in [1, 255], so whole-word arithmetic never borrows.
+            auto const key = box ? home + wrap - grid.image[q] : wrap;
+            out.partners.push_back(static_cast<int>(q));
+            out.local_shifts.push_back(out.intern(key));
+          }
+        };
+        visit(p + 1, grid.start[c + 1], Vec3{}, pack_shift(0, 0, 0));
+        for (auto const &neighbor : neighbors) {
+          visit(grid.start[neighbor.cell], grid.start[neighbor.cell + 1], neighbor.shift, neighbor.wrap);
+        }
+        out.counts.push_back(out.partners.size() - before);
+      }
+    }
+  });
+
+  // One table of distinct shifts for the whole list.
+  std::vector<std::uint32_t> keys;
+  for (auto const &buffer : buffers) {
+    keys.insert(keys.end(), buffer.keys.begin(), buffer.keys.end());
+  }
+  std::ranges::sort(keys);
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  if (keys.size() > std::numeric_limits<std::uint16_t>::max() + std::size_t{1}) {
+    throw std::invalid_argument(fmt::format("Pairs need {} distinct periodic shifts", keys.size()));
+  }
+  shift_vectors_.resize(keys.size());
+  for (std::size_t id = 0; id < keys.size(); ++id) {
+    auto const [ta, tb, tc] = unpack_shift(keys[id]);
+    shift_vectors_[id] = box ? lattice_shift(h, ta, tb, tc) : Vec3{};
+  }
+
+  // Rows stay in cell order: task buffers are consecutive runs of rows.
+  std::vector<std::size_t> first_row(tasks + 1, 0);
+  for (std::size_t task = 0; task < tasks; ++task) {
+    first_row[task + 1] = first_row[task] + buffers[task].counts.size();
+  }
+  offsets_.assign(natom + 1, 0);
+  for (std::size_t task = 0; task < tasks; ++task) {
+    for (std::size_t row = 0; row < buffers[task].counts.size(); ++row) {
+      offsets_[first_row[task] + row + 1] = buffers[task].counts[row];
+    }
+  }
+  for (std::size_t row = 0; row < natom; ++row) {
+    offsets_[row + 1] += offsets_[row];
+  }
+  order_.assign(grid.atoms.begin(), grid.atoms.end());
+  partners_.resize(offsets_.back());
+  shifts_.resize(offsets_.back());
+  parallel_for(tasks, options_.threads, [&](std::size_t task) {
+    auto &buffer = buffers[task];
+    std::vector<std::uint16_t> global(buffer.keys.size());
+    for (std::size_t id = 0; id < buffer.keys.size(); ++id) {
+      global[id] = static_cast<std::uint16_t>(std::ranges::lower_bound(keys, buffer.keys[id]) - keys.begin());
+    }
+    auto const write = offsets_[first_row[task]];
+    std::ranges::copy(buffer.partners, partners_.begin() + static_cast<std::ptrdiff_t>(write));
+    for (std::size_t idx = 0; idx < buffer.local_shifts.size(); ++idx) {
+      shifts_[write + idx] = global[buffer.local_shifts[idx]];
+    }
+    buffer = PairBuffer{};
+  });
+
+  box_ = box;
+  built_at_ = positions;
+  ++rebuilds_;
+}
+
+} // namespace rms
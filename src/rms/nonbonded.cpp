@@ -0,0 +1,590 @@
+#include "include/nonbonded.hpp"
+#include "include/exclusions.hpp"
+#include "include/forcefield.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+// Atoms per task when summing the per-worker force buffers.
+constexpr std::size_t kAtomsPerReduce = 4096;
+
+struct PairKernel {
+  std::size_t const *offsets;
+  int const *partners;
+  std::uint16_t const *shifts;
+  // {x, y, z, charge} per atom, 32-byte aligned.
+  double const *atoms;
+  double const *shift_x;
+  double const *shift_y;
+  double const *shift_z;
+  int const *lj_row;
+  int const *lj_col;
+  double const *lj;
+  double cutoff2;
+};
+
+struct PairSums {
+  double vdw = 0.0;
+  double elec = 0.0;
+};
+
+// One worker's force accumulators; unused when only energies are wanted.
+struct ForceSink {
+  double *x = nullptr;
+  double *y = nullptr;
+  double *z = nullptr;
+};
+
+template <bool Forces>
+[[gnu::always_inline]] inline void pair_scalar(const PairKernel &k, std::size_t slot, const Vec3 &ri, double qi,
+  int row, PairSums &sums, Vec3 &fi, const ForceSink &sink) noexcept {
+  auto const j = static_cast<std::size_t>(k.partners[slot]);
+  auto const shift = k.shifts[slot];
+  double const *const record = k.atoms + 4 * j;
+  double const dx = record[0] + k.shift_x[shift] - ri[0];
+  double const dy = record[1] + k.shift_y[shift] - ri[1];
+  double const dz = record[2] + k.shift_z[shift] - ri[2];
+  double const r2 = dx * dx + dy * dy + dz * dz;
+  if (!(r2 < k.cutoff2)) {
+    return;
+  }
+  double const inv_r = 1.0 / std::sqrt(r2);
+  double const inv_r2 = inv_r * inv_r;
+  double const inv_r6 = inv_r2 * inv_r2 * inv_r2;
+  auto const idx = static_cast<std::size_t>(row + k.lj_col[j]);
+  double const a12 = k.lj[idx] * inv_r6 * inv_r6;
+  double const b6 = k.lj[idx + 1] * inv_r6;
+  double const elec = qi * record[3] * inv_r;
+  sums.vdw += a12 - b6;
+  sums.elec += elec;
+  if constexpr (Forces) {
+    double const f = (12.0 * a12 - 6.0 * b6 + elec) * inv_r2;
+    fi[0] -= f * dx;
+    fi[1] -= f * dy;
+    fi[2] -= f * dz;
+    sink.x[j] += f * dx;
+    sink.y[j] += f * dy;
+    sink.z[j] += f * dz;
+  }
+}
+
+// Pair terms of list rows [begin, end), added to `sums` and (with Forces) `sink`.
+using RowsFn = void (*)(const PairKernel &k, std::size_t begin, std::size_t end, PairSums &sums,
+  const ForceSink &sink) noexcept;
+
+template <bool Forces>
+void rows_scalar(const PairKernel &k, std::size_t begin, std::size_t end, PairSums &sums,
+  const ForceSink &sink) noexcept {
+  for (std::size_t atom = begin; atom < end; ++atom) {
+    double const *const record = k.atoms + 4 * atom;
+    Vec3 const ri = {record[0], record[1], record[2]};
+    Vec3 fi{};
+    for (std::size_t slot = k.offsets[atom]; slot < k.offsets[atom + 1]; ++slot) {
+      pair_scalar<Forces>(k, slot, ri, record[3], k.lj_row[atom], sums, fi, sink);
+    }
+    if constexpr (Forces) {
+      sink.x[atom] += fi[0];
+      sink.y[atom] += fi[1];
+      sink.z[atom] += fi[2];
+    }
+  }
+}
+
+#if RMS_X86_DISPATCH
+[[gnu::always_inline]] RMS_TARGET("avx2,fma") inline double hsum_avx2(__m256d v) noexcept {
+  __m128d const pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// Masked form of _mm256_i32gather_pd with every lane on; the plain intrinsic
+// starts from an undefined register, which GCC reports as uninitialized.
+[[gnu::always_inline]] RMS_TARGET("avx2,fma") inline __m256d gather_avx2(double const *base, __m128i index) noexcept {
+  __m256d const all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, all, 8);
+}
+
+// The {x, y, z, q} records of four atoms, transposed into one vector each.
+[[gnu::always_inline]] RMS_TARGET("avx2,fma") inline void load_records_avx2(double const *atoms, int const *index,
+  __m256d &x, __m256d &y, __m256d &z, __m256d &q) noexcept {
+  __m256d const r0 = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(index[0]));
+  __m256d const r1 = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(index[1]));
+  __m256d const r2 = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(index[2]));
+  __m256d const r3 = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(index[3]));
+  __m256d const xz01 = _mm256_unpacklo_pd(r0, r1);
+  __m256d const yq01 = _mm256_unpackhi_pd(r0, r1);
+  __m256d const xz23 = _mm256_unpacklo_pd(r2, r3);
+  __m256d const yq23 = _mm256_unpackhi_pd(r2, r3);
+  x = _mm256_permute2f128_pd(xz01, xz23, 0x20);
+  z = _mm256_permute2f128_pd(xz01, xz23, 0x31);
+  y = _mm256_permute2f128_pd(yq01, yq23, 0x20);
+  q = _mm256_permute2f128_pd(yq01, yq23, 0x31);
+}
+
+// Four partners at a time: each partner's record is one aligned load, and the
+// shift vectors and LJ {A, B} are gathered from their small tables; lanes past
+// the cutoff are masked off. Partners of one row are
+// distinct atoms, so their forces go back through plain stores.
+template <bool Forces>
+RMS_TARGET("avx2,fma")
+void rows_avx2(const PairKernel &k, std::size_t begin, std::size_t end, PairSums &sums,
+  const ForceSink &sink) noexcept {
+  __m256d const cutoff2 = _mm256_set1_pd(k.cutoff2);
+  __m256d const one = _mm256_set1_pd(1.0);
+  __m256d const six = _mm256_set1_pd(6.0);
+  __m256d const twelve = _mm256_set1_pd(12.0);
+  __m256d vdw = _mm256_setzero_pd();
+  __m256d elec = _mm256_setzero_pd();
+  PairSums tail;
+  for (std::size_t atom = begin; atom < end; ++atom) {
+    double const *const record = k.atoms + 4 * atom;
+    Vec3 const ri = {record[0], record[1], record[2]};
+    double const qi = record[3];
+    int const row = k.lj_row[atom];
+    __m256d const xi = _mm256_set1_pd(ri[0]);
+    __m256d const yi = _mm256_set1_pd(ri[1]);
+    __m256d const zi = _mm256_set1_pd(ri[2]);
+    __m256d const vqi = _mm256_set1_pd(qi);
+    __m128i const vrow = _mm_set1_epi32(row);
+    __m256d fx = _mm256_setzero_pd();
+    __m256d fy = _mm256_setzero_pd();
+    __m256d fz = _mm256_setzero_pd();
+    Vec3 fi{};
+    std::size_t slot = k.offsets[atom];
+    std::size_t const last = k.offsets[atom + 1];
+    for (; slot + 4 <= last; slot += 4) {
+      __m128i const j = _mm_loadu_si128(reinterpret_cast<__m128i const *>(k.partners + slot));
+      __m128i const s = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(k.shifts + slot)));
+      __m256d xj;
+      __m256d yj;
+      __m256d zj;
+      __m256d qj;
+      load_records_avx2(k.atoms, k.partners + slot, xj, yj, zj, qj);
+      __m256d const dx = _mm256_sub_pd(_mm256_add_pd(xj, gather_avx2(k.shift_x, s)), xi);
+      __m256d const dy = _mm256_sub_pd(_mm256_add_pd(yj, gather_avx2(k.shift_y, s)), yi);
+      __m256d const dz = _mm256_sub_pd(_mm256_add_pd(zj, gather_avx2(k.shift_z, s)), zi);
+      __m256d const r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+      __m256d const in = _mm256_cmp_pd(r2, cutoff2, _CMP_LT_OQ);
+      if (_mm256_movemask_pd(in) == 0) {
+        continue;
+      }
+      __m256d const inv_r = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+      __m256d const inv_r2 = _mm256_mul_pd(inv_r, inv_r);
+      __m256d const inv_r6 = _mm256_mul_pd(_mm256_mul_pd(inv_r2, inv_r2), inv_r2);
+      __m128i const idx = _mm_add_epi32(vrow, _mm_i32gather_epi32(k.lj_col, j, 4));
+      __m256d const a12 = _mm256_mul_pd(_mm256_mul_pd(gather_avx2(k.lj, idx), inv_r6), inv_r6);
+      __m256d const b6 = _mm256_mul_pd(gather_avx2(k.lj + 1, idx), inv_r6);
+      __m256d const e =
+        _mm256_and_pd(in, _mm256_mul_pd(_mm256_mul_pd(vqi, qj), inv_r));
+      vdw = _mm256_add_pd(vdw, _mm256_and_pd(in, _mm256_sub_pd(a12, b6)));
+      elec = _mm256_add_pd(elec, e);
+      if constexpr (Forces) {
+        __m256d const f = _mm256_and_pd(
+          in, _mm256_mul_pd(_mm256_fmadd_pd(twelve, a12, _mm256_fnmadd_pd(six, b6, e)), inv_r2));
+        __m256d const fxj = _mm256_mul_pd(f, dx);
+        __m256d const fyj = _mm256_mul_pd(f, dy);
+        __m256d const fzj = _mm256_mul_pd(f, dz);
+        fx = _mm256_sub_pd(fx, fxj);
+        fy = _mm256_sub_pd(fy, fyj);
+        fz = _mm256_sub_pd(fz, fzj);
+        alignas(32) std::array<double, 4> lane_x{};
+        alignas(32) std::array<double, 4> lane_y{};
+        alignas(32) std::array<double, 4> lane_z{};
+        _mm256_store_pd(lane_x.data(), fxj);
+        _mm256_store_pd(lane_y.data(), fyj);
+        _mm256_store_pd(lane_z.data(), fzj);
+        for (std::size_t lane = 0; lane < 4; ++lane) {
+          auto const partner = static_cast<std::size_t>(k.partners[slot + lane]);
+          sink.x[partner] += lane_x[lane];
+          sink.y[partner] += lane_y[lane];
+          sink.z[partner] += lane_z[lane];
+        }
+      }
+    }
+    for (; slot < last; ++slot) {
+      pair_scalar<Forces>(k, slot, ri, qi, row, tail, fi, sink);
+    }
+    if constexpr (Forces) {
+      sink.x[atom] += hsum_avx2(fx) + fi[0];
+      sink.y[atom] += hsum_avx2(fy) + fi[1];
+      sink.z[atom] += hsum_avx2(fz) + fi[2];
+    }
+  }
+  sums.vdw += hsum_avx2(vdw) + tail.vdw;
+  sums.elec += hsum_avx2(elec) + tail.elec;
+}
+
+// Stored rather than reduced in-register; GCC flags the undefined upper halves
+// that _mm512_reduce_add_pd starts from.
+[[gnu::always_inline]] RMS_TARGET("avx512f") inline double hsum_avx512(__m512d v) noexcept {
+  alignas(64) std::array<double, 8> lanes;
+  _mm512_store_pd(lanes.data(), v);
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// Records `low` and `high` in the lower and upper halves of one register.
+[[gnu::always_inline]] RMS_TARGET("avx512f") inline __m512d join_records_avx512(double const *atoms, int low,
+  int high) noexcept {
+  __m256d const first = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(low));
+  __m256d const second = _mm256_load_pd(atoms + 4 * static_cast<std::size_t>(high));
+  return _mm512_mask_broadcast_f64x4(_mm512_maskz_broadcast_f64x4(0x0F, first), 0xF0, second);
+}
+
+// The records of eight atoms transposed into x, y, z and q. Records pair up
+// as [0 | 2], [1 | 3], [4 | 6], [5 | 7] so that the unpacks and one 128-bit
+// shuffle leave the lanes in order. The zero-masked forms keep GCC from
+// flagging the undefined registers the plain intrinsics start from.
+[[gnu::always_inline]] RMS_TARGET("avx512f") inline void load_records_avx512(double const *atoms, int const *index,
+  __m512d &x, __m512d &y, __m512d &z, __m512d &q) noexcept {
+  __m512d const r02 = join_records_avx512(atoms, index[0], index[2]);
+  __m512d const r13 = join_records_avx512(atoms, index[1], index[3]);
+  __m512d const r46 = join_records_avx512(atoms, index[4], index[6]);
+  __m512d const r57 = join_records_avx512(atoms, index[5], index[7]);
+  __m512d const xz_low = _mm512_maskz_unpacklo_pd(0xFF, r02, r13);
+  __m512d const yq_low = _mm512_maskz_unpackhi_pd(0xFF, r02, r13);
+  __m512d const xz_high = _mm512_maskz_unpacklo_pd(0xFF, r46, r57);
+  __m512d const yq_high = _mm512_maskz_unpackhi_pd(0xFF, r46, r57);
+  // Even 128-bit lanes hold x (or y), odd ones z (or q).
+  x = _mm512_maskz_shuffle_f64x2(0xFF, xz_low, xz_high, 0x88);
+  z = _mm512_maskz_shuffle_f64x2(0xFF, xz_low, xz_high, 0xDD);
+  y = _mm512_maskz_shuffle_f64x2(0xFF, yq_low, yq_high, 0x88);
+  q = _mm512_maskz_shuffle_f64x2(0xFF, yq_low, yq_high, 0xDD);
+}
+
+// Eight partners at a time, with masked gathers so lanes past the cutoff load
+// no LJ coefficients, and partner forces gathered, added and scattered back.
+template <bool Forces>
+RMS_TARGET("avx512f")
+void rows_avx512(const PairKernel &k, std::size_t begin, std::size_t end, PairSums &sums,
+  const ForceSink &sink) noexcept {
+  __m512d const cutoff2 = _mm512_set1_pd(k.cutoff2);
+  __m512d const one = _mm512_set1_pd(1.0);
+  __m512d const six = _mm512_set1_pd(6.0);
+  __m512d const twelve = _mm512_set1_pd(12.0);
+  __m512d const zero = _mm512_setzero_pd();
+  // Unmasked gathers go through the masked form too, for the same reason.
+  __mmask8 const all = 0xFF;
+  __m512d vdw = zero;
+  __m512d elec = zero;
+  PairSums tail;
+  for (std::size_t atom = begin; atom < end; ++atom) {
+    double const *const record = k.atoms + 4 * atom;
+    Vec3 const ri = {record[0], record[1], record[2]};
+    double const qi = record[3];
+    int const row = k.lj_row[atom];
+    __m512d const xi = _mm512_set1_pd(ri[0]);
+    __m512d const yi = _mm512_set1_pd(ri[1]);
+    __m512d const zi = _mm512_set1_pd(ri[2]);
+    __m512d const vqi = _mm512_set1_pd(qi);
+    __m256i const vrow = _mm256_set1_epi32(row);
+    __m512d fx = zero;
+    __m512d fy = zero;
+    __m512d fz = zero;
+    Vec3 fi{};
+    std::size_t slot = k.offsets[atom];
+    std::size_t const last = k.offsets[atom + 1];
+    for (; slot + 8 <= last; slot += 8) {
+      __m256i const j = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(k.partners + slot));
+      __m256i const s = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(k.shifts + slot)));
+      __m512d xj;
+      __m512d yj;
+      __m512d zj;
+      __m512d qj;
+      load_records_avx512(k.atoms, k.partners + slot, xj, yj, zj, qj);
+      __m512d const dx = _mm512_sub_pd(_mm512_add_pd(xj, _mm512_mask_i32gather_pd(zero, all, s, k.shift_x, 8)), xi);
+      __m512d const dy = _mm512_sub_pd(_mm512_add_pd(yj, _mm512_mask_i32gather_pd(zero, all, s, k.shift_y, 8)), yi);
+      __m512d const dz = _mm512_sub_pd(_mm512_add_pd(zj, _mm512_mask_i32gather_pd(zero, all, s, k.shift_z, 8)), zi);
+      __m512d const r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+      __mmask8 const in = _mm512_cmp_pd_mask(r2, cutoff2, _CMP_LT_OQ);
+      if (in == 0) {
+        continue;
+      }
+      __m512d const inv_r = _mm512_maskz_div_pd(in, one, _mm512_maskz_sqrt_pd(in, r2));
+      __m512d const inv_r2 = _mm512_mul_pd(inv_r, inv_r);
+      __m512d const inv_r6 = _mm512_mul_pd(_mm512_mul_pd(inv_r2, inv_r2), inv_r2);
+      __m256i const idx = _mm256_add_epi32(vrow, _mm256_i32gather_epi32(k.lj_col, j, 4));
+      __m512d const a = _mm512_mask_i32gather_pd(zero, in, idx, k.lj, 8);
+      __m512d const b = _mm512_mask_i32gather_pd(zero, in, idx, k.lj + 1, 8);
+      __m512d const a12 = _mm512_mul_pd(_mm512_mul_pd(a, inv_r6), inv_r6);
+      __m512d const b6 = _mm512_mul_pd(b, inv_r6);
+      __m512d const e = _mm512_mul_pd(_mm512_mul_pd(vqi, qj), inv_r);
+      vdw = _mm512_add_pd(vdw, _mm512_sub_pd(a12, b6));
+      elec = _mm512_add_pd(elec, e);
+      if constexpr (Forces) {
+        __m512d const f = _mm512_mul_pd(_mm512_fmadd_pd(twelve, a12, _mm512_fnmadd_pd(six, b6, e)), inv_r2);
+        __m512d const fxj = _mm512_mul_pd(f, dx);
+        __m512d const fyj = _mm512_mul_pd(f, dy);
+        __m512d const fzj = _mm512_mul_pd(f, dz);
+        fx = _mm512_sub_pd(fx, fxj);
+        fy = _mm512_sub_pd(fy, fyj);
+        fz = _mm512_sub_pd(fz, fzj);
+        __m512d const gx = _mm512_mask_i32gather_pd(zero, in, j, sink.x, 8);
+        __m512d const gy = _mm512_mask_i32gather_pd(zero, in, j, sink.y, 8);
+        __m512d const gz = _mm512_mask_i32gather_pd(zero, in, j, sink.z, 8);
+        _mm512_mask_i32scatter_pd(sink.x, in, j, _mm512_add_pd(gx, fxj), 8);
+        _mm512_mask_i32scatter_pd(sink.y, in, j, _mm512_add_pd(gy, fyj), 8);
+        _mm512_mask_i32scatter_pd(sink.z, in, j, _mm512_add_pd(gz, fzj), 8);
+      }
+    }
+    for (; slot < last; ++slot) {
+      pair_scalar<Forces>(k, slot, ri, qi, row, tail, fi, sink);
+    }
+    if constexpr (Forces) {
+      sink.x[atom] += hsum_avx512(fx) + fi[0];
+      sink.y[atom] += hsum_avx512(fy) + fi[1];
+      sink.z[atom] += hsum_avx512(fz) + fi[2];
+    }
+  }
+  sums.vdw += hsum_avx512(vdw) + tail.vdw;
+  sums.elec += hsum_avx512(elec) + tail.elec;
+}
+#endif
+
+[[nodiscard]] RowsFn select_rows(SimdLevel level, bool forces) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return forces ? &rows_avx512<true> : &rows_avx512<false>;
+  }
+  if (level >= SimdLevel::Avx2) {
+    return forces ? &rows_avx2<true> : &rows_avx2<false>;
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return forces ? &rows_scalar<true> : &rows_scalar<false>;
+}
+
+void require_size(std::string_view name, std::size_t size, std::size_t expected) {
+  if (size != expected) {
+    throw std::runtime_error(fmt::format("NonbondedEngine needs {} with {} entries, got {}", name, expected, size));
+  }
+}
+
+[[nodiscard]] VerletList make_neighbors(const Parm7Topology &topo, const NonbondedOptions &options) {
+  ExclusionList const exclusions(topo, options.threads);
+  return VerletList(
+    NeighborOptions{.cutoff = options.cutoff, .skin = options.skin, .threads = options.threads}, &exclusions);
+}
+
+} // namespace
+
+NonbondedEngine::NonbondedEngine(const Parm7Topology &topo, const NonbondedOptions &options)
+    : NonbondedEngine(topo, AtomSelection::all(static_cast<std::size_t>(topo.pointers.natom)), options) {}
+
+NonbondedEngine::NonbondedEngine(const Parm7Topology &topo, const AtomSelection &selection,
+  const NonbondedOptions &options)
+    : options_(options), one_four_(topo, options.threads), neighbors_(make_neighbors(topo, options)) {
+  options_.level = std::min(options_.level, detected_simd_level());
+  auto const natom = static_cast<std::size_t>(topo.pointers.natom);
+  if (selection.natom() != natom) {
+    throw std::invalid_argument(
+      fmt::format("Nonbonded selection is for {} atoms, but the topology has {}", selection.natom(), natom));
+  }
+  require_size("CHARGE", topo.charge.size(), natom);
+  require_size("ATOM_TYPE_INDEX", topo.atom_type_index.size(), natom);
+  LJTable const table(topo);
+  std::size_t const ntypes = table.ntypes();
+  ntypes_ = ntypes + 1;
+  if (2 * ntypes_ * ntypes_ > static_cast<std::size_t>(INT_MAX)) {
+    throw std::runtime_error(fmt::format("NonbondedEngine supports at most 32766 atom types, got {}", ntypes));
+  }
+  lj_.assign(2 * ntypes_ * ntypes_, 0.0);
+  for (std::size_t type_i = 0; type_i < ntypes; ++type_i) {
+    std::copy_n(table.coefficients().begin() + static_cast<std::ptrdiff_t>(2 * type_i * ntypes), 2 * ntypes,
+      lj_.begin() + static_cast<std::ptrdiff_t>(2 * type_i * ntypes_));
+  }
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    int const type = topo.atom_type_index[atom];
+    if (type < 0 || std::cmp_greater_equal(type, ntypes)) {
+      throw std::runtime_error(fmt::format("ATOM_TYPE_INDEX entry {} is {}, outside [1, {}]", atom, type + 1, ntypes));
+    }
+  }
+  charge_.assign(topo.charge.begin(), topo.charge.end());
+  type_.assign(topo.atom_type_index.begin(), topo.atom_type_index.end());
+  if (selection.size() != natom) {
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      if (!selection.contains(atom)) {
+        charge_[atom] = 0.0;
+        type_[atom] = static_cast<int>(ntypes);
+      }
+    }
+  }
+}
+
+NonbondedEnergy NonbondedEngine::evaluate(const Coordinates &positions, const std::optional<PeriodicBox> &box,
+  Coordinates *forces) {
+  std::size_t const natom = atom_count();
+  if (positions.size() != natom || positions.y.size() != natom || positions.z.size() != natom) {
+    throw std::invalid_argument(
+      fmt::format("NonbondedEngine expects {} atoms, got {}", natom, positions.size()));
+  }
+  bool const rebuilt = neighbors_.update(positions, box);
+  auto const order = neighbors_.order();
+  if (rebuilt || row_of_.size() != natom) {
+    // Per-row copies of everything that follows the list's cell order.
+    auto const ntypes = static_cast<int>(ntypes_);
+    row_of_.resize(natom);
+    lj_row_.resize(natom);
+    lj_col_.resize(natom);
+    for (std::size_t row = 0; row < natom; ++row) {
+      auto const atom = static_cast<std::size_t>(order[row]);
+      row_of_[atom] = static_cast<int>(row);
+      lj_row_[row] = 2 * type_[atom] * ntypes;
+      lj_col_[row] = 2 * type_[atom];
+    }
+    auto const vectors = neighbors_.shift_vectors();
+    shift_x_.resize(vectors.size());
+    shift_y_.resize(vectors.size());
+    shift_z_.resize(vectors.size());
+    for (std::size_t id = 0; id < vectors.size(); ++id) {
+      shift_x_[id] = vectors[id][0];
+      shift_y_[id] = vectors[id][1];
+      shift_z_[id] = vectors[id][2];
+    }
+  }
+
+  // Positions and charges interleaved in row order, so a partner is one
+  // 32-byte load and the partners of a row are a few contiguous runs.
+  records_.resize(4 * natom);
+  for (std::size_t row = 0; row < natom; ++row) {
+    auto const atom = static_cast<std::size_t>(order[row]);
+    records_[4 * row] = positions.x[atom];
+    records_[4 * row + 1] = positions.y[atom];
+    records_[4 * row + 2] = positions.z[atom];
+    records_[4 * row + 3] = charge_[atom];
+  }
+
+  auto const offsets = neighbors_.offsets();
+  PairKernel const kernel{.offsets = offsets.data(),
+    .partners = neighbors_.partners().data(),
+    .shifts = neighbors_.shifts().data(),
+    .atoms = records_.data(),
+    .shift_x = shift_x_.data(),
+    .shift_y = shift_y_.data(),
+    .shift_z = shift_z_.data(),
+    .lj_row = lj_row_.data(),
+    .lj_col = lj_col_.data(),
+    .lj = lj_.data(),
+    .cutoff2 = options_.cutoff * options_.cutoff};
+  RowsFn const rows = select_rows(options_.level, forces != nullptr);
+
+  // Contiguous row ranges with equal shares of the pairs (and of the 1-4
+  // list), fixed by the thread count alone so the sums are reproducible.
+  std::size_t const workers = std::max<std::size_t>(1, std::min(resolve_thread_count(options_.threads), natom));
+  std::size_t const pairs = neighbors_.pair_count();
+  auto const row_start = [&](std::size_t worker) {
+    if (worker >= workers) {
+      return natom;
+    }
+    auto const starts = offsets.first(natom);
+    return static_cast<std::size_t>(std::ranges::lower_bound(starts, pairs * worker / workers) - starts.begin());
+  };
+
+  if (forces != nullptr) {
+    forces->resize(natom);
+    scratch_.resize(workers);
+  }
+  std::vector<NonbondedEnergy> partial(workers);
+  parallel_for(workers, workers, [&](std::size_t worker) {
+    ForceSink sink;
+    if (forces != nullptr) {
+      auto &buffer = scratch_[worker];
+      buffer.resize(natom);
+      std::ranges::fill(buffer.x, 0.0);
+      std::ranges::fill(buffer.y, 0.0);
+      std::ranges::fill(buffer.z, 0.0);
+      sink = ForceSink{.x = buffer.x.data(), .y = buffer.y.data(), .z = buffer.z.data()};
+    }
+    PairSums sums;
+    rows(kernel, row_start(worker), row_start(worker + 1), sums, sink);
+    auto &out = partial[worker];
+    out.vdw = sums.vdw;
+    out.elec = sums.elec;
+
+    // 1-4 terms, outside the list (the topology excludes these pairs) and
+    // without the cutoff; imaged only so wrapped molecules stay whole.
+    for (std::size_t idx = one_four_.size() * worker / workers; idx < one_four_.size() * (worker + 1) / workers;
+         ++idx) {
+      auto const i = static_cast<std::size_t>(row_of_[static_cast<std::size_t>(one_four_.i()[idx])]);
+      auto const j = static_cast<std::size_t>(row_of_[static_cast<std::size_t>(one_four_.j()[idx])]);
+      double const scee = one_four_.scee()[idx];
+      double const scnb = one_four_.scnb()[idx];
+      double const *ri = records_.data() + 4 * i;
+      double const *rj = records_.data() + 4 * j;
+      Vec3 d = {rj[0] - ri[0], rj[1] - ri[1], rj[2] - ri[2]};
+      if (box) {
+        d = box->minimum_image(d);
+      }
+      double const r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+      double const inv_r = 1.0 / std::sqrt(r2);
+      double const inv_r2 = inv_r * inv_r;
+      double const inv_r6 = inv_r2 * inv_r2 * inv_r2;
+      auto const idx_lj = static_cast<std::size_t>(lj_row_[i] + lj_col_[j]);
+      double const a12 = lj_[idx_lj] * inv_r6 * inv_r6 / scnb;
+      double const b6 = lj_[idx_lj + 1] * inv_r6 / scnb;
+      double const elec = ri[3] * rj[3] * inv_r / scee;
+      out.vdw14 += a12 - b6;
+      out.elec14 += elec;
+      if (forces != nullptr) {
+        double const f = (12.0 * a12 - 6.0 * b6 + elec) * inv_r2;
+        sink.x[i] -= f * d[0];
+        sink.y[i] -= f * d[1];
+        sink.z[i] -= f * d[2];
+        sink.x[j] += f * d[0];
+        sink.y[j] += f * d[1];
+        sink.z[j] += f * d[2];
+      }
+    }
+  });
+
+  // Sum the worker buffers in worker order and put rows back in atom order.
+  if (forces != nullptr) {
+    std::size_t const blocks = (natom + kAtomsPerReduce - 1) / kAtomsPerReduce;
+    parallel_for(blocks, options_.threads, [&](std::size_t block) {
+      std::size_t const begin = block * kAtomsPerReduce;
+      std::size_t const end = std::min(natom, begin + kAtomsPerReduce);
+      for (std::size_t row = begin; row < end; ++row) {
+        double fx = 0.0;
+        double fy = 0.0;
+        double fz = 0.0;
+        for (auto const &buffer : scratch_) {
+          fx += buffer.x[row];
+          fy += buffer.y[row];
+          fz += buffer.z[row];
+        }
+        auto const atom = static_cast<std::size_t>(order[row]);
+        forces->x[atom] = fx;
+        forces->y[atom] = fy;
+        forces->z[atom] = fz;
+      }
+    });
+  }
+
+  NonbondedEnergy total;
+  for (auto const &part : partial) {
+    total.vdw += part.vdw;
+    total.elec += part.elec;
+    total.vdw14 += part.vdw14;
+    total.elec14 += part.elec14;
+  }
+  return total;
+}
+
+} // namespace rms
@@ -0,0 +1,179 @@
+#include "include/one_four.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+// Amber's 1-4 divisors for topologies written before SCEE / SCNB were stored.
+constexpr double kDefaultScee = 1.2;
+constexpr double kDefaultScnb = 2.0;
+// Below this many entries per worker, extra workers cost more than they save.
+constexpr std::size_t kEntriesPerTask = 16384;
+constexpr unsigned kDigitBits = 11;
+constexpr std::size_t kBuckets = std::size_t{1} << kDigitBits;
+
+// [begin, end) of block `block` when `count` entries are split `blocks` ways.
+[[nodiscard]] std::size_t block_start(std::size_t count, std::size_t blocks, std::size_t block) noexcept {
+  return count * block / blocks;
+}
+
+// Stable LSD radix sort of `keys` (and `types` alongside) on the low `bits`
+// bits. Every pass histograms its digit per block, so block b's entries of a
+// digit land after those of blocks < b, which keeps equal keys in input order.
+void radix_sort(std::vector<std::uint64_t> &keys, std::vector<int> &types, unsigned bits, std::size_t blocks,
+  std::size_t threads) {
+  std::size_t const count = keys.size();
+  std::vector<std::uint64_t> key_scratch(count);
+  std::vector<int> type_scratch(count);
+  std::vector<std::array<std::size_t, kBuckets>> counts(blocks);
+  for (unsigned shift = 0; shift < bits; shift += kDigitBits) {
+    auto const digit = [shift](std::uint64_t key) { return (key >> shift) & (kBuckets - 1); };
+    parallel_for(blocks, threads, [&](std::size_t block) {
+      auto &local = counts[block];
+      local.fill(0);
+      for (auto idx = block_start(count, blocks, block); idx < block_start(count, blocks, block + 1); ++idx) {
+        ++local[digit(keys[idx])];
+      }
+    });
+    // Exclusive prefix over (digit, block), in that order.
+    std::size_t next = 0;
+    for (std::size_t bucket = 0; bucket < kBuckets; ++bucket) {
+      for (auto &local : counts) {
+        auto const here = local[bucket];
+        local[bucket] = next;
+        next += here;
+      }
+    }
+    parallel_for(blocks, threads, [&](std::size_t block) {
+      auto &local = counts[block];
+      for (auto idx = block_start(count, blocks, block); idx < block_start(count, blocks, block + 1); ++idx) {
+        auto const slot = local[digit(keys[idx])]++;
+        key_scratch[slot] = keys[idx];
+        type_scratch[slot] = types[idx];
+      }
+    });
+    keys.swap(key_scratch);
+    types.swap(type_scratch);
+  }
+}
+
+void require_size(std::string_view name, std::size_t size, std::size_t expected) {
+  if (size != expected) {
+    throw std::runtime_error(fmt::format("OneFourList needs {} with {} entries, got {}", name, expected, size));
+  }
+}
+
+} // namespace
+
+OneFourList::OneFourList(const Parm7Topology &topo, std::size_t threads) {
+  if ((topo.loaded_sections & section_bit(Parm7Section::DihedralsIncHydrogen)) == 0) {
+    throw std::runtime_error("OneFourList needs the DIHEDRALS sections to be loaded");
+  }
+  auto const natom = static_cast<std::size_t>(topo.pointers.natom);
+  bool const scaled = !topo.scee_scale_factor.empty() || !topo.scnb_scale_factor.empty();
+  if (scaled) {
+    require_size("SCEE_SCALE_FACTOR", topo.scee_scale_factor.size(), topo.dihedral_force_constant.size());
+    require_size("SCNB_SCALE_FACTOR", topo.scnb_scale_factor.size(), topo.dihedral_force_constant.size());
+  }
+  std::size_t const dihedrals = topo.dihedral_i.size();
+  std::size_t const blocks =
+    std::max<std::size_t>(1, std::min(resolve_thread_count(threads), dihedrals / kEntriesPerTask));
+
+  // Pass 1: count the unflagged dihedrals per block, checking their atoms.
+  std::vector<std::size_t> kept(blocks + 1, 0);
+  parallel_for(blocks, threads, [&](std::size_t block) {
+    std::size_t count = 0;
+    for (auto idx = block_start(dihedrals, blocks, block); idx < block_start(dihedrals, blocks, block + 1); ++idx) {
+      if ((topo.dihedral_flags[idx] & 0x1U) != 0) {
+        continue;
+      }
+      int const first = topo.dihedral_i[idx];
+      int const last = topo.dihedral_l[idx];
+      if (first < 0 || last < 0 || static_cast<std::size_t>(first) >= natom || static_cast<std::size_t>(last) >= natom
+          || first == last) {
+        throw std::runtime_error(fmt::format(
+          "Dihedral {} has 1-4 atoms {} and {}, outside [0, {}) or equal", idx, first, last, natom));
+      }
+      auto const type = static_cast<std::size_t>(topo.dihedral_type[idx]);
+      if (scaled && type >= topo.scee_scale_factor.size()) {
+        throw std::runtime_error(
+          fmt::format("Dihedral {} has type {}, outside [0, {})", idx, type, topo.scee_scale_factor.size()));
+      }
+      ++count;
+    }
+    kept[block + 1] = count;
+  });
+  for (std::size_t block = 0; block < blocks; ++block) {
+    kept[block + 1] += kept[block];
+  }
+
+  // Pass 2: keys in dihedral order, so the stable sort keeps the first
+  // dihedral of each pair in front.
+  unsigned const atom_bits = natom > 1 ? static_cast<unsigned>(std::bit_width(natom - 1)) : 1U;
+  std::vector<std::uint64_t> keys(kept.back());
+  std::vector<int> types(kept.back());
+  parallel_for(blocks, threads, [&](std::size_t block) {
+    auto out = kept[block];
+    for (auto idx = block_start(dihedrals, blocks, block); idx < block_start(dihedrals, blocks, block + 1); ++idx) {
+      if ((topo.dihedral_flags[idx] & 0x1U) != 0) {
+        continue;
+      }
+      auto const first = static_cast<std::uint64_t>(std::min(topo.dihedral_i[idx], topo.dihedral_l[idx]));
+      auto const last = static_cast<std::uint64_t>(std::max(topo.dihedral_i[idx], topo.dihedral_l[idx]));
+      keys[out] = first << atom_bits | last;
+      types[out] = topo.dihedral_type[idx];
+      ++out;
+    }
+  });
+  std::size_t const sort_blocks =
+    std::max<std::size_t>(1, std::min(resolve_thread_count(threads), keys.size() / kEntriesPerTask));
+  radix_sort(keys, types, 2 * atom_bits, sort_blocks, threads);
+
+  // Pass 3: keep the first key of each run, counted then written per block.
+  std::vector<std::size_t> unique(sort_blocks + 1, 0);
+  auto const leads = [&](std::size_t idx) { return idx == 0 || keys[idx] != keys[idx - 1]; };
+  parallel_for(sort_blocks, threads, [&](std::size_t block) {
+    std::size_t count = 0;
+    for (auto idx = block_start(keys.size(), sort_blocks, block);
+         idx < block_start(keys.size(), sort_blocks, block + 1); ++idx) {
+      count += leads(idx) ? 1U : 0U;
+    }
+    unique[block + 1] = count;
+  });
+  for (std::size_t block = 0; block < sort_blocks; ++block) {
+    unique[block + 1] += unique[block];
+  }
+  i_.resize(unique.back());
+  j_.resize(unique.back());
+  scee_.resize(unique.back());
+  scnb_.resize(unique.back());
+  std::uint64_t const low_mask = (std::uint64_t{1} << atom_bits) - 1;
+  parallel_for(sort_blocks, threads, [&](std::size_t block) {
+    auto out = unique[block];
+    for (auto idx = block_start(keys.size(), sort_blocks, block);
+         idx < block_start(keys.size(), sort_blocks, block + 1); ++idx) {
+      if (!leads(idx)) {
+        continue;
+      }
+      auto const type = static_cast<std::size_t>(types[idx]);
+      i_[out] = static_cast<int>(keys[idx] >> atom_bits);
+      j_[out] = static_cast<int>(keys[idx] & low_mask);
+      scee_[out] = scaled ? topo.scee_scale_factor[type] : kDefaultScee;
+      scnb_[out] = scaled ? topo.scnb_scale_factor[type] : kDefaultScnb;
+      ++out;
+    }
+  });
+}
+
+} // namespace rms
@@ -0,0 +1,177 @@
+#include "include/pairwise.hpp"
+#include "include/mask.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::array<char, 8> kMatrixMagic = {'R', 'M', 'S', 'P', 'A', 'I', 'R', 'S'};
+constexpr std::uint32_t kByteOrderTag = 0x01020304;
+// Cache budget for the two frame blocks of a tile, about half a typical L2.
+constexpr std::size_t kTileBytes = std::size_t{512} << 10U;
+constexpr std::size_t kMaxBlockFrames = 512;
+
+struct MatrixHeader {
+  std::array<char, 8> magic{};
+  std::uint32_t version = 0;
+  std::uint32_t byte_order = 0;
+  std::uint64_t frames = 0;
+  std::uint64_t natom = 0;
+  std::uint64_t weighted = 0;
+  std::array<std::uint64_t, 3> reserved{};
+};
+static_assert(sizeof(MatrixHeader) == kCacheLineSize);
+
+[[nodiscard]] std::size_t condensed_size(std::size_t frames) noexcept {
+  return frames < 2 ? 0 : frames * (frames - 1) / 2;
+}
+
+} // namespace
+
+PackedFrames::PackedFrames(const MdcrdTrajectory &trajectory, std::span<const double> weights, std::size_t threads,
+  std::span<const int> atoms)
+    : natom_(atoms.empty() ? trajectory.natom() : atoms.size()),
+      stride_((natom_ + kPackedFrameAlign - 1) / kPackedFrameAlign * kPackedFrameAlign), weighted_(!weights.empty()) {
+  auto const total = trajectory.natom();
+  if (std::ranges::any_of(atoms, [total](int atom) { return atom < 0 || static_cast<std::size_t>(atom) >= total; })) {
+    throw std::invalid_argument(fmt::format("Selected atom is outside the trajectory's {} atoms", total));
+  }
+  if (weighted_ && weights.size() != natom_) {
+    throw std::invalid_argument(
+      fmt::format("Trajectory has {} atoms, but {} weights were given", natom_, weights.size()));
+  }
+  // Frames are scaled by sqrt(w), so sum (sqrt(w) a)(sqrt(w) b) is the weighted
+  // covariance and the kernel streams no weights.
+  std::vector<double> scale(natom_, 1.0);
+  total_weight_ = static_cast<double>(natom_);
+  if (weighted_) {
+    total_weight_ = 0.0;
+    for (std::size_t atom = 0; atom < natom_; ++atom) {
+      if (!(weights[atom] >= 0.0)) {
+        throw std::invalid_argument(fmt::format("RMSD weight {} is negative", atom));
+      }
+      scale[atom] = std::sqrt(weights[atom]);
+      total_weight_ += weights[atom];
+    }
+    if (natom_ > 0 && !(total_weight_ > 0.0)) {
+      throw std::invalid_argument("RMSD weights sum to zero");
+    }
+  }
+
+  auto const frames = trajectory.frame_count();
+  values_.assign(frames * 3 * stride_, 0.0F);
+  inner_.assign(frames, 0.0);
+  auto const workers = std::min(resolve_thread_count(threads), std::max<std::size_t>(1, frames));
+  std::vector<MdcrdFrame> buffers(workers);
+  std::vector<Coordinates> selected(atoms.empty() ? 0 : workers);
+  parallel_for_stealing(frames, threads, [&](std::size_t worker, std::size_t idx) {
+    auto &buffer = buffers[worker];
+    trajectory.read_frame(idx, buffer);
+    auto const *positions = &buffer.positions;
+    if (!atoms.empty()) {
+      gather(buffer.positions, atoms, selected[worker]);
+      positions = &selected[worker];
+    }
+    std::array<double const *, 3> const source = {positions->x.data(), positions->y.data(), positions->z.data()};
+    auto *out = values_.data() + idx * 3 * stride_;
+    double inner = 0.0;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      double sum = 0.0;
+      for (std::size_t atom = 0; atom < natom_; ++atom) {
+        sum += scale[atom] * scale[atom] * source[axis][atom];
+      }
+      double const centre = total_weight_ > 0.0 ? sum / total_weight_ : 0.0;
+      // The inner product is taken over the stored floats, so it matches the
+      // covariance the kernel sums from them.
+      for (std::size_t atom = 0; atom < natom_; ++atom) {
+        auto const value = static_cast<float>(scale[atom] * (source[axis][atom] - centre));
+        out[axis * stride_ + atom] = value;
+        inner += static_cast<double>(value) * static_cast<double>(value);
+      }
+    }
+    inner_[idx] = inner;
+  });
+}
+
+void write_pairwise_rmsd(const std::filesystem::path &out, const PackedFrames &frames,
+  const PairwiseRmsdOptions &options) {
+  auto const count = frames.frame_count();
+  auto const level = std::min(options.level, detected_simd_level());
+  auto const frame_bytes = std::max<std::size_t>(1, frames.stride() * 3 * sizeof(float));
+  auto const block = options.block_frames > 0
+                       ? options.block_frames
+                       : std::clamp<std::size_t>(kTileBytes / (2 * frame_bytes), 1, kMaxBlockFrames);
+
+  MappedOutputFile file(out, sizeof(MatrixHeader) + condensed_size(count) * sizeof(float));
+  MatrixHeader header;
+  header.magic = kMatrixMagic;
+  header.version = kRmsdMatrixVersion;
+  header.byte_order = kByteOrderTag;
+  header.frames = count;
+  header.natom = frames.natom();
+  header.weighted = frames.weighted() ? 1 : 0;
+  std::memcpy(file.bytes().data(), &header, sizeof(header));
+  auto *values = reinterpret_cast<float *>(file.bytes().data() + sizeof(header));
+
+  // Tiles (I, J) with I <= J, row by row. Diagonal tiles hold half the pairs,
+  // and dynamic scheduling evens that out.
+  auto const blocks = (count + block - 1) / block;
+  std::vector<std::pair<std::size_t, std::size_t>> tiles;
+  tiles.reserve(blocks * (blocks + 1) / 2);
+  for (std::size_t row = 0; row < blocks; ++row) {
+    for (std::size_t col = row; col < blocks; ++col) {
+      tiles.emplace_back(row, col);
+    }
+  }
+  parallel_for(tiles.size(), options.threads, [&](std::size_t task) {
+    auto const [row, col] = tiles[task];
+    auto const row_end = std::min(count, (row + 1) * block);
+    auto const col_end = std::min(count, (col + 1) * block);
+    for (auto i = row * block; i < row_end; ++i) {
+      auto const first = std::max(col * block, i + 1);
+      if (first >= col_end) {
+        continue;
+      }
+      auto *dst = values + condensed_index(count, i, first);
+      for (auto j = first; j < col_end; ++j) {
+        *dst++ = static_cast<float>(frames.rmsd(i, j, level));
+      }
+    }
+  });
+  file.sync();
+}
+
+RmsdMatrix::RmsdMatrix(const std::filesystem::path &path) : file_(path) {
+  auto const bytes = file_.bytes();
+  MatrixHeader header;
+  if (bytes.size() < sizeof(header)) {
+    throw std::runtime_error(fmt::format("RMSD matrix is truncated: {}", path.string()));
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != kMatrixMagic || header.byte_order != kByteOrderTag) {
+    throw std::runtime_error(fmt::format("Not an RMSD matrix: {}", path.string()));
+  }
+  if (header.version != kRmsdMatrixVersion) {
+    throw std::runtime_error(
+      fmt::format("RMSD matrix {} has version {}, expected {}", path.string(), header.version, kRmsdMatrixVersion));
+  }
+  frames_ = header.frames;
+  natom_ = header.natom;
+  weighted_ = header.weighted != 0;
+  auto const values = condensed_size(frames_);
+  if (bytes.size() != sizeof(header) + values * sizeof(float)) {
+    throw std::runtime_error(fmt::format("RMSD matrix size does not match its header: {}", path.string()));
+  }
+  values_ = {reinterpret_cast<float const *>(bytes.data() + sizeof(header)), values};
+}
+
+} // namespace rms
@@ -0,0 +1,77 @@
+#include "include/parallel.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace rms {
+namespace {
+
+// Set while a thread runs its share of a job, so nested loops run inline
+// rather than waiting for the job they are part of.
+thread_local bool t_in_job = false;
+
+} // namespace
+
+ThreadPool &ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::~ThreadPool() {
+  stopping_ = true;
+  generation_.fetch_add(1, std::memory_order_release);
+  generation_.notify_all();
+}
+
+void ThreadPool::dispatch(std::size_t workers, Call call, void const *context) {
+  if (workers <= 1 || t_in_job) {
+    call(context, 0);
+    return;
+  }
+
+  std::scoped_lock const lock(jobs_);
+  while (threads_.size() + 1 < workers) {
+    // A new thread waits for the generation after the current one, which is
+    // the job published below.
+    threads_.emplace_back(
+      [this, worker = threads_.size() + 1, seen = generation_.load(std::memory_order_relaxed)] { work(worker, seen); });
+  }
+  workers_ = workers;
+  call_ = call;
+  context_ = context;
+  pending_.store(threads_.size(), std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_release);
+  generation_.notify_all();
+
+  t_in_job = true;
+  call(context, 0);
+  t_in_job = false;
+  for (auto left = pending_.load(std::memory_order_acquire); left != 0;
+       left = pending_.load(std::memory_order_acquire)) {
+    pending_.wait(left, std::memory_order_acquire);
+  }
+}
+
+void ThreadPool::work(std::size_t worker, std::uint64_t seen) {
+  for (;;) {
+    generation_.wait(seen, std::memory_order_acquire);
+    seen = generation_.load(std::memory_order_acquire);
+    if (stopping_) {
+      return;
+    }
+    if (worker < workers_) {
+      t_in_job = true;
+      call_(context_, worker);
+      t_in_job = false;
+    }
+    // Every thread checks in, so none can still be reading the job when the
+    // next one is written.
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pending_.notify_one();
+    }
+  }
+}
+
+} // namespace rms
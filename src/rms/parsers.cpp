@@ -1,16 +1,24 @@
 #include "include/parsers.hpp"
+#include "include/fixed_width.hpp"
+#include "include/mapped_file.hpp"
+#include "include/parallel.hpp"
 #include "include/utils.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
 #include <limits>
+#include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
 
 #include <fmt/format.h>
 
@@ -23,56 +31,9 @@ struct FormatSpec {
   int width = 0;
 };
 
-enum class Section {
-  None,
-  Unknown,
-  Title,
-  Pointers,
-  AtomName,
-  Charge,
-  AtomicNumber,
-  Mass,
-  AtomTypeIndex,
-  NumberExcludedAtoms,
-  ExcludedAtomsList,
-  NonbondedParmIndex,
-  ResidueLabel,
-  ResiduePointer,
-  BondForceConstant,
-  BondEquilValue,
-  AngleForceConstant,
-  AngleEquilValue,
-  DihedralForceConstant,
-  DihedralPeriodicity,
-  DihedralPhase,
-  SceeScaleFactor,
-  ScnbScaleFactor,
-  Solty,
-  LennardJonesAcoef,
-  LennardJonesBcoef,
-  BondsIncHydrogen,
-  BondsWithoutHydrogen,
-  AnglesIncHydrogen,
-  AnglesWithoutHydrogen,
-  DihedralsIncHydrogen,
-  DihedralsWithoutHydrogen,
-  HbondAcoef,
-  HbondBcoef,
-  HbondCut,
-  AmberAtomType,
-  TreeChainClassification,
-  JoinArray,
-  Irotat,
-  SolventPointers,
-  AtomsPerMolecule,
-  BoxDimensions,
-  RadiusSet,
-  Radii,
-  Screen,
-  Ipol
-};
+using Section = Parm7Section;
 
-constexpr std::array<std::pair<std::string_view, Section>, 44> kSectionMap = {
+constexpr std::array<std::pair<std::string_view, Section>, kParm7SectionCount> kSectionMap = {
   std::pair{"TITLE", Section::Title},
   std::pair{"POINTERS", Section::Pointers},
   std::pair{"ATOM_NAME", Section::AtomName},
@@ -123,6 +84,35 @@ constexpr std::array<std::pair<std::string_view, Section>, 44> kSectionMap = {
   return value.rfind(prefix, 0) == 0;
 }
 
+// Splits a byte buffer into lines without copying. Line terminators ("\n" or
+// "\r\n") are not part of the returned views.
+class LineReader
+{
+public:
+  explicit LineReader(std::span<const char> buffer) : cursor_(buffer.data()), end_(buffer.data() + buffer.size()) {}
+
+  [[nodiscard]] bool next(std::string_view &line) {
+    if (cursor_ == end_) {
+      return false;
+    }
+    auto const remaining = static_cast<std::size_t>(end_ - cursor_);
+    auto const *newline = static_cast<char const *>(std::memchr(cursor_, '\n', remaining));
+    char const *line_end = newline != nullptr ? newline : end_;
+    line = std::string_view(cursor_, static_cast<std::size_t>(line_end - cursor_));
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    cursor_ = newline != nullptr ? newline + 1 : end_;
+    return true;
+  }
+
+  [[nodiscard]] char const *position() const noexcept { return cursor_; }
+
+private:
+  char const *cursor_;
+  char const *end_;
+};
+
 [[nodiscard]] FormatSpec parse_format_line(std::string_view line) {
   auto const open = line.find('(');
   auto const close = line.find(')', open == std::string_view::npos ? 0 : open + 1);
@@ -156,61 +146,90 @@ constexpr std::array<std::pair<std::string_view, Section>, 44> kSectionMap = {
   return {count, type, width};
 }
 
-[[nodiscard]] Section parse_section_name(std::string_view line) {
+// Unknown flags yield nullopt; their bodies are indexed but never decoded.
+[[nodiscard]] std::optional<Section> parse_section_name(std::string_view line) {
   auto const name = trim(line.substr(6));
   for (auto const &[label, section] : kSectionMap) {
     if (name == label) {
       return section;
     }
   }
-  return Section::Unknown;
+  return std::nullopt;
 }
 
-[[nodiscard]] Parm7Pointers parse_pointers(const std::vector<int> &values) {
-  if (values.size() < kParm7PointerCount) {
-    throw std::runtime_error(fmt::format("POINTERS section has {} values, expected at least {}", values.size(),
-      kParm7PointerCount));
+// POINTERS entries in file order, with their Amber names for error messages.
+constexpr std::array<std::pair<std::string_view, std::int32_t Parm7Pointers::*>,
+  static_cast<std::size_t>(kParm7PointerCount)>
+  kPointerFields = {
+  std::pair{"NATOM", &Parm7Pointers::natom},
+  std::pair{"NTYPES", &Parm7Pointers::ntypes},
+  std::pair{"NBONH", &Parm7Pointers::nbonh},
+  std::pair{"MBONA", &Parm7Pointers::mbona},
+  std::pair{"NTHETH", &Parm7Pointers::ntheth},
+  std::pair{"MTHETA", &Parm7Pointers::mtheta},
+  std::pair{"NPHIH", &Parm7Pointers::nphih},
+  std::pair{"MPHIA", &Parm7Pointers::mphia},
+  std::pair{"NHPARM", &Parm7Pointers::nhparm},
+  std::pair{"NPARM", &Parm7Pointers::nparm},
+  std::pair{"NNB", &Parm7Pointers::nnb},
+  std::pair{"NRES", &Parm7Pointers::nres},
+  std::pair{"NBONA", &Parm7Pointers::nbona},
+  std::pair{"NTHETA", &Parm7Pointers::ntheta},
+  std::pair{"NPHIA", &Parm7Pointers::nphia},
+  std::pair{"NUMBND", &Parm7Pointers::numbnd},
+  std::pair{"NUMANG", &Parm7Pointers::numang},
+  std::pair{"NPTRA", &Parm7Pointers::nptra},
+  std::pair{"NATYP", &Parm7Pointers::natyp},
+  std::pair{"NPHB", &Parm7Pointers::nphb},
+  std::pair{"IFPERT", &Parm7Pointers::ifpert},
+  std::pair{"NBPER", &Parm7Pointers::nbper},
+  std::pair{"NGPER", &Parm7Pointers::ngper},
+  std::pair{"NDPER", &Parm7Pointers::ndper},
+  std::pair{"MBPER", &Parm7Pointers::mbper},
+  std::pair{"MGPER", &Parm7Pointers::mgper},
+  std::pair{"MDPER", &Parm7Pointers::mdper},
+  std::pair{"IFBOX", &Parm7Pointers::ifbox},
+  std::pair{"NMXRS", &Parm7Pointers::nmxrs},
+  std::pair{"IFCAP", &Parm7Pointers::ifcap},
+  std::pair{"NUMEXTRA", &Parm7Pointers::numextra}
+};
+
+[[nodiscard]] Parm7Pointers parse_pointers(std::span<const int> values) {
+  constexpr std::size_t kCount = kPointerFields.size();
+  if (values.size() < kCount) {
+    throw std::runtime_error(fmt::format("POINTERS section has {} values, expected at least {}", values.size(), kCount));
   }
 
   Parm7Pointers ptr;
-  ptr.natom = static_cast<std::uint16_t>(values[0]);
-  ptr.ntypes = static_cast<std::uint16_t>(values[1]);
-  ptr.nbonh = static_cast<std::uint16_t>(values[2]);
-  ptr.mbona = static_cast<std::uint16_t>(values[3]);
-  ptr.ntheth = static_cast<std::uint16_t>(values[4]);
-  ptr.mtheta = static_cast<std::uint16_t>(values[5]);
-  ptr.nphih = static_cast<std::uint16_t>(values[6]);
-  ptr.mphia = static_cast<std::uint16_t>(values[7]);
-  ptr.nhparm = static_cast<std::uint16_t>(values[8]);
-  ptr.nparm = static_cast<std::uint16_t>(values[9]);
-  ptr.nnb = static_cast<std::uint16_t>(values[10]);
-  ptr.nres = static_cast<std::uint16_t>(values[11]);
-  ptr.nbona = static_cast<std::uint16_t>(values[12]);
-  ptr.ntheta = static_cast<std::uint16_t>(values[13]);
-  ptr.nphia = static_cast<std::uint16_t>(values[14]);
-  ptr.numbnd = static_cast<std::uint16_t>(values[15]);
-  ptr.numang = static_cast<std::uint16_t>(values[16]);
-  ptr.nptra = static_cast<std::uint16_t>(values[17]);
-  ptr.natyp = static_cast<std::uint16_t>(values[18]);
-  ptr.nphb = static_cast<std::uint16_t>(values[19]);
-  ptr.ifpert = static_cast<std::uint16_t>(values[20]);
-  ptr.nbper = static_cast<std::uint16_t>(values[21]);
-  ptr.ngper = static_cast<std::uint16_t>(values[22]);
-  ptr.ndper = static_cast<std::uint16_t>(values[23]);
-  ptr.mbper = static_cast<std::uint16_t>(values[24]);
-  ptr.mgper = static_cast<std::uint16_t>(values[25]);
-  ptr.mdper = static_cast<std::uint16_t>(values[26]);
-  ptr.ifbox = static_cast<std::uint16_t>(values[27]);
-  ptr.nmxrs = static_cast<std::uint16_t>(values[28]);
-  ptr.ifcap = static_cast<std::uint16_t>(values[29]);
-  ptr.numextra = static_cast<std::uint16_t>(values[30]);
-  if (values.size() > kParm7PointerCount) {
-    ptr.ncopy = static_cast<std::uint16_t>(values[31]);
+  for (std::size_t idx = 0; idx < kCount; ++idx) {
+    auto const &[name, field] = kPointerFields[idx];
+    if (values[idx] < 0) {
+      throw std::runtime_error(fmt::format("POINTERS entry {} is negative: {}", name, values[idx]));
+    }
+    ptr.*field = values[idx];
+  }
+  if (values.size() > kCount) {
+    if (values[kCount] < 0) {
+      throw std::runtime_error(fmt::format("POINTERS entry NCOPY is negative: {}", values[kCount]));
+    }
+    ptr.ncopy = values[kCount];
+  }
+
+  // Connectivity sections store 3 * atom index, and the SoA arrays use int
+  // atom indices, so NATOM must leave room for that encoding.
+  constexpr auto kMaxAtoms = std::numeric_limits<int>::max() / 3;
+  if (ptr.natom > kMaxAtoms) {
+    throw std::runtime_error(fmt::format("POINTERS entry NATOM ({}) exceeds the supported maximum of {}", ptr.natom,
+      kMaxAtoms));
   }
   return ptr;
 }
 
-void reserve_from_pointers(Parm7Topology &topo, const Parm7Pointers &ptr) {
+// Calls `reserve(section, array, count)` for every topology array whose final
+// length POINTERS fixes. Interned names are sized by intern_names instead.
+template <typename Reserve>
+void for_each_sized_array(Parm7Topology &topo, const Parm7Pointers &ptr, Reserve &&reserve) {
+
   auto const natom = static_cast<std::size_t>(ptr.natom);
   auto const nnb = static_cast<std::size_t>(ptr.nnb);
   auto const nres = static_cast<std::size_t>(ptr.nres);
@@ -220,67 +239,75 @@ void reserve_from_pointers(Parm7Topology &topo, const Parm7Pointers &ptr) {
   auto const natyp = static_cast<std::size_t>(ptr.natyp);
   auto const ntypes = static_cast<std::size_t>(ptr.ntypes);
   auto const nphb = static_cast<std::size_t>(ptr.nphb);
-  auto const bond_count = static_cast<std::size_t>(ptr.nbonh + ptr.nbona);
-  auto const angle_count = static_cast<std::size_t>(ptr.ntheth + ptr.ntheta);
-  auto const dihedral_count = static_cast<std::size_t>(ptr.nphih + ptr.nphia);
-
-  topo.atom_name.reserve(natom);
-  topo.charge.reserve(natom);
-  topo.atomic_number.reserve(natom);
-  topo.mass.reserve(natom);
-  topo.atom_type_index.reserve(natom);
-  topo.number_excluded_atoms.reserve(natom);
-  topo.excluded_atoms_list.reserve(nnb);
-  topo.nonbonded_parm_index.reserve(ntypes * ntypes);
-  topo.residue_label.reserve(nres);
-  topo.residue_pointer.reserve(nres);
-
-  topo.bond_force_constant.reserve(numbnd);
-  topo.bond_equil_value.reserve(numbnd);
-  topo.angle_force_constant.reserve(numang);
-  topo.angle_equil_value.reserve(numang);
-  topo.dihedral_force_constant.reserve(nptra);
-  topo.dihedral_periodicity.reserve(nptra);
-  topo.dihedral_phase.reserve(nptra);
-  topo.scee_scale_factor.reserve(nptra);
-  topo.scnb_scale_factor.reserve(nptra);
-  topo.solty.reserve(natyp);
+  auto const bond_count = static_cast<std::size_t>(ptr.nbonh) + static_cast<std::size_t>(ptr.nbona);
+  auto const angle_count = static_cast<std::size_t>(ptr.ntheth) + static_cast<std::size_t>(ptr.ntheta);
+  auto const dihedral_count = static_cast<std::size_t>(ptr.nphih) + static_cast<std::size_t>(ptr.nphia);
+
+  reserve(Section::AtomName, topo.atom_name, natom);
+  reserve(Section::Charge, topo.charge, natom);
+  reserve(Section::AtomicNumber, topo.atomic_number, natom);
+  reserve(Section::Mass, topo.mass, natom);
+  reserve(Section::AtomTypeIndex, topo.atom_type_index, natom);
+  reserve(Section::NumberExcludedAtoms, topo.number_excluded_atoms, natom);
+  reserve(Section::ExcludedAtomsList, topo.excluded_atoms_list, nnb);
+  reserve(Section::NonbondedParmIndex, topo.nonbonded_parm_index, ntypes * ntypes);
+  reserve(Section::ResiduePointer, topo.residue_pointer, nres);
+
+  reserve(Section::BondForceConstant, topo.bond_force_constant, numbnd);
+  reserve(Section::BondEquilValue, topo.bond_equil_value, numbnd);
+  reserve(Section::AngleForceConstant, topo.angle_force_constant, numang);
+  reserve(Section::AngleEquilValue, topo.angle_equil_value, numang);
+  reserve(Section::DihedralForceConstant, topo.dihedral_force_constant, nptra);
+  reserve(Section::DihedralPeriodicity, topo.dihedral_periodicity, nptra);
+  reserve(Section::DihedralPhase, topo.dihedral_phase, nptra);
+  reserve(Section::SceeScaleFactor, topo.scee_scale_factor, nptra);
+  reserve(Section::ScnbScaleFactor, topo.scnb_scale_factor, nptra);
+  reserve(Section::Solty, topo.solty, natyp);
 
   auto const lj_count = ntypes * (ntypes + 1U) / 2U;
-  topo.lennard_jones_acoeff.reserve(lj_count);
-  topo.lennard_jones_bcoeff.reserve(lj_count);
-
-  topo.bond_i.reserve(bond_count);
-  topo.bond_j.reserve(bond_count);
-  topo.bond_type.reserve(bond_count);
-
-  topo.angle_i.reserve(angle_count);
-  topo.angle_j.reserve(angle_count);
-  topo.angle_k.reserve(angle_count);
-  topo.angle_type.reserve(angle_count);
-
-  topo.dihedral_i.reserve(dihedral_count);
-  topo.dihedral_j.reserve(dihedral_count);
-  topo.dihedral_k.reserve(dihedral_count);
-  topo.dihedral_l.reserve(dihedral_count);
-  topo.dihedral_type.reserve(dihedral_count);
-  topo.dihedral_flags.reserve(dihedral_count);
-
-  topo.hbond_acoeff.reserve(nphb);
-  topo.hbond_bcoeff.reserve(nphb);
-
-  topo.amber_atom_type.reserve(natom);
-  topo.tree_chain_classification.reserve(natom);
-  topo.join_array.reserve(natom);
-  topo.irotat.reserve(natom);
-
-  topo.atoms_per_molecule.reserve(nres);
-  topo.radii.reserve(natom);
-  topo.screen.reserve(natom);
+  reserve(Section::LennardJonesAcoef, topo.lennard_jones_acoeff, lj_count);
+  reserve(Section::LennardJonesBcoef, topo.lennard_jones_bcoeff, lj_count);
+
+  reserve(Section::BondsIncHydrogen, topo.bond_i, bond_count);
+  reserve(Section::BondsIncHydrogen, topo.bond_j, bond_count);
+  reserve(Section::BondsIncHydrogen, topo.bond_type, bond_count);
+
+  reserve(Section::AnglesIncHydrogen, topo.angle_i, angle_count);
+  reserve(Section::AnglesIncHydrogen, topo.angle_j, angle_count);
+  reserve(Section::AnglesIncHydrogen, topo.angle_k, angle_count);
+  reserve(Section::AnglesIncHydrogen, topo.angle_type, angle_count);
+
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_i, dihedral_count);
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_j, dihedral_count);
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_k, dihedral_count);
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_l, dihedral_count);
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_type, dihedral_count);
+  reserve(Section::DihedralsIncHydrogen, topo.dihedral_flags, dihedral_count);
+
+  reserve(Section::HbondAcoef, topo.hbond_acoeff, nphb);
+  reserve(Section::HbondBcoef, topo.hbond_bcoeff, nphb);
+
+  reserve(Section::TreeChainClassification, topo.tree_chain_classification, natom);
+  reserve(Section::JoinArray, topo.join_array, natom);
+  reserve(Section::Irotat, topo.irotat, natom);
+
+  reserve(Section::AtomsPerMolecule, topo.atoms_per_molecule, nres);
+  reserve(Section::Radii, topo.radii, natom);
+  reserve(Section::Screen, topo.screen, natom);
+}
+
+// Reserves storage for the sections in `mask` only, so skipped sections cost no
+// memory. Appends stop at these sizes, so decoding never allocates again.
+void reserve_from_pointers(Parm7Topology &topo, const Parm7Pointers &ptr, Parm7SectionMask mask) {
+  for_each_sized_array(topo, ptr, [mask](Section section, auto &values, std::size_t count) {
+    if ((mask & section_bit(section)) != 0) {
+      values.reserve(count);
+    }
+  });
 }
 
-void append_strings(std::string_view line, const FormatSpec &fmt, std::vector<std::string> &out,
-  std::optional<std::size_t> expected) {
+void append_names(std::string_view line, const FormatSpec &fmt, std::pmr::vector<PackedName> &out,
+  std::optional<std::size_t> expected, std::string_view section_name) {
   std::size_t const limit = expected.value_or(std::numeric_limits<std::size_t>::max());
   if (out.size() >= limit || fmt.width <= 0) {
     return;
@@ -296,13 +323,17 @@ void append_strings(std::string_view line, const FormatSpec &fmt, std::vector<st
       break;
     }
     std::size_t const len = std::min<std::size_t>(width, line.size() - start);
-    auto const raw = line.substr(start, len);
-    out.emplace_back(trim(raw));
+    auto const name = trim(line.substr(start, len));
+    if (name.size() > kPackedNameLength) {
+      throw std::runtime_error(fmt::format("Name '{}' in {} is longer than {} characters", name, section_name,
+        kPackedNameLength));
+    }
+    out.emplace_back(name);
   }
 }
 
 template <typename Transform>
-void append_ints_transform(std::string_view line, const FormatSpec &fmt, std::vector<int> &out,
+void append_ints_transform(std::string_view line, const FormatSpec &fmt, std::pmr::vector<int> &out,
   std::optional<std::size_t> expected, std::string_view section_name, Transform transform) {
   std::size_t const limit = expected.value_or(std::numeric_limits<std::size_t>::max());
   if (out.size() >= limit || fmt.width <= 0 || line.empty()) {
@@ -313,7 +344,22 @@ void append_ints_transform(std::string_view line, const FormatSpec &fmt, std::ve
   std::size_t const max_fields = std::min<std::size_t>(static_cast<std::size_t>(fmt.count),
     std::max<std::size_t>(1, (line.size() + width - 1) / width));
 
-  for (std::size_t idx = 0; idx < max_fields && out.size() < limit; ++idx) {
+  std::size_t idx = 0;
+  if (width == kI8FieldWidth) {
+    // Decode the leading run of well-formed fields in one SIMD pass and apply
+    // the transform while the values are still hot; anything the fast path
+    // rejects (blanks, short tails) falls through to the per-field loop below.
+    std::size_t const base = out.size();
+    std::size_t const fields = std::min({max_fields, line.size() / width, limit - base});
+    out.resize(base + fields);
+    idx = decode_i8_fields(line, std::span<int>(out).subspan(base));
+    for (std::size_t pos = base; pos < base + idx; ++pos) {
+      out[pos] = transform(out[pos]);
+    }
+    out.resize(base + idx);
+  }
+
+  for (; idx < max_fields && out.size() < limit; ++idx) {
     std::size_t const start = idx * width;
     if (start >= line.size()) {
       break;
@@ -332,7 +378,7 @@ void append_ints_transform(std::string_view line, const FormatSpec &fmt, std::ve
 }
 
 template <typename Transform>
-void append_doubles_transform(std::string_view line, const FormatSpec &fmt, std::vector<double> &out,
+void append_doubles_transform(std::string_view line, const FormatSpec &fmt, std::pmr::vector<double> &out,
   std::optional<std::size_t> expected, std::string_view section_name, Transform transform) {
   std::size_t const limit = expected.value_or(std::numeric_limits<std::size_t>::max());
   if (out.size() >= limit || fmt.width <= 0 || line.empty()) {
@@ -343,7 +389,18 @@ void append_doubles_transform(std::string_view line, const FormatSpec &fmt, std:
   std::size_t const max_fields = std::min<std::size_t>(static_cast<std::size_t>(fmt.count),
     std::max<std::size_t>(1, (line.size() + width - 1) / width));
 
-  for (std::size_t idx = 0; idx < max_fields && out.size() < limit; ++idx) {
+  // Batch-decode the leading run of complete fields straight into the output,
+  // then let the per-field loop below handle blanks and short tails.
+  std::size_t const base = out.size();
+  std::size_t const fields = std::min({max_fields, line.size() / width, limit - base});
+  out.resize(base + fields);
+  std::size_t idx = decode_real_fields(line, width, std::span<double>(out).subspan(base));
+  for (std::size_t pos = base; pos < base + idx; ++pos) {
+    out[pos] = transform(out[pos]);
+  }
+  out.resize(base + idx);
+
+  for (; idx < max_fields && out.size() < limit; ++idx) {
     std::size_t const start = idx * width;
     if (start >= line.size()) {
       break;
@@ -361,79 +418,92 @@ void append_doubles_transform(std::string_view line, const FormatSpec &fmt, std:
   }
 }
 
-void append_ints(std::string_view line, const FormatSpec &fmt, std::vector<int> &out,
+void append_ints(std::string_view line, const FormatSpec &fmt, std::pmr::vector<int> &out,
   std::optional<std::size_t> expected, std::string_view section_name) {
   append_ints_transform(line, fmt, out, expected, section_name, [](int value) { return value; });
 }
 
-void append_doubles(std::string_view line, const FormatSpec &fmt, std::vector<double> &out,
+void append_doubles(std::string_view line, const FormatSpec &fmt, std::pmr::vector<double> &out,
   std::optional<std::size_t> expected, std::string_view section_name) {
   append_doubles_transform(line, fmt, out, expected, section_name, [](double value) { return value; });
 }
 
-void decode_bonds(const std::vector<int> &raw, Parm7Topology &topo) {
-  if (raw.size() % 3 != 0) {
-    throw std::runtime_error("Bond list size is not a multiple of 3");
-  }
-  for (std::size_t idx = 0; idx < raw.size(); idx += 3) {
-    int const atom_i = raw[idx] / 3;
-    int const atom_j = raw[idx + 1] / 3;
-    int const type = raw[idx + 2] - 1;
-    topo.bond_i.push_back(atom_i);
-    topo.bond_j.push_back(atom_j);
-    topo.bond_type.push_back(type);
-  }
-}
-
-void decode_angles(const std::vector<int> &raw, Parm7Topology &topo) {
-  if (raw.size() % 4 != 0) {
-    throw std::runtime_error("Angle list size is not a multiple of 4");
-  }
-  for (std::size_t idx = 0; idx < raw.size(); idx += 4) {
-    int const atom_i = raw[idx] / 3;
-    int const atom_j = raw[idx + 1] / 3;
-    int const atom_k = raw[idx + 2] / 3;
-    int const type = raw[idx + 3] - 1;
-    topo.angle_i.push_back(atom_i);
-    topo.angle_j.push_back(atom_j);
-    topo.angle_k.push_back(atom_k);
-    topo.angle_type.push_back(type);
+// Streams one connectivity section into its rows of the SoA arrays. A row is
+// `columns` raw integers: coordinate indices (3 * atom) then a 1-based parameter
+// index. Dihedral rows also turn negative k / l entries into `flags` bits.
+struct ConnectivityRows {
+  std::array<int *, 4> atoms{};
+  int *type = nullptr;
+  std::uint8_t *flags = nullptr;
+  std::size_t columns = 1;
+  std::size_t rows = 0;
+  std::size_t row = 0;
+  std::size_t column = 0;
+
+  [[nodiscard]] std::size_t remaining() const noexcept { return (rows - row) * columns - column; }
+
+  void push(int value) noexcept {
+    if (column + 1 == columns) {
+      type[row] = value - 1;
+      column = 0;
+      ++row;
+      return;
+    }
+    if (flags != nullptr && column >= 2) {
+      if (value < 0) {
+        flags[row] |= column == 2 ? std::uint8_t{0x1u} : std::uint8_t{0x2u};
+      }
+      value = std::abs(value);
+    }
+    atoms[column][row] = value / 3;
+    ++column;
   }
-}
+};
 
-void decode_dihedrals(const std::vector<int> &raw, Parm7Topology &topo) {
-  if (raw.size() % 5 != 0) {
-    throw std::runtime_error("Dihedral list size is not a multiple of 5");
+void append_connectivity(std::string_view line, const FormatSpec &fmt, ConnectivityRows &out,
+  std::string_view section_name) {
+  if (out.remaining() == 0 || fmt.width <= 0 || line.empty()) {
+    return;
   }
-  for (std::size_t idx = 0; idx < raw.size(); idx += 5) {
-    int const raw_i = raw[idx];
-    int const raw_j = raw[idx + 1];
-    int const raw_k = raw[idx + 2];
-    int const raw_l = raw[idx + 3];
-    int const type = raw[idx + 4] - 1;
 
-    bool const suppress_14 = raw_k < 0;
-    bool const improper = raw_l < 0;
+  std::size_t const width = static_cast<std::size_t>(fmt.width);
+  std::size_t const max_fields = std::min<std::size_t>(static_cast<std::size_t>(fmt.count),
+    std::max<std::size_t>(1, (line.size() + width - 1) / width));
 
-    int const atom_i = raw_i / 3;
-    int const atom_j = raw_j / 3;
-    int const atom_k = std::abs(raw_k) / 3;
-    int const atom_l = std::abs(raw_l) / 3;
+  std::size_t idx = 0;
+  if (width == kI8FieldWidth) {
+    // SIMD-decode the well-formed leading fields a few at a time into registers
+    // and scatter them straight into their rows.
+    std::array<int, 16> chunk{};
+    std::size_t const complete = std::min(max_fields, line.size() / width);
+    while (idx < complete && out.remaining() > 0) {
+      std::size_t const fields = std::min({chunk.size(), complete - idx, out.remaining()});
+      std::size_t const decoded = decode_i8_fields(line.substr(idx * width), std::span<int>(chunk).first(fields));
+      for (std::size_t pos = 0; pos < decoded; ++pos) {
+        out.push(chunk[pos]);
+      }
+      idx += decoded;
+      if (decoded < fields) {
+        break;
+      }
+    }
+  }
 
-    std::uint8_t flags = 0;
-    if (suppress_14) {
-      flags |= 0x1u;
+  for (; idx < max_fields && out.remaining() > 0; ++idx) {
+    std::size_t const start = idx * width;
+    if (start >= line.size()) {
+      break;
     }
-    if (improper) {
-      flags |= 0x2u;
+    std::size_t const len = std::min<std::size_t>(width, line.size() - start);
+    auto const raw = line.substr(start, len);
+    auto value = to_int(raw);
+    if (!value) {
+      if (trim(raw).empty()) {
+        continue;
+      }
+      throw std::runtime_error(fmt::format("Failed to parse integer in {}: {}", section_name, raw));
     }
-
-    topo.dihedral_i.push_back(atom_i);
-    topo.dihedral_j.push_back(atom_j);
-    topo.dihedral_k.push_back(atom_k);
-    topo.dihedral_l.push_back(atom_l);
-    topo.dihedral_type.push_back(type);
-    topo.dihedral_flags.push_back(flags);
+    out.push(*value);
   }
 }
 
@@ -443,314 +513,343 @@ void require_size(std::string_view name, std::size_t actual, std::size_t expecte
   }
 }
 
-} // namespace
+// One %FLAG block: the parsed %FORMAT and the data lines that follow it.
+// `flag` points at the %FLAG line, so [flag, body end) is the whole block.
+struct SectionSlice {
+  std::optional<Section> section;
+  FormatSpec format{};
+  char const *flag = nullptr;
+  std::string_view body;
+};
 
-Parm7Topology parse_parm7_file(const std::filesystem::path &path) {
-  std::ifstream file(path);
-  if (!file.is_open()) {
-    throw std::runtime_error(fmt::format("Failed to open parm7 file: {}", path.string()));
-  }
+// Per-section decode state outside Parm7Topology: connectivity cursors into the
+// final arrays, and temporaries for sections that are converted afterwards.
+// Names are sized from POINTERS and live in `scratch`; the few unbounded
+// temporaries grow on the (thread-safe) default resource.
+struct RawSections {
+  explicit RawSections(std::pmr::memory_resource *scratch) : residue_label(scratch), amber_atom_type(scratch) {}
+
+  ConnectivityRows bonds_inc;
+  ConnectivityRows bonds_noh;
+  ConnectivityRows angles_inc;
+  ConnectivityRows angles_noh;
+  ConnectivityRows dihedrals_inc;
+  ConnectivityRows dihedrals_noh;
+  std::pmr::vector<PackedName> residue_label;
+  std::pmr::vector<PackedName> amber_atom_type;
+  std::pmr::vector<double> hbond_cut;
+  std::pmr::vector<int> solvent_pointers;
+  std::pmr::vector<double> box_dimensions;
+  std::pmr::vector<int> ipol;
+};
 
-  Parm7Topology topo;
-  Section current_section = Section::None;
-  FormatSpec current_format{};
+// Calls `reserve(section, array, count)` for the sized temporaries.
+template <typename Reserve>
+void for_each_raw_array(RawSections &raw, const Parm7Pointers &ptr, Reserve &&reserve) {
+  reserve(Section::ResidueLabel, raw.residue_label, static_cast<std::size_t>(ptr.nres));
+  reserve(Section::AmberAtomType, raw.amber_atom_type, static_cast<std::size_t>(ptr.natom));
+}
 
-  std::vector<int> pointer_values;
-  std::vector<int> bonds_inc_raw;
-  std::vector<int> bonds_noh_raw;
-  std::vector<int> angles_inc_raw;
-  std::vector<int> angles_noh_raw;
-  std::vector<int> dihedrals_inc_raw;
-  std::vector<int> dihedrals_noh_raw;
-  std::vector<double> hbond_cut_raw;
-  std::vector<int> solvent_pointer_raw;
-  std::vector<double> box_dimensions_raw;
+// Sizes the selected connectivity arrays and points each section at its rows:
+// the hydrogen half first, then the heavy-atom half. The halves decode in
+// parallel into disjoint rows, so nothing is resized after this.
+void bind_connectivity(Parm7Topology &topo, Parm7SectionMask mask, RawSections &raw) {
+  auto const &ptr = topo.pointers;
+  auto bind = [](ConnectivityRows &first, ConnectivityRows &second, std::int32_t first_rows, std::int32_t second_rows,
+                std::initializer_list<std::pmr::vector<int> *> atoms, std::pmr::vector<int> &type,
+                std::pmr::vector<std::uint8_t> *flags) {
+    auto const head = static_cast<std::size_t>(first_rows);
+    auto const rows = head + static_cast<std::size_t>(second_rows);
+    for (auto *column : atoms) {
+      column->resize(rows);
+    }
+    type.resize(rows);
+    if (flags != nullptr) {
+      flags->resize(rows);
+    }
+    for (auto const &[cursor, offset, count] : {std::tuple{&first, std::size_t{0}, head},
+           std::tuple{&second, head, rows - head}}) {
+      std::size_t col = 0;
+      for (auto *column : atoms) {
+        cursor->atoms[col++] = column->data() + offset;
+      }
+      cursor->type = type.data() + offset;
+      cursor->flags = flags != nullptr ? flags->data() + offset : nullptr;
+      cursor->columns = atoms.size() + 1;
+      cursor->rows = count;
+    }
+  };
 
-  bool pointers_ready = false;
+  if ((mask & section_bit(Section::BondsIncHydrogen)) != 0) {
+    bind(raw.bonds_inc, raw.bonds_noh, ptr.nbonh, ptr.nbona, {&topo.bond_i, &topo.bond_j}, topo.bond_type, nullptr);
+  }
+  if ((mask & section_bit(Section::AnglesIncHydrogen)) != 0) {
+    bind(raw.angles_inc, raw.angles_noh, ptr.ntheth, ptr.ntheta, {&topo.angle_i, &topo.angle_j, &topo.angle_k},
+      topo.angle_type, nullptr);
+  }
+  if ((mask & section_bit(Section::DihedralsIncHydrogen)) != 0) {
+    bind(raw.dihedrals_inc, raw.dihedrals_noh, ptr.nphih, ptr.nphia,
+      {&topo.dihedral_i, &topo.dihedral_j, &topo.dihedral_k, &topo.dihedral_l}, topo.dihedral_type,
+      &topo.dihedral_flags);
+  }
+}
 
-  std::string line;
-  while (std::getline(file, line)) {
-    std::string_view line_view(line);
+// Checks that every connectivity section filled exactly its rows.
+void finish_connectivity(RawSections &raw, Parm7SectionMask mask) {
+  for (auto const &[section, name, inc, noh, row_name] :
+    {std::tuple{Section::BondsIncHydrogen, "BONDS", &raw.bonds_inc, &raw.bonds_noh, "Bond"},
+      std::tuple{Section::AnglesIncHydrogen, "ANGLES", &raw.angles_inc, &raw.angles_noh, "Angle"},
+      std::tuple{Section::DihedralsIncHydrogen, "DIHEDRALS", &raw.dihedrals_inc, &raw.dihedrals_noh, "Dihedral"}}) {
+    if ((mask & section_bit(section)) == 0) {
+      continue;
+    }
+    if (inc->column != 0 || noh->column != 0) {
+      throw std::runtime_error(fmt::format("{} list size is not a multiple of {}", row_name, inc->columns));
+    }
+    require_size(name, inc->row + noh->row, inc->rows + noh->rows);
+  }
+}
 
-    if (starts_with(line_view, "%VERSION")) {
-      topo.version = std::string(trim(line_view));
+// Phase 1: index every %FLAG/%FORMAT header. Data lines never contain '%', so
+// the scan jumps from header to header with memchr instead of visiting lines.
+[[nodiscard]] std::vector<SectionSlice> scan_sections(std::span<const char> buffer, std::string &version) {
+  std::vector<SectionSlice> slices;
+  char const *const begin = buffer.data();
+  char const *const end = begin + buffer.size();
+
+  char const *cursor = begin;
+  while (cursor < end) {
+    auto const *marker = static_cast<char const *>(std::memchr(cursor, '%', static_cast<std::size_t>(end - cursor)));
+    if (marker == nullptr) {
+      break;
+    }
+    if (marker != begin && marker[-1] != '\n') {
+      cursor = marker + 1;
       continue;
     }
 
-    if (starts_with(line_view, "%FLAG")) {
-      if (current_section == Section::Pointers && !pointers_ready) {
-        topo.pointers = parse_pointers(pointer_values);
-        reserve_from_pointers(topo, topo.pointers);
-        pointers_ready = true;
-      }
+    LineReader reader(std::span<const char>(marker, static_cast<std::size_t>(end - marker)));
+    std::string_view line;
+    std::string_view format_line;
+    static_cast<void>(reader.next(line));
+    cursor = reader.position();
 
-      current_section = parse_section_name(line_view);
-      if (!std::getline(file, line)) {
-        throw std::runtime_error("Unexpected end of file after %FLAG line");
-      }
-      current_format = parse_format_line(line);
+    // Other directives (e.g. %COMMENT) stay inside the body and are skipped there.
+    bool const is_version = starts_with(line, "%VERSION");
+    bool const is_flag = starts_with(line, "%FLAG");
+    if (!is_version && !is_flag) {
       continue;
     }
-
-    if (current_section == Section::None || current_section == Section::Unknown) {
+    if (!slices.empty()) {
+      slices.back().body = std::string_view(slices.back().body.data(),
+        static_cast<std::size_t>(marker - slices.back().body.data()));
+    }
+    if (is_version) {
+      version = std::string(trim(line));
       continue;
     }
 
-    switch (current_section) {
+    if (!reader.next(format_line)) {
+      throw std::runtime_error("Unexpected end of file after %FLAG line");
+    }
+    char const *const body_start = reader.position();
+    cursor = body_start;
+
+    SectionSlice slice;
+    slice.section = parse_section_name(line);
+    slice.format = parse_format_line(format_line);
+    slice.flag = marker;
+    slice.body = std::string_view(body_start, static_cast<std::size_t>(end - body_start));
+    slices.push_back(slice);
+  }
+
+  return slices;
+}
+
+// Phase 2: decode one section body. Every section writes only to its own
+// destination, so distinct sections can be decoded concurrently.
+void parse_section_body(const SectionSlice &slice, Parm7Topology &topo, RawSections &raw) {
+  auto const &ptr = topo.pointers;
+  auto const natom = static_cast<std::size_t>(ptr.natom);
+  auto const nres = static_cast<std::size_t>(ptr.nres);
+  auto const nptra = static_cast<std::size_t>(ptr.nptra);
+  auto const ntypes = static_cast<std::size_t>(ptr.ntypes);
+  auto const lj_count = ntypes * (ntypes + 1U) / 2U;
+  auto const &fmt = slice.format;
+
+  LineReader reader(std::span<const char>(slice.body.data(), slice.body.size()));
+  std::string_view line;
+  while (reader.next(line)) {
+    if (starts_with(line, "%")) {
+      continue;
+    }
+    switch (*slice.section) {
       case Section::Title:
         topo.title.append(line);
         break;
-      case Section::Pointers:
-        append_ints(line_view, current_format, pointer_values, std::nullopt, "POINTERS");
-        break;
       case Section::AtomName:
-        append_strings(line_view, current_format, topo.atom_name,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt);
+        append_names(line, fmt, topo.atom_name, natom, "ATOM_NAME");
         break;
       case Section::Charge:
-        append_doubles_transform(line_view, current_format, topo.charge,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "CHARGE",
+        append_doubles_transform(line, fmt, topo.charge, natom, "CHARGE",
           [](double value) { return value / kAmberChargeScale; });
         break;
       case Section::AtomicNumber:
-        append_ints(line_view, current_format, topo.atomic_number,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt,
-          "ATOMIC_NUMBER");
+        append_ints(line, fmt, topo.atomic_number, natom, "ATOMIC_NUMBER");
         break;
       case Section::Mass:
-        append_doubles(line_view, current_format, topo.mass,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "MASS");
+        append_doubles(line, fmt, topo.mass, natom, "MASS");
         break;
       case Section::AtomTypeIndex:
-        append_ints_transform(line_view, current_format, topo.atom_type_index,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "ATOM_TYPE_INDEX",
+        append_ints_transform(line, fmt, topo.atom_type_index, natom, "ATOM_TYPE_INDEX",
           [](int value) { return value - 1; });
         break;
       case Section::NumberExcludedAtoms:
-        append_ints(line_view, current_format, topo.number_excluded_atoms,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt,
-          "NUMBER_EXCLUDED_ATOMS");
+        append_ints(line, fmt, topo.number_excluded_atoms, natom, "NUMBER_EXCLUDED_ATOMS");
         break;
       case Section::ExcludedAtomsList:
-        append_ints_transform(line_view, current_format, topo.excluded_atoms_list,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nnb) : std::nullopt, "EXCLUDED_ATOMS_LIST",
-          [](int value) { return value == 0 ? -1 : value - 1; });
+        append_ints_transform(line, fmt, topo.excluded_atoms_list, static_cast<std::size_t>(ptr.nnb),
+          "EXCLUDED_ATOMS_LIST", [](int value) { return value == 0 ? -1 : value - 1; });
         break;
       case Section::NonbondedParmIndex:
-        append_ints_transform(line_view, current_format, topo.nonbonded_parm_index,
-          pointers_ready ? std::optional<std::size_t>(
-                             static_cast<std::size_t>(topo.pointers.ntypes) *
-                             static_cast<std::size_t>(topo.pointers.ntypes))
-                         : std::nullopt,
-          "NONBONDED_PARM_INDEX", [](int value) { return value == 0 ? -1 : value - 1; });
+        append_ints_transform(line, fmt, topo.nonbonded_parm_index, ntypes * ntypes, "NONBONDED_PARM_INDEX",
+          [](int value) { return value == 0 ? -1 : value - 1; });
         break;
       case Section::ResidueLabel:
-        append_strings(line_view, current_format, topo.residue_label,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nres) : std::nullopt);
+        append_names(line, fmt, raw.residue_label, nres, "RESIDUE_LABEL");
         break;
       case Section::ResiduePointer:
-        append_ints_transform(line_view, current_format, topo.residue_pointer,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nres) : std::nullopt, "RESIDUE_POINTER",
+        append_ints_transform(line, fmt, topo.residue_pointer, nres, "RESIDUE_POINTER",
           [](int value) { return value - 1; });
         break;
       case Section::BondForceConstant:
-        append_doubles(line_view, current_format, topo.bond_force_constant,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.numbnd) : std::nullopt,
+        append_doubles(line, fmt, topo.bond_force_constant, static_cast<std::size_t>(ptr.numbnd),
           "BOND_FORCE_CONSTANT");
         break;
       case Section::BondEquilValue:
-        append_doubles(line_view, current_format, topo.bond_equil_value,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.numbnd) : std::nullopt,
-          "BOND_EQUIL_VALUE");
+        append_doubles(line, fmt, topo.bond_equil_value, static_cast<std::size_t>(ptr.numbnd), "BOND_EQUIL_VALUE");
         break;
       case Section::AngleForceConstant:
-        append_doubles(line_view, current_format, topo.angle_force_constant,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.numang) : std::nullopt,
+        append_doubles(line, fmt, topo.angle_force_constant, static_cast<std::size_t>(ptr.numang),
           "ANGLE_FORCE_CONSTANT");
         break;
       case Section::AngleEquilValue:
-        append_doubles(line_view, current_format, topo.angle_equil_value,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.numang) : std::nullopt,
-          "ANGLE_EQUIL_VALUE");
+        append_doubles(line, fmt, topo.angle_equil_value, static_cast<std::size_t>(ptr.numang), "ANGLE_EQUIL_VALUE");
         break;
       case Section::DihedralForceConstant:
-        append_doubles(line_view, current_format, topo.dihedral_force_constant,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nptra) : std::nullopt,
-          "DIHEDRAL_FORCE_CONSTANT");
+        append_doubles(line, fmt, topo.dihedral_force_constant, nptra, "DIHEDRAL_FORCE_CONSTANT");
         break;
       case Section::DihedralPeriodicity:
-        append_doubles(line_view, current_format, topo.dihedral_periodicity,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nptra) : std::nullopt,
-          "DIHEDRAL_PERIODICITY");
+        append_doubles(line, fmt, topo.dihedral_periodicity, nptra, "DIHEDRAL_PERIODICITY");
         break;
       case Section::DihedralPhase:
-        append_doubles(line_view, current_format, topo.dihedral_phase,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nptra) : std::nullopt,
-          "DIHEDRAL_PHASE");
+        append_doubles(line, fmt, topo.dihedral_phase, nptra, "DIHEDRAL_PHASE");
         break;
       case Section::SceeScaleFactor:
-        append_doubles(line_view, current_format, topo.scee_scale_factor,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nptra) : std::nullopt,
-          "SCEE_SCALE_FACTOR");
+        append_doubles(line, fmt, topo.scee_scale_factor, nptra, "SCEE_SCALE_FACTOR");
         break;
       case Section::ScnbScaleFactor:
-        append_doubles(line_view, current_format, topo.scnb_scale_factor,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nptra) : std::nullopt,
-          "SCNB_SCALE_FACTOR");
+        append_doubles(line, fmt, topo.scnb_scale_factor, nptra, "SCNB_SCALE_FACTOR");
         break;
       case Section::Solty:
-        append_doubles(line_view, current_format, topo.solty,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natyp) : std::nullopt, "SOLTY");
+        append_doubles(line, fmt, topo.solty, static_cast<std::size_t>(ptr.natyp), "SOLTY");
         break;
       case Section::LennardJonesAcoef:
-        append_doubles(line_view, current_format, topo.lennard_jones_acoeff,
-          pointers_ready ? std::optional<std::size_t>(
-                             static_cast<std::size_t>(topo.pointers.ntypes) *
-                             static_cast<std::size_t>(topo.pointers.ntypes + 1) / 2)
-                         : std::nullopt,
-          "LENNARD_JONES_ACOEF");
+        append_doubles(line, fmt, topo.lennard_jones_acoeff, lj_count, "LENNARD_JONES_ACOEF");
         break;
       case Section::LennardJonesBcoef:
-        append_doubles(line_view, current_format, topo.lennard_jones_bcoeff,
-          pointers_ready ? std::optional<std::size_t>(
-                             static_cast<std::size_t>(topo.pointers.ntypes) *
-                             static_cast<std::size_t>(topo.pointers.ntypes + 1) / 2)
-                         : std::nullopt,
-          "LENNARD_JONES_BCOEF");
+        append_doubles(line, fmt, topo.lennard_jones_bcoeff, lj_count, "LENNARD_JONES_BCOEF");
         break;
       case Section::BondsIncHydrogen:
-        append_ints(line_view, current_format, bonds_inc_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.nbonh) * 3)
-                         : std::nullopt,
-          "BONDS_INC_HYDROGEN");
+        append_connectivity(line, fmt, raw.bonds_inc, "BONDS_INC_HYDROGEN");
         break;
       case Section::BondsWithoutHydrogen:
-        append_ints(line_view, current_format, bonds_noh_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.nbona) * 3)
-                         : std::nullopt,
-          "BONDS_WITHOUT_HYDROGEN");
+        append_connectivity(line, fmt, raw.bonds_noh, "BONDS_WITHOUT_HYDROGEN");
         break;
       case Section::AnglesIncHydrogen:
-        append_ints(line_view, current_format, angles_inc_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.ntheth) * 4)
-                         : std::nullopt,
-          "ANGLES_INC_HYDROGEN");
+        append_connectivity(line, fmt, raw.angles_inc, "ANGLES_INC_HYDROGEN");
         break;
       case Section::AnglesWithoutHydrogen:
-        append_ints(line_view, current_format, angles_noh_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.ntheta) * 4)
-                         : std::nullopt,
-          "ANGLES_WITHOUT_HYDROGEN");
+        append_connectivity(line, fmt, raw.angles_noh, "ANGLES_WITHOUT_HYDROGEN");
         break;
       case Section::DihedralsIncHydrogen:
-        append_ints(line_view, current_format, dihedrals_inc_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.nphih) * 5)
-                         : std::nullopt,
-          "DIHEDRALS_INC_HYDROGEN");
+        append_connectivity(line, fmt, raw.dihedrals_inc, "DIHEDRALS_INC_HYDROGEN");
         break;
       case Section::DihedralsWithoutHydrogen:
-        append_ints(line_view, current_format, dihedrals_noh_raw,
-          pointers_ready ? std::optional<std::size_t>(static_cast<std::size_t>(topo.pointers.nphia) * 5)
-                         : std::nullopt,
-          "DIHEDRALS_WITHOUT_HYDROGEN");
+        append_connectivity(line, fmt, raw.dihedrals_noh, "DIHEDRALS_WITHOUT_HYDROGEN");
         break;
       case Section::HbondAcoef:
-        append_doubles(line_view, current_format, topo.hbond_acoeff,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nphb) : std::nullopt, "HBOND_ACOEF");
+        append_doubles(line, fmt, topo.hbond_acoeff, static_cast<std::size_t>(ptr.nphb), "HBOND_ACOEF");
         break;
       case Section::HbondBcoef:
-        append_doubles(line_view, current_format, topo.hbond_bcoeff,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nphb) : std::nullopt, "HBOND_BCOEF");
+        append_doubles(line, fmt, topo.hbond_bcoeff, static_cast<std::size_t>(ptr.nphb), "HBOND_BCOEF");
         break;
       case Section::HbondCut:
-        append_doubles(line_view, current_format, hbond_cut_raw, std::nullopt, "HBCUT");
+        append_doubles(line, fmt, raw.hbond_cut, std::nullopt, "HBCUT");
         break;
       case Section::AmberAtomType:
-        append_strings(line_view, current_format, topo.amber_atom_type,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt);
+        append_names(line, fmt, raw.amber_atom_type, natom, "AMBER_ATOM_TYPE");
         break;
       case Section::TreeChainClassification:
-        append_strings(line_view, current_format, topo.tree_chain_classification,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt);
+        append_names(line, fmt, topo.tree_chain_classification, natom, "TREE_CHAIN_CLASSIFICATION");
         break;
       case Section::JoinArray:
-        append_ints(line_view, current_format, topo.join_array,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "JOIN_ARRAY");
+        append_ints(line, fmt, topo.join_array, natom, "JOIN_ARRAY");
         break;
       case Section::Irotat:
-        append_ints(line_view, current_format, topo.irotat,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "IROTAT");
+        append_ints(line, fmt, topo.irotat, natom, "IROTAT");
         break;
       case Section::SolventPointers:
-        append_ints(line_view, current_format, solvent_pointer_raw, std::nullopt, "SOLVENT_POINTERS");
+        append_ints(line, fmt, raw.solvent_pointers, std::nullopt, "SOLVENT_POINTERS");
         break;
       case Section::AtomsPerMolecule:
-        append_ints(line_view, current_format, topo.atoms_per_molecule,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.nres) : std::nullopt, "ATOMS_PER_MOLECULE");
+        append_ints(line, fmt, topo.atoms_per_molecule, nres, "ATOMS_PER_MOLECULE");
         break;
       case Section::BoxDimensions:
-        append_doubles(line_view, current_format, box_dimensions_raw, std::nullopt, "BOX_DIMENSIONS");
+        append_doubles(line, fmt, raw.box_dimensions, std::nullopt, "BOX_DIMENSIONS");
         break;
       case Section::RadiusSet:
         if (topo.radius_set.empty()) {
-          topo.radius_set = std::string(trim(line_view));
+          topo.radius_set = std::string(trim(line));
         }
         break;
       case Section::Radii:
-        append_doubles(line_view, current_format, topo.radii,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "RADII");
+        append_doubles(line, fmt, topo.radii, natom, "RADII");
         break;
       case Section::Screen:
-        append_doubles(line_view, current_format, topo.screen,
-          pointers_ready ? std::optional<std::size_t>(topo.pointers.natom) : std::nullopt, "SCREEN");
-        break;
-      case Section::Ipol: {
-        std::vector<int> raw;
-        append_ints(line_view, current_format, raw, std::nullopt, "IPOL");
-        if (!raw.empty()) {
-          topo.ipol = raw.front();
-        }
-      } break;
-      default:
+        append_doubles(line, fmt, topo.screen, natom, "SCREEN");
+        break;
+      case Section::Ipol:
+        append_ints(line, fmt, raw.ipol, std::nullopt, "IPOL");
         break;
+      default:
+        return;
     }
   }
+}
 
-  if (!pointers_ready) {
-    topo.pointers = parse_pointers(pointer_values);
-    reserve_from_pointers(topo, topo.pointers);
-  }
-
-  if (!topo.title.empty()) {
-    auto const trimmed = trim(std::string_view(topo.title));
-    topo.title.assign(trimmed);
-  }
-
-  if (!solvent_pointer_raw.empty()) {
-    if (solvent_pointer_raw.size() < 3) {
-      throw std::runtime_error("SOLVENT_POINTERS section has fewer than 3 values");
+// The hydrogen / non-hydrogen halves of each connectivity list fill the same
+// arrays, so they are always selected together. POINTERS is always required.
+[[nodiscard]] Parm7SectionMask normalize_mask(Parm7SectionMask mask) {
+  mask |= section_bit(Section::Pointers);
+  for (auto const &[with_h, without_h] : {std::pair{Section::BondsIncHydrogen, Section::BondsWithoutHydrogen},
+         std::pair{Section::AnglesIncHydrogen, Section::AnglesWithoutHydrogen},
+         std::pair{Section::DihedralsIncHydrogen, Section::DihedralsWithoutHydrogen}}) {
+    if ((mask & (section_bit(with_h) | section_bit(without_h))) != 0) {
+      mask |= section_bit(with_h) | section_bit(without_h);
     }
-    topo.solvent_pointers = std::array<int, 3>{solvent_pointer_raw[0], solvent_pointer_raw[1], solvent_pointer_raw[2]};
   }
+  return mask & kAllParm7Sections;
+}
 
-  if (!box_dimensions_raw.empty()) {
-    if (box_dimensions_raw.size() < 4) {
-      throw std::runtime_error("BOX_DIMENSIONS section has fewer than 4 values");
+// Checks the sections in `mask` against the sizes POINTERS declares.
+void validate_sections(const Parm7Topology &topo, Parm7SectionMask mask) {
+  auto loaded = [mask](Section section) { return (mask & section_bit(section)) != 0; };
+  auto check = [&](Section section, std::string_view name, std::size_t actual, std::size_t expected) {
+    if (loaded(section)) {
+      require_size(name, actual, expected);
     }
-    topo.box_dimensions = std::array<double, 4>{box_dimensions_raw[0], box_dimensions_raw[1], box_dimensions_raw[2],
-      box_dimensions_raw[3]};
-  }
-
-  decode_bonds(bonds_inc_raw, topo);
-  decode_bonds(bonds_noh_raw, topo);
-  decode_angles(angles_inc_raw, topo);
-  decode_angles(angles_noh_raw, topo);
-  decode_dihedrals(dihedrals_inc_raw, topo);
-  decode_dihedrals(dihedrals_noh_raw, topo);
-
-  if (!hbond_cut_raw.empty()) {
-    topo.hbond_cut = hbond_cut_raw.front();
-  }
+  };
 
   auto const natom = static_cast<std::size_t>(topo.pointers.natom);
   auto const nnb = static_cast<std::size_t>(topo.pointers.nnb);
@@ -761,64 +860,301 @@ Parm7Topology parse_parm7_file(const std::filesystem::path &path) {
   auto const natyp = static_cast<std::size_t>(topo.pointers.natyp);
   auto const ntypes = static_cast<std::size_t>(topo.pointers.ntypes);
   auto const nphb = static_cast<std::size_t>(topo.pointers.nphb);
-  auto const bond_count = static_cast<std::size_t>(topo.pointers.nbonh + topo.pointers.nbona);
-  auto const angle_count = static_cast<std::size_t>(topo.pointers.ntheth + topo.pointers.ntheta);
-  auto const dihedral_count = static_cast<std::size_t>(topo.pointers.nphih + topo.pointers.nphia);
-
-  require_size("ATOM_NAME", topo.atom_name.size(), natom);
-  require_size("CHARGE", topo.charge.size(), natom);
-  require_size("ATOMIC_NUMBER", topo.atomic_number.size(), natom);
-  require_size("MASS", topo.mass.size(), natom);
-  require_size("ATOM_TYPE_INDEX", topo.atom_type_index.size(), natom);
-  require_size("NUMBER_EXCLUDED_ATOMS", topo.number_excluded_atoms.size(), natom);
-  require_size("EXCLUDED_ATOMS_LIST", topo.excluded_atoms_list.size(), nnb);
-  require_size("NONBONDED_PARM_INDEX", topo.nonbonded_parm_index.size(), ntypes * ntypes);
-  require_size("RESIDUE_LABEL", topo.residue_label.size(), nres);
-  require_size("RESIDUE_POINTER", topo.residue_pointer.size(), nres);
-  require_size("BOND_FORCE_CONSTANT", topo.bond_force_constant.size(), numbnd);
-  require_size("BOND_EQUIL_VALUE", topo.bond_equil_value.size(), numbnd);
-  require_size("ANGLE_FORCE_CONSTANT", topo.angle_force_constant.size(), numang);
-  require_size("ANGLE_EQUIL_VALUE", topo.angle_equil_value.size(), numang);
-  require_size("DIHEDRAL_FORCE_CONSTANT", topo.dihedral_force_constant.size(), nptra);
-  require_size("DIHEDRAL_PERIODICITY", topo.dihedral_periodicity.size(), nptra);
-  require_size("DIHEDRAL_PHASE", topo.dihedral_phase.size(), nptra);
-  require_size("SCEE_SCALE_FACTOR", topo.scee_scale_factor.size(), nptra);
-  require_size("SCNB_SCALE_FACTOR", topo.scnb_scale_factor.size(), nptra);
-  require_size("SOLTY", topo.solty.size(), natyp);
+  auto const bonds = static_cast<std::size_t>(topo.pointers.nbonh) + static_cast<std::size_t>(topo.pointers.nbona);
+  auto const angles = static_cast<std::size_t>(topo.pointers.ntheth) + static_cast<std::size_t>(topo.pointers.ntheta);
+  auto const dihedrals = static_cast<std::size_t>(topo.pointers.nphih) + static_cast<std::size_t>(topo.pointers.nphia);
+
+  check(Section::AtomName, "ATOM_NAME", topo.atom_name.size(), natom);
+  check(Section::Charge, "CHARGE", topo.charge.size(), natom);
+  check(Section::AtomicNumber, "ATOMIC_NUMBER", topo.atomic_number.size(), natom);
+  check(Section::Mass, "MASS", topo.mass.size(), natom);
+  check(Section::AtomTypeIndex, "ATOM_TYPE_INDEX", topo.atom_type_index.size(), natom);
+  check(Section::NumberExcludedAtoms, "NUMBER_EXCLUDED_ATOMS", topo.number_excluded_atoms.size(), natom);
+  check(Section::ExcludedAtomsList, "EXCLUDED_ATOMS_LIST", topo.excluded_atoms_list.size(), nnb);
+  check(Section::NonbondedParmIndex, "NONBONDED_PARM_INDEX", topo.nonbonded_parm_index.size(), ntypes * ntypes);
+  check(Section::ResidueLabel, "RESIDUE_LABEL", topo.residue_label.size(), nres);
+  check(Section::ResiduePointer, "RESIDUE_POINTER", topo.residue_pointer.size(), nres);
+  check(Section::BondForceConstant, "BOND_FORCE_CONSTANT", topo.bond_force_constant.size(), numbnd);
+  check(Section::BondEquilValue, "BOND_EQUIL_VALUE", topo.bond_equil_value.size(), numbnd);
+  check(Section::AngleForceConstant, "ANGLE_FORCE_CONSTANT", topo.angle_force_constant.size(), numang);
+  check(Section::AngleEquilValue, "ANGLE_EQUIL_VALUE", topo.angle_equil_value.size(), numang);
+  check(Section::DihedralForceConstant, "DIHEDRAL_FORCE_CONSTANT", topo.dihedral_force_constant.size(), nptra);
+  check(Section::DihedralPeriodicity, "DIHEDRAL_PERIODICITY", topo.dihedral_periodicity.size(), nptra);
+  check(Section::DihedralPhase, "DIHEDRAL_PHASE", topo.dihedral_phase.size(), nptra);
+  check(Section::SceeScaleFactor, "SCEE_SCALE_FACTOR", topo.scee_scale_factor.size(), nptra);
+  check(Section::ScnbScaleFactor, "SCNB_SCALE_FACTOR", topo.scnb_scale_factor.size(), nptra);
+  check(Section::Solty, "SOLTY", topo.solty.size(), natyp);
+
+  // The parse fills connectivity rows exactly (finish_connectivity); these
+  // catch topologies built some other way, such as from the binary cache.
+  for (auto const *column : {&topo.bond_i, &topo.bond_j, &topo.bond_type}) {
+    check(Section::BondsIncHydrogen, "BONDS", column->size(), bonds);
+  }
+  for (auto const *column : {&topo.angle_i, &topo.angle_j, &topo.angle_k, &topo.angle_type}) {
+    check(Section::AnglesIncHydrogen, "ANGLES", column->size(), angles);
+  }
+  for (auto const *column :
+    {&topo.dihedral_i, &topo.dihedral_j, &topo.dihedral_k, &topo.dihedral_l, &topo.dihedral_type}) {
+    check(Section::DihedralsIncHydrogen, "DIHEDRALS", column->size(), dihedrals);
+  }
+  check(Section::DihedralsIncHydrogen, "DIHEDRALS", topo.dihedral_flags.size(), dihedrals);
 
   auto const lj_count = ntypes * (ntypes + 1U) / 2U;
-  require_size("LENNARD_JONES_ACOEF", topo.lennard_jones_acoeff.size(), lj_count);
-  require_size("LENNARD_JONES_BCOEF", topo.lennard_jones_bcoeff.size(), lj_count);
-
-  require_size("BONDS", topo.bond_i.size(), bond_count);
-  require_size("ANGLES", topo.angle_i.size(), angle_count);
-  require_size("DIHEDRALS", topo.dihedral_i.size(), dihedral_count);
+  check(Section::LennardJonesAcoef, "LENNARD_JONES_ACOEF", topo.lennard_jones_acoeff.size(), lj_count);
+  check(Section::LennardJonesBcoef, "LENNARD_JONES_BCOEF", topo.lennard_jones_bcoeff.size(), lj_count);
 
   if (topo.pointers.nphb > 0) {
-    require_size("HBOND_ACOEF", topo.hbond_acoeff.size(), nphb);
-    require_size("HBOND_BCOEF", topo.hbond_bcoeff.size(), nphb);
-    if (!topo.hbond_cut) {
+    check(Section::HbondAcoef, "HBOND_ACOEF", topo.hbond_acoeff.size(), nphb);
+    check(Section::HbondBcoef, "HBOND_BCOEF", topo.hbond_bcoeff.size(), nphb);
+    if (loaded(Section::HbondCut) && !topo.hbond_cut) {
       throw std::runtime_error("HBCUT missing but NPHB > 0");
     }
   }
 
-  require_size("AMBER_ATOM_TYPE", topo.amber_atom_type.size(), natom);
-  require_size("TREE_CHAIN_CLASSIFICATION", topo.tree_chain_classification.size(), natom);
-  require_size("JOIN_ARRAY", topo.join_array.size(), natom);
-  require_size("IROTAT", topo.irotat.size(), natom);
+  check(Section::AmberAtomType, "AMBER_ATOM_TYPE", topo.amber_atom_type.size(), natom);
+  check(Section::TreeChainClassification, "TREE_CHAIN_CLASSIFICATION", topo.tree_chain_classification.size(), natom);
+  check(Section::JoinArray, "JOIN_ARRAY", topo.join_array.size(), natom);
+  check(Section::Irotat, "IROTAT", topo.irotat.size(), natom);
 
-  if (topo.pointers.ifbox > 0 && !topo.box_dimensions) {
+  if (loaded(Section::BoxDimensions) && topo.pointers.ifbox > 0 && !topo.box_dimensions) {
     throw std::runtime_error("BOX_DIMENSIONS missing but IFBOX > 0");
   }
 
-  require_size("RADII", topo.radii.size(), natom);
-  require_size("SCREEN", topo.screen.size(), natom);
+  check(Section::Radii, "RADII", topo.radii.size(), natom);
+  check(Section::Screen, "SCREEN", topo.screen.size(), natom);
 
   if (!topo.atoms_per_molecule.empty()) {
-    require_size("ATOMS_PER_MOLECULE", topo.atoms_per_molecule.size(), nres);
+    check(Section::AtomsPerMolecule, "ATOMS_PER_MOLECULE", topo.atoms_per_molecule.size(), nres);
+  }
+}
+
+// Decodes the slices whose section is in `mask` (POINTERS must already be in
+// `topo`), converts the temporaries, and validates everything in `mask`.
+void decode_sections(std::span<const SectionSlice> slices, Parm7SectionMask mask, Parm7Topology &topo,
+  std::size_t threads) {
+  // Every array is reserved here, before the fan-out, so neither resource sees
+  // concurrent allocations.
+  reserve_from_pointers(topo, topo.pointers, mask);
+
+  std::size_t scratch_bytes = 0;
+  RawSections sizing(std::pmr::get_default_resource());
+  for_each_raw_array(sizing, topo.pointers, [&](Section section, auto &values, std::size_t count) {
+    if ((mask & section_bit(section)) != 0) {
+      scratch_bytes += count * sizeof(values[0]) + alignof(std::max_align_t);
+    }
+  });
+  std::pmr::monotonic_buffer_resource scratch(std::max<std::size_t>(scratch_bytes, 1));
+  RawSections raw(&scratch);
+  bind_connectivity(topo, mask, raw);
+  for_each_raw_array(raw, topo.pointers, [mask](Section section, auto &values, std::size_t count) {
+    if ((mask & section_bit(section)) != 0) {
+      values.reserve(count);
+    }
+  });
+
+  // Group repeated flags so that each task owns exactly one destination, and
+  // schedule the largest sections first.
+  std::vector<std::vector<SectionSlice const *>> tasks;
+  std::array<std::size_t, kParm7SectionCount> task_of_section{};
+  task_of_section.fill(std::numeric_limits<std::size_t>::max());
+  for (auto const &slice : slices) {
+    if (!slice.section || *slice.section == Section::Pointers || (mask & section_bit(*slice.section)) == 0) {
+      continue;
+    }
+    auto &task_index = task_of_section[static_cast<std::size_t>(*slice.section)];
+    if (task_index == std::numeric_limits<std::size_t>::max()) {
+      task_index = tasks.size();
+      tasks.emplace_back();
+    }
+    tasks[task_index].push_back(&slice);
+  }
+
+  auto task_bytes = [](const std::vector<SectionSlice const *> &task) {
+    std::size_t bytes = 0;
+    for (auto const *slice : task) {
+      bytes += slice->body.size();
+    }
+    return bytes;
+  };
+  std::stable_sort(tasks.begin(), tasks.end(),
+    [&](const auto &lhs, const auto &rhs) { return task_bytes(lhs) > task_bytes(rhs); });
+
+  parallel_for(tasks.size(), threads, [&](std::size_t idx) {
+    for (auto const *slice : tasks[idx]) {
+      parse_section_body(*slice, topo, raw);
+    }
+  });
+
+  if (!topo.title.empty()) {
+    auto const trimmed = trim(std::string_view(topo.title));
+    topo.title.assign(trimmed);
+  }
+
+  if (!raw.solvent_pointers.empty()) {
+    if (raw.solvent_pointers.size() < 3) {
+      throw std::runtime_error("SOLVENT_POINTERS section has fewer than 3 values");
+    }
+    topo.solvent_pointers =
+      std::array<int, 3>{raw.solvent_pointers[0], raw.solvent_pointers[1], raw.solvent_pointers[2]};
+  }
+
+  if (!raw.box_dimensions.empty()) {
+    if (raw.box_dimensions.size() < 4) {
+      throw std::runtime_error("BOX_DIMENSIONS section has fewer than 4 values");
+    }
+    topo.box_dimensions = std::array<double, 4>{raw.box_dimensions[0], raw.box_dimensions[1], raw.box_dimensions[2],
+      raw.box_dimensions[3]};
+  }
+
+  finish_connectivity(raw, mask);
+
+  if (!raw.hbond_cut.empty()) {
+    topo.hbond_cut = raw.hbond_cut.front();
+  }
+  if (!raw.residue_label.empty()) {
+    topo.residue_label = intern_names(raw.residue_label, topo.resource);
+  }
+  if (!raw.amber_atom_type.empty()) {
+    topo.amber_atom_type = intern_names(raw.amber_atom_type, topo.resource);
+  }
+  if (!raw.ipol.empty()) {
+    topo.ipol = raw.ipol.front();
+  }
+
+  validate_sections(topo, mask);
+  topo.loaded_sections |= mask;
+}
+
+// Decodes just the POINTERS block, which sizes everything else.
+[[nodiscard]] Parm7Pointers decode_pointers(std::span<const SectionSlice> slices) {
+  std::pmr::vector<int> values;
+  for (auto const &slice : slices) {
+    if (slice.section != Section::Pointers) {
+      continue;
+    }
+    LineReader reader(std::span<const char>(slice.body.data(), slice.body.size()));
+    std::string_view line;
+    while (reader.next(line)) {
+      if (!starts_with(line, "%")) {
+        append_ints(line, slice.format, values, std::nullopt, "POINTERS");
+      }
+    }
+  }
+  return parse_pointers(values);
+}
+
+} // namespace
+
+std::size_t parm7_storage_bytes(const Parm7Pointers &pointers, Parm7SectionMask sections) {
+  // A monotonic arena aligns each array on its own; leave room for that and for
+  // the distinct-name tables, whose size only decoding reveals.
+  constexpr std::size_t kArrayPadding = alignof(std::max_align_t);
+  constexpr std::size_t kNameTableBytes = 256 * sizeof(PackedName) + kArrayPadding;
+
+  auto const mask = normalize_mask(sections);
+  std::size_t bytes = 0;
+  Parm7Topology layout;
+  for_each_sized_array(layout, pointers, [&](Section section, auto &values, std::size_t count) {
+    if ((mask & section_bit(section)) != 0) {
+      bytes += count * sizeof(values[0]) + kArrayPadding;
+    }
+  });
+  for (auto const &[section, count] : {std::pair{Section::ResidueLabel, pointers.nres},
+         std::pair{Section::AmberAtomType, pointers.natom}}) {
+    if ((mask & section_bit(section)) != 0) {
+      bytes += static_cast<std::size_t>(count) * sizeof(std::uint32_t) + kArrayPadding + kNameTableBytes;
+    }
+  }
+  return bytes;
+}
+
+Parm7Topology make_parm7_topology(const Parm7Pointers &pointers, const Parm7ParseOptions &options) {
+  auto *const upstream = options.resource != nullptr ? options.resource : std::pmr::get_default_resource();
+  if (!options.use_arena) {
+    return Parm7Topology(upstream);
   }
+  auto arena = std::make_shared<std::pmr::monotonic_buffer_resource>(parm7_storage_bytes(pointers, options.sections),
+    upstream);
+  auto *const storage = arena.get();
+  return Parm7Topology(storage, std::move(arena));
+}
+
+void validate_parm7_sections(const Parm7Topology &topo, Parm7SectionMask sections) {
+  validate_sections(topo, normalize_mask(sections));
+}
+
+Parm7Topology parse_parm7_file(const std::filesystem::path &path, const Parm7ParseOptions &options) {
+  MappedFile file;
+  try {
+    file = MappedFile(path);
+  } catch (const std::runtime_error &) {
+    throw std::runtime_error(fmt::format("Failed to open parm7 file: {}", path.string()));
+  }
+  return parse_parm7_buffer(file.bytes(), options);
+}
 
+Parm7Topology parse_parm7_buffer(std::span<const char> buffer, const Parm7ParseOptions &options) {
+  std::string version;
+  auto const slices = scan_sections(buffer, version);
+
+  // POINTERS sizes every other section (and the arena), so it is decoded first.
+  auto const pointers = decode_pointers(slices);
+  auto const mask = normalize_mask(options.sections);
+  auto topo = make_parm7_topology(pointers, options);
+  topo.version = std::move(version);
+  topo.pointers = pointers;
+
+  // Skipped sections are only located; their bytes are never tokenized.
+  for (auto const &slice : slices) {
+    if (slice.section && (mask & section_bit(*slice.section)) == 0) {
+      topo.deferred_sections.push_back(Parm7DeferredSection{*slice.section,
+        static_cast<std::size_t>(slice.flag - buffer.data()),
+        static_cast<std::size_t>(slice.body.data() + slice.body.size() - slice.flag)});
+    }
+  }
+
+  decode_sections(slices, mask, topo, options.threads);
   return topo;
 }
 
+void load_parm7_sections(Parm7Topology &topo, std::span<const char> buffer, Parm7SectionMask sections,
+  const Parm7ParseOptions &options) {
+  auto const mask = normalize_mask(sections) & ~topo.loaded_sections;
+  if (mask == 0) {
+    return;
+  }
+
+  std::vector<SectionSlice> slices;
+  std::string version;
+  auto selected = [mask](const Parm7DeferredSection &deferred) { return (mask & section_bit(deferred.section)) != 0; };
+  for (auto const &deferred : topo.deferred_sections) {
+    if (!selected(deferred)) {
+      continue;
+    }
+    auto const block = std::string_view(buffer.data(), buffer.size()).substr(std::min(deferred.offset, buffer.size()));
+    if (block.size() < deferred.size || !starts_with(block, "%FLAG")) {
+      throw std::runtime_error("Deferred parm7 section does not match the buffer the topology was parsed from");
+    }
+    auto block_slices = scan_sections(std::span<const char>(block.data(), deferred.size), version);
+    if (block_slices.size() != 1 || block_slices.front().section != deferred.section) {
+      throw std::runtime_error("Deferred parm7 section does not match the buffer the topology was parsed from");
+    }
+    slices.push_back(block_slices.front());
+  }
+
+  decode_sections(slices, mask, topo, options.threads);
+  std::erase_if(topo.deferred_sections, selected);
+}
+
+void load_parm7_file_sections(Parm7Topology &topo, const std::filesystem::path &path, Parm7SectionMask sections,
+  const Parm7ParseOptions &options) {
+  MappedFile file;
+  try {
+    file = MappedFile(path);
+  } catch (const std::runtime_error &) {
+    throw std::runtime_error(fmt::format("Failed to open parm7 file: {}", path.string()));
+  }
+  load_parm7_sections(topo, file.bytes(), sections, options);
+}
+
 } // namespace rms
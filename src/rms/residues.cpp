@@ -0,0 +1,55 @@
+#include "include/residues.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kResiduesPerTask = 4096;
+
+} // namespace
+
+ResidueIndex::ResidueIndex(const Parm7Topology &topo) {
+  if ((topo.loaded_sections & section_bit(Parm7Section::ResiduePointer)) == 0) {
+    throw std::runtime_error("ResidueIndex needs the RESIDUE_POINTER section to be loaded");
+  }
+  int const natom = topo.pointers.natom;
+  auto const &pointers = topo.residue_pointer;
+  if (!pointers.empty() && pointers.front() != 0) {
+    throw std::runtime_error(fmt::format("RESIDUE_POINTER starts at atom {}, expected 1", pointers.front() + 1));
+  }
+
+  starts_.reserve(pointers.size() + 1);
+  int previous = 0;
+  for (std::size_t residue = 0; residue < pointers.size(); ++residue) {
+    int const start = pointers[residue];
+    if (start < previous || start > natom) {
+      throw std::runtime_error(fmt::format("RESIDUE_POINTER entry {} ({}) is out of order or past NATOM", residue + 1,
+        start + 1));
+    }
+    starts_.push_back(start);
+    previous = start;
+  }
+  starts_.push_back(natom);
+}
+
+std::vector<int> ResidueIndex::build_atom_map(std::size_t threads) const {
+  std::vector<int> atom_map(atom_count());
+  std::size_t const nres = residue_count();
+  parallel_for((nres + kResiduesPerTask - 1) / kResiduesPerTask, threads, [&](std::size_t task) {
+    std::size_t const end = std::min(nres, (task + 1) * kResiduesPerTask);
+    for (std::size_t residue = task * kResiduesPerTask; residue < end; ++residue) {
+      std::fill(atom_map.begin() + starts_[residue], atom_map.begin() + starts_[residue + 1],
+        static_cast<int>(residue));
+    }
+  });
+  return atom_map;
+}
+
+} // namespace rms
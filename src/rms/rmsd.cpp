@@ -0,0 +1,711 @@
+#include "include/rmsd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+#if RMS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rms {
+namespace {
+
+// Newton tolerance on the largest eigenvalue, and the floor below which a
+// quaternion adjoint row is treated as degenerate (as in Liu et al.'s qcprot).
+constexpr double kEigenvaluePrecision = 1e-11;
+constexpr double kEigenvectorPrecision = 1e-6;
+constexpr int kNewtonIterations = 50;
+
+template <typename T>
+struct KernelInput {
+  T const *ax;
+  T const *ay;
+  T const *az;
+  T const *bx;
+  T const *by;
+  T const *bz;
+  // Null for unweighted RMSD.
+  T const *w;
+  std::size_t count;
+  double total_weight;
+};
+
+template <typename T>
+using SumsFn = void (*)(const KernelInput<T> &, RmsdSums &) noexcept;
+
+template <typename T, bool Weighted>
+void centroid_tail(const KernelInput<T> &in, std::size_t begin, std::size_t end, std::array<double, 3> &sum) noexcept {
+  for (auto atom = begin; atom < end; ++atom) {
+    double const w = Weighted ? static_cast<double>(in.w[atom]) : 1.0;
+    sum[0] += w * static_cast<double>(in.ax[atom]);
+    sum[1] += w * static_cast<double>(in.ay[atom]);
+    sum[2] += w * static_cast<double>(in.az[atom]);
+  }
+}
+
+template <typename T, bool Weighted>
+void moments_tail(const KernelInput<T> &in, std::size_t begin, std::size_t end, RmsdSums &out) noexcept {
+  for (auto atom = begin; atom < end; ++atom) {
+    std::array<double, 3> const a = {static_cast<double>(in.ax[atom]) - out.origin[0],
+      static_cast<double>(in.ay[atom]) - out.origin[1], static_cast<double>(in.az[atom]) - out.origin[2]};
+    std::array<double, 3> const b = {
+      static_cast<double>(in.bx[atom]), static_cast<double>(in.by[atom]), static_cast<double>(in.bz[atom])};
+    double const w = Weighted ? static_cast<double>(in.w[atom]) : 1.0;
+    for (std::size_t i = 0; i < 3; ++i) {
+      double const wa = w * a[i];
+      out.a[i] += wa;
+      out.aa += wa * a[i];
+      for (std::size_t j = 0; j < 3; ++j) {
+        out.ab[3 * i + j] += wa * b[j];
+      }
+    }
+  }
+}
+
+template <typename T, bool Weighted>
+void sums_scalar(const KernelInput<T> &in, RmsdSums &out) noexcept {
+  std::array<double, 3> sum{};
+  centroid_tail<T, Weighted>(in, 0, in.count, sum);
+  for (std::size_t i = 0; i < 3; ++i) {
+    out.origin[i] = sum[i] / in.total_weight;
+  }
+  moments_tail<T, Weighted>(in, 0, in.count, out);
+}
+
+#if RMS_X86_DISPATCH
+// Vector operations for the kernels. Arithmetic is always in double lanes:
+// float coordinates are widened as they are loaded, which keeps their halved
+// memory traffic but makes every product exact. QCP takes the RMSD from the
+// small difference of two large sums, so float lanes would put ~1e-2 A of
+// noise on near-identical structures.
+template <typename T>
+struct Avx2Ops {
+  using Vec = __m256d;
+  static constexpr std::size_t kWidth = 4;
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec load(T const *p) noexcept {
+    if constexpr (std::is_same_v<T, float>) {
+      return _mm256_cvtps_pd(_mm_loadu_ps(p));
+    } else {
+      return _mm256_loadu_pd(p);
+    }
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec zero() noexcept { return _mm256_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec set1(double v) noexcept { return _mm256_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec add(Vec a, Vec b) noexcept { return _mm256_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx2,fma") static double sum(Vec v) noexcept {
+    __m128d const pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+  }
+};
+
+template <typename T>
+struct Avx512Ops {
+  using Vec = __m512d;
+  static constexpr std::size_t kWidth = 8;
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec load(T const *p) noexcept {
+    if constexpr (std::is_same_v<T, float>) {
+      // The zero-masked form; GCC 12's plain one trips -Wmaybe-uninitialized.
+      return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(p));
+    } else {
+      return _mm512_loadu_pd(p);
+    }
+  }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec zero() noexcept { return _mm512_setzero_pd(); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec set1(double v) noexcept { return _mm512_set1_pd(v); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec add(Vec a, Vec b) noexcept { return _mm512_add_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec sub(Vec a, Vec b) noexcept { return _mm512_sub_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec mul(Vec a, Vec b) noexcept { return _mm512_mul_pd(a, b); }
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static Vec fma(Vec a, Vec b, Vec c) noexcept {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+  // Stored rather than reduced in-register, for the same reason.
+  [[gnu::always_inline]] RMS_TARGET("avx512f") static double sum(Vec v) noexcept {
+    alignas(64) std::array<double, 8> lanes;
+    _mm512_store_pd(lanes.data(), v);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+};
+
+// The AVX2 and AVX-512 kernels share one body, written out per target because
+// a function's ISA cannot be a template parameter.
+template <typename T, bool Weighted>
+RMS_TARGET("avx2,fma") void sums_avx2(const KernelInput<T> &in, RmsdSums &out) noexcept {
+  using Ops = Avx2Ops<T>;
+  using Vec = typename Ops::Vec;
+  auto const vector_end = in.count / Ops::kWidth * Ops::kWidth;
+
+  // Pass 1: the centroid, so the moments below are taken about it.
+  Vec cx = Ops::zero();
+  Vec cy = Ops::zero();
+  Vec cz = Ops::zero();
+  for (std::size_t atom = 0; atom < vector_end; atom += Ops::kWidth) {
+    if constexpr (Weighted) {
+      Vec const w = Ops::load(in.w + atom);
+      cx = Ops::fma(w, Ops::load(in.ax + atom), cx);
+      cy = Ops::fma(w, Ops::load(in.ay + atom), cy);
+      cz = Ops::fma(w, Ops::load(in.az + atom), cz);
+    } else {
+      cx = Ops::add(cx, Ops::load(in.ax + atom));
+      cy = Ops::add(cy, Ops::load(in.ay + atom));
+      cz = Ops::add(cz, Ops::load(in.az + atom));
+    }
+  }
+  std::array<double, 3> centroid = {Ops::sum(cx), Ops::sum(cy), Ops::sum(cz)};
+  centroid_tail<T, Weighted>(in, vector_end, in.count, centroid);
+  for (std::size_t i = 0; i < 3; ++i) {
+    out.origin[i] = centroid[i] / in.total_weight;
+  }
+
+  // Pass 2: sums of w a, w |a|^2 and w a_i b_j.
+  Vec const ox = Ops::set1(out.origin[0]);
+  Vec const oy = Ops::set1(out.origin[1]);
+  Vec const oz = Ops::set1(out.origin[2]);
+  Vec sx = Ops::zero();
+  Vec sy = Ops::zero();
+  Vec sz = Ops::zero();
+  Vec saa = Ops::zero();
+  Vec sxx = Ops::zero();
+  Vec sxy = Ops::zero();
+  Vec sxz = Ops::zero();
+  Vec syx = Ops::zero();
+  Vec syy = Ops::zero();
+  Vec syz = Ops::zero();
+  Vec szx = Ops::zero();
+  Vec szy = Ops::zero();
+  Vec szz = Ops::zero();
+  for (std::size_t atom = 0; atom < vector_end; atom += Ops::kWidth) {
+    Vec const ax = Ops::sub(Ops::load(in.ax + atom), ox);
+    Vec const ay = Ops::sub(Ops::load(in.ay + atom), oy);
+    Vec const az = Ops::sub(Ops::load(in.az + atom), oz);
+    Vec const bx = Ops::load(in.bx + atom);
+    Vec const by = Ops::load(in.by + atom);
+    Vec const bz = Ops::load(in.bz + atom);
+    Vec wx = ax;
+    Vec wy = ay;
+    Vec wz = az;
+    if constexpr (Weighted) {
+      Vec const w = Ops::load(in.w + atom);
+      wx = Ops::mul(w, ax);
+      wy = Ops::mul(w, ay);
+      wz = Ops::mul(w, az);
+    }
+    sx = Ops::add(sx, wx);
+    sy = Ops::add(sy, wy);
+    sz = Ops::add(sz, wz);
+    saa = Ops::add(saa, Ops::fma(wz, az, Ops::fma(wy, ay, Ops::mul(wx, ax))));
+    sxx = Ops::fma(wx, bx, sxx);
+    sxy = Ops::fma(wx, by, sxy);
+    sxz = Ops::fma(wx, bz, sxz);
+    syx = Ops::fma(wy, bx, syx);
+    syy = Ops::fma(wy, by, syy);
+    syz = Ops::fma(wy, bz, syz);
+    szx = Ops::fma(wz, bx, szx);
+    szy = Ops::fma(wz, by, szy);
+    szz = Ops::fma(wz, bz, szz);
+  }
+  out.a = {Ops::sum(sx), Ops::sum(sy), Ops::sum(sz)};
+  out.aa = Ops::sum(saa);
+  out.ab = {Ops::sum(sxx), Ops::sum(sxy), Ops::sum(sxz), Ops::sum(syx), Ops::sum(syy), Ops::sum(syz), Ops::sum(szx),
+    Ops::sum(szy), Ops::sum(szz)};
+  moments_tail<T, Weighted>(in, vector_end, in.count, out);
+}
+
+template <typename T, bool Weighted>
+RMS_TARGET("avx512f") void sums_avx512(const KernelInput<T> &in, RmsdSums &out) noexcept {
+  using Ops = Avx512Ops<T>;
+  using Vec = typename Ops::Vec;
+  auto const vector_end = in.count / Ops::kWidth * Ops::kWidth;
+
+  // Pass 1: the centroid, so the moments below are taken about it.
+  Vec cx = Ops::zero();
+  Vec cy = Ops::zero();
+  Vec cz = Ops::zero();
+  for (std::size_t atom = 0; atom < vector_end; atom += Ops::kWidth) {
+    if constexpr (Weighted) {
+      Vec const w = Ops::load(in.w + atom);
+      cx = Ops::fma(w, Ops::load(in.ax + atom), cx);
+      cy = Ops::fma(w, Ops::load(in.ay + atom), cy);
+      cz = Ops::fma(w, Ops::load(in.az + atom), cz);
+    } else {
+      cx = Ops::add(cx, Ops::load(in.ax + atom));
+      cy = Ops::add(cy, Ops::load(in.ay + atom));
+      cz = Ops::add(cz, Ops::load(in.az + atom));
+    }
+  }
+  std::array<double, 3> centroid = {Ops::sum(cx), Ops::sum(cy), Ops::sum(cz)};
+  centroid_tail<T, Weighted>(in, vector_end, in.count, centroid);
+  for (std::size_t i = 0; i < 3; ++i) {
+    out.origin[i] = centroid[i] / in.total_weight;
+  }
+
+  // Pass 2: sums of w a, w |a|^2 and w a_i b_j.
+  Vec const ox = Ops::set1(out.origin[0]);
+  Vec const oy = Ops::set1(out.origin[1]);
+  Vec const oz = Ops::set1(out.origin[2]);
+  Vec sx = Ops::zero();
+  Vec sy = Ops::zero();
+  Vec sz = Ops::zero();
+  Vec saa = Ops::zero();
+  Vec sxx = Ops::zero();
+  Vec sxy = Ops::zero();
+  Vec sxz = Ops::zero();
+  Vec syx = Ops::zero();
+  Vec syy = Ops::zero();
+  Vec syz = Ops::zero();
+  Vec szx = Ops::zero();
+  Vec szy = Ops::zero();
+  Vec szz = Ops::zero();
+  for (std::size_t atom = 0; atom < vector_end; atom += Ops::kWidth) {
+    Vec const ax = Ops::sub(Ops::load(in.ax + atom), ox);
+    Vec const ay = Ops::sub(Ops::load(in.ay + atom), oy);
+    Vec const az = Ops::sub(Ops::load(in.az + atom), oz);
+    Vec const bx = Ops::load(in.bx + atom);
+    Vec const by = Ops::load(in.by + atom);
+    Vec const bz = Ops::load(in.bz + atom);
+    Vec wx = ax;
+    Vec wy = ay;
+    Vec wz = az;
+    if constexpr (Weighted) {
+      Vec const w = Ops::load(in.w + atom);
+      wx = Ops::mul(w, ax);
+      wy = Ops::mul(w, ay);
+      wz = Ops::mul(w, az);
+    }
+    sx = Ops::add(sx, wx);
+    sy = Ops::add(sy, wy);
+    sz = Ops::add(sz, wz);
+    saa = Ops::add(saa, Ops::fma(wz, az, Ops::fma(wy, ay, Ops::mul(wx, ax))));
+    sxx = Ops::fma(wx, bx, sxx);
+    sxy = Ops::fma(wx, by, sxy);
+    sxz = Ops::fma(wx, bz, sxz);
+    syx = Ops::fma(wy, bx, syx);
+    syy = Ops::fma(wy, by, syy);
+    syz = Ops::fma(wy, bz, syz);
+    szx = Ops::fma(wz, bx, szx);
+    szy = Ops::fma(wz, by, szy);
+    szz = Ops::fma(wz, bz, szz);
+  }
+  out.a = {Ops::sum(sx), Ops::sum(sy), Ops::sum(sz)};
+  out.aa = Ops::sum(saa);
+  out.ab = {Ops::sum(sxx), Ops::sum(sxy), Ops::sum(sxz), Ops::sum(syx), Ops::sum(syy), Ops::sum(syz), Ops::sum(szx),
+    Ops::sum(szy), Ops::sum(szz)};
+  moments_tail<T, Weighted>(in, vector_end, in.count, out);
+}
+
+// sum a_i b_j over two packed [x | y | z] frames; `stride` is a multiple of
+// kPackedFrameAlign, so there is no tail. One body per target, as above.
+RMS_TARGET("avx2,fma") std::array<double, 9> packed_covariance_avx2(float const *a, float const *b,
+  std::size_t stride) noexcept {
+  using Ops = Avx2Ops<float>;
+  using Vec = typename Ops::Vec;
+  Vec sxx = Ops::zero();
+  Vec sxy = Ops::zero();
+  Vec sxz = Ops::zero();
+  Vec syx = Ops::zero();
+  Vec syy = Ops::zero();
+  Vec syz = Ops::zero();
+  Vec szx = Ops::zero();
+  Vec szy = Ops::zero();
+  Vec szz = Ops::zero();
+  for (std::size_t atom = 0; atom < stride; atom += Ops::kWidth) {
+    Vec const ax = Ops::load(a + atom);
+    Vec const ay = Ops::load(a + stride + atom);
+    Vec const az = Ops::load(a + 2 * stride + atom);
+    Vec const bx = Ops::load(b + atom);
+    Vec const by = Ops::load(b + stride + atom);
+    Vec const bz = Ops::load(b + 2 * stride + atom);
+    sxx = Ops::fma(ax, bx, sxx);
+    sxy = Ops::fma(ax, by, sxy);
+    sxz = Ops::fma(ax, bz, sxz);
+    syx = Ops::fma(ay, bx, syx);
+    syy = Ops::fma(ay, by, syy);
+    syz = Ops::fma(ay, bz, syz);
+    szx = Ops::fma(az, bx, szx);
+    szy = Ops::fma(az, by, szy);
+    szz = Ops::fma(az, bz, szz);
+  }
+  return {Ops::sum(sxx), Ops::sum(sxy), Ops::sum(sxz), Ops::sum(syx), Ops::sum(syy), Ops::sum(syz), Ops::sum(szx),
+    Ops::sum(szy), Ops::sum(szz)};
+}
+
+RMS_TARGET("avx512f") std::array<double, 9> packed_covariance_avx512(float const *a, float const *b,
+  std::size_t stride) noexcept {
+  using Ops = Avx512Ops<float>;
+  using Vec = typename Ops::Vec;
+  Vec sxx = Ops::zero();
+  Vec sxy = Ops::zero();
+  Vec sxz = Ops::zero();
+  Vec syx = Ops::zero();
+  Vec syy = Ops::zero();
+  Vec syz = Ops::zero();
+  Vec szx = Ops::zero();
+  Vec szy = Ops::zero();
+  Vec szz = Ops::zero();
+  for (std::size_t atom = 0; atom < stride; atom += Ops::kWidth) {
+    Vec const ax = Ops::load(a + atom);
+    Vec const ay = Ops::load(a + stride + atom);
+    Vec const az = Ops::load(a + 2 * stride + atom);
+    Vec const bx = Ops::load(b + atom);
+    Vec const by = Ops::load(b + stride + atom);
+    Vec const bz = Ops::load(b + 2 * stride + atom);
+    sxx = Ops::fma(ax, bx, sxx);
+    sxy = Ops::fma(ax, by, sxy);
+    sxz = Ops::fma(ax, bz, sxz);
+    syx = Ops::fma(ay, bx, syx);
+    syy = Ops::fma(ay, by, syy);
+    syz = Ops::fma(ay, bz, syz);
+    szx = Ops::fma(az, bx, szx);
+    szy = Ops::fma(az, by, szy);
+    szz = Ops::fma(az, bz, szz);
+  }
+  return {Ops::sum(sxx), Ops::sum(sxy), Ops::sum(sxz), Ops::sum(syx), Ops::sum(syy), Ops::sum(syz), Ops::sum(szx),
+    Ops::sum(szy), Ops::sum(szz)};
+}
+#endif
+
+std::array<double, 9> packed_covariance_scalar(float const *a, float const *b, std::size_t stride) noexcept {
+  std::array<double, 9> out{};
+  for (std::size_t atom = 0; atom < stride; ++atom) {
+    std::array<double, 3> const va = {static_cast<double>(a[atom]), static_cast<double>(a[stride + atom]),
+      static_cast<double>(a[2 * stride + atom])};
+    std::array<double, 3> const vb = {static_cast<double>(b[atom]), static_cast<double>(b[stride + atom]),
+      static_cast<double>(b[2 * stride + atom])};
+    for (std::size_t i = 0; i < 3; ++i) {
+      for (std::size_t j = 0; j < 3; ++j) {
+        out[3 * i + j] += va[i] * vb[j];
+      }
+    }
+  }
+  return out;
+}
+
+template <typename T>
+[[nodiscard]] SumsFn<T> select_sums(SimdLevel level, bool weighted) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return weighted ? &sums_avx512<T, true> : &sums_avx512<T, false>;
+  }
+  if (level >= SimdLevel::Avx2) {
+    return weighted ? &sums_avx2<T, true> : &sums_avx2<T, false>;
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return weighted ? &sums_scalar<T, true> : &sums_scalar<T, false>;
+}
+
+// Centres the frame's sums (its centroid sits at s.a / W from the origin it
+// was shifted by) and solves for the RMSD against a reference whose stored
+// values sum to `residual` and have centred inner product `inner_b`.
+[[nodiscard]] double centred_qcp(const RmsdSums &s, double total_weight, const std::array<double, 3> &residual,
+  double inner_b, std::array<double, 9> *rotation) noexcept {
+  std::array<double, 9> covariance{};
+  double inner_a = s.aa;
+  if (total_weight > 0.0) {
+    std::array<double, 3> const mean = {s.a[0] / total_weight, s.a[1] / total_weight, s.a[2] / total_weight};
+    inner_a -= total_weight * (mean[0] * mean[0] + mean[1] * mean[1] + mean[2] * mean[2]);
+    for (std::size_t i = 0; i < 3; ++i) {
+      for (std::size_t j = 0; j < 3; ++j) {
+        covariance[3 * i + j] = s.ab[3 * i + j] - mean[i] * residual[j];
+      }
+    }
+  }
+  return qcp_rmsd(covariance, inner_a, inner_b, total_weight, rotation);
+}
+
+} // namespace
+
+std::array<double, 9> packed_covariance(float const *a, float const *b, std::size_t stride, SimdLevel level) noexcept {
+#if RMS_X86_DISPATCH
+  if (level >= SimdLevel::Avx512) {
+    return packed_covariance_avx512(a, b, stride);
+  }
+  if (level >= SimdLevel::Avx2) {
+    return packed_covariance_avx2(a, b, stride);
+  }
+#else
+  static_cast<void>(level);
+#endif
+  return packed_covariance_scalar(a, b, stride);
+}
+
+double qcp_rmsd(const std::array<double, 9> &covariance, double inner_a, double inner_b, double total_weight,
+  std::array<double, 9> *rotation) noexcept {
+  if (rotation != nullptr) {
+    *rotation = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  }
+  if (!(total_weight > 0.0)) {
+    return 0.0;
+  }
+
+  auto const [sxx, sxy, sxz, syx, syy, syz, szx, szy, szz] = covariance;
+  double const sxx2 = sxx * sxx;
+  double const syy2 = syy * syy;
+  double const szz2 = szz * szz;
+  double const sxy2 = sxy * sxy;
+  double const syz2 = syz * syz;
+  double const sxz2 = sxz * sxz;
+  double const syx2 = syx * syx;
+  double const szy2 = szy * szy;
+  double const szx2 = szx * szx;
+
+  double const syz_szy_m_syy_szz2 = 2.0 * (syz * szy - syy * szz);
+  double const sxx2_syy2_szz2_syz2_szy2 = syy2 + szz2 - sxx2 + syz2 + szy2;
+  double const sxy2_sxz2_syx2_szx2 = sxy2 + sxz2 - syx2 - szx2;
+
+  // Characteristic polynomial of the key matrix: x^4 + c2 x^2 + c1 x + c0.
+  double const c2 = -2.0 * (sxx2 + syy2 + szz2 + sxy2 + syx2 + sxz2 + szx2 + syz2 + szy2);
+  double const c1 =
+    8.0 * (sxx * syz * szy + syy * szx * sxz + szz * sxy * syx - sxx * syy * szz - syz * szx * sxy - szy * syx * sxz);
+
+  double const sxz_p_szx = sxz + szx;
+  double const syz_p_szy = syz + szy;
+  double const sxy_p_syx = sxy + syx;
+  double const syz_m_szy = syz - szy;
+  double const sxz_m_szx = sxz - szx;
+  double const sxy_m_syx = sxy - syx;
+  double const sxx_p_syy = sxx + syy;
+  double const sxx_m_syy = sxx - syy;
+
+  double const c0 = sxy2_sxz2_syx2_szx2 * sxy2_sxz2_syx2_szx2
+                    + (sxx2_syy2_szz2_syz2_szy2 + syz_szy_m_syy_szz2) * (sxx2_syy2_szz2_syz2_szy2 - syz_szy_m_syy_szz2)
+                    + (-sxz_p_szx * syz_m_szy + sxy_m_syx * (sxx_m_syy - szz))
+                        * (-sxz_m_szx * syz_p_szy + sxy_m_syx * (sxx_m_syy + szz))
+                    + (-sxz_p_szx * syz_p_szy - sxy_p_syx * (sxx_p_syy - szz))
+                        * (-sxz_m_szx * syz_m_szy - sxy_p_syx * (sxx_p_syy + szz))
+                    + (sxy_p_syx * syz_p_szy + sxz_p_szx * (sxx_m_syy + szz))
+                        * (-sxy_m_syx * syz_m_szy + sxz_p_szx * (sxx_p_syy + szz))
+                    + (sxy_p_syx * syz_m_szy + sxz_m_szx * (sxx_m_syy - szz))
+                        * (-sxy_m_syx * syz_p_szy + sxz_m_szx * (sxx_p_syy - szz));
+
+  // The largest root is bounded above by E0, so Newton from there converges to
+  // it. Both structures collapsed to a point (e.g. one atom) have E0 = 0.
+  double const e0 = 0.5 * (inner_a + inner_b);
+  if (!(e0 > 0.0)) {
+    return 0.0;
+  }
+  double lambda = e0;
+  for (int iter = 0; iter < kNewtonIterations; ++iter) {
+    double const previous = lambda;
+    double const x2 = lambda * lambda;
+    double const b = (x2 + c2) * lambda;
+    double const a = b + c1;
+    double const step = (a * lambda + c0) / (2.0 * x2 * lambda + b + a);
+    lambda -= step;
+    if (std::abs(lambda - previous) < std::abs(kEigenvaluePrecision * lambda)) {
+      break;
+    }
+  }
+  double const rmsd = std::sqrt(std::abs(2.0 * (e0 - lambda) / total_weight));
+  if (rotation == nullptr) {
+    return rmsd;
+  }
+
+  // Eigenvector of the key matrix for lambda, from the first adjoint row that
+  // is not degenerate.
+  double const a11 = sxx_p_syy + szz - lambda;
+  double const a12 = syz_m_szy;
+  double const a13 = -sxz_m_szx;
+  double const a14 = sxy_m_syx;
+  double const a21 = syz_m_szy;
+  double const a22 = sxx_m_syy - szz - lambda;
+  double const a23 = sxy_p_syx;
+  double const a24 = sxz_p_szx;
+  double const a31 = a13;
+  double const a32 = a23;
+  double const a33 = syy - sxx - szz - lambda;
+  double const a34 = syz_p_szy;
+  double const a41 = a14;
+  double const a42 = a24;
+  double const a43 = a34;
+  double const a44 = szz - sxx_p_syy - lambda;
+
+  double const a3344_4334 = a33 * a44 - a43 * a34;
+  double const a3244_4234 = a32 * a44 - a42 * a34;
+  double const a3243_4233 = a32 * a43 - a42 * a33;
+  double const a3143_4133 = a31 * a43 - a41 * a33;
+  double const a3144_4134 = a31 * a44 - a41 * a34;
+  double const a3142_4132 = a31 * a42 - a41 * a32;
+  double const a1324_1423 = a13 * a24 - a14 * a23;
+  double const a1224_1422 = a12 * a24 - a14 * a22;
+  double const a1223_1322 = a12 * a23 - a13 * a22;
+  double const a1124_1421 = a11 * a24 - a14 * a21;
+  double const a1123_1321 = a11 * a23 - a13 * a21;
+  double const a1122_1221 = a11 * a22 - a12 * a21;
+
+  std::array<std::array<double, 4>, 4> const candidates = {{
+    {a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233, -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133,
+      a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132, -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132},
+    {a12 * a3344_4334 - a13 * a3244_4234 + a14 * a3243_4233, -a11 * a3344_4334 + a13 * a3144_4134 - a14 * a3143_4133,
+      a11 * a3244_4234 - a12 * a3144_4134 + a14 * a3142_4132, -a11 * a3243_4233 + a12 * a3143_4133 - a13 * a3142_4132},
+    {a42 * a1324_1423 - a43 * a1224_1422 + a44 * a1223_1322, -a41 * a1324_1423 + a43 * a1124_1421 - a44 * a1123_1321,
+      a41 * a1224_1422 - a42 * a1124_1421 + a44 * a1122_1221, -a41 * a1223_1322 + a42 * a1123_1321 - a43 * a1122_1221},
+    {a32 * a1324_1423 - a33 * a1224_1422 + a34 * a1223_1322, -a31 * a1324_1423 + a33 * a1124_1421 - a34 * a1123_1321,
+      a31 * a1224_1422 - a32 * a1124_1421 + a34 * a1122_1221, -a31 * a1223_1322 + a32 * a1123_1321 - a33 * a1122_1221},
+  }};
+  for (auto const &q : candidates) {
+    double const norm2 = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+    if (norm2 < kEigenvectorPrecision) {
+      continue;
+    }
+    double const scale = 1.0 / std::sqrt(norm2);
+    double const q1 = q[0] * scale;
+    double const q2 = q[1] * scale;
+    double const q3 = q[2] * scale;
+    double const q4 = q[3] * scale;
+    double const a2 = q1 * q1;
+    double const x2 = q2 * q2;
+    double const y2 = q3 * q3;
+    double const z2 = q4 * q4;
+    double const xy = q2 * q3;
+    double const az = q1 * q4;
+    double const zx = q4 * q2;
+    double const ay = q1 * q3;
+    double const yz = q3 * q4;
+    double const ax = q1 * q2;
+    // The quaternion rotates the reference onto the frame; R is its transpose.
+    *rotation = {a2 + x2 - y2 - z2, 2.0 * (xy - az), 2.0 * (zx + ay), 2.0 * (xy + az), a2 - x2 + y2 - z2,
+      2.0 * (yz - ax), 2.0 * (zx - ay), 2.0 * (yz + ax), a2 - x2 - y2 + z2};
+    break;
+  }
+  // All rows degenerate (e.g. a single atom): any rotation is optimal.
+  return rmsd;
+}
+
+template <typename T>
+BasicRmsdReference<T>::BasicRmsdReference(const BasicCoordinates<T> &reference, std::span<const double> weights,
+  SimdLevel level)
+    : centred_(reference.size()), level_(std::min(level, detected_simd_level())) {
+  auto const count = reference.size();
+  if (reference.y.size() != count || reference.z.size() != count) {
+    throw std::invalid_argument("RMSD reference has ragged x / y / z arrays");
+  }
+  if (!weights.empty() && weights.size() != count) {
+    throw std::invalid_argument(
+      fmt::format("RMSD reference has {} atoms, but {} weights were given", count, weights.size()));
+  }
+
+  if (!weights.empty()) {
+    weights_.resize(count);
+    for (std::size_t atom = 0; atom < count; ++atom) {
+      if (!(weights[atom] >= 0.0)) {
+        throw std::invalid_argument(fmt::format("RMSD weight {} is negative", atom));
+      }
+      weights_[atom] = static_cast<T>(weights[atom]);
+    }
+  }
+  auto const weight = [&](std::size_t atom) { return weights_.empty() ? 1.0 : static_cast<double>(weights_[atom]); };
+
+  std::array<double, 3> sum{};
+  for (std::size_t atom = 0; atom < count; ++atom) {
+    total_weight_ += weight(atom);
+    sum[0] += weight(atom) * static_cast<double>(reference.x[atom]);
+    sum[1] += weight(atom) * static_cast<double>(reference.y[atom]);
+    sum[2] += weight(atom) * static_cast<double>(reference.z[atom]);
+  }
+  if (count > 0 && !(total_weight_ > 0.0)) {
+    throw std::invalid_argument("RMSD weights sum to zero");
+  }
+  for (std::size_t i = 0; i < 3; ++i) {
+    centroid_[i] = count > 0 ? sum[i] / total_weight_ : 0.0;
+  }
+
+  // Centring in T leaves a small residual; the sums keep it so the
+  // covariance and inner product stay exact for the stored values.
+  double inner = 0.0;
+  for (std::size_t atom = 0; atom < count; ++atom) {
+    centred_.x[atom] = static_cast<T>(static_cast<double>(reference.x[atom]) - centroid_[0]);
+    centred_.y[atom] = static_cast<T>(static_cast<double>(reference.y[atom]) - centroid_[1]);
+    centred_.z[atom] = static_cast<T>(static_cast<double>(reference.z[atom]) - centroid_[2]);
+    std::array<double, 3> const b = {static_cast<double>(centred_.x[atom]), static_cast<double>(centred_.y[atom]),
+      static_cast<double>(centred_.z[atom])};
+    for (std::size_t i = 0; i < 3; ++i) {
+      residual_[i] += weight(atom) * b[i];
+      inner += weight(atom) * b[i] * b[i];
+    }
+  }
+  if (count > 0) {
+    auto const drift = residual_[0] * residual_[0] + residual_[1] * residual_[1] + residual_[2] * residual_[2];
+    inner_ = inner - drift / total_weight_;
+  }
+}
+
+template <typename T>
+BasicRmsdReference<T>::BasicRmsdReference(const BasicCoordinates<T> &reference, const Parm7Topology &topo,
+  SimdLevel level)
+    : BasicRmsdReference(reference, std::span<const double>(topo.mass), level) {
+  if (topo.mass.empty() && !reference.empty()) {
+    throw std::invalid_argument("Topology has no MASS section for a mass-weighted RMSD");
+  }
+}
+
+template <typename T>
+RmsdSums BasicRmsdReference<T>::sums(const BasicCoordinates<T> &frame) const {
+  auto const count = size();
+  if (frame.x.size() != count || frame.y.size() != count || frame.z.size() != count) {
+    throw std::invalid_argument(
+      fmt::format("Frame has {} atoms, but the RMSD reference has {}", frame.x.size(), count));
+  }
+  RmsdSums out;
+  if (count == 0) {
+    return out;
+  }
+  KernelInput<T> const in = {frame.x.data(), frame.y.data(), frame.z.data(), centred_.x.data(), centred_.y.data(),
+    centred_.z.data(), weights_.empty() ? nullptr : weights_.data(), count, total_weight_};
+  select_sums<T>(level_, weighted())(in, out);
+  return out;
+}
+
+template <typename T>
+double BasicRmsdReference<T>::rmsd(const BasicCoordinates<T> &frame) const {
+  return centred_qcp(sums(frame), total_weight_, residual_, inner_, nullptr);
+}
+
+template <typename T>
+double BasicRmsdReference<T>::rmsd(const BasicCoordinates<T> &frame, std::array<double, 9> &rotation) const {
+  return centred_qcp(sums(frame), total_weight_, residual_, inner_, &rotation);
+}
+
+template <typename T>
+RmsdFit BasicRmsdReference<T>::fit(const BasicCoordinates<T> &frame) const {
+  auto const s = sums(frame);
+  RmsdFit out;
+  out.rmsd = centred_qcp(s, total_weight_, residual_, inner_, &out.rotation);
+  for (std::size_t i = 0; i < 3; ++i) {
+    out.centroid[i] = total_weight_ > 0.0 ? s.origin[i] + s.a[i] / total_weight_ : 0.0;
+  }
+  return out;
+}
+
+template <typename T>
+void BasicRmsdReference<T>::superpose(BasicCoordinates<T> &frame, const RmsdFit &fit) const {
+  auto const count = frame.size();
+  if (frame.y.size() != count || frame.z.size() != count) {
+    throw std::invalid_argument("Frame has ragged x / y / z arrays");
+  }
+  auto const &r = fit.rotation;
+  for (std::size_t atom = 0; atom < count; ++atom) {
+    double const x = static_cast<double>(frame.x[atom]) - fit.centroid[0];
+    double const y = static_cast<double>(frame.y[atom]) - fit.centroid[1];
+    double const z = static_cast<double>(frame.z[atom]) - fit.centroid[2];
+    frame.x[atom] = static_cast<T>(r[0] * x + r[1] * y + r[2] * z + centroid_[0]);
+    frame.y[atom] = static_cast<T>(r[3] * x + r[4] * y + r[5] * z + centroid_[1]);
+    frame.z[atom] = static_cast<T>(r[6] * x + r[7] * y + r[8] * z + centroid_[2]);
+  }
+}
+
+template class BasicRmsdReference<double>;
+template class BasicRmsdReference<float>;
+
+} // namespace rms
@@ -0,0 +1,339 @@
+#include "include/synthetic.hpp"
+#include "include/parsers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::size_t kWaterAtoms = 3;
+constexpr int kAtomTypes = 3;
+// Waters per cubic angstrom in liquid water, and the matching lattice spacing.
+constexpr double kWaterDensity = 0.0334;
+constexpr double kMinBoxEdge = 20.0;
+// Solute chain geometry: the C-C bond length along a row, the gap between rows.
+constexpr double kSoluteBond = 1.526;
+constexpr double kSoluteRowGap = 4.0;
+// TIP3P-like water: O-H length and the H-O-H angle.
+constexpr double kWaterBond = 0.9572;
+constexpr double kWaterAngle = 1.82421813;
+
+void write_header(std::string &out, std::string_view flag, std::string_view format) {
+  fmt::format_to(std::back_inserter(out), "%FLAG {:<74}\n%FORMAT({})\n", flag, format);
+}
+
+// Each writer emits `count` values produced by value(idx); empty sections get
+// a single blank line, as LEaP writes them.
+template <typename Fn>
+void write_ints(std::string &out, std::string_view flag, std::size_t count, Fn &&value) {
+  write_header(out, flag, "10I8");
+  for (std::size_t idx = 0; idx < count; ++idx) {
+    fmt::format_to(std::back_inserter(out), "{:8d}", value(idx));
+    if (idx % 10 == 9 || idx + 1 == count) {
+      out.push_back('\n');
+    }
+  }
+  if (count == 0) {
+    out.push_back('\n');
+  }
+}
+
+template <typename Fn>
+void write_reals(std::string &out, std::string_view flag, std::size_t count, Fn &&value) {
+  write_header(out, flag, "5E16.8");
+  for (std::size_t idx = 0; idx < count; ++idx) {
+    fmt::format_to(std::back_inserter(out), "{:16.8E}", value(idx));
+    if (idx % 5 == 4 || idx + 1 == count) {
+      out.push_back('\n');
+    }
+  }
+  if (count == 0) {
+    out.push_back('\n');
+  }
+}
+
+template <typename Fn>
+void write_labels(std::string &out, std::string_view flag, std::size_t count, Fn &&value) {
+  write_header(out, flag, "20a4");
+  for (std::size_t idx = 0; idx < count; ++idx) {
+    fmt::format_to(std::back_inserter(out), "{:<4}", value(idx));
+    if (idx % 20 == 19 || idx + 1 == count) {
+      out.push_back('\n');
+    }
+  }
+  if (count == 0) {
+    out.push_back('\n');
+  }
+}
+
+template <std::size_t N>
+void write_real_list(std::string &out, std::string_view flag, const std::array<double, N> &values) {
+  write_reals(out, flag, N, [&](std::size_t idx) { return values[idx]; });
+}
+
+// Connectivity entries are stored as 3 * (0-based atom index).
+[[nodiscard]] std::size_t coord_index(std::size_t atom) { return atom * 3; }
+
+// Cells per edge of the smallest cubic lattice with room for `waters`.
+[[nodiscard]] std::size_t lattice_cells(std::size_t waters) {
+  auto cells = std::max<std::size_t>(1, static_cast<std::size_t>(std::cbrt(static_cast<double>(waters))));
+  while (cells * cells * cells < waters) {
+    ++cells;
+  }
+  return cells;
+}
+
+} // namespace
+
+SyntheticSystem synthetic_system_for_atoms(std::size_t natom) {
+  SyntheticSystem system;
+  if (natom > system.solute_atoms) {
+    system.waters = (natom - system.solute_atoms + kWaterAtoms - 1) / kWaterAtoms;
+  }
+  return system;
+}
+
+std::string make_synthetic_parm7(const SyntheticSystem &system) {
+  std::size_t const solute = system.solute_atoms;
+  std::size_t const waters = system.waters;
+  std::size_t const natom = solute + kWaterAtoms * waters;
+  std::size_t const nres = 1 + waters;
+
+  auto is_solute = [&](std::size_t atom) { return atom < solute; };
+  auto water_site = [&](std::size_t atom) { return (atom - solute) % kWaterAtoms; };
+
+  // Solute: a chain excluding its next three neighbours. Waters exclude the
+  // higher-numbered sites of the same molecule. Atoms without exclusions get
+  // one placeholder entry, so every atom contributes at least one value.
+  auto excluded_count = [&](std::size_t atom) -> std::size_t {
+    if (is_solute(atom)) {
+      return std::max<std::size_t>(1, std::min(solute, atom + 4) - atom - 1);
+    }
+    return std::max<std::size_t>(1, kWaterAtoms - 1 - water_site(atom));
+  };
+  std::string excluded;
+  std::size_t nnb = 0;
+  for (std::size_t atom = 0; atom < natom; ++atom) {
+    std::size_t const last = is_solute(atom) ? std::min(solute, atom + 4) : atom - water_site(atom) + kWaterAtoms;
+    if (atom + 1 >= last) {
+      fmt::format_to(std::back_inserter(excluded), "{:8d}", 0);
+      ++nnb;
+    } else {
+      for (std::size_t other = atom + 1; other < last; ++other) {
+        fmt::format_to(std::back_inserter(excluded), "{:8d}", other + 1);
+        ++nnb;
+      }
+    }
+  }
+
+  std::size_t const solute_bonds = solute > 1 ? solute - 1 : 0;
+  std::size_t const solute_angles = solute > 2 ? solute - 2 : 0;
+  std::size_t const solute_dihedrals = solute > 3 ? solute - 3 : 0;
+
+  std::array<std::size_t, kParm7PointerCount> pointers{};
+  pointers[0] = natom;
+  pointers[1] = kAtomTypes;
+  pointers[2] = 3 * waters;
+  pointers[3] = solute_bonds;
+  pointers[4] = waters;
+  pointers[5] = solute_angles;
+  pointers[6] = 0;
+  pointers[7] = solute_dihedrals;
+  pointers[10] = nnb;
+  pointers[11] = nres;
+  pointers[12] = solute_bonds;
+  pointers[13] = solute_angles;
+  pointers[14] = solute_dihedrals;
+  pointers[15] = 3;
+  pointers[16] = 2;
+  pointers[17] = 2;
+  pointers[18] = 1;
+  pointers[27] = 1;
+  pointers[28] = std::max<std::size_t>(solute, kWaterAtoms);
+
+  std::string out;
+  // Roughly 200 bytes per atom across all sections; avoids regrowth for large systems.
+  out.reserve(4096 + natom * 200);
+  out += "%VERSION  VERSION_STAMP = V0001.000  DATE = 01/01/26  00:00:00\n";
+  out += "%FLAG TITLE\n%FORMAT(20a4)\nsynthetic\n";
+  write_ints(out, "POINTERS", pointers.size(), [&](std::size_t idx) { return pointers[idx]; });
+
+  constexpr std::array<std::string_view, kWaterAtoms> kWaterNames = {"O", "H1", "H2"};
+  write_labels(out, "ATOM_NAME", natom, [&](std::size_t atom) -> std::string {
+    return is_solute(atom) ? fmt::format("C{}", atom % 100) : std::string(kWaterNames[water_site(atom)]);
+  });
+  write_reals(out, "CHARGE", natom, [&](std::size_t atom) {
+    if (is_solute(atom)) {
+      return (static_cast<double>(atom % 7) - 3.0) * 0.1 * kAmberChargeScale;
+    }
+    return (water_site(atom) == 0 ? -0.834 : 0.417) * kAmberChargeScale;
+  });
+  write_ints(out, "ATOMIC_NUMBER", natom,
+    [&](std::size_t atom) { return is_solute(atom) ? 6 : (water_site(atom) == 0 ? 8 : 1); });
+  write_reals(out, "MASS", natom,
+    [&](std::size_t atom) { return is_solute(atom) ? 12.01 : (water_site(atom) == 0 ? 16.0 : 1.008); });
+  write_ints(out, "ATOM_TYPE_INDEX", natom,
+    [&](std::size_t atom) { return is_solute(atom) ? 1 : (water_site(atom) == 0 ? 2 : 3); });
+  write_ints(out, "NUMBER_EXCLUDED_ATOMS", natom, excluded_count);
+  write_ints(out, "NONBONDED_PARM_INDEX", kAtomTypes * kAtomTypes, [](std::size_t idx) {
+    std::size_t const hi = std::max(idx / kAtomTypes, idx % kAtomTypes);
+    std::size_t const lo = std::min(idx / kAtomTypes, idx % kAtomTypes);
+    return hi * (hi + 1) / 2 + lo + 1;
+  });
+  write_labels(out, "RESIDUE_LABEL", nres, [](std::size_t res) { return res == 0 ? "LIG" : "WAT"; });
+  write_ints(out, "RESIDUE_POINTER", nres,
+    [&](std::size_t res) { return res == 0 ? 1 : solute + kWaterAtoms * (res - 1) + 1; });
+  write_real_list(out, "BOND_FORCE_CONSTANT", std::array{553.0, 553.0, 310.0});
+  write_real_list(out, "BOND_EQUIL_VALUE", std::array{0.9572, 1.5136, 1.526});
+  write_real_list(out, "ANGLE_FORCE_CONSTANT", std::array{100.0, 40.0});
+  write_real_list(out, "ANGLE_EQUIL_VALUE", std::array{1.82421813, 1.91113553});
+  write_real_list(out, "DIHEDRAL_FORCE_CONSTANT", std::array{0.156, 0.25});
+  write_real_list(out, "DIHEDRAL_PERIODICITY", std::array{3.0, 2.0});
+  write_real_list(out, "DIHEDRAL_PHASE", std::array{0.0, 3.141594});
+  write_real_list(out, "SCEE_SCALE_FACTOR", std::array{1.2, 1.2});
+  write_real_list(out, "SCNB_SCALE_FACTOR", std::array{2.0, 2.0});
+  write_real_list(out, "SOLTY", std::array{0.0});
+  // Type pairs (1,1) (2,1) (2,2) (3,1) (3,2) (3,3); the water hydrogens have no LJ.
+  write_real_list(out, "LENNARD_JONES_ACOEF", std::array{1043080.2, 675612.1, 582000.4, 0.0, 0.0, 0.0});
+  write_real_list(out, "LENNARD_JONES_BCOEF", std::array{675.6, 605.8, 595.0, 0.0, 0.0, 0.0});
+
+  // Water bonds: O-H1, O-H2 and the H1-H2 constraint.
+  write_ints(out, "BONDS_INC_HYDROGEN", 9 * waters, [&](std::size_t idx) {
+    std::size_t const oxygen = solute + kWaterAtoms * (idx / 9);
+    constexpr std::array<std::size_t, 9> kLayout = {0, 1, 1, 0, 2, 1, 1, 2, 2};
+    std::size_t const slot = idx % 9;
+    return slot % 3 == 2 ? kLayout[slot] : coord_index(oxygen + kLayout[slot]);
+  });
+  write_ints(out, "BONDS_WITHOUT_HYDROGEN", 3 * solute_bonds, [&](std::size_t idx) {
+    std::size_t const bond = idx / 3;
+    std::size_t const slot = idx % 3;
+    return slot == 2 ? 3 : coord_index(bond + slot);
+  });
+  write_ints(out, "ANGLES_INC_HYDROGEN", 4 * waters, [&](std::size_t idx) {
+    std::size_t const oxygen = solute + kWaterAtoms * (idx / 4);
+    constexpr std::array<std::size_t, 3> kLayout = {1, 0, 2};
+    std::size_t const slot = idx % 4;
+    return slot == 3 ? 1 : coord_index(oxygen + kLayout[slot]);
+  });
+  write_ints(out, "ANGLES_WITHOUT_HYDROGEN", 4 * solute_angles, [&](std::size_t idx) {
+    std::size_t const angle = idx / 4;
+    std::size_t const slot = idx % 4;
+    return slot == 3 ? 2 : coord_index(angle + slot);
+  });
+  write_ints(out, "DIHEDRALS_INC_HYDROGEN", 0, [](std::size_t) { return 0; });
+  // Some dihedrals carry the negative k (no 1-4) and negative l (improper) flags.
+  write_ints(out, "DIHEDRALS_WITHOUT_HYDROGEN", 5 * solute_dihedrals, [&](std::size_t idx) -> long long {
+    std::size_t const dihedral = idx / 5;
+    std::size_t const slot = idx % 5;
+    if (slot == 4) {
+      return 1 + static_cast<long long>(dihedral % 2);
+    }
+    auto const value = static_cast<long long>(coord_index(dihedral + slot));
+    bool const negate = (slot == 2 && dihedral % 3 == 1) || (slot == 3 && dihedral % 5 == 2);
+    return negate ? -value : value;
+  });
+  write_header(out, "EXCLUDED_ATOMS_LIST", "10I8");
+  for (std::size_t pos = 0; pos < excluded.size(); pos += 80) {
+    out.append(excluded, pos, 80);
+    out.push_back('\n');
+  }
+  write_reals(out, "HBOND_ACOEF", 0, [](std::size_t) { return 0.0; });
+  write_reals(out, "HBOND_BCOEF", 0, [](std::size_t) { return 0.0; });
+  write_reals(out, "HBCUT", 0, [](std::size_t) { return 0.0; });
+  write_labels(out, "AMBER_ATOM_TYPE", natom,
+    [&](std::size_t atom) { return is_solute(atom) ? "CT" : (water_site(atom) == 0 ? "OW" : "HW"); });
+  write_labels(
+    out, "TREE_CHAIN_CLASSIFICATION", natom, [&](std::size_t atom) { return is_solute(atom) ? "M" : "BLA"; });
+  write_ints(out, "JOIN_ARRAY", natom, [](std::size_t) { return 0; });
+  write_ints(out, "IROTAT", natom, [](std::size_t) { return 0; });
+  write_header(out, "SOLVENT_POINTERS", "3I8");
+  fmt::format_to(std::back_inserter(out), "{:8d}{:8d}{:8d}\n", 1, nres, 2);
+  write_ints(
+    out, "ATOMS_PER_MOLECULE", nres, [&](std::size_t mol) { return mol == 0 ? solute : kWaterAtoms; });
+  auto const edge = synthetic_box_edge(system);
+  write_real_list(out, "BOX_DIMENSIONS", std::array{90.0, edge, edge, edge});
+  out += "%FLAG RADIUS_SET\n%FORMAT(1a80)\nmodified Bondi radii (mbondi)\n";
+  write_reals(out, "RADII", natom,
+    [&](std::size_t atom) { return is_solute(atom) ? 1.7 : (water_site(atom) == 0 ? 1.5 : 0.8); });
+  write_reals(out, "SCREEN", natom, [&](std::size_t atom) { return is_solute(atom) ? 0.72 : 0.85; });
+  write_header(out, "IPOL", "1I8");
+  fmt::format_to(std::back_inserter(out), "{:8d}\n", 0);
+  return out;
+}
+
+double synthetic_box_edge(const SyntheticSystem &system) {
+  auto const spacing = std::cbrt(1.0 / kWaterDensity);
+  // Rounded up to 0.001 A so the edge survives the F12.7 / E16.8 round trip exactly.
+  auto const edge = std::ceil(static_cast<double>(lattice_cells(system.waters)) * spacing * 1000.0) / 1000.0;
+  return std::max(kMinBoxEdge, edge);
+}
+
+Rst7 make_synthetic_coordinates(const SyntheticSystem &system, bool with_velocities) {
+  std::size_t const solute = system.solute_atoms;
+  std::size_t const natom = solute + kWaterAtoms * system.waters;
+  auto const edge = synthetic_box_edge(system);
+
+  Rst7 rst7;
+  rst7.title = "synthetic";
+  rst7.time = 0.0;
+  rst7.box = std::array{edge, edge, edge, 90.0, 90.0, 90.0};
+  rst7.positions = Coordinates(natom);
+  auto &pos = rst7.positions;
+
+  // Rows run along x and alternate direction, so consecutive atoms stay bonded.
+  auto const per_row = std::max<std::size_t>(1, static_cast<std::size_t>(edge / kSoluteBond) - 1);
+  for (std::size_t atom = 0; atom < solute; ++atom) {
+    auto const row = atom / per_row;
+    auto const column = row % 2 == 0 ? atom % per_row : per_row - 1 - atom % per_row;
+    pos.x[atom] = static_cast<double>(column) * kSoluteBond;
+    pos.y[atom] = static_cast<double>(row) * kSoluteRowGap;
+    pos.z[atom] = 0.0;
+  }
+
+  // One water per lattice cell, oxygens at the cell centres, so every water is
+  // at least half a cell clear of the solute plane.
+  auto const cells = lattice_cells(system.waters);
+  auto const spacing = edge / static_cast<double>(cells);
+  for (std::size_t water = 0; water < system.waters; ++water) {
+    auto const oxygen = solute + kWaterAtoms * water;
+    auto const centre = [&](std::size_t cell) { return (static_cast<double>(cell) + 0.5) * spacing; };
+    auto const ox = centre(water % cells);
+    auto const oy = centre(water / cells % cells);
+    auto const oz = centre(water / (cells * cells));
+    pos.x[oxygen] = ox;
+    pos.y[oxygen] = oy;
+    pos.z[oxygen] = oz;
+    pos.x[oxygen + 1] = ox + kWaterBond;
+    pos.y[oxygen + 1] = oy;
+    pos.z[oxygen + 1] = oz;
+    pos.x[oxygen + 2] = ox + kWaterBond * std::cos(kWaterAngle);
+    pos.y[oxygen + 2] = oy + kWaterBond * std::sin(kWaterAngle);
+    pos.z[oxygen + 2] = oz;
+  }
+
+  if (with_velocities) {
+    rst7.velocities.emplace(natom);
+    auto &vel = *rst7.velocities;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      auto const phase = static_cast<double>(atom) * 0.37;
+      vel.x[atom] = 0.5 * std::sin(phase);
+      vel.y[atom] = 0.5 * std::sin(phase + 2.0);
+      vel.z[atom] = 0.5 * std::sin(phase + 4.0);
+    }
+  }
+  return rst7;
+}
+
+std::string make_synthetic_rst7(const SyntheticSystem &system, bool with_velocities) {
+  return format_rst7(make_synthetic_coordinates(system, with_velocities));
+}
+
+} // namespace rms
@@ -0,0 +1,457 @@
+#include "include/topology_cache.hpp"
+#include "include/mapped_file.hpp"
+#include "include/parsers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+constexpr std::array<char, 8> kMagic = {'R', 'M', 'S', 'T', 'O', 'P', 'O', '\0'};
+constexpr std::uint32_t kByteOrderTag = 0x01020304;
+constexpr std::size_t kArrayAlignment = 64;
+constexpr std::size_t kKeyHashBytes = 64 * 1024;
+
+struct FileHeader {
+  std::array<char, 8> magic{};
+  std::uint32_t version = 0;
+  std::uint32_t byte_order = 0;
+  std::uint64_t source_size = 0;
+  std::int64_t source_mtime_ns = 0;
+  std::uint64_t source_hash = 0;
+  std::uint64_t slot_count = 0;
+};
+
+struct FileSlot {
+  std::uint64_t offset = 0;
+  std::uint64_t count = 0;
+};
+
+constexpr std::array<std::int32_t Parm7Pointers::*, static_cast<std::size_t>(kParm7PointerCount)> kPointerMembers = {
+  &Parm7Pointers::natom, &Parm7Pointers::ntypes, &Parm7Pointers::nbonh, &Parm7Pointers::mbona,
+  &Parm7Pointers::ntheth, &Parm7Pointers::mtheta, &Parm7Pointers::nphih, &Parm7Pointers::mphia,
+  &Parm7Pointers::nhparm, &Parm7Pointers::nparm, &Parm7Pointers::nnb, &Parm7Pointers::nres, &Parm7Pointers::nbona,
+  &Parm7Pointers::ntheta, &Parm7Pointers::nphia, &Parm7Pointers::numbnd, &Parm7Pointers::numang,
+  &Parm7Pointers::nptra, &Parm7Pointers::natyp, &Parm7Pointers::nphb, &Parm7Pointers::ifpert,
+  &Parm7Pointers::nbper, &Parm7Pointers::ngper, &Parm7Pointers::ndper, &Parm7Pointers::mbper,
+  &Parm7Pointers::mgper, &Parm7Pointers::mdper, &Parm7Pointers::ifbox, &Parm7Pointers::nmxrs,
+  &Parm7Pointers::ifcap, &Parm7Pointers::numextra};
+
+// The slot order below is the file layout; changing it requires a version bump.
+constexpr std::array kIntArrays = {&Parm7Topology::atomic_number, &Parm7Topology::atom_type_index,
+  &Parm7Topology::number_excluded_atoms, &Parm7Topology::excluded_atoms_list, &Parm7Topology::nonbonded_parm_index,
+  &Parm7Topology::residue_pointer, &Parm7Topology::bond_i, &Parm7Topology::bond_j, &Parm7Topology::bond_type,
+  &Parm7Topology::angle_i, &Parm7Topology::angle_j, &Parm7Topology::angle_k, &Parm7Topology::angle_type,
+  &Parm7Topology::dihedral_i, &Parm7Topology::dihedral_j, &Parm7Topology::dihedral_k, &Parm7Topology::dihedral_l,
+  &Parm7Topology::dihedral_type, &Parm7Topology::join_array, &Parm7Topology::irotat,
+  &Parm7Topology::atoms_per_molecule};
+
+constexpr std::array kDoubleArrays = {&Parm7Topology::charge, &Parm7Topology::mass,
+  &Parm7Topology::bond_force_constant, &Parm7Topology::bond_equil_value, &Parm7Topology::angle_force_constant,
+  &Parm7Topology::angle_equil_value, &Parm7Topology::dihedral_force_constant, &Parm7Topology::dihedral_periodicity,
+  &Parm7Topology::dihedral_phase, &Parm7Topology::scee_scale_factor, &Parm7Topology::scnb_scale_factor,
+  &Parm7Topology::solty, &Parm7Topology::lennard_jones_acoeff, &Parm7Topology::lennard_jones_bcoeff,
+  &Parm7Topology::hbond_acoeff, &Parm7Topology::hbond_bcoeff, &Parm7Topology::radii, &Parm7Topology::screen};
+
+constexpr std::array kNameArrays = {&Parm7Topology::atom_name, &Parm7Topology::tree_chain_classification};
+
+constexpr std::array kInternedArrays = {&Parm7Topology::residue_label, &Parm7Topology::amber_atom_type};
+
+constexpr std::size_t kPointersSlot = kIntArrays.size();
+constexpr std::size_t kIpolSlot = kPointersSlot + 1;
+constexpr std::size_t kSolventSlot = kIpolSlot + 1;
+constexpr std::size_t kDihedralFlagsSlot = kSolventSlot + 1;
+constexpr std::size_t kFirstDoubleSlot = kDihedralFlagsSlot + 1;
+constexpr std::size_t kHbondCutSlot = kFirstDoubleSlot + kDoubleArrays.size();
+constexpr std::size_t kBoxSlot = kHbondCutSlot + 1;
+constexpr std::size_t kFirstNameSlot = kBoxSlot + 1;
+// Interned names take two slots each: the distinct-name table, then the ids.
+constexpr std::size_t kFirstInternedSlot = kFirstNameSlot + kNameArrays.size();
+// The scalar strings (version, title, radius set) are cumulative end offsets
+// followed by the characters.
+constexpr std::size_t kStringEndsSlot = kFirstInternedSlot + 2 * kInternedArrays.size();
+constexpr std::size_t kStringCharsSlot = kStringEndsSlot + 1;
+constexpr std::size_t kSlotCount = kStringCharsSlot + 1;
+
+[[nodiscard]] std::size_t slot_element_size(std::size_t slot) {
+  if (slot < kDihedralFlagsSlot) {
+    return sizeof(std::int32_t);
+  }
+  if (slot == kDihedralFlagsSlot) {
+    return 1;
+  }
+  if (slot < kFirstNameSlot) {
+    return sizeof(double);
+  }
+  if (slot < kStringEndsSlot) {
+    return sizeof(PackedName);
+  }
+  return slot == kStringEndsSlot ? sizeof(std::uint64_t) : 1;
+}
+
+template <typename Table, typename Member>
+[[nodiscard]] std::size_t table_index(const Table &table, Member member) {
+  auto const found = std::find(table.begin(), table.end(), member);
+  if (found == table.end()) {
+    throw std::invalid_argument("Topology member is not stored in the cache");
+  }
+  return static_cast<std::size_t>(found - table.begin());
+}
+
+[[nodiscard]] std::uint64_t fnv1a(std::span<const char> bytes, std::uint64_t hash) {
+  for (char const byte : bytes) {
+    hash ^= static_cast<unsigned char>(byte);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+class CacheWriter
+{
+public:
+  CacheWriter() : out_(sizeof(FileHeader) + kSlotCount * sizeof(FileSlot)) {}
+
+  template <typename T>
+  void put(std::span<const T> values) {
+    out_.resize((out_.size() + kArrayAlignment - 1) / kArrayAlignment * kArrayAlignment);
+    slots_.push_back(FileSlot{out_.size(), values.size()});
+    auto const *bytes = reinterpret_cast<char const *>(values.data());
+    out_.insert(out_.end(), bytes, bytes + values.size_bytes());
+  }
+
+  void put_strings(std::span<const std::string> values) {
+    std::vector<std::uint64_t> ends;
+    ends.reserve(values.size());
+    std::string chars;
+    for (auto const &value : values) {
+      chars += value;
+      ends.push_back(chars.size());
+    }
+    put<std::uint64_t>(ends);
+    put<char>(chars);
+  }
+
+  [[nodiscard]] std::vector<char> finish(const TopologyCacheKey &key) {
+    if (slots_.size() != kSlotCount) {
+      throw std::logic_error("Topology cache layout mismatch");
+    }
+    FileHeader header;
+    header.magic = kMagic;
+    header.version = kTopologyCacheVersion;
+    header.byte_order = kByteOrderTag;
+    header.source_size = key.size;
+    header.source_mtime_ns = key.mtime_ns;
+    header.source_hash = key.hash;
+    header.slot_count = kSlotCount;
+    std::memcpy(out_.data(), &header, sizeof(header));
+    std::memcpy(out_.data() + sizeof(header), slots_.data(), slots_.size() * sizeof(FileSlot));
+    return std::move(out_);
+  }
+
+private:
+  std::vector<char> out_;
+  std::vector<FileSlot> slots_;
+};
+
+} // namespace
+
+TopologyCacheKey topology_cache_key(const std::filesystem::path &parm7_path) {
+  MappedFile const file(parm7_path);
+  auto const bytes = file.bytes();
+  auto const head = bytes.first(std::min(bytes.size(), kKeyHashBytes));
+  auto const tail = bytes.last(std::min(bytes.size(), kKeyHashBytes));
+
+  TopologyCacheKey key;
+  key.size = bytes.size();
+  auto const mtime = std::filesystem::last_write_time(parm7_path).time_since_epoch();
+  key.mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime).count();
+  key.hash = fnv1a(tail, fnv1a(head, 0xcbf29ce484222325ULL));
+  return key;
+}
+
+std::filesystem::path topology_cache_path(const std::filesystem::path &parm7_path) {
+  auto path = parm7_path;
+  path += ".rmscache";
+  return path;
+}
+
+void write_topology_cache(const std::filesystem::path &cache_path, const Parm7Topology &topo,
+  const TopologyCacheKey &key) {
+  if (topo.loaded_sections != kAllParm7Sections) {
+    throw std::runtime_error("Only fully loaded topologies can be cached");
+  }
+
+  CacheWriter writer;
+  for (auto const member : kIntArrays) {
+    writer.put<int>(topo.*member);
+  }
+
+  std::vector<std::int32_t> pointers;
+  for (auto const member : kPointerMembers) {
+    pointers.push_back(topo.pointers.*member);
+  }
+  if (topo.pointers.ncopy) {
+    pointers.push_back(*topo.pointers.ncopy);
+  }
+  writer.put<std::int32_t>(pointers);
+
+  std::vector<int> ipol;
+  if (topo.ipol) {
+    ipol.push_back(*topo.ipol);
+  }
+  writer.put<int>(ipol);
+
+  std::vector<int> solvent;
+  if (topo.solvent_pointers) {
+    solvent.assign(topo.solvent_pointers->begin(), topo.solvent_pointers->end());
+  }
+  writer.put<int>(solvent);
+  writer.put<std::uint8_t>(topo.dihedral_flags);
+
+  for (auto const member : kDoubleArrays) {
+    writer.put<double>(topo.*member);
+  }
+  std::vector<double> hbond_cut;
+  if (topo.hbond_cut) {
+    hbond_cut.push_back(*topo.hbond_cut);
+  }
+  writer.put<double>(hbond_cut);
+  std::vector<double> box;
+  if (topo.box_dimensions) {
+    box.assign(topo.box_dimensions->begin(), topo.box_dimensions->end());
+  }
+  writer.put<double>(box);
+
+  for (auto const member : kNameArrays) {
+    writer.put<PackedName>(topo.*member);
+  }
+  for (auto const member : kInternedArrays) {
+    writer.put<PackedName>((topo.*member).table);
+    writer.put<std::uint32_t>((topo.*member).ids);
+  }
+  writer.put_strings(std::array{topo.version, topo.title, topo.radius_set});
+
+  auto const bytes = writer.finish(key);
+
+  // Write under a unique name and rename, so readers in other processes see
+  // either the old cache or the complete new one.
+  std::random_device entropy;
+  auto temp_path = cache_path;
+  temp_path += fmt::format(".tmp{:08x}{:08x}", entropy(), entropy());
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+      std::error_code ignored;
+      std::filesystem::remove(temp_path, ignored);
+      throw std::runtime_error(fmt::format("Failed to write topology cache: {}", temp_path.string()));
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp_path, cache_path, error);
+  if (error) {
+    std::error_code ignored;
+    std::filesystem::remove(temp_path, ignored);
+    throw std::runtime_error(fmt::format("Failed to install topology cache: {}", cache_path.string()));
+  }
+}
+
+TopologyCacheView::TopologyCacheView(const std::filesystem::path &cache_path) : path_(cache_path), file_(cache_path) {
+  auto const bytes = file_.bytes();
+  auto invalid = [&](std::string_view reason) {
+    return std::runtime_error(fmt::format("Invalid topology cache {}: {}", cache_path.string(), reason));
+  };
+
+  FileHeader header;
+  if (bytes.size() < sizeof(header)) {
+    throw invalid("truncated header");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != kMagic || header.byte_order != kByteOrderTag) {
+    throw invalid("not a topology cache for this platform");
+  }
+  if (header.version != kTopologyCacheVersion || header.slot_count != kSlotCount) {
+    throw invalid(fmt::format("format version {} (expected {})", header.version, kTopologyCacheVersion));
+  }
+  if (bytes.size() < sizeof(header) + kSlotCount * sizeof(FileSlot)) {
+    throw invalid("truncated array table");
+  }
+
+  slots_.resize(kSlotCount);
+  for (std::size_t slot = 0; slot < kSlotCount; ++slot) {
+    FileSlot entry;
+    std::memcpy(&entry, bytes.data() + sizeof(header) + slot * sizeof(FileSlot), sizeof(entry));
+    auto const element_size = slot_element_size(slot);
+    if (entry.offset % element_size != 0 || entry.offset > bytes.size()
+        || entry.count > (bytes.size() - entry.offset) / element_size) {
+      throw invalid(fmt::format("array {} out of bounds", slot));
+    }
+    slots_[slot] = Slot{entry.offset, entry.count};
+  }
+  for (std::size_t idx = 0; idx < kInternedArrays.size(); ++idx) {
+    auto const table_size = slots_[kFirstInternedSlot + 2 * idx].count;
+    for (auto const id : slot_data<std::uint32_t>(kFirstInternedSlot + 2 * idx + 1)) {
+      if (id >= table_size) {
+        throw invalid("name id out of range");
+      }
+    }
+  }
+  if (slots_[kStringEndsSlot].count != 3) {
+    throw invalid("missing header strings");
+  }
+
+  auto const pointers = slot_data<std::int32_t>(kPointersSlot);
+  if (pointers.size() < kPointerMembers.size()) {
+    throw invalid("truncated POINTERS");
+  }
+  for (std::size_t idx = 0; idx < kPointerMembers.size(); ++idx) {
+    pointers_.*kPointerMembers[idx] = pointers[idx];
+  }
+  if (pointers.size() > kPointerMembers.size()) {
+    pointers_.ncopy = pointers[kPointerMembers.size()];
+  }
+
+  key_.size = header.source_size;
+  key_.mtime_ns = header.source_mtime_ns;
+  key_.hash = header.source_hash;
+}
+
+template <typename T>
+std::span<const T> TopologyCacheView::slot_data(std::size_t slot) const {
+  auto const &entry = slots_[slot];
+  auto const *data = reinterpret_cast<T const *>(file_.bytes().data() + entry.offset);
+  return {data, static_cast<std::size_t>(entry.count)};
+}
+
+std::string_view TopologyCacheView::scalar_string(std::size_t idx) const {
+  auto const ends = slot_data<std::uint64_t>(kStringEndsSlot);
+  auto const chars = slot_data<char>(kStringCharsSlot);
+  if (idx >= ends.size()) {
+    return {};
+  }
+  auto const end = std::min(static_cast<std::size_t>(ends[idx]), chars.size());
+  auto const begin = std::min(idx == 0 ? std::size_t{0} : static_cast<std::size_t>(ends[idx - 1]), end);
+  return {chars.data() + begin, end - begin};
+}
+
+std::span<const int> TopologyCacheView::array(std::pmr::vector<int> Parm7Topology::*member) const {
+  return slot_data<int>(table_index(kIntArrays, member));
+}
+
+std::span<const double> TopologyCacheView::array(std::pmr::vector<double> Parm7Topology::*member) const {
+  return slot_data<double>(kFirstDoubleSlot + table_index(kDoubleArrays, member));
+}
+
+std::span<const std::uint8_t> TopologyCacheView::array(std::pmr::vector<std::uint8_t> Parm7Topology::*member) const {
+  if (member != &Parm7Topology::dihedral_flags) {
+    throw std::invalid_argument("Topology member is not stored in the cache");
+  }
+  return slot_data<std::uint8_t>(kDihedralFlagsSlot);
+}
+
+std::span<const PackedName> TopologyCacheView::array(std::pmr::vector<PackedName> Parm7Topology::*member) const {
+  return slot_data<PackedName>(kFirstNameSlot + table_index(kNameArrays, member));
+}
+
+std::span<const PackedName> TopologyCacheView::name_table(InternedNames Parm7Topology::*member) const {
+  return slot_data<PackedName>(kFirstInternedSlot + 2 * table_index(kInternedArrays, member));
+}
+
+std::span<const std::uint32_t> TopologyCacheView::name_ids(InternedNames Parm7Topology::*member) const {
+  return slot_data<std::uint32_t>(kFirstInternedSlot + 2 * table_index(kInternedArrays, member) + 1);
+}
+
+Parm7Topology TopologyCacheView::to_topology(const Parm7ParseOptions &options) const {
+  auto storage = options;
+  storage.sections = kAllParm7Sections;
+  auto topo = make_parm7_topology(pointers_, storage);
+  topo.pointers = pointers_;
+  topo.version = std::string(scalar_string(0));
+  topo.title = std::string(scalar_string(1));
+  topo.radius_set = std::string(scalar_string(2));
+
+  for (std::size_t idx = 0; idx < kIntArrays.size(); ++idx) {
+    auto const values = slot_data<int>(idx);
+    (topo.*kIntArrays[idx]).assign(values.begin(), values.end());
+  }
+  for (std::size_t idx = 0; idx < kDoubleArrays.size(); ++idx) {
+    auto const values = slot_data<double>(kFirstDoubleSlot + idx);
+    (topo.*kDoubleArrays[idx]).assign(values.begin(), values.end());
+  }
+  auto const flags = slot_data<std::uint8_t>(kDihedralFlagsSlot);
+  topo.dihedral_flags.assign(flags.begin(), flags.end());
+
+  for (auto const member : kNameArrays) {
+    auto const names = array(member);
+    (topo.*member).assign(names.begin(), names.end());
+  }
+  for (auto const member : kInternedArrays) {
+    auto const table = name_table(member);
+    auto const ids = name_ids(member);
+    (topo.*member).table.assign(table.begin(), table.end());
+    (topo.*member).ids.assign(ids.begin(), ids.end());
+  }
+
+  if (auto const ipol = slot_data<int>(kIpolSlot); !ipol.empty()) {
+    topo.ipol = ipol.front();
+  }
+  if (auto const solvent = slot_data<int>(kSolventSlot); solvent.size() == 3) {
+    topo.solvent_pointers = std::array<int, 3>{solvent[0], solvent[1], solvent[2]};
+  }
+  if (auto const hbond_cut = slot_data<double>(kHbondCutSlot); !hbond_cut.empty()) {
+    topo.hbond_cut = hbond_cut.front();
+  }
+  if (auto const box = slot_data<double>(kBoxSlot); box.size() == 4) {
+    topo.box_dimensions = std::array<double, 4>{box[0], box[1], box[2], box[3]};
+  }
+  topo.loaded_sections = kAllParm7Sections;
+
+  // The constructor only bounds every array by the file; their lengths must
+  // still match POINTERS before anything indexes them.
+  try {
+    validate_parm7_sections(topo);
+  } catch (const std::runtime_error &error) {
+    throw std::runtime_error(fmt::format("Invalid topology cache {}: {}", path_.string(), error.what()));
+  }
+  return topo;
+}
+
+Parm7Topology load_parm7_cached(const std::filesystem::path &parm7_path, const Parm7ParseOptions &options) {
+  TopologyCacheKey key;
+  try {
+    key = topology_cache_key(parm7_path);
+  } catch (const std::runtime_error &) {
+    throw std::runtime_error(fmt::format("Failed to open parm7 file: {}", parm7_path.string()));
+  }
+
+  auto const cache_path = topology_cache_path(parm7_path);
+  try {
+    TopologyCacheView const view(cache_path);
+    if (view.key() == key) {
+      return view.to_topology(options);
+    }
+  } catch (const std::runtime_error &) {
+    // Missing, stale-format or damaged cache: rebuild it from the text below.
+  }
+
+  Parm7ParseOptions full = options;
+  full.sections = kAllParm7Sections;
+  auto topo = parse_parm7_file(parm7_path, full);
+  try {
+    write_topology_cache(cache_path, topo, key);
+  } catch (const std::runtime_error &) {
+    // Read-only directories and full disks only cost the reuse.
+  }
+  return topo;
+}
+
+} // namespace rms
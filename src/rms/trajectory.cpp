@@ -0,0 +1,315 @@
+#include "include/trajectory.hpp"
+#include "include/fixed_width.hpp"
+#include "include/utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+// Trajectory coordinates are 10F8.3; the box line is 3F8.3.
+constexpr std::size_t kMdcrdFieldWidth = 8;
+constexpr std::size_t kMdcrdDecimals = 3;
+constexpr std::size_t kMdcrdFieldsPerLine = 10;
+constexpr std::size_t kMdcrdBoxFields = 3;
+// Smallest byte range one worker scans while indexing.
+constexpr std::size_t kMinScanChunk = std::size_t{1} << 20U;
+
+constexpr std::array<char, 8> kIndexMagic = {'R', 'M', 'S', 'M', 'D', 'I', 'D', 'X'};
+constexpr std::uint32_t kByteOrderTag = 0x01020304;
+
+struct IndexHeader {
+  std::array<char, 8> magic{};
+  std::uint32_t version = 0;
+  std::uint32_t byte_order = 0;
+  std::uint64_t source_size = 0;
+  std::int64_t source_mtime_ns = 0;
+  std::uint64_t source_hash = 0;
+  std::uint64_t natom = 0;
+  std::uint64_t has_box = 0;
+  std::uint64_t offset_count = 0;
+};
+
+// Splits off the line at the front of `text`, without its line terminator.
+[[nodiscard]] std::string_view next_line(std::string_view &text) {
+  auto const newline = text.find('\n');
+  auto line = text.substr(0, newline);
+  text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  return line;
+}
+
+// Decodes the first out.size() F8.3 fields of `line`; false if any is missing
+// or malformed.
+[[nodiscard]] bool decode_fields(std::string_view line, std::span<double> out) noexcept {
+  auto decoded = decode_fixed_fields(line, kMdcrdFieldWidth, kMdcrdDecimals, out);
+  for (; decoded < out.size(); ++decoded) {
+    auto const offset = decoded * kMdcrdFieldWidth;
+    if (offset >= line.size()) {
+      return false;
+    }
+    auto const value = parse_fortran_double(line.substr(offset, kMdcrdFieldWidth));
+    if (!value) {
+      return false;
+    }
+    out[decoded] = *value;
+  }
+  return true;
+}
+
+[[nodiscard]] std::size_t field_count(std::string_view line) {
+  return (trim_right(line).size() + kMdcrdFieldWidth - 1) / kMdcrdFieldWidth;
+}
+
+} // namespace
+
+MdcrdTrajectory::MdcrdTrajectory(const std::filesystem::path &path, const Parm7Topology &topo,
+  const MdcrdOptions &options)
+  : path_(path) {
+  if (topo.pointers.natom <= 0) {
+    throw std::runtime_error("Trajectory topology has no atoms");
+  }
+  natom_ = static_cast<std::size_t>(topo.pointers.natom);
+  coordinate_lines_ = (natom_ * 3 + kMdcrdFieldsPerLine - 1) / kMdcrdFieldsPerLine;
+
+  TopologyCacheKey key;
+  try {
+    file_ = MappedFile(path);
+    key = topology_cache_key(path);
+  } catch (const std::runtime_error &) {
+    throw std::runtime_error(fmt::format("Failed to open mdcrd file: {}", path.string()));
+  }
+
+  std::string_view rest(file_.bytes().data(), file_.size());
+  title_ = std::string(trim_right(next_line(rest)));
+
+  // The line after the first frame's coordinates is a box line (3 fields) or the
+  // next frame (more than 3 fields, unless NATOM is 1; then IFBOX decides).
+  for (std::size_t line = 0; line < coordinate_lines_ && !rest.empty(); ++line) {
+    static_cast<void>(next_line(rest));
+  }
+  if (!rest.empty()) {
+    has_box_ = natom_ > 1 ? field_count(next_line(rest)) == kMdcrdBoxFields : topo.pointers.ifbox > 0;
+  }
+
+  auto const index_path = mdcrd_index_path(path);
+  if (options.use_index_file && load_index(index_path, key)) {
+    index_reused_ = true;
+    return;
+  }
+  build_index(options.threads);
+  if (options.use_index_file) {
+    try {
+      write_index(index_path, key);
+    } catch (const std::runtime_error &) {
+      // Read-only directories only cost the reuse.
+    }
+  }
+}
+
+void MdcrdTrajectory::build_index(std::size_t threads) {
+  auto const bytes = file_.bytes();
+  auto const frame_lines = coordinate_lines_ + (has_box_ ? 1 : 0);
+  auto const workers = resolve_thread_count(threads);
+  auto const chunk = std::max(kMinScanChunk, (bytes.size() + workers * 4 - 1) / (workers * 4));
+  auto const chunks = (bytes.size() + chunk - 1) / chunk;
+  auto chunk_bytes = [&](std::size_t idx) {
+    return bytes.subspan(idx * chunk, std::min(chunk, bytes.size() - idx * chunk));
+  };
+
+  // Pass 1 counts the newlines of every chunk; their prefix sums give the line
+  // each chunk starts in, so pass 2 can place frame starts independently.
+  std::vector<std::size_t> first_line(chunks + 1, 0);
+  parallel_for(chunks, threads, [&](std::size_t idx) {
+    auto const text = chunk_bytes(idx);
+    // memchr per line beats std::count here: lines are ~80 bytes and libc's
+    // search is vectorized.
+    std::size_t newlines = 0;
+    char const *pos = text.data();
+    char const *const end = text.data() + text.size();
+    while ((pos = static_cast<char const *>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)))) != nullptr) {
+      ++newlines;
+      ++pos;
+    }
+    first_line[idx + 1] = newlines;
+  });
+  for (std::size_t idx = 0; idx < chunks; ++idx) {
+    first_line[idx + 1] += first_line[idx];
+  }
+  auto const lines = first_line[chunks] + (!bytes.empty() && bytes.back() != '\n' ? 1 : 0);
+  auto const frames = lines > 0 ? (lines - 1) / frame_lines : 0;
+
+  // The end of the last frame stays at the end of the file unless a line (the
+  // start of a partial frame) follows it.
+  offsets_.assign(frames + 1, bytes.size());
+  parallel_for(chunks, threads, [&](std::size_t idx) {
+    auto const text = chunk_bytes(idx);
+    std::uint64_t const base = idx * chunk;
+    // Line `line` starts a frame when (line - 1) % frame_lines == 0.
+    auto line = first_line[idx];
+    auto until_frame = line == 0 ? 1 : frame_lines - (line - 1) % frame_lines;
+    auto frame = line == 0 ? 0 : (line - 1) / frame_lines + 1;
+    char const *pos = text.data();
+    char const *const end = text.data() + text.size();
+    while (frame <= frames) {
+      // Skip to the newline ending the line before the next frame.
+      for (; until_frame > 1; --until_frame) {
+        pos = static_cast<char const *>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+        if (pos == nullptr) {
+          return;
+        }
+        ++pos;
+      }
+      auto const *newline = static_cast<char const *>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+      if (newline == nullptr) {
+        return;
+      }
+      offsets_[frame] = base + static_cast<std::uint64_t>(newline + 1 - text.data());
+      pos = newline + 1;
+      until_frame = frame_lines;
+      ++frame;
+    }
+  });
+}
+
+bool MdcrdTrajectory::load_index(const std::filesystem::path &index_path, const TopologyCacheKey &key) {
+  MappedFile index;
+  try {
+    index = MappedFile(index_path);
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+  auto const bytes = index.bytes();
+  IndexHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  bool const current = header.magic == kIndexMagic && header.version == kMdcrdIndexVersion
+    && header.byte_order == kByteOrderTag && header.source_size == key.size && header.source_mtime_ns == key.mtime_ns
+    && header.source_hash == key.hash && header.natom == natom_ && header.has_box == (has_box_ ? 1U : 0U)
+    && header.offset_count > 0 && header.offset_count <= (bytes.size() - sizeof(header)) / sizeof(std::uint64_t);
+  if (!current) {
+    return false;
+  }
+  offsets_.resize(header.offset_count);
+  std::memcpy(offsets_.data(), bytes.data() + sizeof(header), offsets_.size() * sizeof(std::uint64_t));
+  if (!std::ranges::is_sorted(offsets_) || offsets_.back() > file_.size()) {
+    offsets_.clear();
+    return false;
+  }
+  return true;
+}
+
+void MdcrdTrajectory::write_index(const std::filesystem::path &index_path, const TopologyCacheKey &key) const {
+  IndexHeader header;
+  header.magic = kIndexMagic;
+  header.version = kMdcrdIndexVersion;
+  header.byte_order = kByteOrderTag;
+  header.source_size = key.size;
+  header.source_mtime_ns = key.mtime_ns;
+  header.source_hash = key.hash;
+  header.natom = natom_;
+  header.has_box = has_box_ ? 1U : 0U;
+  header.offset_count = offsets_.size();
+
+  // Write under a unique name and rename, as the topology cache does.
+  std::random_device entropy;
+  auto temp_path = index_path;
+  temp_path += fmt::format(".tmp{:08x}{:08x}", entropy(), entropy());
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const *>(offsets_.data()),
+      static_cast<std::streamsize>(offsets_.size() * sizeof(std::uint64_t)));
+    if (!file) {
+      std::error_code ignored;
+      std::filesystem::remove(temp_path, ignored);
+      throw std::runtime_error(fmt::format("Failed to write trajectory index: {}", temp_path.string()));
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp_path, index_path, error);
+  if (error) {
+    std::error_code ignored;
+    std::filesystem::remove(temp_path, ignored);
+    throw std::runtime_error(fmt::format("Failed to install trajectory index: {}", index_path.string()));
+  }
+}
+
+void MdcrdTrajectory::read_frame(std::size_t frame, MdcrdFrame &out) const {
+  check_range(frame, frame + 1);
+  auto const begin = static_cast<std::size_t>(offsets_[frame]);
+  std::string_view text(file_.bytes().data() + begin, static_cast<std::size_t>(offsets_[frame + 1]) - begin);
+  auto malformed = [&](std::size_t line) {
+    return std::runtime_error(fmt::format("{}: frame {} line {} is malformed", path_.string(), frame, line + 1));
+  };
+
+  auto &positions = out.positions;
+  positions.resize(natom_);
+  std::array<double *, 3> const components = {positions.x.data(), positions.y.data(), positions.z.data()};
+  auto const values = natom_ * 3;
+  std::array<double, kMdcrdFieldsPerLine> row{};
+  for (std::size_t line = 0; line < coordinate_lines_; ++line) {
+    auto const first = line * kMdcrdFieldsPerLine;
+    auto const count = std::min(kMdcrdFieldsPerLine, values - first);
+    if (!decode_fields(next_line(text), std::span(row).first(count))) {
+      throw malformed(line);
+    }
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      components[(first + idx) % 3][(first + idx) / 3] = row[idx];
+    }
+  }
+
+  out.box.reset();
+  if (has_box_) {
+    std::array<double, kMdcrdBoxFields> box{};
+    if (!decode_fields(next_line(text), box)) {
+      throw malformed(coordinate_lines_);
+    }
+    out.box = box;
+  }
+}
+
+MdcrdFrame MdcrdTrajectory::frame(std::size_t frame) const {
+  MdcrdFrame out;
+  read_frame(frame, out);
+  return out;
+}
+
+std::filesystem::path mdcrd_index_path(const std::filesystem::path &mdcrd_path) {
+  auto path = mdcrd_path;
+  path += ".rmsidx";
+  return path;
+}
+
+void append_mdcrd_frame(std::string &out, const MdcrdFrame &frame) {
+  auto const &positions = frame.positions;
+  std::array<double const *, 3> const components = {positions.x.data(), positions.y.data(), positions.z.data()};
+  auto const values = positions.size() * 3;
+  for (std::size_t idx = 0; idx < values; ++idx) {
+    fmt::format_to(std::back_inserter(out), "{:8.3f}", components[idx % 3][idx / 3]);
+    if (idx % kMdcrdFieldsPerLine == kMdcrdFieldsPerLine - 1 || idx + 1 == values) {
+      out.push_back('\n');
+    }
+  }
+  if (frame.box) {
+    auto const &box = *frame.box;
+    fmt::format_to(std::back_inserter(out), "{:8.3f}{:8.3f}{:8.3f}\n", box[0], box[1], box[2]);
+  }
+}
+
+} // namespace rms
@@ -0,0 +1,110 @@
+#include "include/trajectory_rmsd.hpp"
+#include "include/mask.hpp"
+#include "include/parallel.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <fmt/format.h>
+
+namespace rms {
+namespace {
+
+// Frames formatted per worker and block by write_fitted_mdcrd.
+constexpr std::size_t kFramesPerWriteTask = 4;
+
+void check_atoms(const MdcrdTrajectory &trajectory, const RmsdReference &reference, std::span<const int> atoms) {
+  if (atoms.empty()) {
+    if (reference.size() != trajectory.natom()) {
+      throw std::invalid_argument(fmt::format(
+        "RMSD reference has {} atoms, but the trajectory has {}", reference.size(), trajectory.natom()));
+    }
+    return;
+  }
+  if (reference.size() != atoms.size()) {
+    throw std::invalid_argument(
+      fmt::format("RMSD reference has {} atoms, but {} are selected", reference.size(), atoms.size()));
+  }
+  auto const natom = trajectory.natom();
+  if (std::ranges::any_of(atoms, [natom](int atom) { return atom < 0 || static_cast<std::size_t>(atom) >= natom; })) {
+    throw std::invalid_argument(fmt::format("Selected atom is outside the trajectory's {} atoms", natom));
+  }
+}
+
+} // namespace
+
+TrajectoryRmsd trajectory_rmsd(const MdcrdTrajectory &trajectory, const RmsdReference &reference,
+  const TrajectoryRmsdOptions &options) {
+  check_atoms(trajectory, reference, options.atoms);
+  auto const frames = trajectory.frame_count();
+  TrajectoryRmsd out;
+  out.rmsd.resize(frames);
+  if (options.keep_fits) {
+    out.fits.resize(frames);
+  }
+
+  auto const workers = std::min(resolve_thread_count(options.threads), std::max<std::size_t>(1, frames));
+  std::vector<MdcrdFrame> buffers(workers);
+  std::vector<Coordinates> selected(options.atoms.empty() ? 0 : workers);
+  parallel_for_stealing(frames, options.threads, [&](std::size_t worker, std::size_t frame) {
+    auto &buffer = buffers[worker];
+    trajectory.read_frame(frame, buffer);
+    auto const *positions = &buffer.positions;
+    if (!options.atoms.empty()) {
+      gather(buffer.positions, options.atoms, selected[worker]);
+      positions = &selected[worker];
+    }
+    if (options.keep_fits) {
+      out.fits[frame] = reference.fit(*positions);
+      out.rmsd[frame] = out.fits[frame].rmsd;
+    } else {
+      out.rmsd[frame] = reference.rmsd(*positions);
+    }
+  });
+  return out;
+}
+
+void write_fitted_mdcrd(const std::filesystem::path &out, const MdcrdTrajectory &trajectory,
+  const RmsdReference &reference, std::span<const RmsdFit> fits, std::size_t threads, std::span<const int> atoms) {
+  check_atoms(trajectory, reference, atoms);
+  auto const frames = trajectory.frame_count();
+  if (fits.size() != frames) {
+    throw std::invalid_argument(
+      fmt::format("Trajectory has {} frames, but {} fits were given", frames, fits.size()));
+  }
+
+  std::ofstream file(out, std::ios::binary | std::ios::trunc);
+  file << trajectory.title() << '\n';
+
+  // Blocks of a few frames per worker are formatted concurrently, then
+  // written in order; memory stays bounded by the block.
+  auto const workers = resolve_thread_count(threads);
+  auto const block = workers * kFramesPerWriteTask;
+  std::vector<std::string> texts(workers);
+  for (std::size_t first = 0; first < frames && file; first += block) {
+    auto const last = std::min(frames, first + block);
+    auto const tasks = (last - first + kFramesPerWriteTask - 1) / kFramesPerWriteTask;
+    parallel_for(tasks, threads, [&](std::size_t task) {
+      auto &text = texts[task];
+      text.clear();
+      MdcrdFrame frame;
+      auto const end = std::min(last, first + (task + 1) * kFramesPerWriteTask);
+      for (auto idx = first + task * kFramesPerWriteTask; idx < end; ++idx) {
+        trajectory.read_frame(idx, frame);
+        reference.superpose(frame.positions, fits[idx]);
+        append_mdcrd_frame(text, frame);
+      }
+    });
+    for (std::size_t task = 0; task < tasks; ++task) {
+      file << texts[task];
+    }
+  }
+  file.close();
+  if (!file) {
+    throw std::runtime_error(fmt::format("Failed to write fitted trajectory: {}", out.string()));
+  }
+}
+
+} // namespace rms
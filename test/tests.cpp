@@ -1,10 +1,51 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include "include/bond_graph.hpp"
+#include "include/bonded.hpp"
+#include "include/coordinates.hpp"
+#include "include/exclusions.hpp"
+#include "include/fixed_width.hpp"
 #include "include/forcefield.hpp"
+#include "include/generalized_born.hpp"
+#include "include/mask.hpp"
+#include "include/neighbors.hpp"
+#include "include/nonbonded.hpp"
+#include "include/one_four.hpp"
+#include "include/pairwise.hpp"
+#include "include/parallel.hpp"
 #include "include/parsers.hpp"
+#include "include/residues.hpp"
+#include "include/rmsd.hpp"
+#include "include/synthetic.hpp"
+#include "include/topology_cache.hpp"
+#include "include/trajectory.hpp"
+#include "include/trajectory_rmsd.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 TEST_CASE("Parse binder_wcn.parm7", "[parm7]") {
   auto const data_dir = std::filesystem::path(RMS_TEST_DATA_DIR);
@@ -53,3 +94,1919 @@ TEST_CASE("Parse binder_wcn.parm7", "[parm7]") {
   REQUIRE(topo.atoms_per_molecule.at(0) == 47);
   REQUIRE(topo.radius_set == "modified Bondi radii (mbondi)");
 }
+
+TEST_CASE("Parse binder_wcn.parm7 from an in-memory buffer", "[parm7]") {
+  auto const data_dir = std::filesystem::path(RMS_TEST_DATA_DIR);
+  auto const path = data_dir / "binder_wcn.parm7";
+
+  std::ifstream file(path, std::ios::binary);
+  REQUIRE(file.is_open());
+  std::string const contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+  auto const from_file = rms::parse_parm7_file(path);
+  auto const from_buffer = rms::parse_parm7_buffer(std::span<const char>(contents.data(), contents.size()));
+
+  REQUIRE(from_buffer.title == from_file.title);
+  REQUIRE(from_buffer.pointers.natom == from_file.pointers.natom);
+  REQUIRE(from_buffer.atom_name == from_file.atom_name);
+  REQUIRE(from_buffer.charge == from_file.charge);
+  REQUIRE(from_buffer.bond_i == from_file.bond_i);
+  REQUIRE(from_buffer.dihedral_flags == from_file.dihedral_flags);
+  REQUIRE(from_buffer.radius_set == from_file.radius_set);
+}
+
+TEST_CASE("Parallel section parsing matches sequential parsing", "[parm7]") {
+  auto const data_dir = std::filesystem::path(RMS_TEST_DATA_DIR);
+  auto const path = data_dir / "binder_wcn.parm7";
+
+  auto const sequential = rms::parse_parm7_file(path, rms::Parm7ParseOptions{.threads = 1});
+  auto const parallel = rms::parse_parm7_file(path, rms::Parm7ParseOptions{.threads = 4});
+
+  REQUIRE(parallel.title == sequential.title);
+  REQUIRE(parallel.version == sequential.version);
+  REQUIRE(parallel.atom_name == sequential.atom_name);
+  REQUIRE(parallel.charge == sequential.charge);
+  REQUIRE(parallel.excluded_atoms_list == sequential.excluded_atoms_list);
+  REQUIRE(parallel.lennard_jones_acoeff == sequential.lennard_jones_acoeff);
+  REQUIRE(parallel.bond_i == sequential.bond_i);
+  REQUIRE(parallel.angle_k == sequential.angle_k);
+  REQUIRE(parallel.dihedral_l == sequential.dihedral_l);
+  REQUIRE(parallel.dihedral_flags == sequential.dihedral_flags);
+  REQUIRE(parallel.amber_atom_type == sequential.amber_atom_type);
+  REQUIRE(parallel.screen == sequential.screen);
+}
+
+TEST_CASE("Parse a synthetic system beyond 65535 atoms and residues", "[parm7]") {
+  auto const system = rms::synthetic_system_for_atoms(200'000);
+  auto const text = rms::make_synthetic_parm7(system);
+  auto const topo = rms::parse_parm7_buffer(text);
+
+  auto const natom = system.solute_atoms + 3 * system.waters;
+  REQUIRE(natom >= 200'000);
+  REQUIRE(static_cast<std::size_t>(topo.pointers.natom) == natom);
+  REQUIRE(static_cast<std::size_t>(topo.pointers.nres) == system.waters + 1);
+  REQUIRE(static_cast<std::size_t>(topo.pointers.nbonh) == 3 * system.waters);
+  REQUIRE(topo.pointers.nnb > 65535);
+
+  REQUIRE(topo.atom_name.size() == natom);
+  REQUIRE(topo.charge.size() == natom);
+  REQUIRE(topo.residue_pointer.size() == system.waters + 1);
+  REQUIRE(static_cast<std::size_t>(topo.residue_pointer.back()) == natom - 3);
+  REQUIRE(topo.bond_i.size() == static_cast<std::size_t>(topo.pointers.nbonh) + static_cast<std::size_t>(topo.pointers.nbona));
+  REQUIRE(topo.angle_i.size() == static_cast<std::size_t>(topo.pointers.ntheth) + static_cast<std::size_t>(topo.pointers.ntheta));
+  REQUIRE(static_cast<std::size_t>(topo.bond_j.at(3 * system.waters - 1)) == natom - 1);
+  REQUIRE(topo.atoms_per_molecule.size() == system.waters + 1);
+  REQUIRE(topo.solvent_pointers.has_value());
+  REQUIRE(static_cast<std::size_t>((*topo.solvent_pointers)[1]) == system.waters + 1);
+}
+
+TEST_CASE("POINTERS rejects negative and overflowing counts", "[parm7]") {
+  auto const text = rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 8, .waters = 2});
+  auto const format_begin = text.find('\n', text.find("%FLAG POINTERS")) + 1;
+  auto const values_begin = text.find('\n', format_begin) + 1;
+  auto const values_end = text.find("%FLAG", values_begin);
+
+  // Rewrites POINTERS with NATOM replaced, using I12 fields so values beyond
+  // the I8 range can be expressed.
+  auto with_natom = [&](long long natom) {
+    std::vector<long long> values;
+    std::istringstream stream(text.substr(values_begin, values_end - values_begin));
+    for (long long value = 0; stream >> value;) {
+      values.push_back(value);
+    }
+    values.at(0) = natom;
+
+    std::string pointers = "%FORMAT(10I12)\n";
+    for (std::size_t idx = 0; idx < values.size(); ++idx) {
+      pointers += fmt::format("{:12d}", values[idx]);
+      if (idx % 10 == 9 || idx + 1 == values.size()) {
+        pointers += '\n';
+      }
+    }
+    return text.substr(0, format_begin) + pointers + text.substr(values_end);
+  };
+
+  REQUIRE(rms::parse_parm7_buffer(with_natom(14)).pointers.natom == 14);
+  REQUIRE_THROWS_AS(rms::parse_parm7_buffer(with_natom(-14)), std::runtime_error);
+  REQUIRE_THROWS_AS(rms::parse_parm7_buffer(with_natom(800'000'000)), std::runtime_error);
+  REQUIRE_THROWS_AS(rms::parse_parm7_buffer(with_natom(5'000'000'000)), std::runtime_error);
+}
+
+TEST_CASE("Section mask skips sections and loads them on demand", "[parm7]") {
+  auto const text = rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 40, .waters = 500});
+  auto const full = rms::parse_parm7_buffer(text);
+
+  auto topo = rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.sections = rms::kParm7AtomSections});
+  REQUIRE(topo.loaded_sections == rms::kParm7AtomSections);
+  REQUIRE(topo.atom_name == full.atom_name);
+  REQUIRE(topo.charge == full.charge);
+  REQUIRE(topo.residue_pointer == full.residue_pointer);
+  REQUIRE(topo.box_dimensions == full.box_dimensions);
+  REQUIRE(topo.excluded_atoms_list.empty());
+  REQUIRE(topo.dihedral_i.empty());
+  REQUIRE(topo.join_array.empty());
+  REQUIRE(topo.deferred_sections.size() == rms::kParm7SectionCount - 12);
+  for (auto const &deferred : topo.deferred_sections) {
+    REQUIRE(std::string_view(text).substr(deferred.offset, 5) == "%FLAG");
+  }
+
+  // Requesting one half of a connectivity list loads both halves.
+  rms::load_parm7_sections(topo, text, rms::section_bit(rms::Parm7Section::DihedralsWithoutHydrogen));
+  REQUIRE(topo.dihedral_i == full.dihedral_i);
+  REQUIRE(topo.dihedral_flags == full.dihedral_flags);
+  REQUIRE(topo.bond_i.empty());
+
+  rms::load_parm7_sections(topo, text, rms::kAllParm7Sections);
+  REQUIRE(topo.loaded_sections == rms::kAllParm7Sections);
+  REQUIRE(topo.deferred_sections.empty());
+  REQUIRE(topo.excluded_atoms_list == full.excluded_atoms_list);
+  REQUIRE(topo.bond_i == full.bond_i);
+  REQUIRE(topo.lennard_jones_bcoeff == full.lennard_jones_bcoeff);
+  REQUIRE(topo.radii == full.radii);
+}
+
+TEST_CASE("Names are packed into 32 bits and interned", "[parm7][names]") {
+  constexpr rms::PackedName ca("CA");
+  static_assert(ca.view() == "CA");
+  static_assert(ca == rms::PackedName("CA"));
+  static_assert(ca != rms::PackedName("CB"));
+  static_assert(rms::PackedName().empty());
+  static_assert(rms::PackedName("H5''").view() == "H5''");
+
+  std::vector<rms::PackedName> const names = {rms::PackedName("WAT"), rms::PackedName("WAT"), rms::PackedName("LIG"),
+    rms::PackedName("WAT"), rms::PackedName("Na+")};
+  auto const interned = rms::intern_names(names);
+  REQUIRE(interned.table.size() == 3);
+  REQUIRE(std::ranges::equal(interned.ids, std::vector<std::uint32_t>{0, 0, 1, 0, 2}));
+  REQUIRE(interned.at(4) == "Na+");
+  REQUIRE(interned.find(rms::PackedName("LIG")) == 1U);
+  REQUIRE_FALSE(interned.find(rms::PackedName("CL")).has_value());
+
+  auto const text = rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 12, .waters = 50});
+  auto const topo = rms::parse_parm7_buffer(text);
+  REQUIRE(topo.atom_name.at(12) == "O");
+  REQUIRE(topo.amber_atom_type.table.size() == 3);
+  REQUIRE(topo.amber_atom_type.at(13) == "HW");
+  REQUIRE(topo.residue_label.table.size() == 2);
+  REQUIRE(topo.tree_chain_classification.at(20) == "BLA");
+
+  // Read as 8-wide fields, pairs of types run together into names that do not fit.
+  auto too_long = text;
+  too_long.replace(too_long.find("(20a4)", too_long.find("AMBER_ATOM_TYPE")), 6, "(10a8)");
+  REQUIRE_THROWS_AS(rms::parse_parm7_buffer(too_long), std::runtime_error);
+}
+
+TEST_CASE("Binary topology cache round-trips and is reused", "[parm7][cache]") {
+  auto const dir = std::filesystem::temp_directory_path() / "rms_cache_test";
+  std::filesystem::create_directories(dir);
+  auto const parm7_path = dir / "synthetic.parm7";
+  {
+    std::ofstream file(parm7_path, std::ios::binary | std::ios::trunc);
+    file << rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 30, .waters = 200});
+  }
+  auto const cache_path = rms::topology_cache_path(parm7_path);
+  std::filesystem::remove(cache_path);
+
+  auto const text = rms::parse_parm7_file(parm7_path);
+  auto const first = rms::load_parm7_cached(parm7_path);
+  REQUIRE(std::filesystem::exists(cache_path));
+
+  rms::TopologyCacheView const view(cache_path);
+  REQUIRE(view.key() == rms::topology_cache_key(parm7_path));
+  REQUIRE(view.pointers().natom == text.pointers.natom);
+  auto const charge = view.array(&rms::Parm7Topology::charge);
+  REQUIRE(std::ranges::equal(charge, text.charge));
+  auto const bond_j = view.array(&rms::Parm7Topology::bond_j);
+  REQUIRE(std::ranges::equal(bond_j, text.bond_j));
+  REQUIRE(reinterpret_cast<std::uintptr_t>(bond_j.data()) % 64 == 0);
+  auto const names = view.array(&rms::Parm7Topology::atom_name);
+  REQUIRE(std::ranges::equal(names, text.atom_name));
+  auto const residue_ids = view.name_ids(&rms::Parm7Topology::residue_label);
+  REQUIRE(view.name_table(&rms::Parm7Topology::residue_label)[residue_ids.back()] == "WAT");
+
+  auto const cached = rms::load_parm7_cached(parm7_path);
+  for (auto const *topo : {&first, &cached}) {
+    REQUIRE(topo->title == text.title);
+    REQUIRE(topo->version == text.version);
+    REQUIRE(topo->radius_set == text.radius_set);
+    REQUIRE(topo->atom_name == text.atom_name);
+    REQUIRE(topo->tree_chain_classification == text.tree_chain_classification);
+    REQUIRE(topo->excluded_atoms_list == text.excluded_atoms_list);
+    REQUIRE(topo->dihedral_flags == text.dihedral_flags);
+    REQUIRE(topo->lennard_jones_acoeff == text.lennard_jones_acoeff);
+    REQUIRE(topo->box_dimensions == text.box_dimensions);
+    REQUIRE(topo->solvent_pointers == text.solvent_pointers);
+    REQUIRE(topo->ipol == text.ipol);
+    REQUIRE(topo->loaded_sections == rms::kAllParm7Sections);
+  }
+
+  // A damaged cache is ignored and rebuilt.
+  {
+    std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+    file << "not a cache";
+  }
+  REQUIRE_THROWS_AS(rms::TopologyCacheView(cache_path), std::runtime_error);
+  REQUIRE(rms::load_parm7_cached(parm7_path).atom_name == text.atom_name);
+  REQUIRE(rms::TopologyCacheView(cache_path).key() == rms::topology_cache_key(parm7_path));
+
+  // So is one whose arrays do not match POINTERS.
+  auto short_radii = rms::parse_parm7_file(parm7_path);
+  short_radii.radii.pop_back();
+  rms::write_topology_cache(cache_path, short_radii, rms::topology_cache_key(parm7_path));
+  REQUIRE_THROWS_AS(rms::TopologyCacheView(cache_path).to_topology(), std::runtime_error);
+  REQUIRE(rms::load_parm7_cached(parm7_path).radii == text.radii);
+  REQUIRE(rms::TopologyCacheView(cache_path).to_topology().radii == text.radii);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("LJTable matches the checked pair lookup", "[forcefield][lj]") {
+  auto const topo =
+    rms::parse_parm7_buffer(rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 20, .waters = 10}));
+  rms::LJTable const table(topo);
+  REQUIRE(table.ntypes() == static_cast<std::size_t>(topo.pointers.ntypes));
+  REQUIRE(reinterpret_cast<std::uintptr_t>(table.coefficients().data()) % rms::kCacheLineSize == 0);
+
+  for (int type_i = 0; type_i < topo.pointers.ntypes; ++type_i) {
+    for (int type_j = 0; type_j < topo.pointers.ntypes; ++type_j) {
+      auto const checked = rms::lj_pair_coeffs(topo, type_i, type_j);
+      auto const pair = table.pair(type_i, type_j);
+      REQUIRE(checked.has_value());
+      REQUIRE(pair.a == checked->first);
+      REQUIRE(pair.b == checked->second);
+      REQUIRE(table.coefficients()[2 * table.index(type_i, type_j) + 1] == pair.b);
+      if (pair.a > 0.0) {
+        double const sigma6 = std::pow(table.sigma(type_i, type_j), 6.0);
+        REQUIRE(4.0 * table.epsilon(type_i, type_j) * sigma6 * sigma6 == Catch::Approx(pair.a));
+        REQUIRE(4.0 * table.epsilon(type_i, type_j) * sigma6 == Catch::Approx(pair.b));
+      }
+    }
+  }
+
+  auto broken = topo;
+  broken.nonbonded_parm_index.pop_back();
+  REQUIRE_THROWS_AS(rms::LJTable(broken), std::runtime_error);
+}
+
+TEST_CASE("Exclusion CSR agrees with the raw parm7 lists", "[parm7][exclusions]") {
+  auto const topo =
+    rms::parse_parm7_buffer(rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 30, .waters = 40}));
+  auto const natom = topo.pointers.natom;
+
+  // Reference: a linear scan of the raw arrays, in both directions.
+  auto const count = static_cast<std::size_t>(natom);
+  std::vector<std::vector<bool>> expected(count, std::vector<bool>(count, false));
+  std::size_t cursor = 0;
+  for (int atom = 0; atom < natom; ++atom) {
+    for (int idx = 0; idx < topo.number_excluded_atoms[static_cast<std::size_t>(atom)]; ++idx) {
+      int const partner = topo.excluded_atoms_list[cursor++];
+      if (partner >= 0) {
+        expected[static_cast<std::size_t>(atom)][static_cast<std::size_t>(partner)] = true;
+        expected[static_cast<std::size_t>(partner)][static_cast<std::size_t>(atom)] = true;
+      }
+    }
+  }
+
+  for (std::size_t threads : {std::size_t{1}, std::size_t{4}}) {
+    rms::ExclusionList const exclusions(topo, threads);
+    REQUIRE(exclusions.atom_count() == static_cast<std::size_t>(natom));
+    std::size_t mismatches = 0;
+    for (int atom_i = 0; atom_i < natom; ++atom_i) {
+      REQUIRE(std::ranges::is_sorted(exclusions.partners(atom_i)));
+      for (int atom_j = 0; atom_j < natom; ++atom_j) {
+        bool const want = expected[static_cast<std::size_t>(atom_i)][static_cast<std::size_t>(atom_j)];
+        mismatches += exclusions.excluded(atom_i, atom_j) != want ? 1U : 0U;
+      }
+    }
+    REQUIRE(mismatches == 0);
+  }
+
+  // Hand-built lists: a lower partner is re-homed, and far partners use the sorted rows.
+  rms::Parm7Topology manual;
+  manual.pointers.natom = 100;
+  manual.number_excluded_atoms.assign(100, 1);
+  manual.number_excluded_atoms[0] = 3;
+  manual.excluded_atoms_list.assign(102, -1);
+  manual.excluded_atoms_list[0] = 90;
+  manual.excluded_atoms_list[1] = 2;
+  manual.excluded_atoms_list[2] = 90;
+  manual.excluded_atoms_list[3] = 0;
+  rms::ExclusionList const rehomed(manual);
+  REQUIRE(rehomed.pair_count() == 3);
+  REQUIRE(std::ranges::equal(rehomed.partners(0), std::vector<int>{1, 2, 90}));
+  REQUIRE(rehomed.excluded(1, 0));
+  REQUIRE(rehomed.excluded(90, 0));
+  REQUIRE_FALSE(rehomed.excluded(0, 89));
+  REQUIRE_FALSE(rehomed.excluded(1, 2));
+
+  manual.excluded_atoms_list[4] = 100;
+  REQUIRE_THROWS_AS(rms::ExclusionList(manual), std::runtime_error);
+  manual.excluded_atoms_list.pop_back();
+  REQUIRE_THROWS_AS(rms::ExclusionList(manual), std::runtime_error);
+}
+
+TEST_CASE("Bond graph and molecules match the topology", "[parm7][graph]") {
+  auto const topo =
+    rms::parse_parm7_buffer(rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 25, .waters = 3000}));
+
+  rms::BondGraph const serial(topo, 1);
+  rms::BondGraph const graph(topo, 4);
+  REQUIRE(graph.bond_count() == topo.bond_i.size());
+  REQUIRE(std::ranges::equal(graph.offsets(), serial.offsets()));
+  REQUIRE(std::ranges::equal(graph.adjacency(), serial.adjacency()));
+  REQUIRE(std::ranges::equal(graph.neighbors(1), std::vector<int>{0, 2}));
+  REQUIRE(std::ranges::equal(graph.neighbors(25), std::vector<int>{26, 27}));
+
+  auto const molecules = rms::find_molecules(graph, 4);
+  REQUIRE(molecules.size() == 3001);
+  REQUIRE(molecules.atoms_of(0).size() == 25);
+  REQUIRE(std::ranges::equal(molecules.atoms_of(1), std::vector<int>{25, 26, 27}));
+  REQUIRE(molecules.molecule_of.back() == 3000);
+  REQUIRE_NOTHROW(rms::check_molecules(topo, molecules));
+  REQUIRE(rms::first_solvent_molecule(topo, molecules) == 1);
+
+  // Breaking the solute chain adds a molecule that the topology does not list.
+  auto broken = topo;
+  auto const cut = static_cast<std::size_t>(topo.pointers.nbonh) + 10;
+  broken.bond_j[cut] = broken.bond_i[cut];
+  REQUIRE_THROWS_AS(rms::check_molecules(broken, rms::find_molecules(rms::BondGraph(broken))), std::runtime_error);
+
+  broken.bond_j[cut] = topo.pointers.natom;
+  REQUIRE_THROWS_AS(rms::BondGraph(broken), std::runtime_error);
+}
+
+TEST_CASE("Residue index answers atom and residue queries", "[parm7][residues]") {
+  auto const topo =
+    rms::parse_parm7_buffer(rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 17, .waters = 5000}));
+  rms::ResidueIndex const residues(topo);
+  REQUIRE(residues.residue_count() == static_cast<std::size_t>(topo.pointers.nres));
+  REQUIRE(residues.atom_count() == static_cast<std::size_t>(topo.pointers.natom));
+
+  auto const reference = rms::build_atom_residue_map(topo);
+  REQUIRE(residues.build_atom_map(1) == reference);
+  REQUIRE(residues.build_atom_map(4) == reference);
+  std::size_t mismatches = 0;
+  for (std::size_t atom = 0; atom < reference.size(); ++atom) {
+    mismatches += residues.residue_of(static_cast<int>(atom)) != reference[atom] ? 1U : 0U;
+  }
+  REQUIRE(mismatches == 0);
+
+  REQUIRE(residues.atoms_of(0).size() == 17);
+  REQUIRE(residues.atoms_of(1).begin == 17);
+  REQUIRE(residues.atoms_of(1).contains(19));
+  std::size_t visited = 0;
+  residues.for_each_residue([&](int residue, rms::AtomRange atoms) {
+    visited += atoms.size();
+    REQUIRE(residues.residue_of(atoms.end - 1) == residue);
+  });
+  REQUIRE(visited == residues.atom_count());
+
+  // Empty residues are skipped; bad tables are rejected.
+  auto edited = topo;
+  edited.residue_pointer[2] = edited.residue_pointer[1];
+  rms::ResidueIndex const with_empty(edited);
+  REQUIRE(with_empty.atoms_of(1).size() == 0);
+  REQUIRE(with_empty.residue_of(17) == 2);
+  edited.residue_pointer[2] = edited.residue_pointer[1] - 1;
+  REQUIRE_THROWS_AS(rms::ResidueIndex(edited), std::runtime_error);
+}
+
+TEST_CASE("rst7 reader round-trips positions, velocities and box", "[rst7]") {
+  rms::SyntheticSystem const system{.solute_atoms = 17, .waters = 20000};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const expected = rms::make_synthetic_coordinates(system, true);
+  auto const text = rms::format_rst7(expected);
+
+  auto const rst7 = rms::parse_rst7_buffer(text, rms::Rst7ParseOptions{.threads = 4});
+  REQUIRE(rst7.title == "synthetic");
+  REQUIRE(rst7.time == 0.0);
+  REQUIRE_NOTHROW(rms::check_rst7(topo, rst7));
+  REQUIRE(rst7.box == expected.box);
+  REQUIRE(rst7.velocities.has_value());
+  REQUIRE(reinterpret_cast<std::uintptr_t>(rst7.positions.x.data()) % 64 == 0);
+  double worst = 0.0;
+  for (std::size_t atom = 0; atom < rst7.natom(); ++atom) {
+    worst = std::max({worst, std::abs(rst7.positions.x[atom] - expected.positions.x[atom]),
+      std::abs(rst7.positions.z[atom] - expected.positions.z[atom]),
+      std::abs(rst7.velocities->y[atom] - expected.velocities->y[atom])});
+  }
+  REQUIRE(worst <= 5e-8);
+  REQUIRE(rms::parse_rst7_buffer(text, rms::Rst7ParseOptions{.threads = 1}) == rst7);
+
+  // Odd atom counts end the block on a half line; without velocities the box
+  // line follows the positions directly; inpcrd files may carry neither.
+  std::string const odd = "odd\n    3\n"
+                          "   1.0000000   2.0000000   3.0000000   4.0000000   5.0000000   6.0000000\n"
+                          "  -7.0000000   8.5000000  -9.2500000\n"
+                          "  30.0000000  31.0000000  32.0000000\n";
+  auto const small = rms::parse_rst7_buffer(odd);
+  REQUIRE(small.natom() == 3);
+  REQUIRE(!small.time);
+  REQUIRE(!small.velocities);
+  REQUIRE(small.positions.x[1] == 4.0);
+  REQUIRE(small.positions.z[2] == -9.25);
+  REQUIRE(small.box == std::array{30.0, 31.0, 32.0, 90.0, 90.0, 90.0});
+  auto const bare = rms::parse_rst7_buffer(odd.substr(0, odd.rfind("  30.0")));
+  REQUIRE(!bare.box);
+
+  REQUIRE_THROWS_AS(rms::check_rst7(topo, small), std::runtime_error);
+  REQUIRE_THROWS_AS(rms::parse_rst7_buffer(odd.substr(0, odd.find("  -7.0"))), std::runtime_error);
+  auto garbled = odd;
+  garbled.replace(garbled.find("8.5000000"), 9, "x.5000000");
+  REQUIRE_THROWS_AS(rms::parse_rst7_buffer(garbled), std::runtime_error);
+}
+
+TEST_CASE("mdcrd frames are indexed and decoded by random access", "[mdcrd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 17, .waters = 300};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const start = rms::make_synthetic_coordinates(system);
+  constexpr std::size_t kFrames = 120;
+
+  // Frame f is the start structure shifted by f / 4 along x, with a growing box.
+  auto make_frame = [&](std::size_t frame, bool with_box) {
+    rms::MdcrdFrame out{.positions = start.positions, .box = std::nullopt};
+    for (auto &x : out.positions.x) {
+      x += static_cast<double>(frame) * 0.25;
+    }
+    if (with_box) {
+      out.box = std::array{40.0 + static_cast<double>(frame), 41.0, 42.0};
+    }
+    return out;
+  };
+  auto const dir = std::filesystem::temp_directory_path() / "rms_mdcrd_test";
+  std::filesystem::create_directories(dir);
+  auto write = [&](const std::filesystem::path &path, bool with_box, std::string_view tail) {
+    std::string text = "synthetic trajectory\n";
+    for (std::size_t frame = 0; frame < kFrames; ++frame) {
+      rms::append_mdcrd_frame(text, make_frame(frame, with_box));
+    }
+    text += tail;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+    std::filesystem::remove(rms::mdcrd_index_path(path));
+  };
+
+  auto const path = dir / "boxed.mdcrd";
+  write(path, true, "");
+  rms::MdcrdTrajectory const trajectory(path, topo, rms::MdcrdOptions{.threads = 4});
+  REQUIRE(trajectory.title() == "synthetic trajectory");
+  REQUIRE(trajectory.natom() == static_cast<std::size_t>(topo.pointers.natom));
+  REQUIRE(trajectory.frame_count() == kFrames);
+  REQUIRE(trajectory.has_box());
+  REQUIRE_FALSE(trajectory.index_reused());
+
+  auto const frame = trajectory.frame(77);
+  auto const expected = make_frame(77, true);
+  double worst = 0.0;
+  for (std::size_t atom = 0; atom < trajectory.natom(); ++atom) {
+    worst = std::max({worst, std::abs(frame.positions.x[atom] - expected.positions.x[atom]),
+      std::abs(frame.positions.y[atom] - expected.positions.y[atom]),
+      std::abs(frame.positions.z[atom] - expected.positions.z[atom])});
+  }
+  REQUIRE(worst <= 5e-4);
+  REQUIRE(frame.box == expected.box);
+
+  std::vector<std::size_t> order;
+  trajectory.for_each_frame(10, 20, [&](std::size_t idx, const rms::MdcrdFrame &decoded) {
+    order.push_back(idx);
+    REQUIRE((*decoded.box)[0] == 40.0 + static_cast<double>(idx));
+  });
+  REQUIRE(order == std::vector<std::size_t>{10, 11, 12, 13, 14, 15, 16, 17, 18, 19});
+  std::vector<double> first_x(kFrames, 0.0);
+  trajectory.for_each_frame_parallel(0, kFrames, 4, [&](std::size_t idx, const rms::MdcrdFrame &decoded) {
+    first_x[idx] = decoded.positions.x[0];
+  });
+  for (std::size_t idx = 0; idx < kFrames; ++idx) {
+    REQUIRE(first_x[idx] == Catch::Approx(start.positions.x[0] + static_cast<double>(idx) * 0.25).margin(1e-3));
+  }
+  REQUIRE_THROWS_AS(trajectory.frame(kFrames), std::out_of_range);
+
+  // The sidecar is reused while the file is unchanged, and matches a fresh scan.
+  rms::MdcrdTrajectory const reopened(path, topo);
+  REQUIRE(reopened.index_reused());
+  REQUIRE(std::ranges::equal(reopened.offsets(), trajectory.offsets()));
+  rms::MdcrdTrajectory const serial(path, topo, rms::MdcrdOptions{.threads = 1, .use_index_file = false});
+  REQUIRE(std::ranges::equal(serial.offsets(), trajectory.offsets()));
+
+  // No box lines, and a partial frame at the end from a run still writing.
+  auto const partial = dir / "partial.mdcrd";
+  write(partial, false, "   1.000   2.000   3.000\n");
+  rms::MdcrdTrajectory const unboxed(partial, topo, rms::MdcrdOptions{.threads = 4});
+  REQUIRE_FALSE(unboxed.has_box());
+  REQUIRE(unboxed.frame_count() == kFrames);
+  REQUIRE_FALSE(unboxed.frame(kFrames - 1).box);
+  REQUIRE(unboxed.frame(kFrames - 1).positions.z[5] == Catch::Approx(start.positions.z[5]).margin(1e-3));
+
+  // A damaged value surfaces when its frame is decoded.
+  auto damaged = dir / "damaged.mdcrd";
+  write(damaged, true, "");
+  {
+    std::fstream file(damaged, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(trajectory.offsets()[3] + 8));
+    file << "  x.yyy ";
+  }
+  rms::MdcrdTrajectory const broken(damaged, topo, rms::MdcrdOptions{.use_index_file = false});
+  REQUIRE_NOTHROW(broken.frame(2));
+  REQUIRE_THROWS_AS(broken.frame(3), std::runtime_error);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Connectivity streams into the SoA arrays", "[parm7][connectivity]") {
+  auto const text = rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 12, .waters = 4});
+  auto const topo = rms::parse_parm7_buffer(text);
+
+  // Hydrogen rows come first (three per water), then the solute chain.
+  REQUIRE(topo.bond_i.size() == 3 * 4 + 11);
+  REQUIRE(topo.bond_i.front() == 12);
+  REQUIRE(topo.bond_j.front() == 13);
+  REQUIRE(topo.bond_type.front() == 0);
+  REQUIRE(topo.bond_i[12] == 0);
+  REQUIRE(topo.bond_j[12] == 1);
+  REQUIRE(topo.bond_type[12] == 2);
+
+  REQUIRE(topo.dihedral_flags[0] == 0);
+  REQUIRE(topo.dihedral_flags[1] == 0x1);
+  REQUIRE(topo.dihedral_k[1] == 3);
+  REQUIRE(topo.dihedral_flags[2] == 0x2);
+  REQUIRE(topo.dihedral_l[2] == 5);
+  REQUIRE(topo.dihedral_type[1] == 1);
+
+  // Dropping the last line of a section leaves rows unfilled.
+  auto truncated = text;
+  auto const next = truncated.find("%FLAG ANGLES_INC_HYDROGEN");
+  auto const last_line = truncated.rfind('\n', next - 2) + 1;
+  truncated.erase(last_line, next - last_line);
+  REQUIRE_THROWS_AS(rms::parse_parm7_buffer(truncated), std::runtime_error);
+}
+
+namespace {
+
+// Counts what reaches the global heap, to observe how a parse allocates.
+class CountingResource final : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations = 0;
+  std::size_t live_bytes = 0;
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    live_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override {
+    live_bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+  }
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // namespace
+
+TEST_CASE("Topologies parse into an owned arena or a caller resource", "[parm7][arena]") {
+  auto const text = rms::make_synthetic_parm7(rms::SyntheticSystem{.solute_atoms = 40, .waters = 500});
+  auto const baseline = rms::parse_parm7_buffer(text);
+
+  CountingResource upstream;
+  {
+    auto arena_topo = rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.resource = &upstream, .use_arena = true});
+    REQUIRE(upstream.allocations == 1);
+    REQUIRE(arena_topo.bond_i.get_allocator().resource() == arena_topo.resource);
+
+    auto const moved = std::move(arena_topo);
+    REQUIRE(moved.charge == baseline.charge);
+    REQUIRE(moved.bond_i == baseline.bond_i);
+    REQUIRE(moved.dihedral_flags == baseline.dihedral_flags);
+    REQUIRE(moved.atom_name == baseline.atom_name);
+    REQUIRE(moved.residue_label == baseline.residue_label);
+    REQUIRE(moved.amber_atom_type == baseline.amber_atom_type);
+
+    // Copies allocate from the default resource and own no arena.
+    auto copy = moved;
+    REQUIRE(copy.arena == nullptr);
+    REQUIRE(copy.resource == std::pmr::get_default_resource());
+    REQUIRE(copy.bond_i.get_allocator().resource() == copy.resource);
+    REQUIRE(copy.residue_label.ids.get_allocator().resource() == copy.resource);
+    REQUIRE(copy.charge == baseline.charge);
+
+    // Assignment replaces the arrays and the storage together: the old arena
+    // is released, and nothing is left pointing into it.
+    auto assigned = rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.resource = &upstream, .use_arena = true});
+    assigned = rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.resource = &upstream, .use_arena = true});
+    REQUIRE(upstream.allocations == 3);
+    REQUIRE(assigned.bond_i.get_allocator().resource() == assigned.resource);
+    REQUIRE(assigned.arena.get() == assigned.resource);
+    REQUIRE(assigned.bond_i == baseline.bond_i);
+    assigned = copy;
+    REQUIRE(assigned.arena == nullptr);
+    REQUIRE(assigned.bond_i.get_allocator().resource() == std::pmr::get_default_resource());
+    REQUIRE(assigned.amber_atom_type == baseline.amber_atom_type);
+    copy = std::move(assigned);
+    REQUIRE(copy.lennard_jones_acoeff == baseline.lennard_jones_acoeff);
+  }
+  REQUIRE(upstream.live_bytes == 0);
+
+  // A caller-owned buffer sized from POINTERS alone holds the whole topology.
+  auto const header =
+    rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.sections = rms::section_bit(rms::Parm7Section::Pointers)});
+  std::vector<std::byte> buffer(rms::parm7_storage_bytes(header.pointers));
+  std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+  auto const in_buffer = rms::parse_parm7_buffer(text, rms::Parm7ParseOptions{.resource = &arena});
+  REQUIRE(in_buffer.lennard_jones_acoeff == baseline.lennard_jones_acoeff);
+  REQUIRE(in_buffer.excluded_atoms_list == baseline.excluded_atoms_list);
+  REQUIRE(in_buffer.amber_atom_type == baseline.amber_atom_type);
+}
+
+TEST_CASE("I8 field decoder agrees across SIMD tiers", "[parm7][simd]") {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> value_dist(-9999999, 99999999);
+  std::string text;
+  std::vector<int> expected;
+  for (int idx = 0; idx < 1000; ++idx) {
+    int const value = idx % 7 == 0 ? value_dist(rng) % 1000 : value_dist(rng);
+    text += fmt::format("{:8d}", value);
+    expected.push_back(value);
+  }
+
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Sse42, rms::SimdLevel::Avx2}) {
+    std::vector<int> decoded(expected.size());
+    REQUIRE(rms::decode_i8_fields(text, decoded, level) == expected.size());
+    REQUIRE(decoded == expected);
+  }
+
+  // Decoding stops at the first malformed field so the caller can take over.
+  std::string const malformed = "       1      -2       3     4 5       6       7       8       9      10";
+  for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Sse42, rms::SimdLevel::Avx2}) {
+    std::vector<int> decoded(10);
+    REQUIRE(rms::decode_i8_fields(malformed, decoded, level) == 3);
+    REQUIRE(decoded[0] == 1);
+    REQUIRE(decoded[1] == -2);
+    REQUIRE(decoded[2] == 3);
+  }
+
+  for (std::string_view const bad : {"        ", "      +1", "      1-", "     - 1", "  --   1"}) {
+    std::vector<int> decoded(4);
+    std::string const line = std::string(bad) + "       1       2       3";
+    for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Sse42, rms::SimdLevel::Avx2}) {
+      REQUIRE(rms::decode_i8_fields(line, decoded, level) == 0);
+    }
+  }
+}
+
+TEST_CASE("Fortran real parser handles E/D exponents without allocating", "[parm7]") {
+  REQUIRE(rms::parse_fortran_double("  1.40100000E+01") == 14.01);
+  REQUIRE(rms::parse_fortran_double(" -9.01433680E+00") == -9.0143368);
+  REQUIRE(rms::parse_fortran_double("  8.49322032D+05") == 849322.032);
+  REQUIRE(rms::parse_fortran_double("  5.65406768d+02") == 565.406768);
+  REQUIRE(rms::parse_fortran_double("    1.5-100") == 1.5e-100);
+  REQUIRE(rms::parse_fortran_double("+2.5") == 2.5);
+  REQUIRE(rms::parse_fortran_double("0.00000000E+00") == 0.0);
+  REQUIRE(rms::parse_fortran_double("1.23456789012345678901E+02") == 123.456789012345678901);
+  REQUIRE_FALSE(rms::parse_fortran_double("        ").has_value());
+  REQUIRE_FALSE(rms::parse_fortran_double("abc").has_value());
+
+  std::string const line = "  1.40100000E+01  1.20100000E+01 -4.94686000D-01  0.00000000E+00  3.39966950E+00";
+  std::vector<double> values(5);
+  REQUIRE(rms::decode_real_fields(line, 16, values) == 5);
+  REQUIRE(values == std::vector<double>{14.01, 12.01, -0.494686, 0.0, 3.3996695});
+
+  std::string const gap = "  1.00000000E+00                  3.00000000E+00";
+  REQUIRE(rms::decode_real_fields(gap, 16, values) == 1);
+}
+
+TEST_CASE("Fixed-point F decoder matches the general parser", "[parm7][rst7]") {
+  std::mt19937_64 rng(12);
+  std::uniform_real_distribution<double> coordinate(-999.0, 9999.0);
+  std::string line;
+  std::vector<double> expected;
+  for (int idx = 0; idx < 6000; ++idx) {
+    auto const value = idx % 7 == 0 ? coordinate(rng) * 1e-4 : coordinate(rng);
+    auto const field = fmt::format("{:12.7f}", value);
+    line += field;
+    expected.push_back(*rms::parse_fortran_double(field));
+  }
+  std::vector<double> values(expected.size());
+  REQUIRE(rms::decode_fixed_fields(line, 12, 7, values) == values.size());
+  REQUIRE(values == expected);
+
+  // Anything off the fixed layout stops the fast path at that field.
+  std::vector<double> row(3);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000  -0.2500000   3.0000000", 12, 7, row) == 3);
+  REQUIRE(row == std::vector<double>{1.5, -0.25, 3.0});
+  REQUIRE(std::signbit(row[1]));
+  REQUIRE(rms::decode_fixed_fields("   1.5000000 1.00000E+02   3.0000000", 12, 7, row) == 1);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000************   3.0000000", 12, 7, row) == 1);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000    -.250000   3.0000000", 12, 7, row) == 1);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000  - 0.250000   3.0000000", 12, 7, row) == 1);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000   0.25 0000   3.0000000", 12, 7, row) == 1);
+  REQUIRE(rms::decode_fixed_fields("   1.5000000            ", 12, 7, row) == 1);
+}
+
+namespace {
+
+// Kabsch superposition RMSD by a route independent of QCP: the singular values
+// of the weighted covariance H are the square roots of the eigenvalues of H^T H
+// (Jacobi sweeps), with the smallest negated when det(H) < 0.
+double kabsch_rmsd(const rms::Coordinates &a, const rms::Coordinates &b, const std::vector<double> &weights) {
+  auto const count = a.size();
+  auto const weight = [&](std::size_t atom) { return weights.empty() ? 1.0 : weights[atom]; };
+  double total = 0.0;
+  std::array<double, 3> ca{};
+  std::array<double, 3> cb{};
+  for (std::size_t atom = 0; atom < count; ++atom) {
+    total += weight(atom);
+    ca = {ca[0] + weight(atom) * a.x[atom], ca[1] + weight(atom) * a.y[atom], ca[2] + weight(atom) * a.z[atom]};
+    cb = {cb[0] + weight(atom) * b.x[atom], cb[1] + weight(atom) * b.y[atom], cb[2] + weight(atom) * b.z[atom]};
+  }
+  std::array<double, 9> h{};
+  double inner = 0.0;
+  for (std::size_t atom = 0; atom < count; ++atom) {
+    std::array<double, 3> const pa = {a.x[atom] - ca[0] / total, a.y[atom] - ca[1] / total, a.z[atom] - ca[2] / total};
+    std::array<double, 3> const pb = {b.x[atom] - cb[0] / total, b.y[atom] - cb[1] / total, b.z[atom] - cb[2] / total};
+    for (std::size_t i = 0; i < 3; ++i) {
+      inner += weight(atom) * (pa[i] * pa[i] + pb[i] * pb[i]);
+      for (std::size_t j = 0; j < 3; ++j) {
+        h[3 * i + j] += weight(atom) * pa[i] * pb[j];
+      }
+    }
+  }
+  std::array<double, 9> m{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 3; ++j) {
+      for (std::size_t k = 0; k < 3; ++k) {
+        m[3 * i + j] += h[3 * k + i] * h[3 * k + j];
+      }
+    }
+  }
+  for (int sweep = 0; sweep < 50; ++sweep) {
+    for (std::size_t p = 0; p < 3; ++p) {
+      for (std::size_t q = p + 1; q < 3; ++q) {
+        if (std::abs(m[3 * p + q]) < 1e-300) {
+          continue;
+        }
+        double const theta = (m[3 * q + q] - m[3 * p + p]) / (2.0 * m[3 * p + q]);
+        double const t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+        double const c = 1.0 / std::sqrt(t * t + 1.0);
+        double const s = t * c;
+        for (std::size_t k = 0; k < 3; ++k) {
+          double const mkp = m[3 * k + p];
+          double const mkq = m[3 * k + q];
+          m[3 * k + p] = c * mkp - s * mkq;
+          m[3 * k + q] = s * mkp + c * mkq;
+        }
+        for (std::size_t k = 0; k < 3; ++k) {
+          double const mpk = m[3 * p + k];
+          double const mqk = m[3 * q + k];
+          m[3 * p + k] = c * mpk - s * mqk;
+          m[3 * q + k] = s * mpk + c * mqk;
+        }
+      }
+    }
+  }
+  std::array<double, 3> sigma = {
+    std::sqrt(std::max(0.0, m[0])), std::sqrt(std::max(0.0, m[4])), std::sqrt(std::max(0.0, m[8]))};
+  std::ranges::sort(sigma, std::greater<>());
+  double const det = h[0] * (h[4] * h[8] - h[5] * h[7]) - h[1] * (h[3] * h[8] - h[5] * h[6])
+                     + h[2] * (h[3] * h[7] - h[4] * h[6]);
+  double const trace = sigma[0] + sigma[1] + (det < 0.0 ? -sigma[2] : sigma[2]);
+  return std::sqrt(std::max(0.0, (inner - 2.0 * trace) / total));
+}
+
+// Weighted RMSD of `rotation` (a - centroid(a)) against b - centroid(b), with no fitting.
+double rotated_rmsd(const rms::Coordinates &a, const rms::Coordinates &b, const std::vector<double> &weights,
+  const std::array<double, 9> &rotation) {
+  auto const centre = [&](const rms::Coordinates &c) {
+    std::array<double, 4> sum{};
+    for (std::size_t atom = 0; atom < c.size(); ++atom) {
+      double const w = weights.empty() ? 1.0 : weights[atom];
+      sum = {sum[0] + w * c.x[atom], sum[1] + w * c.y[atom], sum[2] + w * c.z[atom], sum[3] + w};
+    }
+    return std::array{sum[0] / sum[3], sum[1] / sum[3], sum[2] / sum[3], sum[3]};
+  };
+  auto const ca = centre(a);
+  auto const cb = centre(b);
+  double sum = 0.0;
+  for (std::size_t atom = 0; atom < a.size(); ++atom) {
+    std::array<double, 3> const pa = {a.x[atom] - ca[0], a.y[atom] - ca[1], a.z[atom] - ca[2]};
+    std::array<double, 3> const pb = {b.x[atom] - cb[0], b.y[atom] - cb[1], b.z[atom] - cb[2]};
+    for (std::size_t i = 0; i < 3; ++i) {
+      double const moved = rotation[3 * i] * pa[0] + rotation[3 * i + 1] * pa[1] + rotation[3 * i + 2] * pa[2];
+      sum += (weights.empty() ? 1.0 : weights[atom]) * (moved - pb[i]) * (moved - pb[i]);
+    }
+  }
+  return std::sqrt(sum / ca[3]);
+}
+
+} // namespace
+
+TEST_CASE("QCP RMSD matches a Kabsch superposition across SIMD tiers", "[rmsd][simd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 17, .waters = 1000};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const reference = rms::make_synthetic_coordinates(system).positions;
+
+  // The frame is the reference rotated, moved far off the origin and jittered.
+  std::mt19937_64 rng(17);
+  std::normal_distribution<double> jitter(0.0, 0.3);
+  double const angle = 0.7;
+  rms::Coordinates frame(reference.size());
+  for (std::size_t atom = 0; atom < reference.size(); ++atom) {
+    double const x = reference.x[atom];
+    double const y = reference.y[atom];
+    frame.x[atom] = std::cos(angle) * x - std::sin(angle) * y + 250.0 + jitter(rng);
+    frame.y[atom] = std::sin(angle) * x + std::cos(angle) * y - 120.0 + jitter(rng);
+    frame.z[atom] = reference.z[atom] + 75.0 + jitter(rng);
+  }
+  auto const frame_f = rms::to_float(frame);
+  auto const reference_f = rms::to_float(reference);
+  // The single-precision inputs, exactly, for the float kernels' expected values.
+  auto const widen = [](const rms::CoordinatesF &c) {
+    rms::Coordinates out(c.size());
+    std::ranges::copy(c.x, out.x.begin());
+    std::ranges::copy(c.y, out.y.begin());
+    std::ranges::copy(c.z, out.z.begin());
+    return out;
+  };
+
+  for (bool const mass_weighted : {false, true}) {
+    auto const weights =
+      mass_weighted ? std::vector<double>(topo.mass.begin(), topo.mass.end()) : std::vector<double>{};
+    double const expected = kabsch_rmsd(frame, reference, weights);
+    double const expected_f = kabsch_rmsd(widen(frame_f), widen(reference_f), weights);
+    REQUIRE(expected > 0.4);
+    REQUIRE(expected < 0.6);
+    for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+      auto const fit = mass_weighted ? rms::RmsdReference(reference, topo, level)
+                                     : rms::RmsdReference(reference, std::span<const double>{}, level);
+      REQUIRE(fit.weighted() == mass_weighted);
+      REQUIRE(fit.rmsd(frame) == Catch::Approx(expected).epsilon(1e-10));
+
+      // R maps the centred frame onto the centred reference.
+      std::array<double, 9> rotation{};
+      REQUIRE(fit.rmsd(frame, rotation) == Catch::Approx(expected).epsilon(1e-10));
+      REQUIRE(rotated_rmsd(frame, reference, weights, rotation) == Catch::Approx(expected).epsilon(1e-8));
+
+      // Single precision, summed in float lanes, stays close to the exact
+      // answer for its inputs even 250 A from the origin.
+      auto const fit_f = mass_weighted ? rms::RmsdReferenceF(reference_f, topo, level)
+                                       : rms::RmsdReferenceF(reference_f, std::span<const double>{}, level);
+      CAPTURE(fit_f.rmsd(frame_f) - expected_f);
+      REQUIRE(fit_f.rmsd(frame_f) == Catch::Approx(expected_f).epsilon(1e-7));
+      REQUIRE(fit_f.rmsd(reference_f) < 1e-5);
+    }
+  }
+
+  // A frame against itself, and one atom, give zero.
+  rms::RmsdReference const self(frame);
+  REQUIRE(self.rmsd(frame) < 1e-6);
+  rms::Coordinates one(1);
+  one.x[0] = 3.0;
+  REQUIRE(rms::RmsdReference(one).rmsd(one) == 0.0);
+
+  rms::Coordinates shorter(reference.size() - 1);
+  REQUIRE_THROWS_AS(rms::RmsdReference(reference).rmsd(shorter), std::invalid_argument);
+  std::vector<double> const few_weights(3, 1.0);
+  REQUIRE_THROWS_AS(rms::RmsdReference(reference, few_weights), std::invalid_argument);
+}
+
+TEST_CASE("Work-stealing loop visits every index once", "[parallel]") {
+  for (std::size_t const threads : {std::size_t{1}, std::size_t{3}, std::size_t{8}}) {
+    constexpr std::size_t kCount = 1000;
+    std::vector<std::atomic<int>> visits(kCount);
+    std::vector<std::atomic<int>> per_worker(8);
+    // Early indices are slow, so the other workers have to steal them.
+    rms::parallel_for_stealing(kCount, threads, [&](std::size_t worker, std::size_t idx) {
+      if (idx < 50) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+      ++visits[idx];
+      ++per_worker[worker];
+    });
+    REQUIRE(std::ranges::all_of(visits, [](auto const &count) { return count.load() == 1; }));
+    int total = 0;
+    for (std::size_t worker = 0; worker < per_worker.size(); ++worker) {
+      REQUIRE((worker < threads || per_worker[worker].load() == 0));
+      total += per_worker[worker].load();
+    }
+    REQUIRE(total == static_cast<int>(kCount));
+  }
+
+  REQUIRE_THROWS_AS(rms::parallel_for_stealing(100, 4,
+                      [](std::size_t, std::size_t idx) {
+                        if (idx == 42) {
+                          throw std::runtime_error("task failed");
+                        }
+                      }),
+    std::runtime_error);
+
+  // Both loops share one persistent pool; a loop started from inside a job
+  // runs inline rather than waiting for the job it is part of.
+  std::atomic<int> inner{0};
+  std::atomic<int> off_worker_zero{0};
+  for (int round = 0; round < 100; ++round) {
+    rms::parallel_for(8, 4, [&](std::size_t) {
+      rms::parallel_for_stealing(10, 4, [&](std::size_t worker, std::size_t) {
+        ++inner;
+        off_worker_zero += worker != 0 ? 1 : 0;
+      });
+    });
+  }
+  REQUIRE(inner.load() == 8000);
+  REQUIRE(off_worker_zero.load() == 0);
+}
+
+TEST_CASE("Trajectory RMSD matches per-frame fits, in frame order", "[rmsd][mdcrd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 17, .waters = 200};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const reference = rms::make_synthetic_coordinates(system).positions;
+  constexpr std::size_t kFrames = 90;
+
+  // Frame f is the reference turned by 0.02 f about z, shifted and jittered.
+  auto const dir = std::filesystem::temp_directory_path() / "rms_trajectory_rmsd_test";
+  std::filesystem::create_directories(dir);
+  auto const path = dir / "rotating.mdcrd";
+  {
+    std::mt19937_64 rng(5);
+    std::normal_distribution<double> jitter(0.0, 0.2);
+    std::string text = "rotating\n";
+    rms::MdcrdFrame frame{.positions = rms::Coordinates(reference.size()), .box = std::nullopt};
+    for (std::size_t idx = 0; idx < kFrames; ++idx) {
+      double const angle = 0.02 * static_cast<double>(idx);
+      for (std::size_t atom = 0; atom < reference.size(); ++atom) {
+        double const x = reference.x[atom];
+        double const y = reference.y[atom];
+        frame.positions.x[atom] = std::cos(angle) * x - std::sin(angle) * y + 5.0 + jitter(rng);
+        frame.positions.y[atom] = std::sin(angle) * x + std::cos(angle) * y + jitter(rng);
+        frame.positions.z[atom] = reference.z[atom] + jitter(rng);
+      }
+      rms::append_mdcrd_frame(text, frame);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+  }
+  rms::MdcrdTrajectory const trajectory(path, topo, rms::MdcrdOptions{.use_index_file = false});
+  rms::RmsdReference const fit(reference, topo);
+
+  std::vector<double> expected(kFrames);
+  trajectory.for_each_frame(0, kFrames,
+    [&](std::size_t idx, const rms::MdcrdFrame &frame) { expected[idx] = fit.rmsd(frame.positions); });
+  for (std::size_t const threads : {std::size_t{1}, std::size_t{4}}) {
+    auto const result = rms::trajectory_rmsd(trajectory, fit, rms::TrajectoryRmsdOptions{.threads = threads});
+    REQUIRE(result.rmsd == expected);
+    REQUIRE(result.fits.empty());
+  }
+
+  // Fitted frames sit on the reference: no further superposition helps.
+  auto const result =
+    rms::trajectory_rmsd(trajectory, fit, rms::TrajectoryRmsdOptions{.threads = 4, .keep_fits = true});
+  REQUIRE(result.rmsd == expected);
+  auto const fitted_path = dir / "fitted.mdcrd";
+  rms::write_fitted_mdcrd(fitted_path, trajectory, fit, result.fits, 4);
+  rms::MdcrdTrajectory const fitted(fitted_path, topo, rms::MdcrdOptions{.use_index_file = false});
+  REQUIRE(fitted.title() == "rotating");
+  REQUIRE(fitted.frame_count() == kFrames);
+  fitted.for_each_frame(0, kFrames, [&](std::size_t idx, const rms::MdcrdFrame &frame) {
+    auto const refit = fit.fit(frame.positions);
+    REQUIRE(refit.rmsd == Catch::Approx(expected[idx]).margin(1e-3));
+    for (std::size_t i = 0; i < 3; ++i) {
+      REQUIRE(refit.centroid[i] == Catch::Approx(fit.centroid()[i]).margin(1e-3));
+      REQUIRE(refit.rotation[4 * i] == Catch::Approx(1.0).margin(1e-4));
+    }
+  });
+
+  // A mask fits on the gathered atoms of every frame.
+  auto const solute = rms::compile_mask(":1", topo);
+  rms::RmsdReference const solute_fit(rms::gather(reference, solute.indices()));
+  auto const masked = rms::trajectory_rmsd(
+    trajectory, solute_fit, rms::TrajectoryRmsdOptions{.threads = 4, .atoms = solute.indices()});
+  trajectory.for_each_frame(0, kFrames, [&](std::size_t idx, const rms::MdcrdFrame &frame) {
+    REQUIRE(masked.rmsd[idx] == solute_fit.rmsd(rms::gather(frame.positions, solute.indices())));
+  });
+  REQUIRE_THROWS_AS(rms::trajectory_rmsd(trajectory, fit, rms::TrajectoryRmsdOptions{.atoms = solute.indices()}),
+    std::invalid_argument);
+
+  rms::Coordinates const shorter(reference.size() - 1);
+  REQUIRE_THROWS_AS(rms::trajectory_rmsd(trajectory, rms::RmsdReference(shorter)), std::invalid_argument);
+  REQUIRE_THROWS_AS(
+    rms::write_fitted_mdcrd(fitted_path, trajectory, fit, std::span(result.fits).first(3)), std::invalid_argument);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Pairwise RMSD matrix matches per-pair fits", "[rmsd][pairwise]") {
+  rms::SyntheticSystem const system{.solute_atoms = 21, .waters = 40};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto const start = rms::make_synthetic_coordinates(system).positions;
+  constexpr std::size_t kFrames = 37;
+
+  // Frames wander off the start structure by a random walk, with rigid moves.
+  auto const dir = std::filesystem::temp_directory_path() / "rms_pairwise_test";
+  std::filesystem::create_directories(dir);
+  auto const path = dir / "walk.mdcrd";
+  {
+    std::mt19937_64 rng(19);
+    std::normal_distribution<double> step(0.0, 0.05);
+    std::string text = "walk\n";
+    rms::MdcrdFrame frame{.positions = start, .box = std::nullopt};
+    auto walk = start;
+    for (std::size_t idx = 0; idx < kFrames; ++idx) {
+      double const angle = 0.1 * static_cast<double>(idx);
+      for (std::size_t atom = 0; atom < walk.size(); ++atom) {
+        walk.x[atom] += step(rng);
+        walk.y[atom] += step(rng);
+        walk.z[atom] += step(rng);
+        frame.positions.x[atom] = std::cos(angle) * walk.x[atom] + std::sin(angle) * walk.z[atom] - 3.0;
+        frame.positions.y[atom] = walk.y[atom] + static_cast<double>(idx);
+        frame.positions.z[atom] = -std::sin(angle) * walk.x[atom] + std::cos(angle) * walk.z[atom];
+      }
+      rms::append_mdcrd_frame(text, frame);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+  }
+  rms::MdcrdTrajectory const trajectory(path, topo, rms::MdcrdOptions{.use_index_file = false});
+  std::vector<rms::Coordinates> decoded;
+  trajectory.for_each_frame(
+    0, kFrames, [&](std::size_t, const rms::MdcrdFrame &frame) { decoded.push_back(frame.positions); });
+
+  auto const matrix_path = dir / "walk.rmsmat";
+  for (bool const mass_weighted : {false, true}) {
+    auto const weights = mass_weighted ? std::span<const double>(topo.mass) : std::span<const double>{};
+    rms::PackedFrames const frames(trajectory, weights, 4);
+    REQUIRE(frames.frame_count() == kFrames);
+    REQUIRE(frames.stride() % rms::kPackedFrameAlign == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(frames.frame(1)) % rms::kCacheLineSize == 0);
+
+    std::vector<double> expected(kFrames * kFrames, 0.0);
+    for (std::size_t i = 0; i < kFrames; ++i) {
+      rms::RmsdReference const reference(decoded[i], weights);
+      for (std::size_t j = 0; j < kFrames; ++j) {
+        expected[i * kFrames + j] = reference.rmsd(decoded[j]);
+      }
+    }
+
+    for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+      for (std::size_t const block : {std::size_t{0}, std::size_t{1}, std::size_t{7}}) {
+        rms::write_pairwise_rmsd(
+          matrix_path, frames, rms::PairwiseRmsdOptions{.threads = 4, .block_frames = block, .level = level});
+        rms::RmsdMatrix const matrix(matrix_path);
+        REQUIRE(matrix.size() == kFrames);
+        REQUIRE(matrix.natom() == trajectory.natom());
+        REQUIRE(matrix.weighted() == mass_weighted);
+        REQUIRE(matrix.condensed().size() == kFrames * (kFrames - 1) / 2);
+        for (std::size_t i = 0; i < kFrames; ++i) {
+          REQUIRE(matrix(i, i) == 0.0F);
+          for (std::size_t j = i + 1; j < kFrames; ++j) {
+            REQUIRE(matrix(i, j) == matrix(j, i));
+            REQUIRE(matrix(i, j) == Catch::Approx(expected[i * kFrames + j]).margin(1e-4));
+          }
+        }
+      }
+    }
+  }
+
+  // Masked frames keep only the selected atoms.
+  auto const oxygens = rms::compile_mask("@O", topo);
+  rms::PackedFrames const masked(trajectory, {}, 4, oxygens.indices());
+  REQUIRE(masked.natom() == oxygens.size());
+  for (std::size_t const j : {std::size_t{1}, std::size_t{20}, kFrames - 1}) {
+    rms::RmsdReference const reference(rms::gather(decoded[0], oxygens.indices()));
+    auto const expected = reference.rmsd(rms::gather(decoded[j], oxygens.indices()));
+    REQUIRE(masked.rmsd(0, j) == Catch::Approx(expected).margin(1e-4));
+  }
+
+  // Damaged headers and truncated files are rejected.
+  {
+    std::fstream file(matrix_path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(0);
+    file << "NOTAMTRX";
+  }
+  REQUIRE_THROWS_AS(rms::RmsdMatrix(matrix_path), std::runtime_error);
+  rms::write_pairwise_rmsd(matrix_path, rms::PackedFrames(trajectory));
+  std::filesystem::resize_file(matrix_path, std::filesystem::file_size(matrix_path) - 4);
+  REQUIRE_THROWS_AS(rms::RmsdMatrix(matrix_path), std::runtime_error);
+  std::vector<double> const few_weights(3, 1.0);
+  REQUIRE_THROWS_AS(rms::PackedFrames(trajectory, few_weights), std::invalid_argument);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Amber masks select the same atoms as a per-atom match", "[parm7][mask]") {
+  rms::SyntheticSystem const system{.solute_atoms = 150, .waters = 300};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  rms::ResidueIndex const residues(topo);
+  auto const natom = static_cast<std::size_t>(topo.pointers.natom);
+
+  // Reference matcher: a plain recursive glob over the trimmed strings.
+  std::function<bool(std::string_view, std::string_view)> glob = [&](std::string_view text, std::string_view pattern) {
+    if (pattern.empty()) {
+      return text.empty();
+    }
+    if (pattern.front() == '*') {
+      return glob(text, pattern.substr(1)) || (!text.empty() && glob(text.substr(1), pattern));
+    }
+    return !text.empty() && (pattern.front() == '?' || pattern.front() == text.front())
+           && glob(text.substr(1), pattern.substr(1));
+  };
+  auto const atom_name = [&](std::size_t atom) { return topo.atom_name[atom].view(); };
+  // Interned names come back by value, so these return owning strings.
+  auto const residue_name = [&](std::size_t atom) {
+    return std::string(
+      topo.residue_label[static_cast<std::size_t>(residues.residue_of(static_cast<int>(atom)))].view());
+  };
+  auto const residue_number = [&](std::size_t atom) { return residues.residue_of(static_cast<int>(atom)) + 1; };
+  auto const type_name = [&](std::size_t atom) { return std::string(topo.amber_atom_type[atom].view()); };
+
+  struct Case {
+    std::string_view mask;
+    std::function<bool(std::size_t)> expected;
+  };
+  std::vector<Case> const cases = {
+    {"*", [](std::size_t) { return true; }},
+    {":1", [&](std::size_t a) { return residue_number(a) == 1; }},
+    {":2-5,300",
+      [&](std::size_t a) {
+        return (residue_number(a) >= 2 && residue_number(a) <= 5) || residue_number(a) == 300;
+      }},
+    {":WAT", [&](std::size_t a) { return residue_name(a) == "WAT"; }},
+    {":L*", [&](std::size_t a) { return glob(residue_name(a), "L*"); }},
+    {":?A?@O", [&](std::size_t a) { return glob(residue_name(a), "?A?") && atom_name(a) == "O"; }},
+    {"@1-10,149-152", [](std::size_t a) { return a < 10 || (a >= 148 && a < 152); }},
+    {"@C1?", [&](std::size_t a) { return glob(atom_name(a), "C1?"); }},
+    {"@C*", [&](std::size_t a) { return glob(atom_name(a), "C*"); }},
+    {"@*1", [&](std::size_t a) { return glob(atom_name(a), "*1"); }},
+    {"@H?,O", [&](std::size_t a) { return glob(atom_name(a), "H?") || atom_name(a) == "O"; }},
+    {"@%HW", [&](std::size_t a) { return type_name(a) == "HW"; }},
+    {"@%?T", [&](std::size_t a) { return glob(type_name(a), "?T"); }},
+    {"@/O,H", [&](std::size_t a) { return topo.atomic_number[a] == 8 || topo.atomic_number[a] == 1; }},
+    {"!:WAT", [&](std::size_t a) { return residue_name(a) != "WAT"; }},
+    {":WAT & !@O", [&](std::size_t a) { return residue_name(a) == "WAT" && atom_name(a) != "O"; }},
+    {"@C5* | :10 & @H1", [&](std::size_t a) {
+       return glob(atom_name(a), "C5*") || (residue_number(a) == 10 && atom_name(a) == "H1");
+     }},
+    {"!(:1 | @O)", [&](std::size_t a) { return residue_number(a) != 1 && atom_name(a) != "O"; }},
+    {"@NOPE", [](std::size_t) { return false; }},
+  };
+  for (auto const &item : cases) {
+    INFO(item.mask);
+    auto const selection = rms::compile_mask(item.mask, topo);
+    REQUIRE(selection.natom() == natom);
+    std::vector<int> expected;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      REQUIRE(selection.contains(atom) == item.expected(atom));
+      if (item.expected(atom)) {
+        expected.push_back(static_cast<int>(atom));
+      }
+    }
+    REQUIRE(std::ranges::equal(selection.indices(), expected));
+  }
+  REQUIRE(rms::compile_mask("*", topo) == rms::AtomSelection::all(natom));
+
+  // Gathers follow the index list.
+  auto const oxygens = rms::compile_mask(":WAT@O", topo);
+  REQUIRE(oxygens.size() == system.waters);
+  auto const masses = oxygens.gather(std::span<const double>(topo.mass));
+  REQUIRE(std::ranges::all_of(masses, [](double mass) { return mass == 16.0; }));
+  auto const positions = rms::make_synthetic_coordinates(system).positions;
+  auto const picked = rms::gather(positions, oxygens.indices());
+  REQUIRE(picked.size() == system.waters);
+  REQUIRE(picked.x[7] == positions.x[static_cast<std::size_t>(oxygens.indices()[7])]);
+
+  for (std::string_view const bad : {"", ":", "@", ":1-", ":5-2", "@0", "(:1", ":1)", ":1 :2", "@/Xx", "@CA <:5.0",
+         ":1 &", "#"}) {
+    INFO(bad);
+    REQUIRE_THROWS_AS(rms::compile_mask(bad, topo), std::invalid_argument);
+  }
+  auto const names_only = rms::section_bit(rms::Parm7Section::Pointers) | rms::section_bit(rms::Parm7Section::AtomName);
+  auto const bare =
+    rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), rms::Parm7ParseOptions{.sections = names_only});
+  REQUIRE(rms::compile_mask("@O", bare) == rms::compile_mask("@O", topo));
+  REQUIRE_THROWS_AS(rms::compile_mask("@%CT", bare), std::runtime_error);
+  REQUIRE_THROWS_AS(rms::compile_mask(":WAT", bare), std::runtime_error);
+}
+
+TEST_CASE("Verlet list finds every pair in range, through periodic images", "[neighbors]") {
+  using Pairs = std::vector<std::pair<int, int>>;
+  // All-pairs reference through the box's minimum image.
+  auto const brute = [](const rms::Coordinates &positions, const std::optional<rms::PeriodicBox> &box, double cutoff,
+                       const rms::ExclusionList *exclusions) {
+    Pairs pairs;
+    auto const natom = static_cast<int>(positions.size());
+    for (int i = 0; i < natom; ++i) {
+      for (int j = i + 1; j < natom; ++j) {
+        auto const a = static_cast<std::size_t>(i);
+        auto const b = static_cast<std::size_t>(j);
+        rms::Vec3 d{positions.x[b] - positions.x[a], positions.y[b] - positions.y[a], positions.z[b] - positions.z[a]};
+        if (box) {
+          d = box->minimum_image(d);
+        }
+        if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] < cutoff * cutoff
+            && (exclusions == nullptr || !exclusions->excluded(i, j))) {
+          pairs.emplace_back(i, j);
+        }
+      }
+    }
+    return pairs;
+  };
+  // Listed pairs within the cutoff; each displacement must be the minimum image.
+  auto const listed = [](const rms::VerletList &list, const rms::Coordinates &positions) {
+    Pairs pairs;
+    list.for_each_pair(positions, [&](int i, int j, double dx, double dy, double dz, double r2) {
+      auto const a = static_cast<std::size_t>(i);
+      auto const b = static_cast<std::size_t>(j);
+      rms::Vec3 d{positions.x[b] - positions.x[a], positions.y[b] - positions.y[a], positions.z[b] - positions.z[a]};
+      if (list.box()) {
+        d = list.box()->minimum_image(d);
+      }
+      REQUIRE(dx == Catch::Approx(d[0]).margin(1e-9));
+      REQUIRE(dy == Catch::Approx(d[1]).margin(1e-9));
+      REQUIRE(dz == Catch::Approx(d[2]).margin(1e-9));
+      REQUIRE(r2 == Catch::Approx(dx * dx + dy * dy + dz * dz));
+      pairs.emplace_back(std::min(i, j), std::max(i, j));
+    });
+    std::ranges::sort(pairs);
+    REQUIRE(std::ranges::adjacent_find(pairs) == pairs.end());
+    return pairs;
+  };
+
+  SECTION("orthorhombic water box with topology exclusions") {
+    rms::SyntheticSystem const system{.solute_atoms = 40, .waters = 600};
+    auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+    rms::ExclusionList const exclusions(topo);
+    auto const box = rms::PeriodicBox::from_topology(topo);
+    REQUIRE(box);
+    REQUIRE(box->orthorhombic());
+    // Jittered, with some atoms moved by whole box vectors out of the cell.
+    auto positions = rms::make_synthetic_coordinates(system).positions;
+    std::mt19937_64 rng(3);
+    std::normal_distribution<double> jitter(0.0, 0.3);
+    for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+      auto const image = static_cast<double>(static_cast<int>(atom % 5) - 2);
+      positions.x[atom] += jitter(rng) + image * box->vectors()[0][0];
+      positions.y[atom] += jitter(rng);
+      positions.z[atom] += jitter(rng) - image * box->vectors()[2][2];
+    }
+    auto const expected = brute(positions, box, 7.0, &exclusions);
+    REQUIRE(expected.size() > 10000);
+
+    rms::VerletList serial(rms::NeighborOptions{.cutoff = 7.0, .skin = 1.5, .threads = 1}, &exclusions);
+    rms::VerletList parallel(rms::NeighborOptions{.cutoff = 7.0, .skin = 1.5, .threads = 4}, &exclusions);
+    REQUIRE(serial.update(positions, box));
+    REQUIRE(parallel.update(positions, box));
+    REQUIRE(listed(serial, positions) == expected);
+    REQUIRE(std::ranges::equal(serial.offsets(), parallel.offsets()));
+    REQUIRE(std::ranges::equal(serial.partners(), parallel.partners()));
+    REQUIRE(std::ranges::equal(serial.shifts(), parallel.shifts()));
+
+    // Within half the skin nothing is rebuilt and the list still holds every pair.
+    std::uniform_real_distribution<double> nudge(-0.4, 0.4);
+    auto moved = positions;
+    for (std::size_t atom = 0; atom < moved.size(); ++atom) {
+      moved.x[atom] += nudge(rng);
+      moved.y[atom] += nudge(rng);
+    }
+    REQUIRE_FALSE(serial.update(moved, box));
+    REQUIRE(serial.rebuild_count() == 1);
+    REQUIRE(listed(serial, moved) == brute(moved, box, 7.0, &exclusions));
+    moved.z[17] += 0.8;
+    REQUIRE(serial.update(moved, box));
+    REQUIRE(serial.rebuild_count() == 2);
+    REQUIRE(listed(serial, moved) == brute(moved, box, 7.0, &exclusions));
+
+    auto params = box->parameters();
+    params[0] += 0.1;
+    REQUIRE(serial.update(moved, rms::PeriodicBox(params)));
+    rms::VerletList too_long(rms::NeighborOptions{.cutoff = box->max_cutoff(), .skin = 0.5});
+    REQUIRE_THROWS_AS(too_long.rebuild(positions, box), std::invalid_argument);
+    rms::Coordinates const fewer(positions.size() - 1);
+    REQUIRE_THROWS_AS(serial.rebuild(fewer, box), std::invalid_argument);
+  }
+
+  SECTION("truncated octahedron") {
+    rms::PeriodicBox const box({30.0, 30.0, 30.0, 109.4712206, 109.4712206, 109.4712206});
+    REQUIRE_FALSE(box.orthorhombic());
+    REQUIRE(box.max_cutoff() == Catch::Approx(15.0));
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> fraction(-0.5, 1.5);
+    rms::Coordinates positions(900);
+    for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+      auto const r = box.cartesian({fraction(rng), fraction(rng), fraction(rng)});
+      positions.x[atom] = r[0];
+      positions.y[atom] = r[1];
+      positions.z[atom] = r[2];
+    }
+    for (double const cutoff : {4.0, 9.0, 14.0}) {
+      rms::VerletList list(rms::NeighborOptions{.cutoff = cutoff, .skin = 1.0, .threads = 4});
+      list.rebuild(positions, box);
+      REQUIRE(listed(list, positions) == brute(positions, box, cutoff, nullptr));
+    }
+  }
+
+  SECTION("no box") {
+    std::mt19937_64 rng(9);
+    std::uniform_real_distribution<double> coordinate(-20.0, 20.0);
+    rms::Coordinates positions(700);
+    for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+      positions.x[atom] = coordinate(rng);
+      positions.y[atom] = coordinate(rng);
+      positions.z[atom] = 0.25 * coordinate(rng);
+    }
+    rms::VerletList list(rms::NeighborOptions{.cutoff = 6.0, .skin = 2.0, .threads = 4});
+    list.rebuild(positions, std::nullopt);
+    REQUIRE(list.shift_vectors().size() == 1);
+    REQUIRE(listed(list, positions) == brute(positions, std::nullopt, 6.0, nullptr));
+    list.rebuild(rms::Coordinates{}, std::nullopt);
+    REQUIRE(list.pair_count() == 0);
+  }
+
+  REQUIRE_THROWS_AS(rms::PeriodicBox({10.0, 10.0, 10.0, 90.0, 90.0, 0.0}), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::PeriodicBox({10.0, 10.0, 10.0, 60.0, 60.0, 150.0}), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::PeriodicBox({-1.0, 10.0, 10.0, 90.0, 90.0, 90.0}), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::VerletList(rms::NeighborOptions{.cutoff = 0.0}), std::invalid_argument);
+}
+
+TEST_CASE("Nonbonded energies and forces match an all-pairs sum", "[nonbonded][simd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 40, .waters = 400};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  rms::ExclusionList const exclusions(topo);
+  rms::LJTable const lj(topo);
+  auto positions = rms::make_synthetic_coordinates(system).positions;
+  std::mt19937_64 rng(5);
+  std::normal_distribution<double> jitter(0.0, 0.2);
+  for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+    positions.x[atom] += jitter(rng);
+    positions.y[atom] += jitter(rng);
+    positions.z[atom] += jitter(rng);
+  }
+  auto const natom = positions.size();
+
+  // Every unexcluded pair through the minimum image, then each 1-4 pair of an
+  // unflagged dihedral once.
+  auto const reference = [&](const rms::Coordinates &at, const std::optional<rms::PeriodicBox> &box, double cutoff,
+                           rms::Coordinates &forces, const rms::AtomSelection *scored = nullptr) {
+    rms::NonbondedEnergy energy;
+    forces = rms::Coordinates(natom);
+    auto const add = [&](std::size_t i, std::size_t j, rms::Vec3 d, double scee, double scnb, bool one_four) {
+      if (scored != nullptr && (!scored->contains(i) || !scored->contains(j))) {
+        return;
+      }
+      double const r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+      auto const [a, b] = lj.pair(topo.atom_type_index[i], topo.atom_type_index[j]);
+      double const r6 = r2 * r2 * r2;
+      double const vdw = (a / (r6 * r6) - b / r6) / scnb;
+      double const elec = topo.charge[i] * topo.charge[j] / std::sqrt(r2) / scee;
+      (one_four ? energy.vdw14 : energy.vdw) += vdw;
+      (one_four ? energy.elec14 : energy.elec) += elec;
+      double const f = (12.0 * a / (r6 * r6) / scnb - 6.0 * b / r6 / scnb + elec) / r2;
+      for (std::size_t axis = 0; axis < 3; ++axis) {
+        auto &component = axis == 0 ? forces.x : (axis == 1 ? forces.y : forces.z);
+        component[i] -= f * d[axis];
+        component[j] += f * d[axis];
+      }
+    };
+    auto const displacement = [&](std::size_t i, std::size_t j) {
+      rms::Vec3 const d{at.x[j] - at.x[i], at.y[j] - at.y[i], at.z[j] - at.z[i]};
+      return box ? box->minimum_image(d) : d;
+    };
+    for (std::size_t i = 0; i < natom; ++i) {
+      for (std::size_t j = i + 1; j < natom; ++j) {
+        auto const d = displacement(i, j);
+        if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] < cutoff * cutoff
+            && !exclusions.excluded(static_cast<int>(i), static_cast<int>(j))) {
+          add(i, j, d, 1.0, 1.0, false);
+        }
+      }
+    }
+    std::vector<std::pair<int, int>> seen;
+    for (std::size_t dihedral = 0; dihedral < topo.dihedral_i.size(); ++dihedral) {
+      std::pair<int, int> const pair = std::minmax(topo.dihedral_i[dihedral], topo.dihedral_l[dihedral]);
+      if ((topo.dihedral_flags[dihedral] & 0x1U) != 0 || std::ranges::find(seen, pair) != seen.end()) {
+        continue;
+      }
+      seen.emplace_back(pair);
+      auto const type = static_cast<std::size_t>(topo.dihedral_type[dihedral]);
+      auto const i = static_cast<std::size_t>(pair.first);
+      auto const j = static_cast<std::size_t>(pair.second);
+      add(i, j, displacement(i, j), topo.scee_scale_factor[type], topo.scnb_scale_factor[type], true);
+    }
+    return energy;
+  };
+  auto const same_forces = [](const rms::Coordinates &lhs, const rms::Coordinates &rhs) {
+    REQUIRE(lhs.size() == rhs.size());
+    for (std::size_t atom = 0; atom < lhs.size(); ++atom) {
+      REQUIRE(lhs.x[atom] == Catch::Approx(rhs.x[atom]).margin(1e-8));
+      REQUIRE(lhs.y[atom] == Catch::Approx(rhs.y[atom]).margin(1e-8));
+      REQUIRE(lhs.z[atom] == Catch::Approx(rhs.z[atom]).margin(1e-8));
+    }
+  };
+  auto const same_energy = [](const rms::NonbondedEnergy &lhs, const rms::NonbondedEnergy &rhs) {
+    REQUIRE(lhs.vdw == Catch::Approx(rhs.vdw).epsilon(1e-11));
+    REQUIRE(lhs.elec == Catch::Approx(rhs.elec).epsilon(1e-11));
+    REQUIRE(lhs.vdw14 == Catch::Approx(rhs.vdw14).epsilon(1e-11));
+    REQUIRE(lhs.elec14 == Catch::Approx(rhs.elec14).epsilon(1e-11));
+  };
+
+  // Dihedrals 1, 4, 7, ... carry the suppress-1-4 flag.
+  rms::NonbondedEngine probe(topo);
+  auto const dihedrals = system.solute_atoms - 3;
+  REQUIRE(probe.one_four_pairs().size() == dihedrals - (dihedrals + 1) / 3);
+  REQUIRE(probe.one_four_pairs().scee()[0] == Catch::Approx(1.2));
+  REQUIRE(probe.one_four_pairs().scnb()[0] == Catch::Approx(2.0));
+
+  SECTION("periodic box, every SIMD tier and thread count") {
+    auto const box = rms::PeriodicBox::from_topology(topo);
+    REQUIRE(box);
+    double const cutoff = std::min(8.0, box->max_cutoff() - 1.0);
+    rms::Coordinates expected_forces;
+    auto const expected = reference(positions, box, cutoff, expected_forces);
+    REQUIRE(expected.vdw > 0.0);
+    REQUIRE(expected.elec != 0.0);
+    REQUIRE(expected.elec14 != 0.0);
+    for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+      if (level > rms::detected_simd_level()) {
+        break;
+      }
+      for (std::size_t const threads : {std::size_t{1}, std::size_t{4}}) {
+        rms::NonbondedEngine engine(
+          topo, rms::NonbondedOptions{.cutoff = cutoff, .skin = 1.0, .threads = threads, .level = level});
+        same_energy(engine.evaluate(positions, box), expected);
+        rms::Coordinates forces;
+        auto const with_forces = engine.evaluate(positions, box, &forces);
+        same_energy(with_forces, expected);
+        same_forces(forces, expected_forces);
+        // Reproducible bit for bit at a fixed thread count.
+        rms::Coordinates again;
+        auto const repeat = engine.evaluate(positions, box, &again);
+        REQUIRE(repeat.total() == with_forces.total());
+        REQUIRE(again == forces);
+        REQUIRE(engine.neighbors().rebuild_count() == 1);
+      }
+    }
+  }
+
+  SECTION("vacuum forces are the energy gradient") {
+    rms::NonbondedEngine engine(topo, rms::NonbondedOptions{.cutoff = 200.0, .skin = 0.0, .threads = 2});
+    rms::Coordinates expected_forces;
+    auto const expected = reference(positions, std::nullopt, 200.0, expected_forces);
+    rms::Coordinates forces;
+    same_energy(engine.evaluate(positions, std::nullopt, &forces), expected);
+    same_forces(forces, expected_forces);
+    double const h = 1e-5;
+    for (std::size_t const atom : {std::size_t{3}, std::size_t{20}, std::size_t{41}, natom - 1}) {
+      auto shifted = positions;
+      shifted.y[atom] += h;
+      double const up = engine.evaluate(shifted, std::nullopt).total();
+      shifted.y[atom] -= 2.0 * h;
+      double const down = engine.evaluate(shifted, std::nullopt).total();
+      REQUIRE(-(up - down) / (2.0 * h) == Catch::Approx(forces.y[atom]).epsilon(1e-5).margin(1e-5));
+    }
+  }
+
+  SECTION("a selection scores only the pairs inside it") {
+    auto const box = rms::PeriodicBox::from_topology(topo);
+    double const cutoff = std::min(8.0, box->max_cutoff() - 1.0);
+    rms::NonbondedOptions const options{.cutoff = cutoff, .skin = 1.0, .threads = 3};
+    // Partial solutes and waters leave 1-4 and excluded pairs straddling
+    // the selection's edge.
+    for (auto const *mask : {"!:WAT", ":WAT", "!:WAT | :WAT@O", "@1-10,30-35"}) {
+      auto const selection = rms::compile_mask(mask, topo);
+      rms::Coordinates expected_forces;
+      auto const expected = reference(positions, box, cutoff, expected_forces, &selection);
+      rms::NonbondedEngine engine(topo, selection, options);
+      rms::Coordinates forces;
+      same_energy(engine.evaluate(positions, box, &forces), expected);
+      same_forces(forces, expected_forces);
+    }
+    rms::NonbondedEngine every(topo, rms::AtomSelection::all(natom), options);
+    rms::NonbondedEngine whole(topo, options);
+    REQUIRE(every.evaluate(positions, box).total() == whole.evaluate(positions, box).total());
+  }
+
+  REQUIRE_THROWS_AS(probe.evaluate(rms::Coordinates(natom - 1), std::nullopt), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::NonbondedEngine(topo, rms::AtomSelection::all(natom + 1)), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::NonbondedEngine(topo, rms::NonbondedOptions{.skin = -1.0}), std::invalid_argument);
+  rms::Parm7ParseOptions partial;
+  partial.sections = rms::kAllParm7Sections & ~rms::section_bit(rms::Parm7Section::Charge);
+  REQUIRE_THROWS_AS(rms::NonbondedEngine(rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), partial)),
+    std::runtime_error);
+  partial.sections = rms::kAllParm7Sections
+                   & ~rms::section_mask(
+                     {rms::Parm7Section::DihedralsIncHydrogen, rms::Parm7Section::DihedralsWithoutHydrogen});
+  REQUIRE_THROWS_AS(rms::NonbondedEngine(rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), partial)),
+    std::runtime_error);
+}
+
+TEST_CASE("Bonded energies and forces match a per-term reference", "[bonded][simd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 203, .waters = 50};
+  auto topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  // Phases away from 0 and pi, so the sign of phi matters.
+  topo.dihedral_phase[0] = 0.7;
+  topo.dihedral_phase[1] = 2.1;
+  auto positions = rms::make_synthetic_coordinates(system).positions;
+  std::mt19937_64 rng(11);
+  std::normal_distribution<double> jitter(0.0, 0.3);
+  for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+    positions.x[atom] += jitter(rng);
+    positions.y[atom] += jitter(rng);
+    positions.z[atom] += jitter(rng);
+  }
+  auto const natom = positions.size();
+
+  // Textbook forms: acos for the angle, atan2 of the IUPAC vectors for phi.
+  auto const reference = [](const rms::Parm7Topology &t, const rms::Coordinates &at) {
+    rms::BondedEnergy energy;
+    auto const sub = [&](int a, int b) {
+      auto const i = static_cast<std::size_t>(a);
+      auto const j = static_cast<std::size_t>(b);
+      return rms::Vec3{at.x[i] - at.x[j], at.y[i] - at.y[j], at.z[i] - at.z[j]};
+    };
+    auto const dot = [](const rms::Vec3 &a, const rms::Vec3 &b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+    auto const cross = [](const rms::Vec3 &a, const rms::Vec3 &b) {
+      return rms::Vec3{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    };
+    for (std::size_t n = 0; n < t.bond_i.size(); ++n) {
+      auto const type = static_cast<std::size_t>(t.bond_type[n]);
+      auto const d = sub(t.bond_j[n], t.bond_i[n]);
+      double const dr = std::sqrt(dot(d, d)) - t.bond_equil_value[type];
+      energy.bond += t.bond_force_constant[type] * dr * dr;
+    }
+    for (std::size_t n = 0; n < t.angle_i.size(); ++n) {
+      auto const type = static_cast<std::size_t>(t.angle_type[n]);
+      auto const u = sub(t.angle_i[n], t.angle_j[n]);
+      auto const v = sub(t.angle_k[n], t.angle_j[n]);
+      double const theta = std::acos(std::clamp(dot(u, v) / std::sqrt(dot(u, u) * dot(v, v)), -1.0, 1.0));
+      double const dt = theta - t.angle_equil_value[type];
+      energy.angle += t.angle_force_constant[type] * dt * dt;
+    }
+    for (std::size_t n = 0; n < t.dihedral_i.size(); ++n) {
+      auto const type = static_cast<std::size_t>(t.dihedral_type[n]);
+      auto const b1 = sub(t.dihedral_j[n], t.dihedral_i[n]);
+      auto const b2 = sub(t.dihedral_k[n], t.dihedral_j[n]);
+      auto const b3 = sub(t.dihedral_l[n], t.dihedral_k[n]);
+      auto const n1 = cross(b1, b2);
+      auto const n2 = cross(b2, b3);
+      double const phi = std::atan2(std::sqrt(dot(b2, b2)) * dot(b1, n2), dot(n1, n2));
+      double const e = t.dihedral_force_constant[type]
+                     * (1.0 + std::cos(t.dihedral_periodicity[type] * phi - t.dihedral_phase[type]));
+      ((t.dihedral_flags[n] & 0x2U) != 0 ? energy.improper : energy.dihedral) += e;
+    }
+    return energy;
+  };
+  // Forces as central differences of the reference energy.
+  auto const reference_forces = [&](const rms::Parm7Topology &t, const rms::Coordinates &at) {
+    double const h = 1e-6;
+    rms::Coordinates forces(natom);
+    auto shifted = at;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      for (auto *component : {&shifted.x, &shifted.y, &shifted.z}) {
+        double const saved = (*component)[atom];
+        (*component)[atom] = saved + h;
+        double const up = reference(t, shifted).total();
+        (*component)[atom] = saved - h;
+        double const down = reference(t, shifted).total();
+        (*component)[atom] = saved;
+        auto &out = component == &shifted.x ? forces.x : (component == &shifted.y ? forces.y : forces.z);
+        out[atom] = -(up - down) / (2.0 * h);
+      }
+    }
+    return forces;
+  };
+  auto const same_energy = [](const rms::BondedEnergy &lhs, const rms::BondedEnergy &rhs) {
+    REQUIRE(lhs.bond == Catch::Approx(rhs.bond).epsilon(1e-10));
+    REQUIRE(lhs.angle == Catch::Approx(rhs.angle).epsilon(1e-10));
+    REQUIRE(lhs.dihedral == Catch::Approx(rhs.dihedral).epsilon(1e-10));
+    REQUIRE(lhs.improper == Catch::Approx(rhs.improper).epsilon(1e-10));
+  };
+  auto const same_forces = [](const rms::Coordinates &lhs, const rms::Coordinates &rhs) {
+    REQUIRE(lhs.size() == rhs.size());
+    for (std::size_t atom = 0; atom < lhs.size(); ++atom) {
+      REQUIRE(lhs.x[atom] == Catch::Approx(rhs.x[atom]).epsilon(1e-5).margin(1e-4));
+      REQUIRE(lhs.y[atom] == Catch::Approx(rhs.y[atom]).epsilon(1e-5).margin(1e-4));
+      REQUIRE(lhs.z[atom] == Catch::Approx(rhs.z[atom]).epsilon(1e-5).margin(1e-4));
+    }
+  };
+  // Every batch is atom-disjoint and the batches cover each term once.
+  auto const check_batches = [](std::span<const std::size_t> batches, const std::vector<int> &atoms,
+                               std::size_t arity, std::size_t count) {
+    REQUIRE(batches.front() == 0);
+    REQUIRE(batches.back() == count);
+    REQUIRE(atoms.size() == arity * count);
+    for (std::size_t batch = 0; batch + 1 < batches.size(); ++batch) {
+      REQUIRE(batches[batch] < batches[batch + 1]);
+      std::vector<int> seen(atoms.begin() + static_cast<std::ptrdiff_t>(arity * batches[batch]),
+        atoms.begin() + static_cast<std::ptrdiff_t>(arity * batches[batch + 1]));
+      std::ranges::sort(seen);
+      REQUIRE(std::ranges::adjacent_find(seen) == seen.end());
+    }
+  };
+
+  auto const expected = reference(topo, positions);
+  auto const expected_forces = reference_forces(topo, positions);
+  REQUIRE(expected.bond > 0.0);
+  REQUIRE(expected.angle > 0.0);
+  REQUIRE(expected.dihedral > 0.0);
+  REQUIRE(expected.improper > 0.0);
+
+  SECTION("every SIMD tier and thread count") {
+    for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+      if (level > rms::detected_simd_level()) {
+        break;
+      }
+      rms::Coordinates serial;
+      for (std::size_t const threads : {std::size_t{1}, std::size_t{4}}) {
+        rms::BondedEngine const engine(topo, rms::BondedOptions{.threads = threads, .level = level});
+        REQUIRE(engine.bond_count() == topo.bond_i.size());
+        REQUIRE(engine.angle_count() == topo.angle_i.size());
+        REQUIRE(engine.dihedral_count() == topo.dihedral_i.size());
+        check_batches(engine.bond_batches(), engine.bond_atoms(), 2, engine.bond_count());
+        check_batches(engine.angle_batches(), engine.angle_atoms(), 3, engine.angle_count());
+        check_batches(engine.dihedral_batches(), engine.dihedral_atoms(), 4, engine.dihedral_count());
+        same_energy(engine.evaluate(positions), expected);
+        rms::Coordinates forces;
+        auto const with_forces = engine.evaluate(positions, &forces);
+        same_energy(with_forces, expected);
+        same_forces(forces, expected_forces);
+        // Batches fix the order of every force sum, whatever the thread count.
+        if (threads == 1) {
+          serial = forces;
+        } else {
+          REQUIRE(forces == serial);
+        }
+      }
+    }
+  }
+
+  SECTION("terms sharing one atom spill past 64 batches") {
+    auto star = topo;
+    for (std::size_t n = 0; n < star.bond_i.size(); ++n) {
+      star.bond_i[n] = star.bond_j[n] == 0 ? 1 : 0;
+    }
+    rms::BondedEngine const engine(star, rms::BondedOptions{.threads = 3});
+    REQUIRE(engine.bond_batches().size() > 65);
+    check_batches(engine.bond_batches(), engine.bond_atoms(), 2, engine.bond_count());
+    REQUIRE(engine.evaluate(positions).bond == Catch::Approx(reference(star, positions).bond).epsilon(1e-10));
+  }
+
+  rms::BondedEngine const probe(topo);
+  REQUIRE_THROWS_AS(probe.evaluate(rms::Coordinates(natom - 1)), std::invalid_argument);
+  auto fractional = topo;
+  fractional.dihedral_periodicity[0] = 2.5;
+  REQUIRE_THROWS_AS(rms::BondedEngine(fractional), std::runtime_error);
+  auto stray = topo;
+  stray.angle_k[3] = static_cast<int>(natom);
+  REQUIRE_THROWS_AS(rms::BondedEngine(stray), std::runtime_error);
+  rms::Parm7ParseOptions partial;
+  partial.sections = rms::kAllParm7Sections & ~rms::section_bit(rms::Parm7Section::DihedralPhase);
+  REQUIRE_THROWS_AS(rms::BondedEngine(rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), partial)),
+    std::runtime_error);
+}
+
+TEST_CASE("1-4 pair list matches an ordered-set build", "[one_four]") {
+  // A chain long enough for several radix passes and blocks, with every
+  // third dihedral repeated (ends swapped, other type) after the originals.
+  rms::SyntheticSystem const system{.solute_atoms = 40000, .waters = 10};
+  auto topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  std::size_t const original = topo.dihedral_i.size();
+  for (std::size_t dihedral = 0; dihedral < original; dihedral += 3) {
+    topo.dihedral_i.push_back(topo.dihedral_l[dihedral]);
+    topo.dihedral_j.push_back(topo.dihedral_k[dihedral]);
+    topo.dihedral_k.push_back(topo.dihedral_j[dihedral]);
+    topo.dihedral_l.push_back(topo.dihedral_i[dihedral]);
+    topo.dihedral_type.push_back(1 - topo.dihedral_type[dihedral]);
+    topo.dihedral_flags.push_back(0);
+  }
+  topo.scee_scale_factor[1] = 1.0;
+  topo.scnb_scale_factor[1] = 1.5;
+
+  // The naive build: first unflagged dihedral of each pair wins.
+  std::map<std::pair<int, int>, std::size_t> expected;
+  for (std::size_t dihedral = 0; dihedral < topo.dihedral_i.size(); ++dihedral) {
+    if ((topo.dihedral_flags[dihedral] & 0x1U) == 0) {
+      expected.try_emplace(std::minmax(topo.dihedral_i[dihedral], topo.dihedral_l[dihedral]),
+        static_cast<std::size_t>(topo.dihedral_type[dihedral]));
+    }
+  }
+
+  for (std::size_t const threads : {std::size_t{1}, std::size_t{3}, std::size_t{8}}) {
+    rms::OneFourList const list(topo, threads);
+    REQUIRE(list.size() == expected.size());
+    std::size_t idx = 0;
+    for (auto const &[pair, type] : expected) {
+      REQUIRE(list.i()[idx] == pair.first);
+      REQUIRE(list.j()[idx] == pair.second);
+      REQUIRE(list.scee()[idx] == topo.scee_scale_factor[type]);
+      REQUIRE(list.scnb()[idx] == topo.scnb_scale_factor[type]);
+      ++idx;
+    }
+  }
+
+  // Without SCEE / SCNB the Amber defaults apply.
+  auto unscaled = topo;
+  unscaled.scee_scale_factor.clear();
+  unscaled.scnb_scale_factor.clear();
+  rms::OneFourList const defaults(unscaled, 2);
+  REQUIRE(defaults.size() == expected.size());
+  REQUIRE(std::ranges::all_of(defaults.scee(), [](double value) { return value == 1.2; }));
+  REQUIRE(std::ranges::all_of(defaults.scnb(), [](double value) { return value == 2.0; }));
+
+  auto self = topo;
+  self.dihedral_l[5] = self.dihedral_i[5];
+  self.dihedral_flags[5] = 0;
+  REQUIRE_THROWS_AS(rms::OneFourList(self), std::runtime_error);
+  auto stray = topo;
+  stray.dihedral_l[0] = topo.pointers.natom;
+  REQUIRE_THROWS_AS(rms::OneFourList(stray), std::runtime_error);
+  auto short_scee = topo;
+  short_scee.scee_scale_factor.pop_back();
+  REQUIRE_THROWS_AS(rms::OneFourList(short_scee), std::runtime_error);
+  rms::Parm7ParseOptions partial;
+  partial.sections = rms::kAllParm7Sections
+                   & ~rms::section_mask(
+                     {rms::Parm7Section::DihedralsIncHydrogen, rms::Parm7Section::DihedralsWithoutHydrogen});
+  REQUIRE_THROWS_AS(rms::OneFourList(rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), partial)),
+    std::runtime_error);
+}
+
+TEST_CASE("Generalized Born energy matches sander's pairwise formulas", "[gb][simd]") {
+  rms::SyntheticSystem const system{.solute_atoms = 40, .waters = 300};
+  auto const topo = rms::parse_parm7_buffer(rms::make_synthetic_parm7(system));
+  auto positions = rms::make_synthetic_coordinates(system).positions;
+  std::mt19937_64 rng(11);
+  std::normal_distribution<double> jitter(0.0, 0.2);
+  for (std::size_t atom = 0; atom < positions.size(); ++atom) {
+    positions.x[atom] += jitter(rng);
+    positions.y[atom] += jitter(rng);
+    positions.z[atom] += jitter(rng);
+  }
+  auto const natom = positions.size();
+
+  // sander's egb.F descreening branches (all but its tail series), Born
+  // radii and pair sum, written out directly.
+  auto const reference = [&](const rms::Coordinates &at, const rms::GeneralizedBornOptions &options,
+                           std::vector<double> &born) {
+    auto const descreen = [&](double r, double rho, double s) {
+      double const rgbmax = options.rgbmax;
+      if (r > rgbmax + s) {
+        return 0.0;
+      }
+      if (r > rgbmax - s) {
+        return 0.125 / r
+             * (1.0 + 2.0 * r / (r - s) + (r * r - 4.0 * rgbmax * r - s * s) / (rgbmax * rgbmax)
+                + 2.0 * std::log((r - s) / rgbmax));
+      }
+      if (r > rho + s) {
+        return 0.5 * (s / (r * r - s * s) + 0.5 / r * std::log((r - s) / (r + s)));
+      }
+      if (r > std::abs(rho - s)) {
+        double const theta = 0.5 / (rho * r) * (r * r + rho * rho - s * s);
+        double const u = 1.0 / (r + s);
+        return 0.25 * ((2.0 - theta) / rho - u + std::log(rho * u) / r);
+      }
+      if (rho < s) {
+        return 0.5 * (s / (r * r - s * s) + 2.0 / rho + 0.5 / r * std::log((s - r) / (s + r)));
+      }
+      return 0.0;
+    };
+    auto const distance = [&](std::size_t i, std::size_t j) {
+      double const dx = at.x[j] - at.x[i];
+      double const dy = at.y[j] - at.y[i];
+      double const dz = at.z[j] - at.z[i];
+      return std::sqrt(dx * dx + dy * dy + dz * dz);
+    };
+    born.assign(natom, 0.0);
+    for (std::size_t i = 0; i < natom; ++i) {
+      double const rho = topo.radii[i] - options.offset;
+      double integral = 0.0;
+      for (std::size_t j = 0; j < natom; ++j) {
+        if (j != i) {
+          integral += descreen(distance(i, j), rho, topo.screen[j] * (topo.radii[j] - options.offset));
+        }
+      }
+      if (options.model == rms::GbModel::Hct) {
+        born[i] = 1.0 / (1.0 / rho - integral);
+      } else {
+        auto const [alpha, beta, gamma] = options.model == rms::GbModel::ObcI ? std::array{0.8, 0.0, 2.909125}
+                                                                               : std::array{1.0, 0.8, 4.85};
+        double const psi = integral * rho;
+        born[i] = 1.0 / (1.0 / rho - std::tanh((alpha - beta * psi + gamma * psi * psi) * psi) / topo.radii[i]);
+      }
+    }
+    double const kappa = std::sqrt(0.10806 * options.salt_concentration);
+    auto const screening = [&](double f) {
+      return 1.0 / options.solute_dielectric - std::exp(-kappa * f) / options.solvent_dielectric;
+    };
+    double energy = 0.0;
+    for (std::size_t i = 0; i < natom; ++i) {
+      energy -= 0.5 * topo.charge[i] * topo.charge[i] * screening(born[i]) / born[i];
+      for (std::size_t j = i + 1; j < natom; ++j) {
+        double const r = distance(i, j);
+        if (r < options.cutoff) {
+          double const rr = born[i] * born[j];
+          double const f = std::sqrt(r * r + rr * std::exp(-r * r / (4.0 * rr)));
+          energy -= topo.charge[i] * topo.charge[j] * screening(f) / f;
+        }
+      }
+    }
+    return energy;
+  };
+
+  SECTION("every model, SIMD tier and thread count") {
+    for (auto const &base :
+      {rms::GeneralizedBornOptions{.model = rms::GbModel::Hct},
+        rms::GeneralizedBornOptions{.model = rms::GbModel::ObcI, .rgbmax = 10.0},
+        rms::GeneralizedBornOptions{.model = rms::GbModel::ObcII, .salt_concentration = 0.15, .cutoff = 12.0}}) {
+      std::vector<double> expected_born;
+      double const expected = reference(positions, base, expected_born);
+      REQUIRE(expected < 0.0);
+      for (auto const level : {rms::SimdLevel::Scalar, rms::SimdLevel::Avx2, rms::SimdLevel::Avx512}) {
+        if (level > rms::detected_simd_level()) {
+          break;
+        }
+        double serial = 0.0;
+        for (std::size_t const threads : {std::size_t{1}, std::size_t{4}}) {
+          auto options = base;
+          options.threads = threads;
+          options.level = level;
+          rms::GeneralizedBornEngine engine(topo, options);
+          double const energy = engine.evaluate(positions);
+          REQUIRE(energy == Catch::Approx(expected).epsilon(1e-11));
+          auto const born = engine.born_radii();
+          REQUIRE(born.size() == natom);
+          for (std::size_t atom = 0; atom < natom; ++atom) {
+            REQUIRE(born[atom] == Catch::Approx(expected_born[atom]).epsilon(1e-11));
+          }
+          // The same bits for any thread count.
+          if (threads == 1) {
+            serial = energy;
+          } else {
+            REQUIRE(energy == serial);
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("isolated atoms keep their radii and give the Born self energy") {
+    auto spread = positions;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      spread.x[atom] *= 100.0;
+      spread.y[atom] *= 100.0;
+      spread.z[atom] = 100.0 * static_cast<double>(atom);
+    }
+    double expected = 0.0;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      expected -= 0.5 * topo.charge[atom] * topo.charge[atom] * (1.0 - 1.0 / 78.5) / (topo.radii[atom] - 0.09);
+    }
+    for (auto const model : {rms::GbModel::Hct, rms::GbModel::ObcI, rms::GbModel::ObcII}) {
+      rms::GeneralizedBornEngine engine(topo, rms::GeneralizedBornOptions{.model = model, .cutoff = 1.0});
+      REQUIRE(engine.evaluate(spread) == Catch::Approx(expected).epsilon(1e-12));
+      for (std::size_t atom = 0; atom < natom; ++atom) {
+        REQUIRE(engine.born_radii()[atom] == Catch::Approx(topo.radii[atom] - 0.09).epsilon(1e-14));
+      }
+    }
+  }
+
+  SECTION("a selection is scored as a system of its own") {
+    // Waters moved far apart from everything only add their Born self
+    // energies to the full system, so the solute alone must make up the rest.
+    auto const solute = rms::compile_mask("!:WAT", topo);
+    REQUIRE(solute.size() == system.solute_atoms);
+    auto apart = positions;
+    double water_self = 0.0;
+    for (std::size_t atom = 0; atom < natom; ++atom) {
+      if (!solute.contains(atom)) {
+        apart.x[atom] = 1000.0 * static_cast<double>(atom);
+        water_self -= 0.5 * topo.charge[atom] * topo.charge[atom] * (1.0 - 1.0 / 78.5) / (topo.radii[atom] - 0.09);
+      }
+    }
+    rms::GeneralizedBornOptions const options{.cutoff = 100.0, .threads = 2};
+    rms::GeneralizedBornEngine whole(topo, options);
+    rms::GeneralizedBornEngine part(topo, solute, options);
+    REQUIRE(part.atom_count() == natom);
+    double const energy = part.evaluate(apart);
+    REQUIRE(energy < 0.0);
+    REQUIRE(whole.evaluate(apart) == Catch::Approx(energy + water_self).epsilon(1e-12));
+    REQUIRE(part.born_radii().size() == solute.size());
+    for (std::size_t idx = 0; idx < solute.size(); ++idx) {
+      auto const atom = static_cast<std::size_t>(solute.indices()[idx]);
+      REQUIRE(part.born_radii()[idx] == Catch::Approx(whole.born_radii()[atom]).epsilon(1e-12));
+    }
+    // Selecting every atom is the plain engine.
+    rms::GeneralizedBornEngine every(topo, rms::AtomSelection::all(natom), options);
+    REQUIRE(every.evaluate(positions) == whole.evaluate(positions));
+    rms::AtomSelection const none(natom, std::vector<std::uint64_t>((natom + 63) / 64, 0));
+    REQUIRE(rms::GeneralizedBornEngine(topo, none, options).evaluate(positions) == 0.0);
+  }
+
+  rms::GeneralizedBornEngine probe(topo);
+  REQUIRE_THROWS_AS(probe.evaluate(rms::Coordinates(natom - 1)), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::GeneralizedBornEngine(topo, rms::AtomSelection::all(natom - 1)), std::invalid_argument);
+  REQUIRE_THROWS_AS(
+    rms::GeneralizedBornEngine(topo, rms::GeneralizedBornOptions{.solvent_dielectric = 0.0}), std::invalid_argument);
+  REQUIRE_THROWS_AS(
+    rms::GeneralizedBornEngine(topo, rms::GeneralizedBornOptions{.salt_concentration = -0.1}), std::invalid_argument);
+  REQUIRE_THROWS_AS(rms::GeneralizedBornEngine(topo, rms::GeneralizedBornOptions{.offset = 1.0}), std::runtime_error);
+  rms::Parm7ParseOptions partial;
+  partial.sections = rms::kAllParm7Sections & ~rms::section_bit(rms::Parm7Section::Screen);
+  REQUIRE_THROWS_AS(rms::GeneralizedBornEngine(rms::parse_parm7_buffer(rms::make_synthetic_parm7(system), partial)),
+    std::runtime_error);
+}